@@ -346,6 +346,8 @@ BiInitializeAndValidateHive (
                           NULL,
                           NULL,
                           NULL,
+                          NULL,
+                          NULL,
                           0,
                           NULL);
     if (NT_SUCCESS(Status))
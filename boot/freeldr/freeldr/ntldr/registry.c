@@ -73,6 +73,8 @@ RegImportBinaryHive(
                           NULL,
                           NULL,
                           NULL,
+                          NULL,
+                          NULL,
                           1,
                           NULL);
     if (!NT_SUCCESS(Status))
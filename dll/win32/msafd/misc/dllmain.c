@@ -2804,6 +2804,7 @@ WSPSetSockOpt(
                             sizeof(struct linger));
               return NO_ERROR;
 
+           case SO_RCVBUF:
            case SO_SNDBUF:
               if (optlen < sizeof(DWORD))
               {
@@ -2811,9 +2812,28 @@ WSPSetSockOpt(
                   return SOCKET_ERROR;
               }
 
-              /* TODO: The total per-socket buffer space reserved for sends */
-              ERR("Setting send buf to %x is not implemented yet\n", optval);
-              return NO_ERROR;
+              /* Size the buffers of AFD... */
+              Errno = SetSocketInformation(Socket,
+                                           (optname == SO_RCVBUF) ? AFD_INFO_RECEIVE_WINDOW_SIZE :
+                                                                    AFD_INFO_SEND_WINDOW_SIZE,
+                                           NULL,
+                                           (PULONG)optval,
+                                           NULL,
+                                           NULL,
+                                           NULL);
+              if (Errno != NO_ERROR)
+              {
+                  if (lpErrno) *lpErrno = WSAENOBUFS;
+                  return SOCKET_ERROR;
+              }
+
+              if (optname == SO_RCVBUF)
+                  RtlCopyMemory(&Socket->SharedData->SizeOfRecvBuffer, optval, sizeof(DWORD));
+              else
+                  RtlCopyMemory(&Socket->SharedData->SizeOfSendBuffer, optval, sizeof(DWORD));
+
+              /* ...and let the helper size those of the transport */
+              goto SendToHelper;
 
            case SO_ERROR:
               if (optlen < sizeof(INT))
@@ -414,7 +414,11 @@ FAT12CountAvailableClusters(
         }
 
         if (Entry == 0)
+        {
             ulCount++;
+            if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+        }
     }
 
     CcUnpinData(Context);
@@ -465,7 +469,11 @@ FAT16CountAvailableClusters(
         while (Block < BlockEnd && i < FatLength)
         {
             if (*Block == 0)
+            {
                 ulCount++;
+                if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                    RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+            }
             Block++;
             i++;
         }
@@ -521,7 +529,11 @@ FAT32CountAvailableClusters(
         while (Block < BlockEnd && i < FatLength)
         {
             if ((*Block & 0x0fffffff) == 0)
+            {
                 ulCount++;
+                if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+                    RtlClearBit(&DeviceExt->FreeClusterBitmap, i);
+            }
             Block++;
             i++;
         }
@@ -541,15 +553,40 @@ CountAvailableClusters(
     PLARGE_INTEGER Clusters)
 {
     NTSTATUS Status = STATUS_SUCCESS;
+    PULONG BitmapBuffer;
+
     ExAcquireResourceExclusiveLite (&DeviceExt->FatResource, TRUE);
     if (!DeviceExt->AvailableClustersValid)
     {
+        /* Build the free cluster bitmap in the same pass, if we can afford it */
+        if (DeviceExt->FreeClusterBitmap.Buffer == NULL)
+        {
+            BitmapBuffer = ExAllocatePoolWithTag(PagedPool,
+                                                 ROUND_UP(DeviceExt->FatInfo.NumberOfClusters + 2, 32) / 8,
+                                                 TAG_BITMAP);
+            if (BitmapBuffer != NULL)
+            {
+                RtlInitializeBitMap(&DeviceExt->FreeClusterBitmap,
+                                    BitmapBuffer,
+                                    DeviceExt->FatInfo.NumberOfClusters + 2);
+            }
+        }
+        if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+            RtlSetAllBits(&DeviceExt->FreeClusterBitmap);
+
         if (DeviceExt->FatInfo.FatType == FAT12)
             Status = FAT12CountAvailableClusters(DeviceExt);
         else if (DeviceExt->FatInfo.FatType == FAT16 || DeviceExt->FatInfo.FatType == FATX16)
             Status = FAT16CountAvailableClusters(DeviceExt);
         else
             Status = FAT32CountAvailableClusters(DeviceExt);
+
+        /* A partial bitmap would hide free clusters, go back to scanning the FAT */
+        if (!NT_SUCCESS(Status) && DeviceExt->FreeClusterBitmap.Buffer != NULL)
+        {
+            ExFreePoolWithTag(DeviceExt->FreeClusterBitmap.Buffer, TAG_BITMAP);
+            DeviceExt->FreeClusterBitmap.Buffer = NULL;
+        }
     }
     if (Clusters != NULL)
     {
@@ -710,6 +747,12 @@ WriteCluster(
 
     ExAcquireResourceExclusiveLite (&DeviceExt->FatResource, TRUE);
     Status = DeviceExt->WriteCluster(DeviceExt, ClusterToWrite, NewValue, &OldValue);
+    if (!NT_SUCCESS(Status))
+    {
+        ExReleaseResourceLite(&DeviceExt->FatResource);
+        return Status;
+    }
+
     if (DeviceExt->AvailableClustersValid)
     {
         if (OldValue && NewValue == 0)
@@ -717,6 +760,13 @@ WriteCluster(
         else if (OldValue == 0 && NewValue)
             InterlockedDecrement((PLONG)&DeviceExt->AvailableClusters);
     }
+    if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+    {
+        if (NewValue == 0)
+            RtlClearBit(&DeviceExt->FreeClusterBitmap, ClusterToWrite);
+        else
+            RtlSetBit(&DeviceExt->FreeClusterBitmap, ClusterToWrite);
+    }
     ExReleaseResourceLite(&DeviceExt->FatResource);
     return Status;
 }
@@ -764,6 +814,122 @@ GetNextCluster(
     return Status;
 }
 
+/*
+ * FUNCTION: Allocates ClusterCount clusters and appends them to the chain
+ *           ending with LastCluster, or starts a new chain if LastCluster is 0.
+ *           The clusters are taken in runs as long as the free space allows,
+ *           starting right after LastCluster when possible.
+ */
+NTSTATUS
+AllocateClusters(
+    PDEVICE_EXTENSION DeviceExt,
+    ULONG LastCluster,
+    ULONG ClusterCount,
+    PULONG FirstCluster)
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+    ULONG Previous = LastCluster;
+    ULONG Index, Length, i;
+    ULONG Cluster, NextCluster;
+
+    DPRINT("AllocateClusters(DeviceExt %p, LastCluster %x, ClusterCount %u)\n",
+           DeviceExt, LastCluster, ClusterCount);
+
+    *FirstCluster = 0;
+
+    ExAcquireResourceExclusiveLite(&DeviceExt->FatResource, TRUE);
+
+    /* Don't start a chain we already know we can't complete */
+    if (DeviceExt->AvailableClustersValid && DeviceExt->AvailableClusters < ClusterCount)
+    {
+        ExReleaseResourceLite(&DeviceExt->FatResource);
+        return STATUS_DISK_FULL;
+    }
+
+    while (ClusterCount > 0)
+    {
+        if (DeviceExt->FreeClusterBitmap.Buffer != NULL)
+        {
+            /* Look for a run big enough for all the clusters, else take the longest one */
+            Length = ClusterCount;
+            Index = RtlFindClearBits(&DeviceExt->FreeClusterBitmap,
+                                     ClusterCount,
+                                     Previous != 0 ? Previous + 1 : DeviceExt->LastAvailableCluster);
+            if (Index == 0xFFFFFFFF)
+            {
+                Length = RtlFindLongestRunClear(&DeviceExt->FreeClusterBitmap, &Index);
+                if (Length == 0)
+                {
+                    Status = STATUS_DISK_FULL;
+                    break;
+                }
+                Length = min(Length, ClusterCount);
+            }
+
+            /* Chain the clusters of the run, ending with EOF, before linking it to the chain */
+            for (i = 0; i < Length; i++)
+            {
+                Status = WriteCluster(DeviceExt, Index + i, i + 1 < Length ? Index + i + 1 : 0xFFFFFFFF);
+                if (!NT_SUCCESS(Status))
+                    break;
+            }
+            if (NT_SUCCESS(Status) && Previous != 0)
+                Status = WriteCluster(DeviceExt, Previous, Index);
+            if (!NT_SUCCESS(Status))
+            {
+                /* The run never made it into the chain, free what was written of it */
+                while (i-- > 0)
+                    WriteCluster(DeviceExt, Index + i, 0);
+                break;
+            }
+            if (*FirstCluster == 0)
+                *FirstCluster = Index;
+
+            DeviceExt->LastAvailableCluster = Index + Length;
+        }
+        else
+        {
+            Length = 1;
+            Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &Index);
+            if (!NT_SUCCESS(Status))
+                break;
+
+            if (Previous != 0)
+            {
+                Status = WriteCluster(DeviceExt, Previous, Index);
+                if (!NT_SUCCESS(Status))
+                {
+                    WriteCluster(DeviceExt, Index, 0);
+                    break;
+                }
+            }
+            if (*FirstCluster == 0)
+                *FirstCluster = Index;
+        }
+
+        Previous = Index + Length - 1;
+        ClusterCount -= Length;
+    }
+
+    if (!NT_SUCCESS(Status) && *FirstCluster != 0)
+    {
+        /* Give back what we got so far, the chain ends where it used to */
+        if (LastCluster != 0)
+            WriteCluster(DeviceExt, LastCluster, 0xFFFFFFFF);
+
+        for (Cluster = *FirstCluster; Cluster > 1 && Cluster != 0xFFFFFFFF; Cluster = NextCluster)
+        {
+            if (!NT_SUCCESS(DeviceExt->GetNextCluster(DeviceExt, Cluster, &NextCluster)))
+                break;
+            WriteCluster(DeviceExt, Cluster, 0);
+        }
+        *FirstCluster = 0;
+    }
+
+    ExReleaseResourceLite(&DeviceExt->FatResource);
+    return Status;
+}
+
 /*
  * FUNCTION: Retrieve the next cluster depending on the FAT type
  */
@@ -773,7 +939,6 @@ GetNextClusterExtend(
     ULONG CurrentCluster,
     PULONG NextCluster)
 {
-    ULONG NewCluster;
     NTSTATUS Status;
 
     DPRINT("GetNextClusterExtend(DeviceExt %p, CurrentCluster %x)\n",
@@ -786,16 +951,9 @@ GetNextClusterExtend(
      */
     if (CurrentCluster == 0)
     {
-        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
-        if (!NT_SUCCESS(Status))
-        {
-            ExReleaseResourceLite(&DeviceExt->FatResource);
-            return Status;
-        }
-
-        *NextCluster = NewCluster;
+        Status = AllocateClusters(DeviceExt, 0, 1, NextCluster);
         ExReleaseResourceLite(&DeviceExt->FatResource);
-        return STATUS_SUCCESS;
+        return Status;
     }
 
     Status = DeviceExt->GetNextCluster(DeviceExt, CurrentCluster, NextCluster);
@@ -803,19 +961,7 @@ GetNextClusterExtend(
     if ((*NextCluster) == 0xFFFFFFFF)
     {
         /* We are after last existing cluster, we must add one to file */
-        /* Firstly, find the next available open allocation unit and
-           mark it as end of file */
-        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
-        if (!NT_SUCCESS(Status))
-        {
-            ExReleaseResourceLite(&DeviceExt->FatResource);
-            return Status;
-        }
-
-        /* Now, write the AU of the LastCluster with the value of the newly
-           found AU */
-        WriteCluster(DeviceExt, CurrentCluster, NewCluster);
-        *NextCluster = NewCluster;
+        Status = AllocateClusters(DeviceExt, CurrentCluster, 1, NextCluster);
     }
 
     ExReleaseResourceLite(&DeviceExt->FatResource);
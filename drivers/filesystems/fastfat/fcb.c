@@ -151,7 +151,7 @@ vfatNewFCB(
     ExInitializeResourceLite(&rcFCB->PagingIoResource);
     ExInitializeResourceLite(&rcFCB->MainResource);
     FsRtlInitializeFileLock(&rcFCB->FileLock, NULL, NULL);
-    ExInitializeFastMutex(&rcFCB->LastMutex);
+    ExInitializeFastMutex(&rcFCB->RunMutex);
     rcFCB->RFCB.PagingIoResource = &rcFCB->PagingIoResource;
     rcFCB->RFCB.Resource = &rcFCB->MainResource;
     rcFCB->RFCB.IsFastIoPossible = FastIoIsNotPossible;
@@ -283,6 +283,10 @@ vfatDestroyFCB(
     {
         RemoveEntryList(&pFCB->ParentListEntry);
     }
+    if (pFCB->Runs != NULL)
+    {
+        ExFreePoolWithTag(pFCB->Runs, TAG_RUNS);
+    }
     ExFreePool(pFCB->PathNameBuffer);
     ExDeleteResourceLite(&pFCB->PagingIoResource);
     ExDeleteResourceLite(&pFCB->MainResource);
@@ -1244,36 +1244,16 @@ VfatSetAllocationSizeInformation(
         AllocSizeChanged = TRUE;
         if (FirstCluster == 0)
         {
-            Fcb->LastCluster = Fcb->LastOffset = 0;
-            Status = NextCluster(DeviceExt, FirstCluster, &FirstCluster, TRUE);
+            /* Allocate the whole chain at once, so that it can be contiguous */
+            Status = AllocateClusters(DeviceExt, 0,
+                                      ROUND_DOWN(NewSize - 1, ClusterSize) / ClusterSize + 1,
+                                      &FirstCluster);
             if (!NT_SUCCESS(Status))
             {
-                DPRINT1("NextCluster failed. Status = %x\n", Status);
+                DPRINT1("AllocateClusters failed. Status = %x\n", Status);
                 return Status;
             }
 
-            if (FirstCluster == 0xffffffff)
-            {
-                return STATUS_DISK_FULL;
-            }
-
-            Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                     ROUND_DOWN(NewSize - 1, ClusterSize),
-                                     &NCluster, TRUE);
-            if (NCluster == 0xffffffff || !NT_SUCCESS(Status))
-            {
-                /* disk is full */
-                NCluster = Cluster = FirstCluster;
-                Status = STATUS_SUCCESS;
-                while (NT_SUCCESS(Status) && Cluster != 0xffffffff && Cluster > 1)
-                {
-                    Status = NextCluster(DeviceExt, FirstCluster, &NCluster, FALSE);
-                    WriteCluster(DeviceExt, Cluster, 0);
-                    Cluster = NCluster;
-                }
-                return STATUS_DISK_FULL;
-            }
-
             if (IsFatX)
             {
                 Fcb->entry.FatX.FirstCluster = FirstCluster;
@@ -1294,55 +1274,29 @@ VfatSetAllocationSizeInformation(
         }
         else
         {
-            if (Fcb->LastCluster > 0)
+            Status = VfatGetClusterRun(DeviceExt, Fcb, FirstCluster,
+                                       Fcb->RFCB.AllocationSize.u.LowPart / ClusterSize - 1, 1,
+                                       &Cluster, &NCluster);
+            if (!NT_SUCCESS(Status))
             {
-                if (Fcb->RFCB.AllocationSize.u.LowPart - ClusterSize == Fcb->LastOffset)
-                {
-                    Cluster = Fcb->LastCluster;
-                    Status = STATUS_SUCCESS;
-                }
-                else
-                {
-                    Status = OffsetToCluster(DeviceExt, Fcb->LastCluster,
-                                             Fcb->RFCB.AllocationSize.u.LowPart - ClusterSize - Fcb->LastOffset,
-                                             &Cluster, FALSE);
-                }
+                return Status;
             }
-            else
+
+            if (Cluster == 0xffffffff)
             {
-                Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                         Fcb->RFCB.AllocationSize.u.LowPart - ClusterSize,
-                                         &Cluster, FALSE);
+                DPRINT1("WARNING: File system corruption detected. You may need to run a disk repair utility.\n");
+                return STATUS_FILE_CORRUPT_ERROR;
             }
 
+            /* Cluster points now to the last cluster within the chain,
+             * append all the missing ones at once so that they can follow it */
+            Status = AllocateClusters(DeviceExt, Cluster,
+                                      (ROUND_DOWN(NewSize - 1, ClusterSize) + ClusterSize - Fcb->RFCB.AllocationSize.u.LowPart) / ClusterSize,
+                                      &NCluster);
             if (!NT_SUCCESS(Status))
             {
                 return Status;
             }
-
-            Fcb->LastCluster = Cluster;
-            Fcb->LastOffset = Fcb->RFCB.AllocationSize.u.LowPart - ClusterSize;
-
-            /* FIXME: Check status */
-            /* Cluster points now to the last cluster within the chain */
-            Status = OffsetToCluster(DeviceExt, Cluster,
-                                     ROUND_DOWN(NewSize - 1, ClusterSize) - Fcb->LastOffset,
-                                     &NCluster, TRUE);
-            if (NCluster == 0xffffffff || !NT_SUCCESS(Status))
-            {
-                /* disk is full */
-                NCluster = Cluster;
-                Status = NextCluster(DeviceExt, FirstCluster, &NCluster, FALSE);
-                WriteCluster(DeviceExt, Cluster, 0xffffffff);
-                Cluster = NCluster;
-                while (NT_SUCCESS(Status) && Cluster != 0xffffffff && Cluster > 1)
-                {
-                    Status = NextCluster(DeviceExt, FirstCluster, &NCluster, FALSE);
-                    WriteCluster(DeviceExt, Cluster, 0);
-                    Cluster = NCluster;
-                }
-                return STATUS_DISK_FULL;
-            }
         }
         UpdateFileSize(FileObject, Fcb, NewSize, ClusterSize, vfatVolumeIsFatX(DeviceExt));
     }
@@ -1358,19 +1312,21 @@ VfatSetAllocationSizeInformation(
         DPRINT("Can set file size\n");
 
         AllocSizeChanged = TRUE;
-        /* FIXME: Use the cached cluster/offset better way. */
-        Fcb->LastCluster = Fcb->LastOffset = 0;
         UpdateFileSize(FileObject, Fcb, NewSize, ClusterSize, vfatVolumeIsFatX(DeviceExt));
         if (NewSize > 0)
         {
-            Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                     ROUND_DOWN(NewSize - 1, ClusterSize),
-                                     &Cluster, FALSE);
+            Status = VfatGetClusterRun(DeviceExt, Fcb, FirstCluster,
+                                       ROUND_DOWN(NewSize - 1, ClusterSize) / ClusterSize, 1,
+                                       &Cluster, &NCluster);
+            VfatTruncateClusterRuns(Fcb, ROUND_DOWN(NewSize - 1, ClusterSize) / ClusterSize + 1);
 
-            NCluster = Cluster;
-            Status = NextCluster(DeviceExt, FirstCluster, &NCluster, FALSE);
-            WriteCluster(DeviceExt, Cluster, 0xffffffff);
-            Cluster = NCluster;
+            if (NT_SUCCESS(Status) && Cluster != 0xffffffff)
+            {
+                NCluster = Cluster;
+                Status = NextCluster(DeviceExt, FirstCluster, &NCluster, FALSE);
+                WriteCluster(DeviceExt, Cluster, 0xffffffff);
+                Cluster = NCluster;
+            }
         }
         else
         {
@@ -1391,6 +1347,7 @@ VfatSetAllocationSizeInformation(
                 }
             }
 
+            VfatTruncateClusterRuns(Fcb, 0);
             NCluster = Cluster = FirstCluster;
             Status = STATUS_SUCCESS;
         }
@@ -113,6 +113,216 @@ OffsetToCluster(
    }
 }
 
+/*
+ * Append the cluster at Vcn, which must be the first unmapped one, to the
+ * runs of the FCB
+ */
+static
+BOOLEAN
+VfatAddClusterRun(
+    PVFATFCB Fcb,
+    ULONG Vcn,
+    ULONG Cluster)
+{
+    PVFAT_CLUSTER_RUN Runs;
+    PVFAT_CLUSTER_RUN Run;
+    ULONG MaxRunCount;
+
+    ASSERT(Vcn == Fcb->MappedClusters);
+
+    /* Grow the last run if the cluster follows it on the disk */
+    if (Fcb->RunCount > 0)
+    {
+        Run = &Fcb->Runs[Fcb->RunCount - 1];
+        if (Run->Cluster + Run->Length == Cluster)
+        {
+            Run->Length++;
+            Fcb->MappedClusters++;
+            return TRUE;
+        }
+    }
+
+    if (Fcb->RunCount == Fcb->MaxRunCount)
+    {
+        /* Non paged, as the paging file may live on FAT */
+        MaxRunCount = max(Fcb->MaxRunCount * 2, 8);
+        Runs = ExAllocatePoolWithTag(NonPagedPool, MaxRunCount * sizeof(VFAT_CLUSTER_RUN), TAG_RUNS);
+        if (Runs == NULL)
+        {
+            return FALSE;
+        }
+
+        if (Fcb->Runs != NULL)
+        {
+            RtlCopyMemory(Runs, Fcb->Runs, Fcb->RunCount * sizeof(VFAT_CLUSTER_RUN));
+            ExFreePoolWithTag(Fcb->Runs, TAG_RUNS);
+        }
+        Fcb->Runs = Runs;
+        Fcb->MaxRunCount = MaxRunCount;
+    }
+
+    Run = &Fcb->Runs[Fcb->RunCount++];
+    Run->Vcn = Vcn;
+    Run->Cluster = Cluster;
+    Run->Length = 1;
+    Fcb->MappedClusters++;
+    return TRUE;
+}
+
+/*
+ * Return the cluster at Vcn in the file, and how many of the following ones,
+ * up to ClusterCount, are contiguous with it on the disk. Cluster is set to
+ * 0xffffffff if the chain ends before Vcn. The chain is only walked past the
+ * clusters already in the runs of the FCB, and the runs are completed on the
+ * way, so that the FAT is read once per cluster for the life of the FCB.
+ * Reading the FAT may wait for I/O, so RunMutex is dropped around it and the
+ * runs are checked again before they are extended.
+ */
+NTSTATUS
+VfatGetClusterRun(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB Fcb,
+    ULONG FirstCluster,
+    ULONG Vcn,
+    ULONG ClusterCount,
+    PULONG Cluster,
+    PULONG RunLength)
+{
+    PVFAT_CLUSTER_RUN Run;
+    ULONG Low, High, Middle;
+    ULONG CurrentVcn, CurrentCluster, NextCluster;
+    BOOLEAN EndOfChain = FALSE;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    ASSERT(FirstCluster != 1);
+    ASSERT(ClusterCount > 0);
+
+    *Cluster = 0xffffffff;
+    *RunLength = 0;
+
+    if (FirstCluster == 0)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    ExAcquireFastMutex(&Fcb->RunMutex);
+
+    if (Fcb->RunCount == 0 && Vcn + ClusterCount > Fcb->MappedClusters)
+    {
+        VfatAddClusterRun(Fcb, 0, FirstCluster);
+    }
+
+    /* Resume the walk where the previous one stopped */
+    while (Fcb->RunCount > 0 && Vcn + ClusterCount > Fcb->MappedClusters)
+    {
+        Run = &Fcb->Runs[Fcb->RunCount - 1];
+        CurrentVcn = Run->Vcn + Run->Length - 1;
+        CurrentCluster = Run->Cluster + Run->Length - 1;
+
+        ExReleaseFastMutex(&Fcb->RunMutex);
+        Status = GetNextCluster(DeviceExt, CurrentCluster, &NextCluster);
+        ExAcquireFastMutex(&Fcb->RunMutex);
+
+        if (!NT_SUCCESS(Status))
+        {
+            break;
+        }
+
+        if (NextCluster == 0xffffffff)
+        {
+            EndOfChain = TRUE;
+            break;
+        }
+
+        if (NextCluster < 2)
+        {
+            DPRINT1("WARNING: File system corruption detected. You may need to run a disk repair utility.\n");
+            Status = STATUS_FILE_CORRUPT_ERROR;
+            break;
+        }
+
+        /* Someone else may have extended or truncated the runs meanwhile */
+        if (Fcb->RunCount == 0 || Fcb->MappedClusters != CurrentVcn + 1)
+        {
+            continue;
+        }
+
+        Run = &Fcb->Runs[Fcb->RunCount - 1];
+        if (Run->Cluster + Run->Length - 1 != CurrentCluster)
+        {
+            continue;
+        }
+
+        if (!VfatAddClusterRun(Fcb, CurrentVcn + 1, NextCluster))
+        {
+            break;
+        }
+    }
+
+    if (Vcn < Fcb->MappedClusters)
+    {
+        /* Find the run holding Vcn */
+        Low = 0;
+        High = Fcb->RunCount - 1;
+        while (Low < High)
+        {
+            Middle = (Low + High + 1) / 2;
+            if (Fcb->Runs[Middle].Vcn <= Vcn)
+                Low = Middle;
+            else
+                High = Middle - 1;
+        }
+
+        Run = &Fcb->Runs[Low];
+        ASSERT(Vcn >= Run->Vcn && Vcn < Run->Vcn + Run->Length);
+        *Cluster = Run->Cluster + (Vcn - Run->Vcn);
+        *RunLength = min(Run->Length - (Vcn - Run->Vcn), ClusterCount);
+        Status = STATUS_SUCCESS;
+    }
+
+    ExReleaseFastMutex(&Fcb->RunMutex);
+
+    if (NT_SUCCESS(Status) && *Cluster == 0xffffffff && !EndOfChain)
+    {
+        /* No memory for more runs, walk the chain for this cluster only */
+        Status = OffsetToCluster(DeviceExt, FirstCluster, Vcn * DeviceExt->FatInfo.BytesPerCluster, Cluster, FALSE);
+        *RunLength = 1;
+    }
+
+    return Status;
+}
+
+/*
+ * Forget the runs past the first ClusterCount clusters of the file, before
+ * they are freed
+ */
+VOID
+VfatTruncateClusterRuns(
+    PVFATFCB Fcb,
+    ULONG ClusterCount)
+{
+    PVFAT_CLUSTER_RUN Run;
+
+    ExAcquireFastMutex(&Fcb->RunMutex);
+
+    while (Fcb->RunCount > 0 && Fcb->Runs[Fcb->RunCount - 1].Vcn >= ClusterCount)
+    {
+        Fcb->RunCount--;
+    }
+
+    if (Fcb->MappedClusters > ClusterCount)
+    {
+        if (Fcb->RunCount > 0)
+        {
+            Run = &Fcb->Runs[Fcb->RunCount - 1];
+            Run->Length = ClusterCount - Run->Vcn;
+        }
+        Fcb->MappedClusters = ClusterCount;
+    }
+
+    ExReleaseFastMutex(&Fcb->RunMutex);
+}
+
 /*
  * FUNCTION: Reads data from a file
  */
@@ -126,7 +336,7 @@ VfatReadFileData(
 {
     ULONG CurrentCluster;
     ULONG FirstCluster;
-    ULONG StartCluster;
+    ULONG Vcn;
     ULONG ClusterCount;
     LARGE_INTEGER StartOffset;
     PDEVICE_EXTENSION DeviceExt;
@@ -136,8 +346,6 @@ VfatReadFileData(
     ULONG BytesDone;
     ULONG BytesPerSector;
     ULONG BytesPerCluster;
-    ULONG LastCluster;
-    ULONG LastOffset;
 
     /* PRECONDITION */
     ASSERT(IrpContext);
@@ -215,87 +423,34 @@ VfatReadFileData(
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    LastCluster = Fcb->LastCluster;
-    LastOffset = Fcb->LastOffset;
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
-    /* Find the cluster to start the read from */
-    if (LastCluster > 0 && ReadOffset.u.LowPart >= LastOffset)
-    {
-        Status = OffsetToCluster(DeviceExt, LastCluster,
-                                 ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) -
-                                 LastOffset,
-                                 &CurrentCluster, FALSE);
-#ifdef DEBUG_VERIFY_OFFSET_CACHING
-        /* DEBUG VERIFICATION */
-        {
-            ULONG CorrectCluster;
-            OffsetToCluster(DeviceExt, FirstCluster,
-                            ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
-                            &CorrectCluster, FALSE);
-            if (CorrectCluster != CurrentCluster)
-                KeBugCheck(FAT_FILE_SYSTEM);
-        }
-#endif
-    }
-    else
-    {
-        Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                 ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster),
-                                 &CurrentCluster, FALSE);
-    }
-
+    /* Find the run to start the read from */
+    Vcn = ReadOffset.u.LowPart / BytesPerCluster;
+    Status = VfatGetClusterRun(DeviceExt, Fcb, FirstCluster, Vcn,
+                               ROUND_UP(ReadOffset.u.LowPart % BytesPerCluster + Length, BytesPerCluster) / BytesPerCluster,
+                               &CurrentCluster, &ClusterCount);
     if (!NT_SUCCESS(Status))
     {
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    Fcb->LastCluster = CurrentCluster;
-    Fcb->LastOffset = ROUND_DOWN (ReadOffset.u.LowPart, BytesPerCluster);
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     KeInitializeEvent(&IrpContext->Event, NotificationEvent, FALSE);
     IrpContext->RefCount = 1;
 
     while (Length > 0 && CurrentCluster != 0xffffffff)
     {
-        StartCluster = CurrentCluster;
-        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector;
-        BytesDone = 0;
-        ClusterCount = 0;
-
-        do
+        /* The clusters of the run follow each other on the disk, read them at once */
+        StartOffset.QuadPart = ClusterToSector(DeviceExt, CurrentCluster) * BytesPerSector;
+        if (First)
         {
-            ClusterCount++;
-            if (First)
-            {
-                BytesDone =  min (Length, BytesPerCluster - (ReadOffset.u.LowPart % BytesPerCluster));
-                StartOffset.QuadPart += ReadOffset.u.LowPart % BytesPerCluster;
-                First = FALSE;
-            }
-            else
-            {
-                if (Length - BytesDone > BytesPerCluster)
-                {
-                    BytesDone += BytesPerCluster;
-                }
-                else
-                {
-                    BytesDone = Length;
-                }
-            }
-            Status = NextCluster(DeviceExt, FirstCluster, &CurrentCluster, FALSE);
+            BytesDone = min(Length, ClusterCount * BytesPerCluster - (ReadOffset.u.LowPart % BytesPerCluster));
+            StartOffset.QuadPart += ReadOffset.u.LowPart % BytesPerCluster;
+            First = FALSE;
         }
-        while (StartCluster + ClusterCount == CurrentCluster && NT_SUCCESS(Status) && Length > BytesDone);
-        DPRINT("start %08x, next %08x, count %u\n",
-               StartCluster, CurrentCluster, ClusterCount);
-
-        ExAcquireFastMutex(&Fcb->LastMutex);
-        Fcb->LastCluster = StartCluster + (ClusterCount - 1);
-        Fcb->LastOffset = ROUND_DOWN(ReadOffset.u.LowPart, BytesPerCluster) + (ClusterCount - 1) * BytesPerCluster;
-        ExReleaseFastMutex(&Fcb->LastMutex);
+        else
+        {
+            BytesDone = min(Length, ClusterCount * BytesPerCluster);
+        }
+        DPRINT("start %08x, count %u\n", CurrentCluster, ClusterCount);
 
         /* Fire up the read command */
         Status = VfatReadDiskPartial (IrpContext, &StartOffset, BytesDone, *LengthRead, FALSE);
@@ -306,6 +461,18 @@ VfatReadFileData(
         *LengthRead += BytesDone;
         Length -= BytesDone;
         ReadOffset.u.LowPart += BytesDone;
+
+        if (Length > 0)
+        {
+            Vcn += ClusterCount;
+            Status = VfatGetClusterRun(DeviceExt, Fcb, FirstCluster, Vcn,
+                                       ROUND_UP(Length, BytesPerCluster) / BytesPerCluster,
+                                       &CurrentCluster, &ClusterCount);
+            if (!NT_SUCCESS(Status))
+            {
+                break;
+            }
+        }
     }
 
     if (InterlockedDecrement((PLONG)&IrpContext->RefCount) != 0)
@@ -341,7 +508,7 @@ VfatWriteFileData(
     ULONG FirstCluster;
     ULONG CurrentCluster;
     ULONG BytesDone;
-    ULONG StartCluster;
+    ULONG Vcn;
     ULONG ClusterCount;
     NTSTATUS Status = STATUS_SUCCESS;
     BOOLEAN First = TRUE;
@@ -349,8 +516,6 @@ VfatWriteFileData(
     ULONG BytesPerCluster;
     LARGE_INTEGER StartOffset;
     ULONG BufferOffset;
-    ULONG LastCluster;
-    ULONG LastOffset;
 
     /* PRECONDITION */
     ASSERT(IrpContext);
@@ -428,89 +593,36 @@ VfatWriteFileData(
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    LastCluster = Fcb->LastCluster;
-    LastOffset = Fcb->LastOffset;
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     /*
-     * Find the cluster to start the write from
+     * Find the run to start the write from
      */
-    if (LastCluster > 0 && WriteOffset.u.LowPart >= LastOffset)
-    {
-        Status = OffsetToCluster(DeviceExt, LastCluster,
-                                 ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) -
-                                 LastOffset,
-                                 &CurrentCluster, FALSE);
-#ifdef DEBUG_VERIFY_OFFSET_CACHING
-        /* DEBUG VERIFICATION */
-        {
-            ULONG CorrectCluster;
-            OffsetToCluster(DeviceExt, FirstCluster,
-                            ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
-                            &CorrectCluster, FALSE);
-            if (CorrectCluster != CurrentCluster)
-                KeBugCheck(FAT_FILE_SYSTEM);
-        }
-#endif
-    }
-    else
-    {
-        Status = OffsetToCluster(DeviceExt, FirstCluster,
-                                 ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster),
-                                 &CurrentCluster, FALSE);
-    }
-
+    Vcn = WriteOffset.u.LowPart / BytesPerCluster;
+    Status = VfatGetClusterRun(DeviceExt, Fcb, FirstCluster, Vcn,
+                               ROUND_UP(WriteOffset.u.LowPart % BytesPerCluster + Length, BytesPerCluster) / BytesPerCluster,
+                               &CurrentCluster, &ClusterCount);
     if (!NT_SUCCESS(Status))
     {
         return Status;
     }
 
-    ExAcquireFastMutex(&Fcb->LastMutex);
-    Fcb->LastCluster = CurrentCluster;
-    Fcb->LastOffset = ROUND_DOWN (WriteOffset.u.LowPart, BytesPerCluster);
-    ExReleaseFastMutex(&Fcb->LastMutex);
-
     IrpContext->RefCount = 1;
     BufferOffset = 0;
 
     while (Length > 0 && CurrentCluster != 0xffffffff)
     {
-        StartCluster = CurrentCluster;
-        StartOffset.QuadPart = ClusterToSector(DeviceExt, StartCluster) * BytesPerSector;
-        BytesDone = 0;
-        ClusterCount = 0;
-
-        do
+        // The clusters of the run follow each other on the disk, write them at once
+        StartOffset.QuadPart = ClusterToSector(DeviceExt, CurrentCluster) * BytesPerSector;
+        if (First)
         {
-            ClusterCount++;
-            if (First)
-            {
-                BytesDone =  min (Length, BytesPerCluster - (WriteOffset.u.LowPart % BytesPerCluster));
-                StartOffset.QuadPart += WriteOffset.u.LowPart % BytesPerCluster;
-                First = FALSE;
-            }
-            else
-            {
-                if (Length - BytesDone > BytesPerCluster)
-                {
-                    BytesDone += BytesPerCluster;
-                }
-                else
-                {
-                    BytesDone = Length;
-                }
-            }
-            Status = NextCluster(DeviceExt, FirstCluster, &CurrentCluster, FALSE);
+            BytesDone = min(Length, ClusterCount * BytesPerCluster - (WriteOffset.u.LowPart % BytesPerCluster));
+            StartOffset.QuadPart += WriteOffset.u.LowPart % BytesPerCluster;
+            First = FALSE;
         }
-        while (StartCluster + ClusterCount == CurrentCluster && NT_SUCCESS(Status) && Length > BytesDone);
-        DPRINT("start %08x, next %08x, count %u\n",
-               StartCluster, CurrentCluster, ClusterCount);
-
-        ExAcquireFastMutex(&Fcb->LastMutex);
-        Fcb->LastCluster = StartCluster + (ClusterCount - 1);
-        Fcb->LastOffset = ROUND_DOWN(WriteOffset.u.LowPart, BytesPerCluster) + (ClusterCount - 1) * BytesPerCluster;
-        ExReleaseFastMutex(&Fcb->LastMutex);
+        else
+        {
+            BytesDone = min(Length, ClusterCount * BytesPerCluster);
+        }
+        DPRINT("start %08x, count %u\n", CurrentCluster, ClusterCount);
 
         // Fire up the write command
         Status = VfatWriteDiskPartial (IrpContext, &StartOffset, BytesDone, BufferOffset, FALSE);
@@ -521,6 +633,18 @@ VfatWriteFileData(
         BufferOffset += BytesDone;
         Length -= BytesDone;
         WriteOffset.u.LowPart += BytesDone;
+
+        if (Length > 0)
+        {
+            Vcn += ClusterCount;
+            Status = VfatGetClusterRun(DeviceExt, Fcb, FirstCluster, Vcn,
+                                       ROUND_UP(Length, BytesPerCluster) / BytesPerCluster,
+                                       &CurrentCluster, &ClusterCount);
+            if (!NT_SUCCESS(Status))
+            {
+                break;
+            }
+        }
     }
 
     if (InterlockedDecrement((PLONG)&IrpContext->RefCount) != 0)
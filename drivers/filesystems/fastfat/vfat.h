@@ -330,6 +330,9 @@ typedef struct DEVICE_EXTENSION
     ULONG LastAvailableCluster;
     ULONG AvailableClusters;
     BOOLEAN AvailableClustersValid;
+    /* One bit per cluster, clear when the cluster is free. Buffer is NULL if
+     * it couldn't be allocated, the FAT is then scanned for each allocation */
+    RTL_BITMAP FreeClusterBitmap;
     ULONG Flags;
     struct _VFATFCB *VolumeFcb;
     struct _VFATFCB *RootFcb;
@@ -443,6 +446,15 @@ extern PVFAT_GLOBAL_DATA VfatGlobalData;
 
 #define NODE_TYPE_FCB ((CSHORT)0x0502)
 
+/* A run of clusters contiguous on the disk, Vcn is the index of the first
+ * one in the file */
+typedef struct _VFAT_CLUSTER_RUN
+{
+    ULONG Vcn;
+    ULONG Cluster;
+    ULONG Length;
+} VFAT_CLUSTER_RUN, *PVFAT_CLUSTER_RUN;
+
 typedef struct _VFATFCB
 {
     /* FCB header required by ROS/NT */
@@ -519,13 +531,16 @@ typedef struct _VFATFCB
     FILE_LOCK FileLock;
 
     /*
-     * Optimization: caching of last read/write cluster+offset pair. Can't
-     * be in VFATCCB because it must be reset everytime the allocated clusters
-     * change.
+     * Optimization: the runs of the cluster chain, sorted by Vcn, as far as
+     * it has been walked. They cover the clusters 0 to MappedClusters - 1 of
+     * the file. Can't be in VFATCCB because they must be truncated everytime
+     * clusters are removed from the chain.
      */
-    FAST_MUTEX LastMutex;
-    ULONG LastCluster;
-    ULONG LastOffset;
+    FAST_MUTEX RunMutex;
+    PVFAT_CLUSTER_RUN Runs;
+    ULONG RunCount;
+    ULONG MaxRunCount;
+    ULONG MappedClusters;
 
     struct _VFAT_CLOSE_CONTEXT * CloseContext;
 } VFATFCB, *PVFATFCB;
@@ -552,6 +567,8 @@ typedef struct _VFATCCB
 #define TAG_NAME 'ntaF'
 #define TAG_SEARCH 'LtaF'
 #define TAG_DIRENT 'DtaF'
+#define TAG_BITMAP 'BtaF'
+#define TAG_RUNS 'RtaF'
 
 #define ENTRIES_PER_SECTOR (BLOCKSIZE / sizeof(FATDirEntry))
 
@@ -919,6 +936,13 @@ GetNextClusterExtend(
     ULONG CurrentCluster,
     PULONG NextCluster);
 
+NTSTATUS
+AllocateClusters(
+    PDEVICE_EXTENSION DeviceExt,
+    ULONG LastCluster,
+    ULONG ClusterCount,
+    PULONG FirstCluster);
+
 NTSTATUS
 CountAvailableClusters(
     PDEVICE_EXTENSION DeviceExt,
@@ -1201,6 +1225,21 @@ NextCluster(
     PULONG CurrentCluster,
     BOOLEAN Extend);
 
+NTSTATUS
+VfatGetClusterRun(
+    PDEVICE_EXTENSION DeviceExt,
+    PVFATFCB Fcb,
+    ULONG FirstCluster,
+    ULONG Vcn,
+    ULONG ClusterCount,
+    PULONG Cluster,
+    PULONG RunLength);
+
+VOID
+VfatTruncateClusterRuns(
+    PVFATFCB Fcb,
+    ULONG ClusterCount);
+
 /* shutdown.c */
 
 DRIVER_DISPATCH
@@ -124,6 +124,21 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 FCB->OobInline = InfoReq->Information.Boolean;
                 break;
             case AFD_INFO_RECEIVE_WINDOW_SIZE:
+                if (!FCB->Recv.Window)
+                {
+                    /* Allocated with this size when the socket gets connected */
+                    if (InfoReq->Information.Ulong)
+                        FCB->Recv.Size = InfoReq->Information.Ulong;
+                    break;
+                }
+
+                /* Don't pull the buffer from under a pending receive */
+                if (!InfoReq->Information.Ulong || FCB->ReceiveIrp.InFlightRequest)
+                {
+                    AFD_DbgPrint(MID_TRACE,("Keeping receive window size %u\n", FCB->Recv.Size));
+                    break;
+                }
+
                 NewBuffer = ExAllocatePoolWithTag(PagedPool,
                                                   InfoReq->Information.Ulong,
                                                   TAG_AFD_DATA_BUFFER);
@@ -153,6 +168,19 @@ AfdSetInfo( PDEVICE_OBJECT DeviceObject, PIRP Irp,
                 }
                 break;
             case AFD_INFO_SEND_WINDOW_SIZE:
+                if (!FCB->Send.Window)
+                {
+                    if (InfoReq->Information.Ulong)
+                        FCB->Send.Size = InfoReq->Information.Ulong;
+                    break;
+                }
+
+                if (!InfoReq->Information.Ulong || FCB->SendIrp.InFlightRequest)
+                {
+                    AFD_DbgPrint(MID_TRACE,("Keeping send window size %u\n", FCB->Send.Size));
+                    break;
+                }
+
                 NewBuffer = ExAllocatePoolWithTag(PagedPool,
                                                   InfoReq->Information.Ulong,
                                                   TAG_AFD_DATA_BUFFER);
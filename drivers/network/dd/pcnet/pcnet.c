@@ -1139,6 +1139,267 @@ MiSyncStartTransmit(
   return TRUE;
 }
 
+static UINT
+MiCopyFromPacket(
+    IN PNDIS_PACKET Packet,
+    IN UINT Offset,
+    OUT PUCHAR Destination,
+    IN UINT Length)
+/*
+ * FUNCTION: Copy part of a packet into a flat buffer
+ * ARGUMENTS:
+ *     Packet: packet to copy from
+ *     Offset: offset in the packet to start at
+ *     Destination: buffer to copy to
+ *     Length: number of bytes to copy
+ * RETURNS:
+ *     Number of bytes copied
+ */
+{
+  PNDIS_BUFFER NdisBuffer;
+  PVOID SourceBuffer;
+  UINT SourceLength, Chunk, Copied = 0;
+
+  NdisQueryPacket(Packet, NULL, NULL, &NdisBuffer, NULL);
+
+  while (NdisBuffer && Copied < Length)
+    {
+      NdisQueryBuffer(NdisBuffer, &SourceBuffer, &SourceLength);
+
+      if (Offset >= SourceLength)
+        {
+          Offset -= SourceLength;
+        }
+      else
+        {
+          Chunk = min(SourceLength - Offset, Length - Copied);
+          RtlCopyMemory(Destination + Copied, (PUCHAR)SourceBuffer + Offset, Chunk);
+          Copied += Chunk;
+          Offset = 0;
+        }
+
+      NdisGetNextBuffer(NdisBuffer, &NdisBuffer);
+    }
+
+  return Copied;
+}
+
+static ULONG
+MiChecksumAdd(
+    IN PUCHAR Data,
+    IN UINT Length,
+    IN ULONG Sum)
+{
+  while (Length > 1)
+    {
+      Sum += (Data[0] << 8) | Data[1];
+      Data += 2;
+      Length -= 2;
+    }
+
+  if (Length)
+    Sum += Data[0] << 8;
+
+  return Sum;
+}
+
+static VOID
+MiChecksumStore(
+    OUT PUCHAR Field,
+    IN ULONG Sum)
+{
+  while (Sum >> 16)
+    Sum = (Sum & 0xffff) + (Sum >> 16);
+
+  Sum = ~Sum & 0xffff;
+  Field[0] = (UCHAR)(Sum >> 8);
+  Field[1] = (UCHAR)Sum;
+}
+
+static VOID
+MiFinishChecksums(
+    IN PUCHAR Frame,
+    IN UINT Length,
+    IN NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo)
+/*
+ * FUNCTION: Compute the checksums the protocol left to us
+ * ARGUMENTS:
+ *     Frame: ethernet frame about to be sent
+ *     Length: length of the frame
+ *     ChecksumInfo: checksums requested for the frame
+ * NOTES:
+ *     - The TCP checksum field may hold a seed from the protocol so
+ *       it is cleared before computing the checksum from scratch
+ */
+{
+  PUCHAR Ip, Tcp;
+  UINT IpLength, TotalLength;
+  ULONG Sum;
+
+  if (Length < ETH_HEADER_LENGTH + 20 ||
+      Frame[ETH_TYPE_OFFSET] != 0x08 || Frame[ETH_TYPE_OFFSET + 1] != 0x00)
+    return;
+
+  Ip = Frame + ETH_HEADER_LENGTH;
+  IpLength = (Ip[0] & 0x0f) << 2;
+  if (IpLength < 20 || ETH_HEADER_LENGTH + IpLength > Length)
+    return;
+
+  if (ChecksumInfo.Transmit.NdisPacketIpChecksum)
+    {
+      Ip[IP_CHECKSUM_OFFSET] = Ip[IP_CHECKSUM_OFFSET + 1] = 0;
+      MiChecksumStore(Ip + IP_CHECKSUM_OFFSET, MiChecksumAdd(Ip, IpLength, 0));
+    }
+
+  if (ChecksumInfo.Transmit.NdisPacketTcpChecksum && Ip[IP_PROTOCOL_OFFSET] == IP_PROTOCOL_TCP)
+    {
+      TotalLength = (Ip[IP_TOTAL_LENGTH_OFFSET] << 8) | Ip[IP_TOTAL_LENGTH_OFFSET + 1];
+      if (TotalLength < IpLength + 20 || ETH_HEADER_LENGTH + TotalLength > Length)
+        return;
+
+      Tcp = Ip + IpLength;
+
+      /* pseudo header */
+      Sum = MiChecksumAdd(Ip + IP_ADDRESSES_OFFSET, 8, 0);
+      Sum += IP_PROTOCOL_TCP + TotalLength - IpLength;
+
+      Tcp[TCP_CHECKSUM_OFFSET] = Tcp[TCP_CHECKSUM_OFFSET + 1] = 0;
+      MiChecksumStore(Tcp + TCP_CHECKSUM_OFFSET, MiChecksumAdd(Tcp, TotalLength - IpLength, Sum));
+    }
+}
+
+static ULONG
+MiFreeTransmitDescriptors(
+    IN PADAPTER Adapter)
+{
+  return (Adapter->CurrentTransmitStartIndex + Adapter->BufferCount -
+          Adapter->CurrentTransmitEndIndex - 1) % Adapter->BufferCount;
+}
+
+static VOID
+MiQueueFrame(
+    IN PADAPTER Adapter,
+    IN UINT Length)
+/*
+ * FUNCTION: Hand the frame in the current transmit buffer to the card
+ * ARGUMENTS:
+ *     Adapter: adapter the frame is sent on
+ *     Length: length of the frame
+ */
+{
+  PTRANSMIT_DESCRIPTOR Desc;
+
+  Desc = Adapter->TransmitDescriptorRingVirt + Adapter->CurrentTransmitEndIndex;
+
+  Adapter->CurrentTransmitEndIndex++;
+  Adapter->CurrentTransmitEndIndex %= Adapter->BufferCount;
+
+  Desc->BCNT = 0xf000 | -(INT)Length;
+  Desc->FLAGS = TD1_OWN | TD1_STP | TD1_ENP;
+}
+
+static NDIS_STATUS
+MiSendLargePacket(
+    IN PADAPTER Adapter,
+    IN PNDIS_PACKET Packet,
+    IN UINT TotalPacketLength,
+    IN ULONG Mss)
+/*
+ * FUNCTION: Cut a large TCP send into frames of at most Mss bytes of payload
+ * ARGUMENTS:
+ *     Adapter: adapter the packet is sent on
+ *     Packet: the large send packet
+ *     TotalPacketLength: length of the packet
+ *     Mss: payload size of each frame, from the protocol
+ * RETURNS:
+ *     NDIS_STATUS_SUCCESS if all frames were queued
+ *     NDIS_STATUS_RESOURCES if there's no place in buffer ring
+ *     NDIS_STATUS_FAILURE if the packet can't be cut
+ * NOTES:
+ *     - Each frame gets the headers of the packet with the IP length,
+ *       IP identification and TCP sequence number adjusted. FIN and PSH
+ *       are only kept on the last frame.
+ */
+{
+  NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+  UCHAR Headers[ETH_HEADER_LENGTH + 60 + 60];
+  PUCHAR Frame, Ip, Tcp;
+  UINT HeaderLength, IpLength, TcpLength, Payload, Offset, Chunk, Segments, i;
+  ULONG Sequence, Value;
+  USHORT Id;
+
+  HeaderLength = MiCopyFromPacket(Packet, 0, Headers, min(TotalPacketLength, sizeof(Headers)));
+  if (HeaderLength < ETH_HEADER_LENGTH + 40 ||
+      Headers[ETH_TYPE_OFFSET] != 0x08 || Headers[ETH_TYPE_OFFSET + 1] != 0x00)
+    return NDIS_STATUS_FAILURE;
+
+  Ip = Headers + ETH_HEADER_LENGTH;
+  IpLength = (Ip[0] & 0x0f) << 2;
+  if (IpLength < 20 || Ip[IP_PROTOCOL_OFFSET] != IP_PROTOCOL_TCP ||
+      ETH_HEADER_LENGTH + IpLength + 20 > HeaderLength)
+    return NDIS_STATUS_FAILURE;
+
+  Tcp = Ip + IpLength;
+  TcpLength = (Tcp[TCP_DATA_OFFSET] >> 4) << 2;
+  if (TcpLength < 20 || ETH_HEADER_LENGTH + IpLength + TcpLength > HeaderLength)
+    return NDIS_STATUS_FAILURE;
+
+  HeaderLength = ETH_HEADER_LENGTH + IpLength + TcpLength;
+  if (HeaderLength + Mss > ETH_MAX_FRAME_LENGTH)
+    return NDIS_STATUS_FAILURE;
+
+  Payload = TotalPacketLength - HeaderLength;
+  Segments = max((Payload + Mss - 1) / Mss, 1);
+  if (Segments >= Adapter->BufferCount)
+    return NDIS_STATUS_FAILURE;
+
+  if (Segments > MiFreeTransmitDescriptors(Adapter))
+    return NDIS_STATUS_RESOURCES;
+
+  Id = (Ip[IP_ID_OFFSET] << 8) | Ip[IP_ID_OFFSET + 1];
+  Sequence = ((ULONG)Tcp[TCP_SEQUENCE_OFFSET] << 24) | ((ULONG)Tcp[TCP_SEQUENCE_OFFSET + 1] << 16) |
+             ((ULONG)Tcp[TCP_SEQUENCE_OFFSET + 2] << 8) | Tcp[TCP_SEQUENCE_OFFSET + 3];
+
+  ChecksumInfo.Value = 0;
+  ChecksumInfo.Transmit.NdisPacketIpChecksum = 1;
+  ChecksumInfo.Transmit.NdisPacketTcpChecksum = 1;
+
+  for (i = 0, Offset = 0; i < Segments; i++, Offset += Chunk)
+    {
+      Chunk = min(Mss, Payload - Offset);
+
+      Frame = (PUCHAR)Adapter->TransmitBufferPtrVirt +
+              Adapter->CurrentTransmitEndIndex * BUFFER_SIZE;
+
+      RtlCopyMemory(Frame, Headers, HeaderLength);
+      MiCopyFromPacket(Packet, HeaderLength + Offset, Frame + HeaderLength, Chunk);
+
+      Ip = Frame + ETH_HEADER_LENGTH;
+      Value = IpLength + TcpLength + Chunk;
+      Ip[IP_TOTAL_LENGTH_OFFSET] = (UCHAR)(Value >> 8);
+      Ip[IP_TOTAL_LENGTH_OFFSET + 1] = (UCHAR)Value;
+      Ip[IP_ID_OFFSET] = (UCHAR)((USHORT)(Id + i) >> 8);
+      Ip[IP_ID_OFFSET + 1] = (UCHAR)(Id + i);
+
+      Tcp = Ip + IpLength;
+      Value = Sequence + Offset;
+      Tcp[TCP_SEQUENCE_OFFSET] = (UCHAR)(Value >> 24);
+      Tcp[TCP_SEQUENCE_OFFSET + 1] = (UCHAR)(Value >> 16);
+      Tcp[TCP_SEQUENCE_OFFSET + 2] = (UCHAR)(Value >> 8);
+      Tcp[TCP_SEQUENCE_OFFSET + 3] = (UCHAR)Value;
+      if (i != Segments - 1)
+        Tcp[TCP_FLAGS_OFFSET] &= ~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+
+      MiFinishChecksums(Frame, HeaderLength + Chunk, ChecksumInfo);
+      MiQueueFrame(Adapter, HeaderLength + Chunk);
+    }
+
+  /* Tell the protocol how much payload went out. This is NOT a pointer. */
+  NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpLargeSendPacketInfo) = (PVOID)(ULONG_PTR)Payload;
+
+  return NDIS_STATUS_SUCCESS;
+}
+
 static NDIS_STATUS
 NTAPI
 MiniportSend(
@@ -1156,13 +1417,16 @@ MiniportSend(
  *     NDIS_STATUS_RESOURCES if there's no place in buffer ring
  * NOTES:
  *     - Called by NDIS at DISPATCH_LEVEL
+ *     - The card has no offload engine, checksums and large sends
+ *       the protocol enabled are done here
  */
 {
   PADAPTER Adapter = (PADAPTER)MiniportAdapterContext;
-  PTRANSMIT_DESCRIPTOR Desc;
-  PNDIS_BUFFER NdisBuffer;
-  PVOID SourceBuffer;
-  UINT TotalPacketLength, SourceLength, Position = 0;
+  NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+  NDIS_STATUS Status = NDIS_STATUS_SUCCESS;
+  PUCHAR Frame;
+  UINT TotalPacketLength;
+  ULONG Mss = 0;
 
   DPRINT("Called\n");
 
@@ -1171,63 +1435,61 @@ MiniportSend(
   NdisDprAcquireSpinLock(&Adapter->Lock);
 
   /* Check if we have free entry in our circular buffer. */
-  if ((Adapter->CurrentTransmitEndIndex + 1 ==
-       Adapter->CurrentTransmitStartIndex) ||
-      (Adapter->CurrentTransmitEndIndex == Adapter->BufferCount - 1 &&
-       Adapter->CurrentTransmitStartIndex == 0))
+  if (!MiFreeTransmitDescriptors(Adapter))
     {
       DPRINT1("No free space in circular buffer\n");
       NdisDprReleaseSpinLock(&Adapter->Lock);
       return NDIS_STATUS_RESOURCES;
     }
 
-  Desc = Adapter->TransmitDescriptorRingVirt + Adapter->CurrentTransmitEndIndex;
-
-  NdisQueryPacket(Packet, NULL, NULL, &NdisBuffer, &TotalPacketLength);
-  ASSERT(TotalPacketLength <= BUFFER_SIZE);
+  NdisQueryPacket(Packet, NULL, NULL, NULL, &TotalPacketLength);
 
   DPRINT("TotalPacketLength: %x\n", TotalPacketLength);
 
-  while (NdisBuffer)
-    {
-      NdisQueryBuffer(NdisBuffer, &SourceBuffer, &SourceLength);
-
-      DPRINT("Buffer: %x Length: %x\n", SourceBuffer, SourceLength);
+  ChecksumInfo.Value = 0;
+  if (Adapter->OffloadFlags & (OFFLOAD_IP_CHECKSUM | OFFLOAD_TCP_CHECKSUM))
+    ChecksumInfo.Value = (ULONG)(ULONG_PTR)NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpIpChecksumPacketInfo);
+  if (Adapter->OffloadFlags & OFFLOAD_LARGE_SEND)
+    Mss = (ULONG)(ULONG_PTR)NDIS_PER_PACKET_INFO_FROM_PACKET(Packet, TcpLargeSendPacketInfo);
 
-      RtlCopyMemory(Adapter->TransmitBufferPtrVirt +
-                    Adapter->CurrentTransmitEndIndex * BUFFER_SIZE + Position,
-                    SourceBuffer, SourceLength);
+  if (Mss)
+    {
+      Status = MiSendLargePacket(Adapter, Packet, TotalPacketLength, Mss);
+    }
+  else
+    {
+      ASSERT(TotalPacketLength <= BUFFER_SIZE);
 
-      Position += SourceLength;
+      Frame = (PUCHAR)Adapter->TransmitBufferPtrVirt +
+              Adapter->CurrentTransmitEndIndex * BUFFER_SIZE;
 
-      NdisGetNextBuffer(NdisBuffer, &NdisBuffer);
-    }
+      MiCopyFromPacket(Packet, 0, Frame, TotalPacketLength);
 
 #if DBG && 0
-  {
-    PUCHAR Ptr = Adapter->TransmitBufferPtrVirt +
-                 Adapter->CurrentTransmitEndIndex * BUFFER_SIZE;
-    for (Position = 0; Position < TotalPacketLength; Position++)
       {
-        if (Position % 16 == 0)
-          DbgPrint("\n");
-        DbgPrint("%x ", *Ptr++);
+        UINT Position;
+        for (Position = 0; Position < TotalPacketLength; Position++)
+          {
+            if (Position % 16 == 0)
+              DbgPrint("\n");
+            DbgPrint("%x ", Frame[Position]);
+          }
       }
-  }
-  DbgPrint("\n");
+      DbgPrint("\n");
 #endif
 
-  Adapter->CurrentTransmitEndIndex++;
-  Adapter->CurrentTransmitEndIndex %= Adapter->BufferCount;
+      if (ChecksumInfo.Transmit.NdisPacketChecksumV4)
+        MiFinishChecksums(Frame, TotalPacketLength, ChecksumInfo);
 
-  Desc->FLAGS = TD1_OWN | TD1_STP | TD1_ENP;
-  Desc->BCNT = 0xf000 | -(INT)TotalPacketLength;
+      MiQueueFrame(Adapter, TotalPacketLength);
+    }
 
-  NdisMSynchronizeWithInterrupt(&Adapter->InterruptObject, MiSyncStartTransmit, Adapter);
+  if (Status == NDIS_STATUS_SUCCESS)
+    NdisMSynchronizeWithInterrupt(&Adapter->InterruptObject, MiSyncStartTransmit, Adapter);
 
   NdisDprReleaseSpinLock(&Adapter->Lock);
 
-  return NDIS_STATUS_SUCCESS;
+  return Status;
 }
 
 static ULONG
@@ -71,6 +71,7 @@ typedef struct _ADAPTER
   ULONG CurrentReceiveDescriptorIndex;
   ULONG CurrentPacketFilter;
   ULONG CurrentLookaheadSize;
+  ULONG OffloadFlags;
 
   /* circular indexes to transmit descriptors */
   ULONG CurrentTransmitStartIndex;
@@ -158,6 +159,33 @@ MiGetMediaDuplex(PADAPTER Adapter);
 /* flags */
 #define RESET_IN_PROGRESS 0x1
 
+/* task offloads enabled by the protocol, done in software */
+#define OFFLOAD_IP_CHECKSUM  0x1
+#define OFFLOAD_TCP_CHECKSUM 0x2
+#define OFFLOAD_LARGE_SEND   0x4
+
+/* largest TCP payload accepted for large send, further capped by the transmit ring */
+#define LARGE_SEND_SIZE      0x4000
+#define LARGE_SEND_MIN_SEGMENTS 2
+#define LARGE_SEND_MSS       (ETH_MAX_FRAME_LENGTH - ETH_HEADER_LENGTH - 40)
+
+/* frame offsets used by the offloads */
+#define ETH_HEADER_LENGTH    14
+#define ETH_MAX_FRAME_LENGTH 1514
+#define ETH_TYPE_OFFSET      12
+#define IP_TOTAL_LENGTH_OFFSET 2
+#define IP_ID_OFFSET         4
+#define IP_PROTOCOL_OFFSET   9
+#define IP_CHECKSUM_OFFSET   10
+#define IP_ADDRESSES_OFFSET  12
+#define IP_PROTOCOL_TCP      6
+#define TCP_SEQUENCE_OFFSET  4
+#define TCP_DATA_OFFSET      12
+#define TCP_FLAGS_OFFSET     13
+#define TCP_CHECKSUM_OFFSET  16
+#define TCP_FLAG_FIN         0x01
+#define TCP_FLAG_PSH         0x08
+
 /* Maximum number of interrupts handled per call to MiniportHandleInterrupt */
 #define INTERRUPT_LIMIT 10
 
@@ -76,9 +76,181 @@ static ULONG MiniportOIDList[] =
   OID_802_3_MAC_OPTIONS,
   OID_802_3_RCV_ERROR_ALIGNMENT,
   OID_802_3_XMIT_ONE_COLLISION,
-  OID_802_3_XMIT_MORE_COLLISIONS
+  OID_802_3_XMIT_MORE_COLLISIONS,
+  OID_TCP_TASK_OFFLOAD
 };
 
+static ULONG
+MiLargeSendSize(
+    IN PADAPTER Adapter)
+/*
+ * FUNCTION: Largest large send we accept
+ * ARGUMENTS:
+ *     Adapter: adapter whose transmit ring holds the segments
+ * NOTES:
+ *     A large send must leave one transmit descriptor free, see MiSendLargePacket
+ */
+{
+  return min(LARGE_SEND_SIZE, (Adapter->BufferCount - 1) * LARGE_SEND_MSS);
+}
+
+static NDIS_STATUS
+MiQueryTaskOffload(
+    IN PADAPTER Adapter,
+    IN PNDIS_TASK_OFFLOAD_HEADER Request,
+    IN ULONG RequestLength,
+    OUT PNDIS_TASK_OFFLOAD_HEADER Header,
+    OUT PUINT Size)
+/*
+ * FUNCTION: Describe the task offloads we can do in software
+ * ARGUMENTS:
+ *     Adapter: adapter whose transmit ring bounds the large sends
+ *     Request: header supplied by the protocol
+ *     RequestLength: size of the protocol's buffer
+ *     Header: buffer to build the task list in
+ *     Size: receives the size of the task list
+ * RETURNS:
+ *     NDIS_STATUS_NOT_SUPPORTED for encapsulations other than ethernet
+ *     NDIS_STATUS_SUCCESS otherwise
+ */
+{
+  PNDIS_TASK_OFFLOAD Task;
+  PNDIS_TASK_TCP_IP_CHECKSUM Checksum;
+  PNDIS_TASK_TCP_LARGE_SEND LargeSend;
+
+  if (RequestLength >= sizeof(NDIS_TASK_OFFLOAD_HEADER))
+    {
+      if (Request->Version != NDIS_TASK_OFFLOAD_VERSION ||
+          Request->EncapsulationFormat.Encapsulation != IEEE_802_3_Encapsulation)
+        return NDIS_STATUS_NOT_SUPPORTED;
+
+      Header->EncapsulationFormat = Request->EncapsulationFormat;
+    }
+
+  Header->Version = NDIS_TASK_OFFLOAD_VERSION;
+  Header->Size = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+  Header->OffsetFirstTask = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+
+  Task = (PNDIS_TASK_OFFLOAD)(Header + 1);
+  Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+  Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+  Task->Task = TcpIpChecksumNdisTask;
+  Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+  Task->OffsetNextTask = FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + Task->TaskBufferLength;
+  Checksum = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+  Checksum->V4Transmit.IpOptionsSupported = 1;
+  Checksum->V4Transmit.TcpOptionsSupported = 1;
+  Checksum->V4Transmit.TcpChecksum = 1;
+  Checksum->V4Transmit.IpChecksum = 1;
+
+  Task = (PNDIS_TASK_OFFLOAD)((PUCHAR)Task + Task->OffsetNextTask);
+  Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+  Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+  Task->Task = TcpLargeSendNdisTask;
+  Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_LARGE_SEND);
+  LargeSend = (PNDIS_TASK_TCP_LARGE_SEND)Task->TaskBuffer;
+  LargeSend->Version = NDIS_TASK_TCP_LARGE_SEND_V0;
+  LargeSend->MaxOffLoadSize = MiLargeSendSize(Adapter);
+  LargeSend->MinSegmentCount = LARGE_SEND_MIN_SEGMENTS;
+  LargeSend->TcpOptions = TRUE;
+  LargeSend->IpOptions = TRUE;
+
+  *Size = (UINT)((PUCHAR)Task->TaskBuffer + Task->TaskBufferLength - (PUCHAR)Header);
+
+  return NDIS_STATUS_SUCCESS;
+}
+
+static NDIS_STATUS
+MiSetTaskOffload(
+    IN PADAPTER Adapter,
+    IN PNDIS_TASK_OFFLOAD_HEADER Header,
+    IN ULONG Length)
+/*
+ * FUNCTION: Enable the task offloads requested by the protocol
+ * ARGUMENTS:
+ *     Adapter: adapter to enable the offloads on
+ *     Header: task list from the protocol, offloads missing from it are disabled
+ *     Length: size of the task list
+ * RETURNS:
+ *     NDIS_STATUS_INVALID_LENGTH if the task list is malformed
+ *     NDIS_STATUS_NOT_SUPPORTED if a task we can't do is requested
+ *     NDIS_STATUS_SUCCESS otherwise
+ */
+{
+  PNDIS_TASK_OFFLOAD Task;
+  PNDIS_TASK_TCP_IP_CHECKSUM Checksum;
+  PNDIS_TASK_TCP_LARGE_SEND LargeSend;
+  ULONG Offset, OffloadFlags = 0;
+
+  if (Length < sizeof(NDIS_TASK_OFFLOAD_HEADER))
+    return NDIS_STATUS_INVALID_LENGTH;
+
+  if (Header->Version != NDIS_TASK_OFFLOAD_VERSION ||
+      Header->EncapsulationFormat.Encapsulation != IEEE_802_3_Encapsulation)
+    return NDIS_STATUS_NOT_SUPPORTED;
+
+  Offset = Header->OffsetFirstTask;
+  while (Offset != 0)
+    {
+      if (Offset < sizeof(NDIS_TASK_OFFLOAD_HEADER) ||
+          Offset > Length - FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer))
+        return NDIS_STATUS_INVALID_LENGTH;
+
+      Task = (PNDIS_TASK_OFFLOAD)((PUCHAR)Header + Offset);
+      if (Task->TaskBufferLength > Length - Offset - FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer))
+        return NDIS_STATUS_INVALID_LENGTH;
+
+      switch (Task->Task)
+        {
+        case TcpIpChecksumNdisTask:
+          if (Task->TaskBufferLength < sizeof(NDIS_TASK_TCP_IP_CHECKSUM))
+            return NDIS_STATUS_INVALID_LENGTH;
+
+          Checksum = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+          if (Checksum->V4Transmit.UdpChecksum ||
+              Checksum->V4Receive.TcpChecksum || Checksum->V4Receive.UdpChecksum ||
+              Checksum->V4Receive.IpChecksum ||
+              Checksum->V6Transmit.TcpChecksum || Checksum->V6Transmit.UdpChecksum ||
+              Checksum->V6Receive.TcpChecksum || Checksum->V6Receive.UdpChecksum)
+            return NDIS_STATUS_NOT_SUPPORTED;
+
+          if (Checksum->V4Transmit.IpChecksum)
+            OffloadFlags |= OFFLOAD_IP_CHECKSUM;
+          if (Checksum->V4Transmit.TcpChecksum)
+            OffloadFlags |= OFFLOAD_TCP_CHECKSUM;
+          break;
+
+        case TcpLargeSendNdisTask:
+          if (Task->TaskBufferLength < sizeof(NDIS_TASK_TCP_LARGE_SEND))
+            return NDIS_STATUS_INVALID_LENGTH;
+
+          LargeSend = (PNDIS_TASK_TCP_LARGE_SEND)Task->TaskBuffer;
+          if (LargeSend->Version != NDIS_TASK_TCP_LARGE_SEND_V0 ||
+              LargeSend->MaxOffLoadSize > MiLargeSendSize(Adapter) ||
+              LargeSend->MinSegmentCount < LARGE_SEND_MIN_SEGMENTS)
+            return NDIS_STATUS_NOT_SUPPORTED;
+
+          OffloadFlags |= OFFLOAD_LARGE_SEND;
+          break;
+
+        default:
+          return NDIS_STATUS_NOT_SUPPORTED;
+        }
+
+      if (Task->OffsetNextTask == 0)
+        break;
+      if (Task->OffsetNextTask > Length)
+        return NDIS_STATUS_INVALID_LENGTH;
+
+      Offset += Task->OffsetNextTask;
+    }
+
+  DPRINT("Offloads enabled: 0x%x\n", OffloadFlags);
+  Adapter->OffloadFlags = OffloadFlags;
+
+  return NDIS_STATUS_SUCCESS;
+}
+
 
 NDIS_STATUS
 NTAPI
@@ -112,6 +284,7 @@ MiniportQueryInformation(
   PVOID CopyFrom;
   UINT CopySize;
   ULONG GenericULONG;
+  ULONG TaskOffload[32];
   PADAPTER Adapter = (PADAPTER)MiniportAdapterContext;
 
   DPRINT("Called. OID 0x%x\n", Oid);
@@ -335,6 +508,15 @@ MiniportQueryInformation(
         GenericULONG = Adapter->Statistics.XmtMoreThanOneRetry;
         break;
 
+    case OID_TCP_TASK_OFFLOAD:
+        {
+          RtlZeroMemory(TaskOffload, sizeof(TaskOffload));
+          Status = MiQueryTaskOffload(Adapter, InformationBuffer, InformationBufferLength,
+                                      (PNDIS_TASK_OFFLOAD_HEADER)TaskOffload, &CopySize);
+          CopyFrom = TaskOffload;
+          break;
+        }
+
     default:
         {
           DPRINT1("Unknown OID\n");
@@ -488,6 +670,18 @@ MiniportSetInformation(
         break;
       }
 
+    case OID_TCP_TASK_OFFLOAD:
+      {
+        Status = MiSetTaskOffload(Adapter, InformationBuffer, InformationBufferLength);
+        if (Status != NDIS_STATUS_SUCCESS)
+          {
+            *BytesRead   = 0;
+            *BytesNeeded = 0;
+          }
+
+        break;
+      }
+
     default:
       {
         DPRINT1("Invalid object ID (0x%X).\n", Oid);
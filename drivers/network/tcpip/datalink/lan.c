@@ -20,6 +20,9 @@ UINT TransferDataCompleteCalled = 0;
 #define CCS_ROOT L"\\Registry\\Machine\\SYSTEM\\CurrentControlSet"
 #define TCPIP_GUID L"{4D36E972-E325-11CE-BFC1-08002BE10318}"
 
+/* Room for the offload header and a few tasks */
+#define OFFLOAD_BUFFER_SIZE 512
+
 typedef struct _LAN_WQ_ITEM {
     LIST_ENTRY ListEntry;
     PNDIS_PACKET Packet;
@@ -1006,6 +1009,12 @@ VOID LANTransmit(
 
     RtlCopyMemory(Data + Adapter->HeaderSize, OldData, OldSize);
 
+    /* Carry over the offload requests made by the IP layer */
+    NDIS_PER_PACKET_INFO_FROM_PACKET(XmitPacket, TcpIpChecksumPacketInfo) =
+        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpIpChecksumPacketInfo);
+    NDIS_PER_PACKET_INFO_FROM_PACKET(XmitPacket, TcpLargeSendPacketInfo) =
+        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket, TcpLargeSendPacketInfo);
+
     (*PC(NdisPacket)->DLComplete)(PC(NdisPacket)->Context, NdisPacket, NDIS_STATUS_SUCCESS);
 
     switch (Adapter->Media) {
@@ -1056,12 +1065,6 @@ VOID LANTransmit(
 		   ((PCHAR)LinkAddress)[5] & 0xff));
 	}
 
-    if (Adapter->MTU < Size) {
-        /* This is NOT a pointer. MSDN explicitly says so. */
-        NDIS_PER_PACKET_INFO_FROM_PACKET(NdisPacket,
-                                         TcpLargeSendPacketInfo) = (PVOID)((ULONG_PTR)Adapter->MTU);
-    }
-
     /* Update interface stats */
     Interface->Stats.OutBytes += Size;
 
@@ -1309,6 +1312,158 @@ VOID GetName( PUNICODE_STRING RegistryKey,
     AppendUnicodeString( OutName, &PartialRegistryKey, FALSE );
 }
 
+static VOID
+InitOffloadHeader(
+    PLAN_ADAPTER Adapter,
+    PNDIS_TASK_OFFLOAD_HEADER Header)
+{
+    RtlZeroMemory(Header, OFFLOAD_BUFFER_SIZE);
+
+    Header->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Header->Size = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    Header->EncapsulationFormat.Encapsulation = IEEE_802_3_Encapsulation;
+    Header->EncapsulationFormat.Flags.FixedHeaderSize = 1;
+    Header->EncapsulationFormat.EncapsulationHeaderSize = Adapter->HeaderSize;
+}
+
+static VOID
+LANNegotiateOffload(
+    PLAN_ADAPTER Adapter,
+    PIP_INTERFACE IF)
+/*
+ * FUNCTION: Enables the task offloads we can use on an adapter
+ * ARGUMENTS:
+ *     Adapter = Pointer to LAN_ADAPTER structure
+ *     IF      = Interface bound to the adapter
+ * NOTES:
+ *    Only IPv4 transmit checksums and TCP large send are used. The
+ *    adapter must handle TCP options since lwIP sends timestamps in
+ *    every segment, and large sends need the TCP checksum offloaded
+ *    as well because the adapter computes it for each frame it cuts.
+ */
+{
+    PNDIS_TASK_OFFLOAD_HEADER Header;
+    PNDIS_TASK_OFFLOAD Task, Previous = NULL;
+    PNDIS_TASK_TCP_IP_CHECKSUM EnabledChecksum;
+    NDIS_TASK_TCP_IP_CHECKSUM Checksum;
+    NDIS_TASK_TCP_LARGE_SEND LargeSend;
+    BOOLEAN HaveChecksum = FALSE, HaveLargeSend = FALSE;
+    ULONG Offset, Offload = 0, LargeSendSize = 0;
+    NDIS_STATUS NdisStatus;
+
+    if (Adapter->Media != NdisMedium802_3)
+        return;
+
+    Header = ExAllocatePoolWithTag(NonPagedPool, OFFLOAD_BUFFER_SIZE, OFFLOAD_TAG);
+    if (!Header)
+        return;
+
+    InitOffloadHeader(Adapter, Header);
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestQueryInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Header,
+                          OFFLOAD_BUFFER_SIZE);
+    if (NdisStatus != NDIS_STATUS_SUCCESS) {
+        TI_DbgPrint(DEBUG_DATALINK, ("No task offload support (0x%X).\n", NdisStatus));
+        ExFreePoolWithTag(Header, OFFLOAD_TAG);
+        return;
+    }
+
+    /* Walk the task list, the miniport's offsets are not trusted */
+    Offset = Header->OffsetFirstTask;
+    while (Offset >= sizeof(NDIS_TASK_OFFLOAD_HEADER) &&
+           Offset <= OFFLOAD_BUFFER_SIZE - FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer)) {
+        Task = (PNDIS_TASK_OFFLOAD)((PUCHAR)Header + Offset);
+
+        if (Task->TaskBufferLength > OFFLOAD_BUFFER_SIZE - Offset - FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer))
+            break;
+
+        if (Task->Task == TcpIpChecksumNdisTask &&
+            Task->TaskBufferLength >= sizeof(NDIS_TASK_TCP_IP_CHECKSUM)) {
+            RtlCopyMemory(&Checksum, Task->TaskBuffer, sizeof(Checksum));
+            HaveChecksum = TRUE;
+        } else if (Task->Task == TcpLargeSendNdisTask &&
+                   Task->TaskBufferLength >= sizeof(NDIS_TASK_TCP_LARGE_SEND)) {
+            RtlCopyMemory(&LargeSend, Task->TaskBuffer, sizeof(LargeSend));
+            HaveLargeSend = TRUE;
+        }
+
+        if (Task->OffsetNextTask == 0 || Task->OffsetNextTask > OFFLOAD_BUFFER_SIZE)
+            break;
+
+        Offset += Task->OffsetNextTask;
+    }
+
+    if (HaveChecksum) {
+        if (Checksum.V4Transmit.IpChecksum)
+            Offload |= IP_OFFLOAD_IP_CHECKSUM;
+        if (Checksum.V4Transmit.TcpChecksum && Checksum.V4Transmit.TcpOptionsSupported)
+            Offload |= IP_OFFLOAD_TCP_CHECKSUM;
+    }
+
+    if (HaveLargeSend &&
+        (Offload & IP_OFFLOAD_TCP_CHECKSUM) &&
+        LargeSend.Version == NDIS_TASK_TCP_LARGE_SEND_V0 &&
+        LargeSend.TcpOptions &&
+        LargeSend.MinSegmentCount <= 2 &&
+        LargeSend.MaxOffLoadSize > Adapter->MTU) {
+        LargeSendSize = LargeSend.MaxOffLoadSize;
+    }
+
+    if (!Offload) {
+        ExFreePoolWithTag(Header, OFFLOAD_TAG);
+        return;
+    }
+
+    /* Build the list of tasks we want enabled */
+    InitOffloadHeader(Adapter, Header);
+    Header->OffsetFirstTask = sizeof(NDIS_TASK_OFFLOAD_HEADER);
+    Offset = Header->OffsetFirstTask;
+
+    Task = (PNDIS_TASK_OFFLOAD)((PUCHAR)Header + Offset);
+    Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+    Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+    Task->Task = TcpIpChecksumNdisTask;
+    Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_IP_CHECKSUM);
+    EnabledChecksum = (PNDIS_TASK_TCP_IP_CHECKSUM)Task->TaskBuffer;
+    EnabledChecksum->V4Transmit.IpChecksum = !!(Offload & IP_OFFLOAD_IP_CHECKSUM);
+    EnabledChecksum->V4Transmit.TcpChecksum = !!(Offload & IP_OFFLOAD_TCP_CHECKSUM);
+    EnabledChecksum->V4Transmit.TcpOptionsSupported = !!(Offload & IP_OFFLOAD_TCP_CHECKSUM);
+    Previous = Task;
+    Offset += FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + Task->TaskBufferLength;
+
+    if (LargeSendSize) {
+        Previous->OffsetNextTask = Offset - ((PUCHAR)Previous - (PUCHAR)Header);
+
+        Task = (PNDIS_TASK_OFFLOAD)((PUCHAR)Header + Offset);
+        Task->Version = NDIS_TASK_OFFLOAD_VERSION;
+        Task->Size = sizeof(NDIS_TASK_OFFLOAD);
+        Task->Task = TcpLargeSendNdisTask;
+        Task->TaskBufferLength = sizeof(NDIS_TASK_TCP_LARGE_SEND);
+        RtlCopyMemory(Task->TaskBuffer, &LargeSend, sizeof(LargeSend));
+        Offset += FIELD_OFFSET(NDIS_TASK_OFFLOAD, TaskBuffer) + Task->TaskBufferLength;
+    }
+
+    NdisStatus = NDISCall(Adapter,
+                          NdisRequestSetInformation,
+                          OID_TCP_TASK_OFFLOAD,
+                          Header,
+                          Offset);
+    if (NdisStatus == NDIS_STATUS_SUCCESS) {
+        IF->ChecksumOffload = Offload;
+        IF->LargeSendSize = LargeSendSize;
+
+        TI_DbgPrint(DEBUG_DATALINK, ("Checksum offload 0x%x, large send %u bytes.\n",
+                                     Offload, LargeSendSize));
+    } else {
+        TI_DbgPrint(MIN_TRACE, ("Could not enable task offload (0x%X).\n", NdisStatus));
+    }
+
+    ExFreePoolWithTag(Header, OFFLOAD_TAG);
+}
+
 BOOLEAN BindAdapter(
     PLAN_ADAPTER Adapter,
     PNDIS_STRING RegistryPath)
@@ -1410,6 +1565,9 @@ BOOLEAN BindAdapter(
     if (NdisStatus != NDIS_STATUS_SUCCESS)
         return FALSE;
 
+    /* Enable checksum and large send offload if the adapter has them */
+    LANNegotiateOffload(Adapter, IF);
+
     /* Register interface with IP layer */
     IPRegisterInterface(IF);
 
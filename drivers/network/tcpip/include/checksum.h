@@ -7,6 +7,8 @@
 
 #pragma once
 
+VOID ChecksumInitialize(VOID);
+
 ULONG ChecksumFold(
   ULONG Sum);
 
@@ -15,11 +17,28 @@ ULONG ChecksumCompute(
     UINT Count,
     ULONG Seed);
 
-unsigned int
-csum_partial(
-  const unsigned char * buff,
-  int len,
-  unsigned int sum);
+ULONG ChecksumCopy(
+    PVOID Destination,
+    CONST VOID *Source,
+    UINT Count,
+    ULONG Seed);
+
+ULONG ChecksumCombine(
+    ULONG Sum,
+    ULONG BlockSum,
+    UINT Offset);
+
+ULONGLONG ChecksumComputeGeneric(
+    PVOID Destination,
+    CONST VOID *Data,
+    UINT Count);
+
+#if defined(_M_IX86) || defined(_M_AMD64) || defined(__i386__) || defined(__x86_64__)
+ULONGLONG ChecksumComputeSse2(
+    PVOID Destination,
+    CONST VOID *Data,
+    UINT Count);
+#endif
 
 ULONG
 UDPv4ChecksumCalculate(
@@ -28,8 +47,7 @@ UDPv4ChecksumCalculate(
   ULONG DataLength);
 
 #define IPv4Checksum(Data, Count, Seed)(~ChecksumFold(ChecksumCompute(Data, Count, Seed)))
-#define TCPv4Checksum(Data, Count, Seed)(~ChecksumFold(csum_partial(Data, Count, Seed)))
-//#define TCPv4Checksum(Data, Count, Seed)(~ChecksumFold(ChecksumCompute(Data, Count, Seed)))
+#define TCPv4Checksum(Data, Count, Seed)(~ChecksumFold(ChecksumCompute(Data, Count, Seed)))
 
 /*
  * Macro to check for a correct checksum
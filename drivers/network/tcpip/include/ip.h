@@ -168,8 +168,14 @@ typedef struct _IP_INTERFACE {
     LL_TRANSMIT_ROUTINE Transmit; /* Pointer to transmit function */
     PVOID TCPContext;             /* TCP Content for this interface */
     SEND_RECV_STATS Stats;        /* Send/Receive statistics */
+    ULONG ChecksumOffload;        /* Transmit checksums computed by the adapter */
+    UINT  LargeSendSize;          /* Largest TCP payload the adapter segments (0 = none) */
 } IP_INTERFACE, *PIP_INTERFACE;
 
+/* IP_INTERFACE.ChecksumOffload flags */
+#define IP_OFFLOAD_IP_CHECKSUM  0x1
+#define IP_OFFLOAD_TCP_CHECKSUM 0x2
+
 typedef struct _IP_SET_ADDRESS {
     ULONG NteIndex;
     IPv4_RAW_ADDRESS Address;
@@ -142,6 +142,8 @@ typedef struct _ADDRESS_FILE {
     UINT DF;                              /* Don't fragment */
     UINT BCast;                           /* Receive broadcast packets */
     UINT HeaderIncl;                      /* Include header in RawIP packets */
+    ULONG ReceiveWindowSize;              /* TCP receive window of connections (zero if automatic) */
+    ULONG SendBufferSize;                 /* TCP send buffer of connections (zero if automatic) */
     WORK_QUEUE_ITEM WorkItem;             /* Work queue item handle */
     DATAGRAM_COMPLETION_ROUTINE Complete; /* Completion routine for delete request */
     PVOID Context;                        /* Delete request context */
@@ -285,6 +287,10 @@ typedef struct _CONNECTION_ENDPOINT {
     NTSTATUS ReceiveShutdownStatus;
     BOOLEAN Closing;
 
+    /* Buffer sizes set by the client (zero if tuned automatically) */
+    ULONG ReceiveWindowSize;
+    ULONG SendBufferSize;
+
     struct _CONNECTION_ENDPOINT *Next; /* Next connection in address file list */
 } CONNECTION_ENDPOINT, *PCONNECTION_ENDPOINT;
 
@@ -9,10 +9,12 @@
 #include "precomp.h"
 
 TDI_STATUS SetConnectionInfo(TDIObjectID *ID,
-                             PCONNECTION_ENDPOINT Connection,
+                             PADDRESS_FILE AddrFile,
                              PVOID Buffer,
                              UINT BufferSize)
 {
+    PCONNECTION_ENDPOINT Connection = AddrFile->Connection;
+
     ASSERT(ID->toi_type == INFO_TYPE_CONNECTION);
     switch (ID->toi_id)
     {
@@ -24,6 +26,26 @@ TDI_STATUS SetConnectionInfo(TDIObjectID *ID,
             Set = *(BOOLEAN*)Buffer;
             return TCPSetNoDelay(Connection, Set);
         }
+        case TCP_SOCKET_WINDOW:
+        {
+            if (BufferSize < sizeof(ULONG))
+                return TDI_INVALID_PARAMETER;
+            /* Sockets usually set this before they connect or listen,
+             * so keep it for the connection that gets associated later */
+            AddrFile->ReceiveWindowSize = *(ULONG*)Buffer;
+            if (!Connection)
+                return TDI_SUCCESS;
+            return TCPSetReceiveWindow(Connection, AddrFile->ReceiveWindowSize);
+        }
+        case TCP_SOCKET_SNDBUF:
+        {
+            if (BufferSize < sizeof(ULONG))
+                return TDI_INVALID_PARAMETER;
+            AddrFile->SendBufferSize = *(ULONG*)Buffer;
+            if (!Connection)
+                return TDI_SUCCESS;
+            return TCPSetSendBuffer(Connection, AddrFile->SendBufferSize);
+        }
         default:
             DbgPrint("TCPIP: Unknown connection info ID: %u.\n", ID->toi_id);
     }
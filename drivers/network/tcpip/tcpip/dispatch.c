@@ -376,6 +376,12 @@ NTSTATUS DispTdiAssociateAddress(
   UnlockObjectFromDpcLevel(AddrFile);
   UnlockObject(Connection, OldIrql);
 
+  /* Apply the buffer sizes set before the connection was associated */
+  if (AddrFile->ReceiveWindowSize)
+      TCPSetReceiveWindow(Connection, AddrFile->ReceiveWindowSize);
+  if (AddrFile->SendBufferSize)
+      TCPSetSendBuffer(Connection, AddrFile->SendBufferSize);
+
   return STATUS_SUCCESS;
 }
 
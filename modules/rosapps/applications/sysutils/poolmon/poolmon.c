@@ -0,0 +1,296 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS pool tag monitor
+ * FILE:            sysutils/poolmon/poolmon.c
+ * PURPOSE:         Display pool usage per tag, sorted by bytes or allocation rate
+ * PROGRAMMERS:     ReactOS Team
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WIN32_NO_STATUS
+#include <windows.h>
+#define NTOS_MODE_USER
+#include <ndk/exfuncs.h>
+
+typedef enum _SORT_ORDER
+{
+    SortByBytes,
+    SortByAllocationRate,
+    SortByOutstanding,
+    SortByTag
+} SORT_ORDER;
+
+#define POOL_PAGED      0x1
+#define POOL_NONPAGED   0x2
+
+typedef struct _TAG_USAGE
+{
+    ULONG Tag;
+    ULONG Allocs;
+    ULONG Frees;
+    SIZE_T Used;
+    LONG AllocRate;
+    LONG FreeRate;
+    SSIZE_T UsedDelta;
+} TAG_USAGE, *PTAG_USAGE;
+
+static SORT_ORDER SortOrder = SortByBytes;
+static ULONG PoolTypes = POOL_PAGED | POOL_NONPAGED;
+static ULONG Interval = 5;
+static ULONG Samples = 0;
+static ULONG Lines = 25;
+
+static PSYSTEM_POOLTAG_INFORMATION
+QueryPoolTags(VOID)
+{
+    PSYSTEM_POOLTAG_INFORMATION Info;
+    ULONG Size = 0x10000, ReturnLength;
+    NTSTATUS Status;
+
+    /* The tag count can grow between two calls, so loop until it fits */
+    while (TRUE)
+    {
+        Info = HeapAlloc(GetProcessHeap(), 0, Size);
+        if (Info == NULL)
+            return NULL;
+
+        Status = NtQuerySystemInformation(SystemPoolTagInformation, Info, Size, &ReturnLength);
+        if (NT_SUCCESS(Status))
+            return Info;
+
+        HeapFree(GetProcessHeap(), 0, Info);
+        if (Status != STATUS_INFO_LENGTH_MISMATCH)
+        {
+            fprintf(stderr, "NtQuerySystemInformation failed with status 0x%08lx\n", Status);
+            return NULL;
+        }
+
+        Size = max(Size * 2, ReturnLength + 0x1000);
+    }
+}
+
+/* Fold the selected pool types of a tag into a single usage entry */
+static VOID
+GetTagUsage(
+    IN PSYSTEM_POOLTAG Tag,
+    OUT PTAG_USAGE Usage)
+{
+    ZeroMemory(Usage, sizeof(*Usage));
+    Usage->Tag = Tag->TagUlong;
+
+    if (PoolTypes & POOL_PAGED)
+    {
+        Usage->Allocs += Tag->PagedAllocs;
+        Usage->Frees += Tag->PagedFrees;
+        Usage->Used += Tag->PagedUsed;
+    }
+
+    if (PoolTypes & POOL_NONPAGED)
+    {
+        Usage->Allocs += Tag->NonPagedAllocs;
+        Usage->Frees += Tag->NonPagedFrees;
+        Usage->Used += Tag->NonPagedUsed;
+    }
+}
+
+static int __cdecl
+CompareTag(const void *First, const void *Second)
+{
+    const TAG_USAGE *Left = First, *Right = Second;
+
+    if (Left->Tag == Right->Tag)
+        return 0;
+    return Left->Tag < Right->Tag ? -1 : 1;
+}
+
+static int __cdecl
+CompareUsage(const void *First, const void *Second)
+{
+    const TAG_USAGE *Left = First, *Right = Second;
+
+    /* Biggest first, ties are broken by tag so the display stays stable */
+    switch (SortOrder)
+    {
+        case SortByBytes:
+            if (Left->Used != Right->Used)
+                return Left->Used > Right->Used ? -1 : 1;
+            break;
+
+        case SortByAllocationRate:
+            if (Left->AllocRate != Right->AllocRate)
+                return Left->AllocRate > Right->AllocRate ? -1 : 1;
+            break;
+
+        case SortByOutstanding:
+            if (Left->Allocs - Left->Frees != Right->Allocs - Right->Frees)
+                return (LONG)(Left->Allocs - Left->Frees) > (LONG)(Right->Allocs - Right->Frees) ? -1 : 1;
+            break;
+
+        case SortByTag:
+            break;
+    }
+
+    return CompareTag(First, Second);
+}
+
+static VOID
+PrintTag(ULONG Tag)
+{
+    CHAR Name[5];
+    ULONG i;
+
+    for (i = 0; i < 4; i++)
+    {
+        Name[i] = (CHAR)(Tag >> (i * 8));
+        if (Name[i] < ' ' || Name[i] > '~')
+            Name[i] = '.';
+    }
+    Name[4] = ANSI_NULL;
+
+    printf("%s", Name);
+}
+
+static VOID
+PrintSample(
+    IN PTAG_USAGE Usage,
+    IN ULONG Count,
+    IN ULONG Sample)
+{
+    SIZE_T TotalUsed = 0;
+    ULONG i;
+
+    for (i = 0; i < Count; i++)
+        TotalUsed += Usage[i].Used;
+
+    printf("\nSample %lu: %lu tags, %Iu KB in %s pool\n", Sample, Count, TotalUsed / 1024,
+           PoolTypes == POOL_PAGED ? "paged" : PoolTypes == POOL_NONPAGED ? "nonpaged" : "paged and nonpaged");
+    printf("Tag   %10s %10s %10s %8s %8s %12s %12s\n",
+           "Allocs", "Frees", "Diff", "Allocs/s", "Frees/s", "Bytes", "Bytes delta");
+
+    for (i = 0; i < Count && i < Lines; i++)
+    {
+        PrintTag(Usage[i].Tag);
+        printf("  %10lu %10lu %10ld %8ld %8ld %12Iu %12Id\n",
+               Usage[i].Allocs, Usage[i].Frees, (LONG)(Usage[i].Allocs - Usage[i].Frees),
+               Usage[i].AllocRate, Usage[i].FreeRate, Usage[i].Used, Usage[i].UsedDelta);
+    }
+}
+
+static VOID
+PrintUsage(VOID)
+{
+    printf("Usage: poolmon [-b | -a | -d | -t] [-p | -n] [-i seconds] [-c samples] [-l lines]\n\n"
+           "  -b           Sort by bytes in use (default)\n"
+           "  -a           Sort by allocations per second\n"
+           "  -d           Sort by outstanding allocations\n"
+           "  -t           Sort by tag\n"
+           "  -p           Only show paged pool\n"
+           "  -n           Only show nonpaged pool\n"
+           "  -i seconds   Time between samples (default 5)\n"
+           "  -c samples   Stop after this many samples (default: run until Ctrl+C)\n"
+           "  -l lines     Number of tags to display (default 25)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    PSYSTEM_POOLTAG_INFORMATION Info;
+    PTAG_USAGE Current, Previous = NULL, Found;
+    ULONG PreviousCount = 0, Count, Sample, i;
+    DWORD LastTick = 0, Tick, Elapsed;
+    int Arg;
+
+    for (Arg = 1; Arg < argc; Arg++)
+    {
+        if ((argv[Arg][0] != '-' && argv[Arg][0] != '/') || argv[Arg][1] == ANSI_NULL || argv[Arg][2] != ANSI_NULL)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        switch (argv[Arg][1])
+        {
+            case 'b': SortOrder = SortByBytes; break;
+            case 'a': SortOrder = SortByAllocationRate; break;
+            case 'd': SortOrder = SortByOutstanding; break;
+            case 't': SortOrder = SortByTag; break;
+            case 'p': PoolTypes = POOL_PAGED; break;
+            case 'n': PoolTypes = POOL_NONPAGED; break;
+
+            case 'i':
+            case 'c':
+            case 'l':
+                if (Arg + 1 >= argc)
+                {
+                    PrintUsage();
+                    return 1;
+                }
+                i = strtoul(argv[++Arg], NULL, 0);
+                if (argv[Arg - 1][1] == 'i') Interval = max(i, 1);
+                else if (argv[Arg - 1][1] == 'c') Samples = i;
+                else Lines = i;
+                break;
+
+            default:
+                PrintUsage();
+                return 1;
+        }
+    }
+
+    for (Sample = 1; Samples == 0 || Sample <= Samples; Sample++)
+    {
+        Info = QueryPoolTags();
+        if (Info == NULL)
+            return 1;
+
+        Tick = GetTickCount();
+        Elapsed = Previous ? Tick - LastTick : 0;
+        LastTick = Tick;
+
+        Current = HeapAlloc(GetProcessHeap(), 0, max(Info->Count, 1) * sizeof(TAG_USAGE));
+        if (Current == NULL)
+        {
+            HeapFree(GetProcessHeap(), 0, Info);
+            return 1;
+        }
+
+        /* Rates are computed against the previous sample, kept sorted by tag */
+        for (i = 0, Count = 0; i < Info->Count; i++)
+        {
+            GetTagUsage(&Info->TagInfo[i], &Current[Count]);
+
+            /* Skip the tags never used in the pool types we look at */
+            if (Current[Count].Allocs == 0)
+                continue;
+
+            Found = Previous ? bsearch(&Current[Count], Previous, PreviousCount, sizeof(TAG_USAGE), CompareTag) : NULL;
+            if (Found && Elapsed)
+            {
+                Current[Count].AllocRate = (LONG)((Current[Count].Allocs - Found->Allocs) * 1000ULL / Elapsed);
+                Current[Count].FreeRate = (LONG)((Current[Count].Frees - Found->Frees) * 1000ULL / Elapsed);
+                Current[Count].UsedDelta = (SSIZE_T)(Current[Count].Used - Found->Used);
+            }
+            Count++;
+        }
+        HeapFree(GetProcessHeap(), 0, Info);
+
+        qsort(Current, Count, sizeof(TAG_USAGE), CompareUsage);
+        PrintSample(Current, Count, Sample);
+
+        qsort(Current, Count, sizeof(TAG_USAGE), CompareTag);
+        if (Previous)
+            HeapFree(GetProcessHeap(), 0, Previous);
+        Previous = Current;
+        PreviousCount = Count;
+
+        if (Samples == 0 || Sample < Samples)
+            Sleep(Interval * 1000);
+    }
+
+    if (Previous)
+        HeapFree(GetProcessHeap(), 0, Previous);
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for ReadFile, including uncached random reads in a multi-GB file
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define TEST_FILE_SIZE      (2048ULL * 1024 * 1024)
+#define MARKER_SPACING      (16 * 1024 * 1024)
+#define MARKER_COUNT        ((ULONG)(TEST_FILE_SIZE / MARKER_SPACING))
+#define BLOCK_SIZE          4096
+#define RANDOM_READS        4096
+
+static
+BOOL
+AccessBlock(
+    HANDLE hFile,
+    ULONGLONG Offset,
+    PULONG Buffer,
+    BOOL Write)
+{
+    OVERLAPPED Overlapped;
+    DWORD Transferred = 0;
+    BOOL Ret;
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.Offset = (DWORD)Offset;
+    Overlapped.OffsetHigh = (DWORD)(Offset >> 32);
+
+    if (Write)
+        Ret = WriteFile(hFile, Buffer, BLOCK_SIZE, &Transferred, &Overlapped);
+    else
+        Ret = ReadFile(hFile, Buffer, BLOCK_SIZE, &Transferred, &Overlapped);
+
+    return Ret && Transferred == BLOCK_SIZE;
+}
+
+/* Each marker block is filled with its own index */
+static
+BOOL
+CheckMarker(
+    PULONG Buffer,
+    ULONG Index)
+{
+    ULONG i;
+
+    for (i = 0; i < BLOCK_SIZE / sizeof(ULONG); i++)
+    {
+        if (Buffer[i] != Index)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+ULONGLONG
+RandomBlockOffset(VOID)
+{
+    ULONGLONG Block;
+
+    Block = ((ULONGLONG)rand() << 15) | rand();
+    return (Block % (TEST_FILE_SIZE / BLOCK_SIZE)) * BLOCK_SIZE;
+}
+
+static
+void
+TestRandomRead(
+    HANDLE hFile,
+    PULONG Buffer)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG i, Index, Failures = 0;
+
+    /* Markers read in random order must come back from the right place */
+    srand(0x5eed);
+    for (i = 0; i < MARKER_COUNT * 4; i++)
+    {
+        Index = rand() % MARKER_COUNT;
+        if (!AccessBlock(hFile, (ULONGLONG)Index * MARKER_SPACING, Buffer, FALSE) ||
+            !CheckMarker(Buffer, Index))
+        {
+            Failures++;
+        }
+    }
+    ok(Failures == 0, "%lu marker reads failed or returned the wrong data\n", Failures);
+
+    /* Then time reads spread over the whole file */
+    Failures = 0;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < RANDOM_READS; i++)
+    {
+        if (!AccessBlock(hFile, RandomBlockOffset(), Buffer, FALSE))
+            Failures++;
+    }
+    QueryPerformanceCounter(&End);
+    ok(Failures == 0, "%lu random reads failed\n", Failures);
+
+    trace("%lu random %u bytes reads in a %I64u MB file took %I64u us, %I64u us per read\n",
+          (ULONG)RANDOM_READS, BLOCK_SIZE, TEST_FILE_SIZE / (1024 * 1024),
+          (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart,
+          (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart / RANDOM_READS);
+}
+
+START_TEST(ReadFile)
+{
+    CHAR FileName[MAX_PATH], FileSystem[MAX_PATH];
+    ULARGE_INTEGER FreeBytes;
+    LARGE_INTEGER Size;
+    PULONG Buffer;
+    HANDLE hFile;
+    ULONG i, j;
+    BOOL Ret;
+
+    if (!GetCurrentDirectoryA(MAX_PATH, FileName) ||
+        !GetDiskFreeSpaceExA(FileName, &FreeBytes, NULL, NULL))
+    {
+        skip("No test directory available\n");
+        return;
+    }
+
+    if (FreeBytes.QuadPart < TEST_FILE_SIZE + 64 * 1024 * 1024)
+    {
+        skip("Not enough free space for a %I64u MB file\n", TEST_FILE_SIZE / (1024 * 1024));
+        return;
+    }
+
+    if (GetVolumeInformationA(NULL, NULL, 0, NULL, NULL, NULL, FileSystem, MAX_PATH))
+        trace("Testing on %s\n", FileSystem);
+
+    StringCbCatA(FileName, sizeof(FileName), "\\ReadFile.tst");
+    hFile = CreateFileA(FileName,
+                        GENERIC_READ | GENERIC_WRITE,
+                        0,
+                        NULL,
+                        CREATE_ALWAYS,
+                        FILE_FLAG_NO_BUFFERING | FILE_FLAG_DELETE_ON_CLOSE,
+                        NULL);
+    ok(hFile != INVALID_HANDLE_VALUE, "CreateFile failed with %lu\n", GetLastError());
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        skip("No test file\n");
+        return;
+    }
+
+    /* Uncached I/O needs an aligned buffer */
+    Buffer = VirtualAlloc(NULL, BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (Buffer == NULL)
+    {
+        CloseHandle(hFile);
+        skip("No memory\n");
+        return;
+    }
+
+    Size.QuadPart = TEST_FILE_SIZE;
+    Ret = SetFilePointerEx(hFile, Size, NULL, FILE_BEGIN) && SetEndOfFile(hFile);
+    ok(Ret, "Extending the file failed with %lu\n", GetLastError());
+    if (!Ret)
+    {
+        VirtualFree(Buffer, 0, MEM_RELEASE);
+        CloseHandle(hFile);
+        return;
+    }
+
+    for (i = 0; i < MARKER_COUNT; i++)
+    {
+        for (j = 0; j < BLOCK_SIZE / sizeof(ULONG); j++)
+            Buffer[j] = i;
+
+        Ret = AccessBlock(hFile, (ULONGLONG)i * MARKER_SPACING, Buffer, TRUE);
+        if (!Ret)
+            break;
+    }
+    ok(Ret, "Writing marker %lu failed with %lu\n", i, GetLastError());
+
+    if (Ret)
+        TestRandomRead(hFile, Buffer);
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    CloseHandle(hFile);
+}
@@ -0,0 +1,146 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for SetFileCompletionNotificationModes
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#ifndef FILE_SKIP_COMPLETION_PORT_ON_SUCCESS
+#define FILE_SKIP_COMPLETION_PORT_ON_SUCCESS 0x1
+#define FILE_SKIP_SET_EVENT_ON_HANDLE        0x2
+#endif
+
+#define FILE_CHUNKS     64
+#define CHUNK_SIZE      4096
+
+typedef BOOL (WINAPI *PSET_FILE_COMPLETION_NOTIFICATION_MODES)(HANDLE, UCHAR);
+
+static PSET_FILE_COMPLETION_NOTIFICATION_MODES pSetFileCompletionNotificationModes;
+static WCHAR FileName[MAX_PATH];
+static CHAR Buffer[CHUNK_SIZE];
+
+static
+ULONG
+DrainPort(HANDLE Port)
+{
+    DWORD Bytes;
+    ULONG_PTR Key;
+    LPOVERLAPPED Overlapped;
+    ULONG Packets = 0;
+
+    while (GetQueuedCompletionStatus(Port, &Bytes, &Key, &Overlapped, 0) || Overlapped)
+        Packets++;
+
+    return Packets;
+}
+
+/* Read the whole file in chunks, twice so that the second pass is cached */
+static
+VOID
+TestCachedReads(UCHAR Modes)
+{
+    OVERLAPPED Overlapped;
+    HANDLE File, Port;
+    LPOVERLAPPED Completed;
+    ULONG_PTR Key;
+    ULONG Pass, i, Reads = 0, Synchronous = 0, Packets = 0, Signaled = 0;
+    DWORD Bytes;
+
+    File = CreateFileW(FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return;
+
+    Port = CreateIoCompletionPort(File, NULL, 1, 0);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+
+    if (Modes)
+        ok(pSetFileCompletionNotificationModes(File, Modes), "Failed with %lu\n", GetLastError());
+
+    for (Pass = 0; Pass < 2; Pass++)
+    {
+        for (i = 0; i < FILE_CHUNKS; i++)
+        {
+            ZeroMemory(&Overlapped, sizeof(Overlapped));
+            Overlapped.Offset = i * CHUNK_SIZE;
+            Reads++;
+
+            if (ReadFile(File, Buffer, CHUNK_SIZE, &Bytes, &Overlapped))
+            {
+                Synchronous++;
+
+                /* The handle is only signaled if we didn't opt out */
+                if (WaitForSingleObject(File, 0) == WAIT_OBJECT_0)
+                    Signaled++;
+            }
+            else
+            {
+                /* The handle may not be signaled, wait for the packet instead */
+                ok(GetLastError() == ERROR_IO_PENDING, "ReadFile failed with %lu\n", GetLastError());
+                ok(GetQueuedCompletionStatus(Port, &Bytes, &Key, &Completed, INFINITE), "Failed with %lu\n", GetLastError());
+                ok(Completed == &Overlapped, "Got %p\n", Completed);
+                Packets++;
+            }
+
+            ok(Bytes == CHUNK_SIZE, "Read %lu bytes\n", Bytes);
+        }
+    }
+
+    Packets += DrainPort(Port);
+
+    trace("Modes %u: %lu reads, %lu synchronous, %lu packets dequeued\n", Modes, Reads, Synchronous, Packets);
+    if (Modes & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)
+        ok(Packets == Reads - Synchronous, "%lu packets for %lu pending reads\n", Packets, Reads - Synchronous);
+    else
+        ok(Packets == Reads, "%lu packets for %lu reads\n", Packets, Reads);
+
+    if (Modes & FILE_SKIP_SET_EVENT_ON_HANDLE)
+        ok(Signaled == 0, "Handle signaled %lu times\n", Signaled);
+    else
+        ok(Signaled == Synchronous, "Handle signaled %lu times\n", Signaled);
+
+    CloseHandle(Port);
+    CloseHandle(File);
+}
+
+START_TEST(SetFileCompletionNotificationModes)
+{
+    WCHAR TempPath[MAX_PATH];
+    HANDLE File;
+    DWORD Written;
+    ULONG i;
+
+    pSetFileCompletionNotificationModes = (PSET_FILE_COMPLETION_NOTIFICATION_MODES)
+        GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetFileCompletionNotificationModes");
+    if (!pSetFileCompletionNotificationModes)
+    {
+        skip("SetFileCompletionNotificationModes is not available\n");
+        return;
+    }
+
+    /* Invalid modes */
+    SetLastError(0xdeadbeef);
+    ok(!pSetFileCompletionNotificationModes(GetCurrentProcess(), 4), "Succeeded\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "Error %lu\n", GetLastError());
+
+    GetTempPathW(MAX_PATH, TempPath);
+    GetTempFileNameW(TempPath, L"fcn", 0, FileName);
+    File = CreateFileW(FileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return;
+
+    FillMemory(Buffer, sizeof(Buffer), 0x55);
+    for (i = 0; i < FILE_CHUNKS; i++)
+        WriteFile(File, Buffer, sizeof(Buffer), &Written, NULL);
+    CloseHandle(File);
+
+    TestCachedReads(0);
+    TestCachedReads(FILE_SKIP_COMPLETION_PORT_ON_SUCCESS);
+    TestCachedReads(FILE_SKIP_SET_EVENT_ON_HANDLE);
+    TestCachedReads(FILE_SKIP_COMPLETION_PORT_ON_SUCCESS | FILE_SKIP_SET_EVENT_ON_HANDLE);
+
+    DeleteFileW(FileName);
+}
@@ -744,6 +744,63 @@ CheckSomeDefaultAddresses(VOID)
 
 #define RUNS 32
 
+#define FAULT_REGION_SIZE   (64 * 1024 * 1024)
+#define FAULT_ROUNDS        4
+
+/* Demand zero faults are satisfied from the zeroed page list when it keeps up */
+static
+VOID
+BenchmarkDemandZeroFaults(VOID)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    NTSTATUS Status;
+    PVOID BaseAddress;
+    SIZE_T Size;
+    PULONG_PTR Page;
+    ULONG Round, Offset, Pages, NonZero;
+    ULONGLONG Microseconds;
+
+    QueryPerformanceFrequency(&Frequency);
+    Pages = FAULT_REGION_SIZE / PAGE_SIZE;
+
+    for (Round = 0; Round < FAULT_ROUNDS; Round++)
+    {
+        BaseAddress = NULL;
+        Size = FAULT_REGION_SIZE;
+        Status = NtAllocateVirtualMemory(NtCurrentProcess(), &BaseAddress, 0, &Size, MEM_COMMIT, PAGE_READWRITE);
+        ok_ntstatus(Status, STATUS_SUCCESS);
+        if (!NT_SUCCESS(Status))
+            return;
+
+        /* Fault in every page */
+        QueryPerformanceCounter(&Start);
+        for (Offset = 0; Offset < FAULT_REGION_SIZE; Offset += PAGE_SIZE)
+            *(volatile ULONG_PTR *)((PUCHAR)BaseAddress + Offset) = Offset;
+        QueryPerformanceCounter(&End);
+
+        Microseconds = (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+        trace("Round %lu: %lu demand zero faults in %I64u us (%I64u faults/s)\n",
+              Round, Pages, Microseconds, Microseconds ? (ULONGLONG)Pages * 1000000 / Microseconds : 0);
+
+        /* Everything but what we wrote must be zero */
+        NonZero = 0;
+        for (Offset = 0; Offset < FAULT_REGION_SIZE; Offset += PAGE_SIZE)
+        {
+            Page = (PULONG_PTR)((PUCHAR)BaseAddress + Offset);
+            if (Page[0] != Offset) NonZero++;
+            if (Page[1] || Page[PAGE_SIZE / sizeof(ULONG_PTR) / 2] || Page[PAGE_SIZE / sizeof(ULONG_PTR) - 1]) NonZero++;
+        }
+        ok(NonZero == 0, "Round %lu: %lu pages not zeroed\n", Round, NonZero);
+
+        Size = 0;
+        Status = NtFreeVirtualMemory(NtCurrentProcess(), &BaseAddress, &Size, MEM_RELEASE);
+        ok_ntstatus(Status, STATUS_SUCCESS);
+
+        /* Let the zero page thread refill the zeroed list */
+        Sleep(500);
+    }
+}
+
 START_TEST(NtAllocateVirtualMemory)
 {
     PVOID Mem1, Mem2;
@@ -791,4 +848,6 @@ START_TEST(NtAllocateVirtualMemory)
     Free(Mem2);
     ok(CheckMemory1(Mem1, Size1) == TRUE, "CheckMemory1 failure\n");
     Free(Mem1);
+
+    BenchmarkDemandZeroFaults();
 }
@@ -0,0 +1,137 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for large object directories
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define MAX_OBJECTS     20000
+
+static HANDLE Events[MAX_OBJECTS];
+
+static
+NTSTATUS
+CreateNamedEvent(
+    HANDLE Directory,
+    ULONG Index,
+    BOOLEAN Open,
+    PHANDLE Handle)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    UNICODE_STRING Name;
+    WCHAR Buffer[32];
+
+    StringCbPrintfW(Buffer, sizeof(Buffer), L"Event%lu", Index);
+    RtlInitUnicodeString(&Name, Buffer);
+    InitializeObjectAttributes(&ObjectAttributes, &Name, 0, Directory, NULL);
+
+    if (Open)
+        return NtOpenEvent(Handle, EVENT_ALL_ACCESS, &ObjectAttributes);
+
+    return NtCreateEvent(Handle, EVENT_ALL_ACCESS, &ObjectAttributes, NotificationEvent, FALSE);
+}
+
+static
+ULONG
+CountEntries(
+    HANDLE Directory)
+{
+    UCHAR Buffer[4096];
+    POBJECT_DIRECTORY_INFORMATION Info;
+    ULONG Context = 0, Count = 0;
+    BOOLEAN Restart = TRUE;
+    NTSTATUS Status;
+
+    do
+    {
+        Status = NtQueryDirectoryObject(Directory, Buffer, sizeof(Buffer), FALSE, Restart, &Context, NULL);
+        if (!NT_SUCCESS(Status))
+            break;
+
+        for (Info = (POBJECT_DIRECTORY_INFORMATION)Buffer; Info->Name.Buffer; Info++)
+            Count++;
+
+        Restart = FALSE;
+    } while (Status == STATUS_MORE_ENTRIES);
+
+    ok(Status == STATUS_SUCCESS || Status == STATUS_NO_MORE_ENTRIES, "Status = 0x%lx\n", Status);
+    return Count;
+}
+
+/* Creation and lookup time per object must not grow with the directory size */
+static
+VOID
+TestDirectorySize(
+    ULONG Objects)
+{
+    LARGE_INTEGER Frequency, Start, Created, Opened;
+    HANDLE Directory, Handle;
+    NTSTATUS Status;
+    ULONG i, Failures = 0;
+
+    Status = NtCreateDirectoryObject(&Directory, DIRECTORY_ALL_ACCESS, NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status)) return;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < Objects; i++)
+    {
+        Status = CreateNamedEvent(Directory, i, FALSE, &Events[i]);
+        if (!NT_SUCCESS(Status))
+        {
+            Events[i] = NULL;
+            Failures++;
+        }
+    }
+
+    QueryPerformanceCounter(&Created);
+
+    for (i = 0; i < Objects; i++)
+    {
+        Status = CreateNamedEvent(Directory, i, TRUE, &Handle);
+        if (!NT_SUCCESS(Status))
+        {
+            Failures++;
+            continue;
+        }
+        NtClose(Handle);
+    }
+
+    QueryPerformanceCounter(&Opened);
+
+    trace("%lu objects: %I64u ns per create, %I64u ns per open\n", Objects,
+          (Created.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / Objects,
+          (Opened.QuadPart - Created.QuadPart) * 1000000000 / Frequency.QuadPart / Objects);
+    ok(Failures == 0, "%lu failures\n", Failures);
+
+    /* Every object is listed exactly once */
+    ok(CountEntries(Directory) == Objects - Failures, "Wrong number of entries\n");
+
+    /* Existing names still collide */
+    Status = CreateNamedEvent(Directory, Objects / 2, FALSE, &Handle);
+    ok_hex(Status, STATUS_OBJECT_NAME_EXISTS);
+    if (NT_SUCCESS(Status)) NtClose(Handle);
+
+    /* Closing the last handle removes the names again */
+    for (i = 0; i < Objects; i++)
+    {
+        if (Events[i]) NtClose(Events[i]);
+    }
+
+    ok(CountEntries(Directory) == 0, "Directory not empty\n");
+    Status = CreateNamedEvent(Directory, 0, TRUE, &Handle);
+    ok_hex(Status, STATUS_OBJECT_NAME_NOT_FOUND);
+
+    NtClose(Directory);
+}
+
+START_TEST(NtCreateDirectoryObject)
+{
+    TestDirectorySize(100);
+    TestDirectorySize(1000);
+    TestDirectorySize(MAX_OBJECTS);
+}
@@ -0,0 +1,142 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for NtFlushKey, including flush latency with many dirty keys
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+static
+NTSTATUS
+OpenSubKey(
+    HANDLE ParentKey,
+    ULONG Index,
+    BOOLEAN Create,
+    PHANDLE KeyHandle)
+{
+    WCHAR Buffer[32];
+    UNICODE_STRING KeyName;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+
+    swprintf(Buffer, L"Key%lu", Index);
+    RtlInitUnicodeString(&KeyName, Buffer);
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &KeyName,
+                               OBJ_CASE_INSENSITIVE,
+                               ParentKey,
+                               NULL);
+    if (!Create)
+        return NtOpenKey(KeyHandle, DELETE, &ObjectAttributes);
+
+    return NtCreateKey(KeyHandle,
+                       KEY_SET_VALUE,
+                       &ObjectAttributes,
+                       0,
+                       NULL,
+                       REG_OPTION_NON_VOLATILE,
+                       NULL);
+}
+
+/* Dirty that many keys, then time the flush that writes them out */
+static
+void
+TestFlushLatency(
+    HANDLE ParentKey,
+    ULONG Keys)
+{
+    LARGE_INTEGER Frequency, Start, Flushed, FlushedClean;
+    UNICODE_STRING ValueName = RTL_CONSTANT_STRING(L"Value");
+    HANDLE KeyHandle;
+    NTSTATUS Status;
+    ULONG i, Data, Failures = 0;
+
+    for (i = 0; i < Keys; i++)
+    {
+        Status = OpenSubKey(ParentKey, i, TRUE, &KeyHandle);
+        if (!NT_SUCCESS(Status))
+        {
+            Failures++;
+            continue;
+        }
+
+        Data = i;
+        Status = NtSetValueKey(KeyHandle, &ValueName, 0, REG_DWORD, &Data, sizeof(Data));
+        if (!NT_SUCCESS(Status))
+            Failures++;
+        NtClose(KeyHandle);
+    }
+    ok(Failures == 0, "%lu keys could not be created\n", Failures);
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    Status = NtFlushKey(ParentKey);
+    QueryPerformanceCounter(&Flushed);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    /* Nothing is dirty anymore, so this one has nothing to write */
+    Status = NtFlushKey(ParentKey);
+    QueryPerformanceCounter(&FlushedClean);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    trace("%lu dirty keys: flush took %I64u us, clean flush took %I64u us\n", Keys,
+          (Flushed.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart,
+          (FlushedClean.QuadPart - Flushed.QuadPart) * 1000000 / Frequency.QuadPart);
+
+    for (i = 0; i < Keys; i++)
+    {
+        Status = OpenSubKey(ParentKey, i, FALSE, &KeyHandle);
+        if (!NT_SUCCESS(Status))
+            continue;
+        NtDeleteKey(KeyHandle);
+        NtClose(KeyHandle);
+    }
+}
+
+START_TEST(NtFlushKey)
+{
+    UNICODE_STRING KeyName = RTL_CONSTANT_STRING(L"Software\\ReactOS NtFlushKey test");
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE ParentKeyHandle, KeyHandle;
+    NTSTATUS Status;
+
+    Status = RtlOpenCurrentUser(KEY_CREATE_SUB_KEY, &ParentKeyHandle);
+    ok(Status == STATUS_SUCCESS, "RtlOpenCurrentUser returned %lx\n", Status);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("No user key handle\n");
+        return;
+    }
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &KeyName,
+                               OBJ_CASE_INSENSITIVE,
+                               ParentKeyHandle,
+                               NULL);
+    Status = NtCreateKey(&KeyHandle,
+                         KEY_CREATE_SUB_KEY | DELETE,
+                         &ObjectAttributes,
+                         0,
+                         NULL,
+                         REG_OPTION_NON_VOLATILE,
+                         NULL);
+    ok(Status == STATUS_SUCCESS, "NtCreateKey returned %lx\n", Status);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(ParentKeyHandle);
+        skip("No key handle\n");
+        return;
+    }
+
+    /* Invalid handle */
+    Status = NtFlushKey(NULL);
+    ok_hex(Status, STATUS_INVALID_HANDLE);
+
+    TestFlushLatency(KeyHandle, 16);
+    TestFlushLatency(KeyHandle, 256);
+    TestFlushLatency(KeyHandle, 2048);
+
+    NtDeleteKey(KeyHandle);
+    NtClose(KeyHandle);
+    NtClose(ParentKeyHandle);
+}
@@ -1626,6 +1626,91 @@ Test_Truncate(VOID)
     ok(Success == TRUE, "DeleteFileW failed with %lu\n", GetLastError());
 }
 
+/* Touch a page file backed section larger than RAM, then read it back */
+static void
+Test_PageFileSectionPaging(VOID)
+{
+    SYSTEM_BASIC_INFORMATION BasicInfo;
+    SYSTEM_PERFORMANCE_INFORMATION Before, Written, Read;
+    LARGE_INTEGER MaximumSize;
+    HANDLE SectionHandle;
+    PVOID BaseAddress = NULL;
+    SIZE_T ViewSize = 0, Pages, i;
+    PULONG_PTR Page;
+    DWORD Start, WriteTime, ReadTime;
+    ULONG Corrupted = 0;
+    NTSTATUS Status;
+
+    Status = NtQuerySystemInformation(SystemBasicInformation, &BasicInfo, sizeof(BasicInfo), NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    Status = NtQuerySystemInformation(SystemPerformanceInformation, &Before, sizeof(Before), NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    /* Enough to push some of it out, without exhausting the page file */
+    Pages = BasicInfo.NumberOfPhysicalPages + 0x2000;
+    Pages = min(Pages, 0x20000);
+    if (Before.CommitLimit - Before.CommittedPages < Pages + 0x1000)
+    {
+        skip("Not enough commit for %Iu pages\n", Pages);
+        return;
+    }
+
+    MaximumSize.QuadPart = (LONGLONG)Pages * PAGE_SIZE;
+    Status = NtCreateSection(&SectionHandle, SECTION_ALL_ACCESS, NULL, &MaximumSize,
+                             PAGE_READWRITE, SEC_COMMIT, NULL);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    Status = NtMapViewOfSection(SectionHandle, NtCurrentProcess(), &BaseAddress, 0, 0,
+                                NULL, &ViewSize, ViewShare, 0, PAGE_READWRITE);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(SectionHandle);
+        return;
+    }
+
+    Start = GetTickCount();
+    for (i = 0; i < Pages; i++)
+    {
+        Page = (PULONG_PTR)((ULONG_PTR)BaseAddress + i * PAGE_SIZE);
+        Page[0] = i;
+        Page[PAGE_SIZE / sizeof(ULONG_PTR) - 1] = ~i;
+    }
+    WriteTime = GetTickCount() - Start;
+    NtQuerySystemInformation(SystemPerformanceInformation, &Written, sizeof(Written), NULL);
+
+    Start = GetTickCount();
+    for (i = 0; i < Pages; i++)
+    {
+        Page = (PULONG_PTR)((ULONG_PTR)BaseAddress + i * PAGE_SIZE);
+        if (Page[0] != i || Page[PAGE_SIZE / sizeof(ULONG_PTR) - 1] != ~i)
+            Corrupted++;
+    }
+    ReadTime = GetTickCount() - Start;
+    NtQuerySystemInformation(SystemPerformanceInformation, &Read, sizeof(Read), NULL);
+
+    ok(Corrupted == 0, "%lu pages corrupted\n", Corrupted);
+    trace("%Iu pages: written in %lu ms, read in %lu ms\n", Pages, WriteTime, ReadTime);
+    trace("Page file writes: %lu pages in %lu I/Os\n",
+          Read.DirtyPagesWriteCount - Before.DirtyPagesWriteCount,
+          Read.DirtyWriteIoCount - Before.DirtyWriteIoCount);
+    trace("Page file reads: %lu pages in %lu I/Os\n",
+          Read.PageReadCount - Written.PageReadCount,
+          Read.PageReadIoCount - Written.PageReadIoCount);
+    ok(Read.DirtyPagesWriteCount - Before.DirtyPagesWriteCount >= Read.DirtyWriteIoCount - Before.DirtyWriteIoCount,
+       "Fewer pages than writes\n");
+    ok(Read.PageReadCount - Written.PageReadCount >= Read.PageReadIoCount - Written.PageReadIoCount,
+       "Fewer pages than reads\n");
+
+    Status = NtUnmapViewOfSection(NtCurrentProcess(), BaseAddress);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    NtClose(SectionHandle);
+}
+
 START_TEST(NtMapViewOfSection)
 {
     Test_PageFileSection();
@@ -1635,4 +1720,5 @@ START_TEST(NtMapViewOfSection)
     Test_SectionContents(TRUE);
     Test_EmptyFile();
     Test_Truncate();
+    Test_PageFileSectionPaging();
 }
@@ -38,6 +38,109 @@ SizeOfMdl(VOID)
     return Is64BitSystem() ? 48 : 28;
 }
 
+#define BENCH_FILE_SIZE     (512 * 1024 * 1024)
+#define BENCH_READ_SIZE     4096
+#define BENCH_READS         65536
+
+/* Cached reads all over a large file, the cost of finding the view in the
+   cache must not depend on where it is */
+static
+VOID
+BenchmarkCachedReads(
+    POBJECT_ATTRIBUTES ObjectAttributes,
+    PVOID Buffer,
+    SIZE_T BufferSize)
+{
+    NTSTATUS Status;
+    HANDLE FileHandle;
+    IO_STATUS_BLOCK IoStatus;
+    LARGE_INTEGER ByteOffset, Frequency, Start, End;
+    FILE_DISPOSITION_INFORMATION DispositionInfo;
+    ULONG Seed = 0x5eed;
+    ULONG Pass, i, Failures;
+
+    Status = NtCreateFile(&FileHandle,
+                          FILE_READ_DATA | FILE_WRITE_DATA | DELETE | SYNCHRONIZE,
+                          ObjectAttributes,
+                          &IoStatus,
+                          NULL,
+                          0,
+                          0,
+                          FILE_SUPERSEDE,
+                          FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
+                          NULL,
+                          0);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    for (ByteOffset.QuadPart = 0;
+         ByteOffset.QuadPart < BENCH_FILE_SIZE;
+         ByteOffset.QuadPart += BufferSize)
+    {
+        Status = NtWriteFile(FileHandle,
+                             NULL,
+                             NULL,
+                             NULL,
+                             &IoStatus,
+                             Buffer,
+                             (ULONG)min(BufferSize, BENCH_FILE_SIZE - ByteOffset.QuadPart),
+                             &ByteOffset,
+                             NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            skip("Failed to write the benchmark file, status %lx\n", Status);
+            goto Cleanup;
+        }
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+
+    for (Pass = 0; Pass < 2; Pass++)
+    {
+        Failures = 0;
+        QueryPerformanceCounter(&Start);
+
+        for (i = 0; i < BENCH_READS; i++)
+        {
+            if (Pass == 0)
+                ByteOffset.QuadPart = (LONGLONG)i * BENCH_READ_SIZE % BENCH_FILE_SIZE;
+            else
+                ByteOffset.QuadPart = (LONGLONG)(RtlRandom(&Seed) % (BENCH_FILE_SIZE / BENCH_READ_SIZE)) * BENCH_READ_SIZE;
+
+            Status = NtReadFile(FileHandle,
+                                NULL,
+                                NULL,
+                                NULL,
+                                &IoStatus,
+                                Buffer,
+                                BENCH_READ_SIZE,
+                                &ByteOffset,
+                                NULL);
+            if (!NT_SUCCESS(Status))
+                Failures++;
+        }
+
+        QueryPerformanceCounter(&End);
+
+        trace("%s cached reads of %u bytes: %I64u ns per read\n",
+              Pass == 0 ? "Sequential" : "Random", BENCH_READ_SIZE,
+              (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / BENCH_READS);
+        ok(Failures == 0, "%lu reads failed\n", Failures);
+    }
+
+Cleanup:
+    DispositionInfo.DeleteFile = TRUE;
+    Status = NtSetInformationFile(FileHandle,
+                                  &IoStatus,
+                                  &DispositionInfo,
+                                  sizeof(DispositionInfo),
+                                  FileDispositionInformation);
+    ok_hex(Status, STATUS_SUCCESS);
+    Status = NtClose(FileHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+}
+
 START_TEST(NtReadFile)
 {
     NTSTATUS Status;
@@ -232,6 +335,8 @@ START_TEST(NtReadFile)
     Status = NtClose(FileHandle);
     ok_hex(Status, STATUS_SUCCESS);
 
+    BenchmarkCachedReads(&ObjectAttributes, Buffer, BufferSize);
+
     Status = NtFreeVirtualMemory(NtCurrentProcess(),
                                  &Buffer,
                                  &BufferSize,
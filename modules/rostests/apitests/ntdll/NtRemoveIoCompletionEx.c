@@ -0,0 +1,93 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for NtRemoveIoCompletionEx
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define PACKETS     100
+#define BATCH       16
+
+static ULONG ApcCount;
+
+static
+VOID
+NTAPI
+ApcRoutine(
+    PVOID NormalContext,
+    PVOID SystemArgument1,
+    PVOID SystemArgument2)
+{
+    ApcCount++;
+}
+
+START_TEST(NtRemoveIoCompletionEx)
+{
+    FILE_IO_COMPLETION_INFORMATION Information[BATCH];
+    LARGE_INTEGER Timeout;
+    HANDLE Port;
+    NTSTATUS Status;
+    ULONG i, Removed, Total = 0, Calls = 0, OutOfOrder = 0;
+
+    Status = NtCreateIoCompletion(&Port, IO_COMPLETION_ALL_ACCESS, NULL, 0);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    /* Nothing queued */
+    Timeout.QuadPart = 0;
+    Removed = 0xdeadbeef;
+    Status = NtRemoveIoCompletionEx(Port, Information, BATCH, &Removed, &Timeout, FALSE);
+    ok_hex(Status, STATUS_TIMEOUT);
+
+    /* No room */
+    Status = NtRemoveIoCompletionEx(Port, Information, 0, &Removed, &Timeout, FALSE);
+    ok_hex(Status, STATUS_INVALID_PARAMETER);
+
+    for (i = 0; i < PACKETS; i++)
+    {
+        Status = NtSetIoCompletion(Port, (PVOID)(ULONG_PTR)i, (PVOID)(ULONG_PTR)(i + 1), STATUS_SUCCESS, i * 2);
+        ok_hex(Status, STATUS_SUCCESS);
+    }
+
+    /* Everything comes back in order, a batch at a time */
+    while (Total < PACKETS)
+    {
+        Status = NtRemoveIoCompletionEx(Port, Information, BATCH, &Removed, &Timeout, FALSE);
+        ok_hex(Status, STATUS_SUCCESS);
+        if (Status != STATUS_SUCCESS)
+            break;
+
+        Calls++;
+        ok(Removed == min(BATCH, PACKETS - Total), "Removed %lu\n", Removed);
+        for (i = 0; i < Removed; i++, Total++)
+        {
+            if (Information[i].KeyContext != (PVOID)(ULONG_PTR)Total ||
+                Information[i].ApcContext != (PVOID)(ULONG_PTR)(Total + 1) ||
+                Information[i].IoStatusBlock.Information != Total * 2)
+            {
+                OutOfOrder++;
+            }
+        }
+    }
+
+    ok(Total == PACKETS, "Got %lu packets\n", Total);
+    ok(Calls == (PACKETS + BATCH - 1) / BATCH, "Needed %lu calls\n", Calls);
+    ok(OutOfOrder == 0, "%lu packets out of order\n", OutOfOrder);
+
+    /* Empty again */
+    Status = NtRemoveIoCompletionEx(Port, Information, BATCH, &Removed, &Timeout, FALSE);
+    ok_hex(Status, STATUS_TIMEOUT);
+
+    /* Alertable waits return for user APCs */
+    Status = NtQueueApcThread(NtCurrentThread(), ApcRoutine, NULL, NULL, NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+    Timeout.QuadPart = -10000000LL;
+    Status = NtRemoveIoCompletionEx(Port, Information, BATCH, &Removed, &Timeout, TRUE);
+    ok_hex(Status, STATUS_USER_APC);
+    ok(ApcCount == 1, "ApcCount = %lu\n", ApcCount);
+
+    NtClose(Port);
+}
@@ -9,6 +9,77 @@
 
 PVOID Buffers[0x100];
 
+#define FRAGMENT_BLOCKS     8192
+#define FRAGMENT_ROUNDS     20000
+
+/* Leaves Count free blocks of 1.5 to 40 KB in the non-dedicated list, then
+   measures how long allocations which have to search it take */
+static
+VOID
+TestFragmentation(
+    ULONG Count)
+{
+    static PVOID Blocks[FRAGMENT_BLOCKS];
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Seed = 0x600d;
+    ULONG i, Round, Failures = 0;
+    SIZE_T Size;
+    PVOID Block;
+    HANDLE Heap;
+
+    Heap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    for (i = 0; i < Count * 2; i++)
+    {
+        Blocks[i] = RtlAllocateHeap(Heap, 0, 1536 + RtlRandom(&Seed) % (40 * 1024 - 1536));
+        if (!Blocks[i]) Failures++;
+    }
+
+    /* Every other one, so that they can't be coalesced */
+    for (i = 0; i < Count * 2; i += 2)
+    {
+        RtlFreeHeap(Heap, 0, Blocks[i]);
+        Blocks[i] = NULL;
+    }
+
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "%lu free blocks: heap not valid\n", Count);
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (Round = 0; Round < FRAGMENT_ROUNDS; Round++)
+    {
+        Size = 1024 + RtlRandom(&Seed) % (48 * 1024);
+        Block = RtlAllocateHeap(Heap, 0, Size);
+        if (!Block)
+        {
+            Failures++;
+            continue;
+        }
+
+        if (!RtlFreeHeap(Heap, 0, Block))
+            Failures++;
+    }
+
+    QueryPerformanceCounter(&End);
+
+    trace("%lu free blocks: %I64u ns per allocation\n", Count,
+          (End.QuadPart - Start.QuadPart) * 1000000000 / Frequency.QuadPart / FRAGMENT_ROUNDS);
+    ok(Failures == 0, "%lu free blocks: %lu failures\n", Count, Failures);
+
+    /* Mix it up some more and check that the free lists are still sane */
+    for (i = 1; i < Count * 2; i += 4)
+    {
+        RtlFreeHeap(Heap, 0, Blocks[i]);
+        Blocks[i] = RtlAllocateHeap(Heap, 0, 1024 + RtlRandom(&Seed) % (48 * 1024));
+    }
+
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "%lu free blocks: heap not valid\n", Count);
+    RtlDestroyHeap(Heap);
+}
+
 START_TEST(RtlAllocateHeap)
 {
     USHORT i;
@@ -71,4 +142,9 @@ START_TEST(RtlAllocateHeap)
     _SEH2_END;
 
     ok(hHeap == NULL, "Unexpected heap value: %p\n", hHeap);
+
+    /* The search time must not grow with the number of free blocks */
+    TestFragmentation(16);
+    TestFragmentation(256);
+    TestFragmentation(FRAGMENT_BLOCKS / 2);
 }
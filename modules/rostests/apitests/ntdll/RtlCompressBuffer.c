@@ -0,0 +1,283 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for RtlCompressBuffer round trips and throughput
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define TEST_BUFFER_SIZE    (256 * 1024)
+
+typedef enum _TEST_DATA_KIND
+{
+    DataRandom,
+    DataZeroes,
+    DataText,
+    DataImage,
+    DataKindCount
+} TEST_DATA_KIND;
+
+static const PCSTR DataKindNames[] = { "random", "zeroes", "text", "image" };
+
+static const struct
+{
+    USHORT Format;
+    PCSTR Name;
+} Formats[] =
+{
+    { COMPRESSION_FORMAT_LZNT1,         "lznt1" },
+    { COMPRESSION_FORMAT_XPRESS,        "xpress" },
+    { COMPRESSION_FORMAT_XPRESS_HUFF,   "xpress_huff" },
+};
+
+static NTSTATUS (NTAPI *pRtlDecompressBufferEx)(USHORT, PUCHAR, ULONG, PUCHAR, ULONG, PULONG, PVOID);
+
+static
+VOID
+FillTestData(
+    PUCHAR Buffer,
+    ULONG Size,
+    TEST_DATA_KIND Kind)
+{
+    static const PCSTR Words[] = { "the ", "quick ", "brown ", "fox ", "jumps ",
+                                   "over ", "the ", "lazy ", "dog", ".\r\n" };
+    PIMAGE_NT_HEADERS NtHeaders;
+    PUCHAR Image;
+    ULONG Seed = 0x5eed;
+    ULONG i = 0, ImageSize;
+    PCSTR Word;
+
+    /* Code and data of a real binary, repeated if it is too small */
+    if (Kind == DataImage)
+    {
+        Image = (PUCHAR)GetModuleHandleW(L"ntdll.dll");
+        NtHeaders = RtlImageNtHeader(Image);
+        ImageSize = NtHeaders->OptionalHeader.SizeOfImage;
+        for (i = 0; i < Size; i += ImageSize)
+            RtlCopyMemory(Buffer + i, Image, min(ImageSize, Size - i));
+        return;
+    }
+
+    while (i < Size)
+    {
+        switch (Kind)
+        {
+            case DataRandom:
+                Buffer[i++] = (UCHAR)RtlRandom(&Seed);
+                break;
+
+            case DataZeroes:
+                Buffer[i++] = 0;
+                break;
+
+            default:
+                Word = Words[RtlRandom(&Seed) % RTL_NUMBER_OF(Words)];
+                while (*Word && i < Size)
+                    Buffer[i++] = *Word++;
+                break;
+        }
+    }
+}
+
+static
+ULONGLONG
+KilobytesPerSecond(
+    ULONG Size,
+    LARGE_INTEGER Start,
+    LARGE_INTEGER End,
+    LARGE_INTEGER Frequency)
+{
+    ULONGLONG Ticks = End.QuadPart - Start.QuadPart;
+
+    return Ticks ? (ULONGLONG)Size * Frequency.QuadPart / 1024 / Ticks : 0;
+}
+
+static
+ULONG
+RoundTrip(
+    USHORT FormatAndEngine,
+    PUCHAR Data,
+    ULONG Size,
+    PUCHAR Compressed,
+    ULONG CompressedSize,
+    PUCHAR Decompressed,
+    PVOID WorkSpace,
+    PVOID FragmentWorkSpace,
+    PCSTR Name)
+{
+    LARGE_INTEGER Frequency, Start, Middle, End;
+    ULONG FinalSize, FinalUncompressedSize;
+    NTSTATUS Status;
+
+    FinalSize = 0xdeadbeef;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    Status = RtlCompressBuffer(FormatAndEngine, Data, Size, Compressed, CompressedSize,
+                               4096, &FinalSize, WorkSpace);
+    QueryPerformanceCounter(&Middle);
+    ok(Status == STATUS_SUCCESS, "%s: Status = 0x%08lx\n", Name, Status);
+    if (!NT_SUCCESS(Status))
+        return 0;
+    ok(FinalSize <= CompressedSize, "%s: FinalSize = %lu\n", Name, FinalSize);
+
+    FinalUncompressedSize = 0xdeadbeef;
+    RtlFillMemory(Decompressed, Size, 0x11);
+    if (pRtlDecompressBufferEx)
+        Status = pRtlDecompressBufferEx(FormatAndEngine & 0xFF, Decompressed, Size, Compressed,
+                                        FinalSize, &FinalUncompressedSize, FragmentWorkSpace);
+    else
+        Status = RtlDecompressBuffer(FormatAndEngine & 0xFF, Decompressed, Size, Compressed,
+                                     FinalSize, &FinalUncompressedSize);
+    QueryPerformanceCounter(&End);
+    ok(Status == STATUS_SUCCESS, "%s: Status = 0x%08lx\n", Name, Status);
+    ok(FinalUncompressedSize == Size, "%s: FinalUncompressedSize = %lu\n", Name, FinalUncompressedSize);
+    ok(RtlCompareMemory(Decompressed, Data, Size) == Size, "%s: Data mismatch\n", Name);
+
+    if (Size == TEST_BUFFER_SIZE)
+    {
+        trace("%s: %lu -> %lu bytes, compress %I64u KB/s, decompress %I64u KB/s\n", Name, Size, FinalSize,
+              KilobytesPerSecond(Size, Start, Middle, Frequency),
+              KilobytesPerSecond(Size, Middle, End, Frequency));
+    }
+
+    return FinalSize;
+}
+
+static
+VOID
+TestFormat(
+    USHORT Format,
+    PCSTR FormatName,
+    PUCHAR Data,
+    PUCHAR Compressed,
+    ULONG CompressedSize,
+    PUCHAR Decompressed)
+{
+    static const ULONG Sizes[] = { 0, 1, 3, 4095, 4096, 4097, 3 * 4096 + 17, 65536, TEST_BUFFER_SIZE };
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize, FinalSize;
+    ULONG StandardSize, MaximumSize;
+    PVOID WorkSpace, FragmentWorkSpace;
+    TEST_DATA_KIND Kind;
+    NTSTATUS Status;
+    CHAR Name[64];
+    ULONG i;
+
+    Status = RtlGetCompressionWorkSpaceSize(Format | COMPRESSION_ENGINE_MAXIMUM,
+                                            &WorkSpaceSize, &FragmentWorkSpaceSize);
+    ok(Status == STATUS_SUCCESS, "%s: Status = 0x%08lx\n", FormatName, Status);
+    if (!NT_SUCCESS(Status))
+        return;
+    ok(WorkSpaceSize != 0, "%s: WorkSpaceSize = %lu\n", FormatName, WorkSpaceSize);
+
+    WorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, WorkSpaceSize);
+    FragmentWorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, max(FragmentWorkSpaceSize, 1));
+    if (!WorkSpace || !FragmentWorkSpace)
+    {
+        skip("Out of memory\n");
+        goto Cleanup;
+    }
+
+    /* No workspace, no match finder */
+    Status = RtlCompressBuffer(Format, Data, 16, Compressed, CompressedSize,
+                               4096, &FinalSize, NULL);
+    ok(Status != STATUS_SUCCESS, "%s: Status = 0x%08lx\n", FormatName, Status);
+
+    for (Kind = DataRandom; Kind < DataKindCount; Kind++)
+    {
+        FillTestData(Data, TEST_BUFFER_SIZE, Kind);
+
+        for (i = 0; i < RTL_NUMBER_OF(Sizes); i++)
+        {
+            /* LZNT1 has no representation for an empty buffer */
+            if (!Sizes[i] && Format == COMPRESSION_FORMAT_LZNT1)
+                continue;
+
+            StringCbPrintfA(Name, sizeof(Name), "%s/%s/%lu/standard", FormatName, DataKindNames[Kind], Sizes[i]);
+            StandardSize = RoundTrip(Format | COMPRESSION_ENGINE_STANDARD,
+                                     Data, Sizes[i], Compressed, CompressedSize,
+                                     Decompressed, WorkSpace, FragmentWorkSpace, Name);
+
+            StringCbPrintfA(Name, sizeof(Name), "%s/%s/%lu/maximum", FormatName, DataKindNames[Kind], Sizes[i]);
+            MaximumSize = RoundTrip(Format | COMPRESSION_ENGINE_MAXIMUM,
+                                    Data, Sizes[i], Compressed, CompressedSize,
+                                    Decompressed, WorkSpace, FragmentWorkSpace, Name);
+
+            if (Sizes[i] < TEST_BUFFER_SIZE || Kind == DataImage)
+                continue;
+
+            if (Kind == DataRandom)
+            {
+                /* Incompressible LZNT1 chunks are stored */
+                if (Format == COMPRESSION_FORMAT_LZNT1)
+                {
+                    FinalSize = Sizes[i] + Sizes[i] / 4096 * sizeof(USHORT);
+                    ok(StandardSize == FinalSize, "StandardSize = %lu\n", StandardSize);
+                    ok(MaximumSize == FinalSize, "MaximumSize = %lu\n", MaximumSize);
+                }
+            }
+            else
+            {
+                ok(StandardSize < Sizes[i] / 2, "%s: StandardSize = %lu\n", FormatName, StandardSize);
+                ok(MaximumSize <= StandardSize, "%s: MaximumSize = %lu, StandardSize = %lu\n",
+                   FormatName, MaximumSize, StandardSize);
+            }
+        }
+    }
+
+Cleanup:
+    if (FragmentWorkSpace) RtlFreeHeap(RtlGetProcessHeap(), 0, FragmentWorkSpace);
+    if (WorkSpace) RtlFreeHeap(RtlGetProcessHeap(), 0, WorkSpace);
+}
+
+START_TEST(RtlCompressBuffer)
+{
+    PUCHAR Data, Compressed, Decompressed;
+    ULONG CompressedSize, FinalSize;
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize;
+    PVOID WorkSpace;
+    NTSTATUS Status;
+    ULONG i;
+
+    pRtlDecompressBufferEx = (PVOID)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "RtlDecompressBufferEx");
+
+    /* Plain XPRESS spends four bytes of flags on every 32 literals */
+    CompressedSize = TEST_BUFFER_SIZE + TEST_BUFFER_SIZE / 8 + 4096;
+    Data = RtlAllocateHeap(RtlGetProcessHeap(), 0, TEST_BUFFER_SIZE);
+    Compressed = RtlAllocateHeap(RtlGetProcessHeap(), 0, CompressedSize);
+    Decompressed = RtlAllocateHeap(RtlGetProcessHeap(), 0, TEST_BUFFER_SIZE);
+    if (!Data || !Compressed || !Decompressed)
+    {
+        skip("Out of memory\n");
+        goto Cleanup;
+    }
+
+    for (i = 0; i < RTL_NUMBER_OF(Formats); i++)
+    {
+        if (Formats[i].Format != COMPRESSION_FORMAT_LZNT1 && !pRtlDecompressBufferEx)
+        {
+            skip("RtlDecompressBufferEx not available, skipping %s\n", Formats[i].Name);
+            continue;
+        }
+
+        TestFormat(Formats[i].Format, Formats[i].Name, Data, Compressed, CompressedSize, Decompressed);
+    }
+
+    /* Compressed output that does not fit */
+    Status = RtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_LZNT1, &WorkSpaceSize, &FragmentWorkSpaceSize);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%08lx\n", Status);
+    WorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, WorkSpaceSize);
+    if (WorkSpace)
+    {
+        FillTestData(Data, TEST_BUFFER_SIZE, DataRandom);
+        Status = RtlCompressBuffer(COMPRESSION_FORMAT_LZNT1, Data, 8192, Compressed, 8192,
+                                   4096, &FinalSize, WorkSpace);
+        ok(Status == STATUS_BUFFER_TOO_SMALL, "Status = 0x%08lx\n", Status);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, WorkSpace);
+    }
+
+Cleanup:
+    if (Decompressed) RtlFreeHeap(RtlGetProcessHeap(), 0, Decompressed);
+    if (Compressed) RtlFreeHeap(RtlGetProcessHeap(), 0, Compressed);
+    if (Data) RtlFreeHeap(RtlGetProcessHeap(), 0, Data);
+}
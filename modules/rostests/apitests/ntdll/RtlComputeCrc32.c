@@ -0,0 +1,124 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for RtlComputeCrc32 results and throughput
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define BENCH_MIN_SIZE      64
+#define BENCH_MAX_SIZE      (64 * 1024 * 1024)
+#define BENCH_TOTAL_BYTES   (256 * 1024 * 1024)
+
+/* One bit at a time, straight from the definition */
+static
+ULONG
+ReferenceCrc32(
+    ULONG Initial,
+    PUCHAR Data,
+    ULONG Length)
+{
+    ULONG Crc = ~Initial;
+    ULONG i;
+
+    while (Length--)
+    {
+        Crc ^= *Data++;
+        for (i = 0; i < 8; i++)
+            Crc = (Crc >> 1) ^ (0xedb88320 & (0 - (Crc & 1)));
+    }
+
+    return ~Crc;
+}
+
+static
+VOID
+TestResults(
+    PUCHAR Buffer,
+    ULONG Size)
+{
+    ULONG Offset, Length, Crc, Expected;
+    ULONG Seed = 0x5eed;
+
+    /* Known values */
+    Crc = RtlComputeCrc32(0, (PUCHAR)"123456789", 9);
+    ok(Crc == 0xcbf43926, "Crc = 0x%08lx\n", Crc);
+    Crc = RtlComputeCrc32(0, Buffer, 0);
+    ok(Crc == 0, "Crc = 0x%08lx\n", Crc);
+    Crc = RtlComputeCrc32(0x12345678, Buffer, 0);
+    ok(Crc == 0x12345678, "Crc = 0x%08lx\n", Crc);
+
+    /* Every alignment and tail, on both sides of the vector threshold */
+    for (Offset = 0; Offset < 16; Offset++)
+    {
+        for (Length = 0; Length < 1100 && Offset + Length <= Size; Length++)
+        {
+            Expected = ReferenceCrc32(Offset * 0x01010101, Buffer + Offset, Length);
+            Crc = RtlComputeCrc32(Offset * 0x01010101, Buffer + Offset, Length);
+            if (Crc != Expected)
+            {
+                ok(0, "Offset %lu, Length %lu: Crc = 0x%08lx, expected 0x%08lx\n",
+                   Offset, Length, Crc, Expected);
+                return;
+            }
+        }
+    }
+
+    /* Splitting the buffer must not change the result */
+    Expected = ReferenceCrc32(0, Buffer, Size);
+    Length = RtlRandom(&Seed) % Size;
+    Crc = RtlComputeCrc32(0, Buffer, Length);
+    Crc = RtlComputeCrc32(Crc, Buffer + Length, Size - Length);
+    ok(Crc == Expected, "Crc = 0x%08lx, expected 0x%08lx\n", Crc, Expected);
+}
+
+static
+VOID
+Benchmark(
+    PUCHAR Buffer)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Size, Iterations, i;
+    ULONG Crc = 0;
+    ULONGLONG Ticks;
+
+    QueryPerformanceFrequency(&Frequency);
+
+    for (Size = BENCH_MIN_SIZE; Size <= BENCH_MAX_SIZE; Size *= 4)
+    {
+        Iterations = max(BENCH_TOTAL_BYTES / Size, 4);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+            Crc = RtlComputeCrc32(Crc, Buffer, Size);
+        QueryPerformanceCounter(&End);
+
+        Ticks = End.QuadPart - Start.QuadPart;
+        trace("%9lu bytes: %I64u MB/s (crc 0x%08lx)\n", Size,
+              Ticks ? (ULONGLONG)Size * Iterations * Frequency.QuadPart / Ticks / (1024 * 1024) : 0,
+              Crc);
+    }
+}
+
+START_TEST(RtlComputeCrc32)
+{
+    PUCHAR Buffer;
+    ULONG Seed = 0x1234;
+    ULONG i;
+
+    Buffer = VirtualAlloc(NULL, BENCH_MAX_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!Buffer)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    for (i = 0; i < 64 * 1024; i++)
+        Buffer[i] = (UCHAR)RtlRandom(&Seed);
+
+    TestResults(Buffer, 64 * 1024);
+    Benchmark(Buffer);
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+}
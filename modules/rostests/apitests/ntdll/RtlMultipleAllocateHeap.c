@@ -0,0 +1,257 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for RtlMultipleAllocateHeap and RtlMultipleFreeHeap
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define BENCH_THREADS       4
+#define BENCH_ROUNDS        200
+#define MAX_BATCH           256
+#define HEAP_GRANULARITY    (2 * sizeof(PVOID))
+
+static ULONG (NTAPI *pRtlMultipleAllocateHeap)(PVOID, ULONG, SIZE_T, ULONG, PVOID *);
+static ULONG (NTAPI *pRtlMultipleFreeHeap)(PVOID, ULONG, ULONG, PVOID *);
+
+typedef struct _BENCH_CONTEXT
+{
+    HANDLE Heap;
+    ULONG Batch;
+    BOOLEAN Multiple;
+    ULONG Failures;
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static
+DWORD
+WINAPI
+BenchThread(
+    PVOID Parameter)
+{
+    PBENCH_CONTEXT Context = Parameter;
+    PVOID Blocks[MAX_BATCH];
+    ULONG Round, i;
+
+    for (Round = 0; Round < BENCH_ROUNDS; Round++)
+    {
+        if (Context->Multiple)
+        {
+            if (pRtlMultipleAllocateHeap(Context->Heap, 0, 48, Context->Batch, Blocks) != Context->Batch)
+            {
+                Context->Failures++;
+                continue;
+            }
+
+            if (pRtlMultipleFreeHeap(Context->Heap, 0, Context->Batch, Blocks) != Context->Batch)
+                Context->Failures++;
+        }
+        else
+        {
+            for (i = 0; i < Context->Batch; i++)
+            {
+                Blocks[i] = RtlAllocateHeap(Context->Heap, 0, 48);
+                if (!Blocks[i]) Context->Failures++;
+            }
+
+            for (i = 0; i < Context->Batch; i++)
+            {
+                if (!RtlFreeHeap(Context->Heap, 0, Blocks[i]))
+                    Context->Failures++;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static
+VOID
+RunBenchmark(
+    ULONG Batch,
+    BOOLEAN Multiple)
+{
+    BENCH_CONTEXT Contexts[BENCH_THREADS];
+    HANDLE Threads[BENCH_THREADS];
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG i, Failures = 0;
+    ULONGLONG Microseconds;
+    HANDLE Heap;
+
+    Heap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < BENCH_THREADS; i++)
+    {
+        Contexts[i].Heap = Heap;
+        Contexts[i].Batch = Batch;
+        Contexts[i].Multiple = Multiple;
+        Contexts[i].Failures = 0;
+        Threads[i] = CreateThread(NULL, 0, BenchThread, &Contexts[i], 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+    }
+
+    for (i = 0; i < BENCH_THREADS; i++)
+    {
+        if (!Threads[i]) continue;
+        WaitForSingleObject(Threads[i], INFINITE);
+        CloseHandle(Threads[i]);
+        Failures += Contexts[i].Failures;
+    }
+
+    QueryPerformanceCounter(&End);
+
+    Microseconds = (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+    trace("%s, batches of %lu: %lu threads x %lu rounds in %I64u us\n",
+          Multiple ? "RtlMultiple*Heap" : "RtlAllocateHeap/RtlFreeHeap",
+          Batch, BENCH_THREADS, BENCH_ROUNDS, Microseconds);
+    ok(Failures == 0, "%lu failures\n", Failures);
+
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "Heap not valid\n");
+    RtlDestroyHeap(Heap);
+}
+
+static
+VOID
+TestBatch(
+    HANDLE Heap,
+    ULONG Flags,
+    SIZE_T Size,
+    ULONG Count)
+{
+    PUCHAR Blocks[MAX_BATCH];
+    ULONG Allocated, Freed, i, j;
+
+    RtlFillMemory(Blocks, sizeof(Blocks), 0xcc);
+    Allocated = pRtlMultipleAllocateHeap(Heap, Flags, Size, Count, (PVOID *)Blocks);
+    ok(Allocated == Count, "Size %Iu: allocated %lu of %lu\n", Size, Allocated, Count);
+
+    for (i = 0; i < Allocated; i++)
+    {
+        ok(RtlSizeHeap(Heap, 0, Blocks[i]) == Size, "Size %Iu: block %lu is %Iu bytes\n",
+           Size, i, RtlSizeHeap(Heap, 0, Blocks[i]));
+
+        if (Flags & HEAP_ZERO_MEMORY)
+        {
+            for (j = 0; j < Size; j++)
+                if (Blocks[i][j] != 0) break;
+            ok(j == Size, "Size %Iu: block %lu not zeroed at %lu\n", Size, i, j);
+        }
+
+        /* Blocks must not overlap */
+        RtlFillMemory(Blocks[i], Size, (UCHAR)i);
+    }
+
+    for (i = 0; i < Allocated; i++)
+    {
+        for (j = 0; j < Size; j++)
+            if (Blocks[i][j] != (UCHAR)i) break;
+        ok(j == Size, "Size %Iu: block %lu overwritten at %lu\n", Size, i, j);
+    }
+
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "Size %Iu: heap not valid\n", Size);
+
+    Freed = pRtlMultipleFreeHeap(Heap, 0, Allocated, (PVOID *)Blocks);
+    ok(Freed == Allocated, "Size %Iu: freed %lu of %lu\n", Size, Freed, Allocated);
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "Size %Iu: heap not valid\n", Size);
+}
+
+/* A batch that takes all of a free block, or all but one unit, leaves its neighbour consistent */
+static
+VOID
+TestExactFit(
+    ULONG Extra)
+{
+    PVOID Blocks[4], Before, Fit, After;
+    ULONG Count;
+    HANDLE Heap;
+
+    Heap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    /* A free block with busy blocks on both sides, the size of the whole batch */
+    Before = RtlAllocateHeap(Heap, 0, 32);
+    Fit = RtlAllocateHeap(Heap, 0, RTL_NUMBER_OF(Blocks) * (32 + HEAP_GRANULARITY) -
+                                   HEAP_GRANULARITY + Extra * HEAP_GRANULARITY);
+    After = RtlAllocateHeap(Heap, 0, 32);
+    ok(Before && Fit && After, "RtlAllocateHeap failed\n");
+    ok(RtlFreeHeap(Heap, 0, Fit) == TRUE, "Free failed\n");
+
+    Count = pRtlMultipleAllocateHeap(Heap, 0, 32, RTL_NUMBER_OF(Blocks), Blocks);
+    ok(Count == RTL_NUMBER_OF(Blocks), "Extra %lu: Count = %lu\n", Extra, Count);
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "Extra %lu: heap not valid\n", Extra);
+
+    /* Coalescing goes back through the previous sizes */
+    ok(RtlFreeHeap(Heap, 0, After) == TRUE, "Free failed\n");
+    Count = pRtlMultipleFreeHeap(Heap, 0, Count, Blocks);
+    ok(Count == RTL_NUMBER_OF(Blocks), "Extra %lu: Count = %lu\n", Extra, Count);
+    ok(RtlFreeHeap(Heap, 0, Before) == TRUE, "Free failed\n");
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "Extra %lu: heap not valid after free\n", Extra);
+
+    RtlDestroyHeap(Heap);
+}
+
+START_TEST(RtlMultipleAllocateHeap)
+{
+    static const SIZE_T Sizes[] = { 0, 1, 24, 100, 1000, 4000, 20000 };
+    PVOID Blocks[3];
+    ULONG Info, Count, i;
+    HANDLE Heap;
+
+    pRtlMultipleAllocateHeap = (PVOID)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "RtlMultipleAllocateHeap");
+    pRtlMultipleFreeHeap = (PVOID)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "RtlMultipleFreeHeap");
+    if (!pRtlMultipleAllocateHeap || !pRtlMultipleFreeHeap)
+    {
+        skip("RtlMultipleAllocateHeap or RtlMultipleFreeHeap not available\n");
+        return;
+    }
+
+    Heap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    for (i = 0; i < RTL_NUMBER_OF(Sizes); i++)
+    {
+        TestBatch(Heap, 0, Sizes[i], 1);
+        TestBatch(Heap, 0, Sizes[i], 64);
+        TestBatch(Heap, HEAP_ZERO_MEMORY, Sizes[i], MAX_BATCH);
+    }
+
+    /* Blocks from the batch are ordinary heap blocks */
+    Count = pRtlMultipleAllocateHeap(Heap, 0, 32, RTL_NUMBER_OF(Blocks), Blocks);
+    ok(Count == RTL_NUMBER_OF(Blocks), "Count = %lu\n", Count);
+    ok(RtlFreeHeap(Heap, 0, Blocks[1]) == TRUE, "Free failed\n");
+
+    /* NULL entries are skipped */
+    Blocks[1] = NULL;
+    Count = pRtlMultipleFreeHeap(Heap, 0, RTL_NUMBER_OF(Blocks), Blocks);
+    ok(Count == RTL_NUMBER_OF(Blocks), "Count = %lu\n", Count);
+
+    Count = pRtlMultipleAllocateHeap(Heap, 0, 32, 0, Blocks);
+    ok(Count == 0, "Count = %lu\n", Count);
+
+    /* Front end heaps take the small blocks */
+    Info = 2;
+    if (NT_SUCCESS(RtlSetHeapInformation(Heap, HeapCompatibilityInformation, &Info, sizeof(Info))))
+    {
+        TestBatch(Heap, HEAP_ZERO_MEMORY, 40, MAX_BATCH);
+        TestBatch(Heap, 0, 4000, 64);
+    }
+
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "Heap not valid\n");
+    RtlDestroyHeap(Heap);
+
+    TestExactFit(0);
+    TestExactFit(1);
+
+    /* Lock acquisitions per block versus per batch */
+    RunBenchmark(64, FALSE);
+    RunBenchmark(64, TRUE);
+    RunBenchmark(MAX_BATCH, FALSE);
+    RunBenchmark(MAX_BATCH, TRUE);
+}
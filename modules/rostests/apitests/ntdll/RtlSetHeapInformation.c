@@ -0,0 +1,211 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for RtlSetHeapInformation and the low fragmentation heap
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define BENCH_THREADS       4
+#define BENCH_ITERATIONS    20000
+#define BENCH_BATCH         64
+
+typedef struct _BENCH_CONTEXT
+{
+    HANDLE Heap;
+    ULONG Seed;
+    ULONG Failures;
+} BENCH_CONTEXT, *PBENCH_CONTEXT;
+
+static
+DWORD
+WINAPI
+BenchThread(
+    PVOID Parameter)
+{
+    PBENCH_CONTEXT Context = Parameter;
+    PUCHAR Blocks[BENCH_BATCH];
+    SIZE_T Sizes[BENCH_BATCH];
+    ULONG i, j;
+
+    for (i = 0; i < BENCH_ITERATIONS / BENCH_BATCH; i++)
+    {
+        for (j = 0; j < BENCH_BATCH; j++)
+        {
+            Sizes[j] = RtlRandom(&Context->Seed) % 512 + 1;
+            Blocks[j] = RtlAllocateHeap(Context->Heap, 0, Sizes[j]);
+            if (!Blocks[j])
+            {
+                Context->Failures++;
+                continue;
+            }
+            Blocks[j][0] = (UCHAR)j;
+            Blocks[j][Sizes[j] - 1] = (UCHAR)j;
+        }
+
+        for (j = 0; j < BENCH_BATCH; j++)
+        {
+            if (!Blocks[j]) continue;
+            if (Blocks[j][0] != (UCHAR)j || Blocks[j][Sizes[j] - 1] != (UCHAR)j)
+                Context->Failures++;
+            if (!RtlFreeHeap(Context->Heap, 0, Blocks[j]))
+                Context->Failures++;
+        }
+    }
+
+    return 0;
+}
+
+static
+ULONG
+RunBenchmark(
+    HANDLE Heap,
+    PCSTR Name)
+{
+    BENCH_CONTEXT Contexts[BENCH_THREADS];
+    HANDLE Threads[BENCH_THREADS];
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG i, Failures = 0;
+    ULONGLONG Microseconds;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    for (i = 0; i < BENCH_THREADS; i++)
+    {
+        Contexts[i].Heap = Heap;
+        Contexts[i].Seed = 0x1234 + i;
+        Contexts[i].Failures = 0;
+        Threads[i] = CreateThread(NULL, 0, BenchThread, &Contexts[i], 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+    }
+
+    for (i = 0; i < BENCH_THREADS; i++)
+    {
+        if (!Threads[i]) continue;
+        WaitForSingleObject(Threads[i], INFINITE);
+        CloseHandle(Threads[i]);
+        Failures += Contexts[i].Failures;
+    }
+
+    QueryPerformanceCounter(&End);
+
+    Microseconds = (End.QuadPart - Start.QuadPart) * 1000000 / Frequency.QuadPart;
+    trace("%s: %lu threads x %lu alloc/free pairs in %I64u us\n",
+          Name, BENCH_THREADS, BENCH_ITERATIONS, Microseconds);
+
+    return Failures;
+}
+
+static
+VOID
+TestFrontEndBlocks(
+    HANDLE Heap)
+{
+    PUCHAR Buffer, NewBuffer;
+    PVOID Blocks[100];
+    SIZE_T Size;
+    ULONG i;
+
+    /* Zeroed small allocation */
+    Buffer = RtlAllocateHeap(Heap, HEAP_ZERO_MEMORY, 40);
+    ok(Buffer != NULL, "Allocation failed\n");
+    if (!Buffer) return;
+    for (i = 0; i < 40; i++)
+        if (Buffer[i] != 0) break;
+    ok(i == 40, "Byte %lu not zeroed\n", i);
+
+    Size = RtlSizeHeap(Heap, 0, Buffer);
+    ok(Size == 40, "Size = %Iu\n", Size);
+    ok(RtlValidateHeap(Heap, 0, Buffer) == TRUE, "Block not valid\n");
+
+    /* Growing it moves it into a bigger size class */
+    RtlFillMemory(Buffer, 40, 0x5a);
+    NewBuffer = RtlReAllocateHeap(Heap, HEAP_ZERO_MEMORY, Buffer, 300);
+    ok(NewBuffer != NULL, "ReAllocation failed\n");
+    if (NewBuffer)
+    {
+        Size = RtlSizeHeap(Heap, 0, NewBuffer);
+        ok(Size == 300, "Size = %Iu\n", Size);
+        ok(NewBuffer[0] == 0x5a && NewBuffer[39] == 0x5a, "Contents not preserved\n");
+        ok(NewBuffer[40] == 0 && NewBuffer[299] == 0, "Tail not zeroed\n");
+        Buffer = NewBuffer;
+    }
+
+    /* In place only can't change the size class */
+    NewBuffer = RtlReAllocateHeap(Heap, HEAP_REALLOC_IN_PLACE_ONLY, Buffer, 8);
+    ok(NewBuffer == NULL, "ReAllocation in place succeeded: %p\n", NewBuffer);
+
+    ok(RtlFreeHeap(Heap, 0, Buffer) == TRUE, "Free failed\n");
+
+    /* Distinct blocks of the same size class */
+    for (i = 0; i < RTL_NUMBER_OF(Blocks); i++)
+    {
+        Blocks[i] = RtlAllocateHeap(Heap, 0, 24);
+        ok(Blocks[i] != NULL, "Allocation %lu failed\n", i);
+        if (i && Blocks[i])
+            ok(Blocks[i] != Blocks[i - 1], "Same block returned twice\n");
+    }
+
+    for (i = 0; i < RTL_NUMBER_OF(Blocks); i++)
+        RtlFreeHeap(Heap, 0, Blocks[i]);
+
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "Heap not valid\n");
+}
+
+START_TEST(RtlSetHeapInformation)
+{
+    HANDLE Heap;
+    ULONG Info;
+    SIZE_T ReturnLength;
+    NTSTATUS Status;
+    ULONG Failures;
+
+    /* A plain heap has no front end */
+    Heap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    Info = 0xdeadbeef;
+    Status = RtlQueryHeapInformation(Heap, HeapCompatibilityInformation, &Info, sizeof(Info), &ReturnLength);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%08lx\n", Status);
+    ok(Info == 0, "Info = %lu\n", Info);
+
+    /* Baseline: everything goes through the heap lock */
+    Failures = RunBenchmark(Heap, "Backend heap");
+    ok(Failures == 0, "%lu failures with the backend heap\n", Failures);
+
+    /* Only the LFH type can be set */
+    Info = 1;
+    Status = RtlSetHeapInformation(Heap, HeapCompatibilityInformation, &Info, sizeof(Info));
+    ok(Status == STATUS_UNSUCCESSFUL, "Status = 0x%08lx\n", Status);
+
+    Info = 2;
+    Status = RtlSetHeapInformation(Heap, HeapCompatibilityInformation, &Info, sizeof(Info));
+    ok(Status == STATUS_SUCCESS, "Status = 0x%08lx\n", Status);
+
+    Info = 0xdeadbeef;
+    Status = RtlQueryHeapInformation(Heap, HeapCompatibilityInformation, &Info, sizeof(Info), &ReturnLength);
+    ok(Status == STATUS_SUCCESS, "Status = 0x%08lx\n", Status);
+    ok(Info == 2, "Info = %lu\n", Info);
+
+    TestFrontEndBlocks(Heap);
+
+    Failures = RunBenchmark(Heap, "Low fragmentation heap");
+    ok(Failures == 0, "%lu failures with the low fragmentation heap\n", Failures);
+
+    ok(RtlValidateHeap(Heap, 0, NULL) == TRUE, "Heap not valid\n");
+    RtlDestroyHeap(Heap);
+
+    /* Unserialized heaps can't have a front end */
+    Heap = RtlCreateHeap(HEAP_GROWABLE | HEAP_NO_SERIALIZE, NULL, 0, 0, NULL, NULL);
+    ok(Heap != NULL, "RtlCreateHeap failed\n");
+    if (!Heap) return;
+
+    Info = 2;
+    Status = RtlSetHeapInformation(Heap, HeapCompatibilityInformation, &Info, sizeof(Info));
+    ok(Status != STATUS_SUCCESS, "Status = 0x%08lx\n", Status);
+
+    RtlDestroyHeap(Heap);
+}
@@ -314,6 +314,107 @@ Test_KernelDebugger(void)
     ok(Status == STATUS_INVALID_INFO_CLASS, "NtSetSystemInformation returned %lx\n", Status);
 }
 
+static
+void
+Test_Lookaside(void)
+{
+    NTSTATUS Status;
+    ULONG ReturnLength, Count, i;
+    ULONG Uninitialized = 0, BadDepth = 0, BadMisses = 0;
+    PSYSTEM_LOOKASIDE_INFORMATION Info;
+    SIZE_T BufferSize = 1024 * sizeof(SYSTEM_LOOKASIDE_INFORMATION);
+
+    Info = RtlAllocateHeap(RtlGetProcessHeap(), 0, BufferSize);
+    if (!Info)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    ReturnLength = 0x55555555;
+    RtlFillMemory(Info, BufferSize, 0x55);
+    Status = NtQuerySystemInformation(SystemLookasideInformation, Info, (ULONG)BufferSize, &ReturnLength);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok(ReturnLength % sizeof(SYSTEM_LOOKASIDE_INFORMATION) == 0, "ReturnLength = %lu\n", ReturnLength);
+    ok(ReturnLength > sizeof(SYSTEM_LOOKASIDE_INFORMATION), "ReturnLength = %lu\n", ReturnLength);
+
+    /* Every list gets its own entry */
+    Count = min(ReturnLength, BufferSize) / sizeof(SYSTEM_LOOKASIDE_INFORMATION);
+    for (i = 0; i < Count; i++)
+    {
+        if (Info[i].Size == 0x55555555 || Info[i].Tag == 0x55555555)
+            Uninitialized++;
+        if (Info[i].CurrentDepth > Info[i].MaximumDepth)
+            BadDepth++;
+        if (Info[i].AllocateMisses > Info[i].TotalAllocates)
+            BadMisses++;
+    }
+    ok(Uninitialized == 0, "%lu of %lu entries not filled in\n", Uninitialized, Count);
+    ok(BadDepth == 0, "%lu lists deeper than their maximum\n", BadDepth);
+    ok(BadMisses == 0, "%lu lists with more misses than allocations\n", BadMisses);
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Info);
+}
+
+static
+void
+Test_PoolTag(void)
+{
+    NTSTATUS Status;
+    ULONG ReturnLength, Count, i, j;
+    ULONG Duplicates = 0, BadPaged = 0, BadNonPaged = 0;
+    BOOLEAN FoundPool = FALSE;
+    PSYSTEM_POOLTAG_INFORMATION Info;
+    ULONG BufferSize = 0x40000;
+
+    Info = RtlAllocateHeap(RtlGetProcessHeap(), 0, BufferSize);
+    if (!Info)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    ReturnLength = 0x55555555;
+    Status = NtQuerySystemInformation(SystemPoolTagInformation, Info, BufferSize, &ReturnLength);
+    if (Status == STATUS_NOT_IMPLEMENTED)
+    {
+        skip("Pool tagging is not enabled\n");
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Info);
+        return;
+    }
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok(ReturnLength == FIELD_OFFSET(SYSTEM_POOLTAG_INFORMATION, TagInfo[Info->Count]), "ReturnLength = %lu\n", ReturnLength);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Info);
+        return;
+    }
+
+    /* The per-processor tables are merged, so each tag is reported once */
+    Count = Info->Count;
+    for (i = 0; i < Count; i++)
+    {
+        for (j = i + 1; j < Count; j++)
+        {
+            if (Info->TagInfo[i].TagUlong == Info->TagInfo[j].TagUlong)
+                Duplicates++;
+        }
+        if (Info->TagInfo[i].PagedAllocs < Info->TagInfo[i].PagedFrees)
+            BadPaged++;
+        if (Info->TagInfo[i].NonPagedAllocs < Info->TagInfo[i].NonPagedFrees)
+            BadNonPaged++;
+        if (Info->TagInfo[i].TagUlong == 'looP')
+            FoundPool = TRUE;
+    }
+    ok(Count > 0, "No tags\n");
+    ok(Duplicates == 0, "%lu duplicate tags\n", Duplicates);
+    ok(BadPaged == 0, "%lu tags with more paged frees than allocations\n", BadPaged);
+    ok(BadNonPaged == 0, "%lu tags with more nonpaged frees than allocations\n", BadNonPaged);
+    ok(FoundPool, "No entry for the pool's own tag\n");
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Info);
+}
+
 START_TEST(NtSystemInformation)
 {
     NTSTATUS Status;
@@ -355,4 +456,6 @@ START_TEST(NtSystemInformation)
     Test_Flags();
     Test_TimeAdjustment();
     Test_KernelDebugger();
+    Test_Lookaside();
+    Test_PoolTag();
 }
@@ -0,0 +1,237 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for thread placement on multiprocessor systems
+ * PROGRAMMER:      ReactOS Team
+ *
+ * Best run on a multiprocessor machine, e.g. qemu -smp 4
+ */
+
+#include "precomp.h"
+
+#define AFFINITY_MASK(Id)   ((KAFFINITY)1 << (Id))
+#define SPIN_MS             300
+#define PINGPONG_MS         1000
+
+typedef struct _SPIN_CONTEXT
+{
+    KAFFINITY Affinity;
+    KAFFINITY SeenProcessors;
+    ULONG WrongProcessor;
+} SPIN_CONTEXT, *PSPIN_CONTEXT;
+
+typedef struct _PINGPONG_CONTEXT
+{
+    HANDLE Events[2];
+    volatile LONG *Stop;
+    ULONG Switches;
+} PINGPONG_CONTEXT, *PPINGPONG_CONTEXT;
+
+static
+DWORD
+WINAPI
+SpinThread(
+    PVOID Parameter)
+{
+    PSPIN_CONTEXT Context = Parameter;
+    DWORD Start = GetTickCount();
+    ULONG Processor;
+
+    while (GetTickCount() - Start < SPIN_MS)
+    {
+        Processor = NtGetCurrentProcessorNumber();
+        Context->SeenProcessors |= AFFINITY_MASK(Processor);
+        if (Context->Affinity && !(Context->Affinity & AFFINITY_MASK(Processor)))
+            Context->WrongProcessor++;
+    }
+
+    return 0;
+}
+
+static
+DWORD
+WINAPI
+PingPongThread(
+    PVOID Parameter)
+{
+    PPINGPONG_CONTEXT Context = Parameter;
+
+    while (!*Context->Stop)
+    {
+        if (WaitForSingleObject(Context->Events[0], INFINITE) != WAIT_OBJECT_0)
+            break;
+        SetEvent(Context->Events[1]);
+        Context->Switches++;
+    }
+
+    /* Release the partner */
+    SetEvent(Context->Events[1]);
+    return 0;
+}
+
+/* All threads must stay within their affinity, even the one they are given later */
+static
+VOID
+TestAffinity(
+    ULONG ProcessorCount)
+{
+    SPIN_CONTEXT Context;
+    KAFFINITY Affinity;
+    HANDLE Thread;
+    NTSTATUS Status;
+    ULONG i;
+
+    for (i = 0; i < ProcessorCount; i++)
+    {
+        RtlZeroMemory(&Context, sizeof(Context));
+        Context.Affinity = AFFINITY_MASK(i);
+
+        Thread = CreateThread(NULL, 0, SpinThread, &Context, CREATE_SUSPENDED, NULL);
+        ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+        if (!Thread) continue;
+
+        Affinity = Context.Affinity;
+        Status = NtSetInformationThread(Thread, ThreadAffinityMask, &Affinity, sizeof(Affinity));
+        ok_hex(Status, STATUS_SUCCESS);
+
+        ResumeThread(Thread);
+        WaitForSingleObject(Thread, INFINITE);
+        CloseHandle(Thread);
+
+        ok(Context.WrongProcessor == 0, "CPU %lu: ran %lu times elsewhere\n", i, Context.WrongProcessor);
+        ok(Context.SeenProcessors == Context.Affinity, "CPU %lu: ran on %Ix\n", i, Context.SeenProcessors);
+    }
+
+    /* Change the affinity of the running thread */
+    if (ProcessorCount > 1)
+    {
+        RtlZeroMemory(&Context, sizeof(Context));
+        Thread = CreateThread(NULL, 0, SpinThread, &Context, 0, NULL);
+        ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+        if (!Thread) return;
+
+        Sleep(SPIN_MS / 4);
+        Affinity = AFFINITY_MASK(ProcessorCount - 1);
+        Status = NtSetInformationThread(Thread, ThreadAffinityMask, &Affinity, sizeof(Affinity));
+        ok_hex(Status, STATUS_SUCCESS);
+
+        /* Give it a moment to be moved away, then start checking */
+        Sleep(10);
+        Context.SeenProcessors = 0;
+        Context.Affinity = Affinity;
+
+        WaitForSingleObject(Thread, INFINITE);
+        CloseHandle(Thread);
+        ok(Context.WrongProcessor == 0, "Ran %lu times on other CPUs\n", Context.WrongProcessor);
+    }
+}
+
+/* As many busy threads as CPUs must spread over them */
+static
+VOID
+TestSpreading(
+    ULONG ProcessorCount)
+{
+    SPIN_CONTEXT Contexts[MAXIMUM_PROCESSORS];
+    HANDLE Threads[MAXIMUM_PROCESSORS];
+    KAFFINITY Seen = 0;
+    ULONG i, Used = 0;
+
+    for (i = 0; i < ProcessorCount; i++)
+    {
+        RtlZeroMemory(&Contexts[i], sizeof(Contexts[i]));
+        Threads[i] = CreateThread(NULL, 0, SpinThread, &Contexts[i], 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed with %lu\n", GetLastError());
+    }
+
+    for (i = 0; i < ProcessorCount; i++)
+    {
+        if (!Threads[i]) continue;
+        WaitForSingleObject(Threads[i], INFINITE);
+        CloseHandle(Threads[i]);
+        Seen |= Contexts[i].SeenProcessors;
+    }
+
+    for (i = 0; i < ProcessorCount; i++)
+    {
+        if (Seen & AFFINITY_MASK(i)) Used++;
+    }
+
+    trace("%lu busy threads ran on %lu of %lu CPUs\n", ProcessorCount, Used, ProcessorCount);
+    if (ProcessorCount > 1)
+        ok(Used > 1, "Only %lu of %lu CPUs used (%Ix)\n", Used, ProcessorCount, Seen);
+}
+
+/* Pairs of threads waking each other up, one pair per CPU at most */
+static
+VOID
+BenchmarkPingPong(
+    ULONG Pairs)
+{
+    PINGPONG_CONTEXT Contexts[MAXIMUM_PROCESSORS][2];
+    HANDLE Threads[MAXIMUM_PROCESSORS][2];
+    HANDLE Events[MAXIMUM_PROCESSORS][2];
+    volatile LONG Stop = FALSE;
+    ULONGLONG Switches = 0;
+    ULONG i, j;
+
+    for (i = 0; i < Pairs; i++)
+    {
+        Events[i][0] = CreateEventW(NULL, FALSE, TRUE, NULL);
+        Events[i][1] = CreateEventW(NULL, FALSE, FALSE, NULL);
+
+        for (j = 0; j < 2; j++)
+        {
+            Contexts[i][j].Events[0] = Events[i][j];
+            Contexts[i][j].Events[1] = Events[i][1 - j];
+            Contexts[i][j].Stop = &Stop;
+            Contexts[i][j].Switches = 0;
+            Threads[i][j] = CreateThread(NULL, 0, PingPongThread, &Contexts[i][j], 0, NULL);
+            ok(Threads[i][j] != NULL, "CreateThread failed with %lu\n", GetLastError());
+        }
+    }
+
+    Sleep(PINGPONG_MS);
+    InterlockedExchange(&Stop, TRUE);
+
+    for (i = 0; i < Pairs; i++)
+    {
+        for (j = 0; j < 2; j++)
+        {
+            if (!Threads[i][j]) continue;
+            WaitForSingleObject(Threads[i][j], INFINITE);
+            CloseHandle(Threads[i][j]);
+            Switches += Contexts[i][j].Switches;
+        }
+
+        CloseHandle(Events[i][0]);
+        CloseHandle(Events[i][1]);
+    }
+
+    trace("%lu thread pairs: %I64u wakeups per second\n", Pairs, Switches * 1000 / PINGPONG_MS);
+    ok(Switches != 0, "No wakeups\n");
+}
+
+START_TEST(ThreadScheduling)
+{
+    SYSTEM_BASIC_INFORMATION BasicInfo;
+    NTSTATUS Status;
+    ULONG ProcessorCount;
+
+    Status = NtQuerySystemInformation(SystemBasicInformation, &BasicInfo, sizeof(BasicInfo), NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    ProcessorCount = min(BasicInfo.NumberOfProcessors, MAXIMUM_PROCESSORS);
+    trace("%lu CPUs\n", ProcessorCount);
+
+    TestAffinity(ProcessorCount);
+    TestSpreading(ProcessorCount);
+
+    /* Wakeups per second must scale with the number of CPUs */
+    BenchmarkPingPong(1);
+    if (ProcessorCount > 1)
+        BenchmarkPingPong(ProcessorCount / 2);
+    BenchmarkPingPong(ProcessorCount);
+}
@@ -0,0 +1,288 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Echo server over an I/O completion port, dequeuing
+ *                  completions one by one or in batches
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "ws2_32.h"
+
+#define ECHO_CLIENTS        16
+#define ECHO_ROUNDS         500
+#define ECHO_MESSAGE        64
+#define ECHO_BATCH          64
+#define ECHO_TIMEOUT        10000
+
+typedef struct _ECHO_CONNECTION
+{
+    OVERLAPPED Overlapped;
+    SOCKET Socket;
+    WSABUF Buffer;
+    BOOL Sending;
+    CHAR Data[ECHO_MESSAGE];
+} ECHO_CONNECTION, *PECHO_CONNECTION;
+
+typedef ULONG (*PDEQUEUE_ROUTINE)(HANDLE Port, LPOVERLAPPED_ENTRY Entries, ULONG Count);
+
+typedef NTSTATUS (NTAPI *PNT_REMOVE_IO_COMPLETION_EX)(HANDLE, PVOID, ULONG, PULONG, PLARGE_INTEGER, BOOLEAN);
+typedef BOOL (WINAPI *PGET_QUEUED_COMPLETION_STATUS_EX)(HANDLE, LPOVERLAPPED_ENTRY, ULONG, PULONG, DWORD, BOOL);
+
+static PNT_REMOVE_IO_COMPLETION_EX pNtRemoveIoCompletionEx;
+static PGET_QUEUED_COMPLETION_STATUS_EX pGetQueuedCompletionStatusEx;
+static USHORT EchoPort;
+
+static
+ULONG
+DequeueSingle(HANDLE Port, LPOVERLAPPED_ENTRY Entries, ULONG Count)
+{
+    DWORD Bytes;
+    ULONG_PTR Key;
+    LPOVERLAPPED Overlapped;
+    BOOL Success;
+
+    Success = GetQueuedCompletionStatus(Port, &Bytes, &Key, &Overlapped, ECHO_TIMEOUT);
+    if (!Overlapped)
+        return 0;
+
+    Entries[0].lpCompletionKey = Key;
+    Entries[0].lpOverlapped = Overlapped;
+    Entries[0].Internal = Success ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+    Entries[0].dwNumberOfBytesTransferred = Bytes;
+    return 1;
+}
+
+static
+ULONG
+DequeueNative(HANDLE Port, LPOVERLAPPED_ENTRY Entries, ULONG Count)
+{
+    LARGE_INTEGER Timeout;
+    ULONG Removed = 0;
+    NTSTATUS Status;
+
+    Timeout.QuadPart = -(LONGLONG)ECHO_TIMEOUT * 10000;
+    Status = pNtRemoveIoCompletionEx(Port, Entries, Count, &Removed, &Timeout, FALSE);
+    if (Status != STATUS_SUCCESS)
+        return 0;
+
+    return Removed;
+}
+
+static
+ULONG
+DequeueKernel32(HANDLE Port, LPOVERLAPPED_ENTRY Entries, ULONG Count)
+{
+    ULONG Removed = 0;
+
+    if (!pGetQueuedCompletionStatusEx(Port, Entries, Count, &Removed, ECHO_TIMEOUT, FALSE))
+        return 0;
+
+    return Removed;
+}
+
+static
+DWORD
+WINAPI
+EchoClient(PVOID Parameter)
+{
+    struct sockaddr_in Address;
+    CHAR Message[ECHO_MESSAGE], Reply[ECHO_MESSAGE];
+    SOCKET Socket;
+    ULONG Round;
+    int Received, Result;
+
+    Socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Socket == INVALID_SOCKET)
+        return 1;
+
+    ZeroMemory(&Address, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = EchoPort;
+    if (connect(Socket, (struct sockaddr *)&Address, sizeof(Address)) == SOCKET_ERROR)
+    {
+        closesocket(Socket);
+        return 1;
+    }
+
+    for (Round = 0; Round < ECHO_ROUNDS; Round++)
+    {
+        FillMemory(Message, sizeof(Message), (CHAR)Round);
+        if (send(Socket, Message, sizeof(Message), 0) != sizeof(Message))
+            break;
+
+        for (Received = 0; Received < sizeof(Reply); Received += Result)
+        {
+            Result = recv(Socket, Reply + Received, sizeof(Reply) - Received, 0);
+            if (Result <= 0)
+                break;
+        }
+
+        if (Received != sizeof(Reply) || memcmp(Message, Reply, sizeof(Reply)))
+            break;
+    }
+
+    closesocket(Socket);
+    return Round == ECHO_ROUNDS ? 0 : 1;
+}
+
+static
+BOOL
+PostEcho(PECHO_CONNECTION Connection, DWORD Bytes)
+{
+    DWORD Flags = 0;
+    int Result;
+
+    ZeroMemory(&Connection->Overlapped, sizeof(Connection->Overlapped));
+    Connection->Buffer.buf = Connection->Data;
+    if (Connection->Sending)
+    {
+        /* The message is back, wait for the next one */
+        Connection->Sending = FALSE;
+        Connection->Buffer.len = sizeof(Connection->Data);
+        Result = WSARecv(Connection->Socket, &Connection->Buffer, 1, NULL, &Flags, &Connection->Overlapped, NULL);
+    }
+    else
+    {
+        /* Send back what we got */
+        Connection->Sending = TRUE;
+        Connection->Buffer.len = Bytes;
+        Result = WSASend(Connection->Socket, &Connection->Buffer, 1, NULL, 0, &Connection->Overlapped, NULL);
+    }
+
+    return Result == 0 || WSAGetLastError() == WSA_IO_PENDING;
+}
+
+static
+VOID
+BenchmarkEchoServer(
+    PCSTR Name,
+    PDEQUEUE_ROUTINE Dequeue,
+    ULONG BatchSize)
+{
+    static ECHO_CONNECTION Connections[ECHO_CLIENTS];
+    OVERLAPPED_ENTRY Entries[ECHO_BATCH];
+    struct sockaddr_in Address;
+    int AddressLength = sizeof(Address);
+    HANDLE Threads[ECHO_CLIENTS];
+    PECHO_CONNECTION Connection;
+    SOCKET Listener;
+    HANDLE Port;
+    ULONG i, Active = 0, Calls = 0, Completions = 0, Removed;
+    DWORD Start, Time, ExitCode;
+
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(Listener != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (Listener == INVALID_SOCKET)
+        return;
+
+    ZeroMemory(&Address, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ok(bind(Listener, (struct sockaddr *)&Address, sizeof(Address)) == 0, "bind failed with %d\n", WSAGetLastError());
+    ok(listen(Listener, ECHO_CLIENTS) == 0, "listen failed with %d\n", WSAGetLastError());
+    getsockname(Listener, (struct sockaddr *)&Address, &AddressLength);
+    EchoPort = Address.sin_port;
+
+    Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+
+    for (i = 0; i < ECHO_CLIENTS; i++)
+        Threads[i] = CreateThread(NULL, 0, EchoClient, NULL, 0, NULL);
+
+    Start = GetTickCount();
+
+    /* Accept everyone and wait for their first message */
+    for (i = 0; i < ECHO_CLIENTS; i++)
+    {
+        Connection = &Connections[i];
+        ZeroMemory(Connection, sizeof(*Connection));
+        Connection->Socket = accept(Listener, NULL, NULL);
+        if (Connection->Socket == INVALID_SOCKET)
+            continue;
+
+        CreateIoCompletionPort((HANDLE)Connection->Socket, Port, (ULONG_PTR)Connection, 0);
+        Connection->Sending = TRUE;
+        if (PostEcho(Connection, 0))
+            Active++;
+        else
+            closesocket(Connection->Socket);
+    }
+
+    while (Active)
+    {
+        Removed = Dequeue(Port, Entries, BatchSize);
+        Calls++;
+        if (!Removed)
+        {
+            ok(0, "%s: timed out with %lu connections left\n", Name, Active);
+            break;
+        }
+
+        for (i = 0; i < Removed; i++)
+        {
+            Connection = (PECHO_CONNECTION)Entries[i].lpCompletionKey;
+            ok(Entries[i].lpOverlapped == &Connection->Overlapped, "Wrong overlapped\n");
+            Completions++;
+
+            /* The client is done, or something went wrong */
+            if (Entries[i].Internal != STATUS_SUCCESS ||
+                Entries[i].dwNumberOfBytesTransferred == 0 ||
+                !PostEcho(Connection, Entries[i].dwNumberOfBytesTransferred))
+            {
+                closesocket(Connection->Socket);
+                Active--;
+            }
+        }
+    }
+
+    Time = GetTickCount() - Start;
+
+    for (i = 0; i < ECHO_CLIENTS; i++)
+    {
+        if (!Threads[i]) continue;
+        WaitForSingleObject(Threads[i], INFINITE);
+        GetExitCodeThread(Threads[i], &ExitCode);
+        ok(ExitCode == 0, "%s: client %lu failed\n", Name, i);
+        CloseHandle(Threads[i]);
+    }
+
+    trace("%s: %lu completions in %lu dequeue calls (%lu.%02lu per call), %lu ms\n",
+          Name, Completions, Calls, Completions / max(Calls, 1),
+          Completions * 100 / max(Calls, 1) % 100, Time);
+    ok(Completions >= ECHO_CLIENTS * ECHO_ROUNDS * 2, "%s: only %lu completions\n", Name, Completions);
+
+    CloseHandle(Port);
+    closesocket(Listener);
+}
+
+START_TEST(iocp)
+{
+    WSADATA WsaData;
+
+    ok(WSAStartup(MAKEWORD(2, 2), &WsaData) == 0, "WSAStartup failed\n");
+
+    pNtRemoveIoCompletionEx = (PNT_REMOVE_IO_COMPLETION_EX)GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtRemoveIoCompletionEx");
+    pGetQueuedCompletionStatusEx = (PGET_QUEUED_COMPLETION_STATUS_EX)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "GetQueuedCompletionStatusEx");
+
+    /* One system call per completion */
+    BenchmarkEchoServer("GetQueuedCompletionStatus", DequeueSingle, 1);
+
+    /* As many completions as are queued per system call */
+    if (pNtRemoveIoCompletionEx)
+    {
+        BenchmarkEchoServer("NtRemoveIoCompletionEx(1)", DequeueNative, 1);
+        BenchmarkEchoServer("NtRemoveIoCompletionEx", DequeueNative, ECHO_BATCH);
+    }
+    else
+    {
+        skip("NtRemoveIoCompletionEx is not available\n");
+    }
+
+    if (pGetQueuedCompletionStatusEx)
+        BenchmarkEchoServer("GetQueuedCompletionStatusEx", DequeueKernel32, ECHO_BATCH);
+    else
+        skip("GetQueuedCompletionStatusEx is not available\n");
+
+    WSACleanup();
+}
@@ -0,0 +1,219 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Bulk TCP transfers over loopback with automatic and
+ *                  fixed SO_RCVBUF/SO_SNDBUF sizes
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "ws2_32.h"
+
+#define TRANSFER_SIZE       (16 * 1024 * 1024)
+#define CHUNK_SIZE          (64 * 1024)
+
+typedef struct _TRANSFER
+{
+    USHORT Port;
+    INT SendBuffer;
+} TRANSFER, *PTRANSFER;
+
+static CHAR SendChunk[CHUNK_SIZE];
+static CHAR RecvChunk[CHUNK_SIZE];
+
+static
+VOID
+FillPattern(PCHAR Buffer, ULONG Offset, ULONG Length)
+{
+    ULONG i;
+
+    for (i = 0; i < Length; i++)
+        Buffer[i] = (CHAR)((Offset + i) % 251);
+}
+
+static
+DWORD
+WINAPI
+SendThread(PVOID Parameter)
+{
+    PTRANSFER Transfer = Parameter;
+    struct sockaddr_in Address;
+    SOCKET Socket;
+    ULONG Sent, Offset;
+    int Result;
+
+    Socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (Socket == INVALID_SOCKET)
+        return 1;
+
+    if (Transfer->SendBuffer &&
+        setsockopt(Socket, SOL_SOCKET, SO_SNDBUF, (PCHAR)&Transfer->SendBuffer, sizeof(INT)) == SOCKET_ERROR)
+    {
+        closesocket(Socket);
+        return 1;
+    }
+
+    ZeroMemory(&Address, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    Address.sin_port = Transfer->Port;
+    if (connect(Socket, (struct sockaddr *)&Address, sizeof(Address)) == SOCKET_ERROR)
+    {
+        closesocket(Socket);
+        return 1;
+    }
+
+    for (Offset = 0; Offset < TRANSFER_SIZE; Offset += CHUNK_SIZE)
+    {
+        FillPattern(SendChunk, Offset, CHUNK_SIZE);
+        for (Sent = 0; Sent < CHUNK_SIZE; Sent += Result)
+        {
+            Result = send(Socket, SendChunk + Sent, CHUNK_SIZE - Sent, 0);
+            if (Result <= 0)
+            {
+                closesocket(Socket);
+                return 1;
+            }
+        }
+    }
+
+    shutdown(Socket, SD_SEND);
+    closesocket(Socket);
+    return 0;
+}
+
+static
+VOID
+TestTransfer(
+    PCSTR Name,
+    INT ReceiveBuffer,
+    INT SendBuffer)
+{
+    TRANSFER Transfer;
+    struct sockaddr_in Address;
+    int AddressLength = sizeof(Address);
+    SOCKET Listener, Socket;
+    HANDLE Thread;
+    ULONG Received = 0, Corrupted = 0, i;
+    DWORD Start, Time, ExitCode;
+    int Result;
+
+    Listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(Listener != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (Listener == INVALID_SOCKET)
+        return;
+
+    /* Accepted connections inherit the listener's window */
+    if (ReceiveBuffer)
+    {
+        Result = setsockopt(Listener, SOL_SOCKET, SO_RCVBUF, (PCHAR)&ReceiveBuffer, sizeof(INT));
+        ok(Result == 0, "%s: setsockopt failed with %d\n", Name, WSAGetLastError());
+    }
+
+    ZeroMemory(&Address, sizeof(Address));
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ok(bind(Listener, (struct sockaddr *)&Address, sizeof(Address)) == 0, "bind failed with %d\n", WSAGetLastError());
+    ok(listen(Listener, 1) == 0, "listen failed with %d\n", WSAGetLastError());
+    getsockname(Listener, (struct sockaddr *)&Address, &AddressLength);
+
+    Transfer.Port = Address.sin_port;
+    Transfer.SendBuffer = SendBuffer;
+    Thread = CreateThread(NULL, 0, SendThread, &Transfer, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+
+    Socket = accept(Listener, NULL, NULL);
+    ok(Socket != INVALID_SOCKET, "%s: accept failed with %d\n", Name, WSAGetLastError());
+
+    Start = GetTickCount();
+    while (Socket != INVALID_SOCKET)
+    {
+        Result = recv(Socket, RecvChunk, sizeof(RecvChunk), 0);
+        if (Result <= 0)
+        {
+            ok(Result == 0, "%s: recv failed with %d\n", Name, WSAGetLastError());
+            break;
+        }
+
+        /* Resizing the window must not lose or reorder anything */
+        for (i = 0; i < (ULONG)Result; i++)
+        {
+            if (RecvChunk[i] != (CHAR)((Received + i) % 251))
+            {
+                Corrupted++;
+                break;
+            }
+        }
+        Received += Result;
+    }
+    Time = GetTickCount() - Start;
+
+    if (Thread)
+    {
+        WaitForSingleObject(Thread, INFINITE);
+        GetExitCodeThread(Thread, &ExitCode);
+        ok(ExitCode == 0, "%s: sender failed\n", Name);
+        CloseHandle(Thread);
+    }
+
+    ok(Received == TRANSFER_SIZE, "%s: received %lu bytes\n", Name, Received);
+    ok(Corrupted == 0, "%s: %lu corrupted receives\n", Name, Corrupted);
+    trace("%s: %lu bytes in %lu ms (%lu KB/s)\n",
+          Name, Received, Time, (ULONG)((ULONGLONG)Received * 1000 / 1024 / max(Time, 1)));
+
+    if (Socket != INVALID_SOCKET)
+        closesocket(Socket);
+    closesocket(Listener);
+}
+
+static
+VOID
+TestOptions(VOID)
+{
+    SOCKET Socket;
+    INT Value, Length;
+
+    Socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(Socket != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (Socket == INVALID_SOCKET)
+        return;
+
+    Value = 256 * 1024;
+    ok(setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (PCHAR)&Value, sizeof(Value)) == 0, "setsockopt failed with %d\n", WSAGetLastError());
+    ok(setsockopt(Socket, SOL_SOCKET, SO_SNDBUF, (PCHAR)&Value, sizeof(Value)) == 0, "setsockopt failed with %d\n", WSAGetLastError());
+
+    Value = 0;
+    Length = sizeof(Value);
+    ok(getsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (PCHAR)&Value, &Length) == 0, "getsockopt failed with %d\n", WSAGetLastError());
+    ok(Value == 256 * 1024, "SO_RCVBUF = %d\n", Value);
+
+    Value = 0;
+    Length = sizeof(Value);
+    ok(getsockopt(Socket, SOL_SOCKET, SO_SNDBUF, (PCHAR)&Value, &Length) == 0, "getsockopt failed with %d\n", WSAGetLastError());
+    ok(Value == 256 * 1024, "SO_SNDBUF = %d\n", Value);
+
+    /* Too small */
+    ok(setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (PCHAR)&Value, 1) == SOCKET_ERROR, "setsockopt succeeded\n");
+    ok(WSAGetLastError() == WSAEFAULT, "Error %d\n", WSAGetLastError());
+
+    closesocket(Socket);
+}
+
+START_TEST(tcpwindow)
+{
+    WSADATA WsaData;
+
+    ok(WSAStartup(MAKEWORD(2, 2), &WsaData) == 0, "WSAStartup failed\n");
+
+    TestOptions();
+
+    /* The windows grow as needed */
+    TestTransfer("Automatic", 0, 0);
+
+    /* Large fixed windows, only usable with window scaling */
+    TestTransfer("1 MB", 1024 * 1024, 1024 * 1024);
+
+    /* Small fixed windows */
+    TestTransfer("8 KB", 8 * 1024, 8 * 1024);
+
+    WSACleanup();
+}
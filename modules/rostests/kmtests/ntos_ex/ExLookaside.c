@@ -0,0 +1,72 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Kernel-Mode Test Suite lookaside list depth tuning test
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <kmt_test.h>
+
+#define TAG_TEST        'aLeT'
+#define ENTRY_SIZE      64
+#define BURST_COUNT     64
+
+static
+VOID
+Sleep(
+    IN ULONG Milliseconds)
+{
+    LARGE_INTEGER Interval;
+
+    Interval.QuadPart = -10000LL * Milliseconds;
+    KeDelayExecutionThread(KernelMode, FALSE, &Interval);
+}
+
+/* Allocate and free bursts of entries, most of them miss a shallow list */
+static
+VOID
+UseList(
+    IN PNPAGED_LOOKASIDE_LIST Lookaside,
+    IN ULONG Milliseconds)
+{
+    PVOID Entries[BURST_COUNT];
+    ULONG Elapsed, Round, i;
+
+    for (Elapsed = 0; Elapsed < Milliseconds; Elapsed += 50)
+    {
+        for (Round = 0; Round < 10; Round++)
+        {
+            for (i = 0; i < BURST_COUNT; i++)
+                Entries[i] = ExAllocateFromNPagedLookasideList(Lookaside);
+            for (i = 0; i < BURST_COUNT; i++)
+                if (Entries[i]) ExFreeToNPagedLookasideList(Lookaside, Entries[i]);
+        }
+        Sleep(50);
+    }
+}
+
+START_TEST(ExLookaside)
+{
+    NPAGED_LOOKASIDE_LIST Lookaside;
+    USHORT InitialDepth, HotDepth, ColdDepth;
+
+    ExInitializeNPagedLookasideList(&Lookaside, NULL, NULL, 0, ENTRY_SIZE, TAG_TEST, 0);
+    InitialDepth = Lookaside.L.Depth;
+    ok(InitialDepth <= Lookaside.L.MaximumDepth, "Depth %u above maximum %u\n", InitialDepth, Lookaside.L.MaximumDepth);
+
+    /* A hot list that keeps missing grows */
+    UseList(&Lookaside, 3000);
+    HotDepth = Lookaside.L.Depth;
+    ok(HotDepth > InitialDepth, "Depth %u did not grow from %u\n", HotDepth, InitialDepth);
+    ok(HotDepth <= Lookaside.L.MaximumDepth, "Depth %u above maximum %u\n", HotDepth, Lookaside.L.MaximumDepth);
+    trace("Depth %u, %lu allocations, %lu misses\n",
+          HotDepth, Lookaside.L.TotalAllocates, Lookaside.L.AllocateMisses);
+
+    /* An unused list shrinks back */
+    Sleep(3000);
+    ColdDepth = Lookaside.L.Depth;
+    ok(ColdDepth < HotDepth, "Depth %u did not shrink from %u\n", ColdDepth, HotDepth);
+    ok(ColdDepth >= InitialDepth, "Depth %u below the minimum %u\n", ColdDepth, InitialDepth);
+
+    ExDeleteNPagedLookasideList(&Lookaside);
+}
@@ -0,0 +1,164 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Kernel-Mode Test Suite Executive worker queue test
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <kmt_test.h>
+
+#define TAG_TEST        'iWeT'
+#define ITEM_COUNT      256
+#define BLOCKING_COUNT  4
+
+typedef struct _TEST_ITEM
+{
+    WORK_QUEUE_ITEM WorkItem;
+    PLONG Remaining;
+    PKEVENT Done;
+    PKEVENT Release;
+    BOOLEAN Wait;
+    BOOLEAN Signal;
+    BOOLEAN Ran;
+    BOOLEAN Passive;
+    BOOLEAN System;
+    BOOLEAN TimedOut;
+} TEST_ITEM, *PTEST_ITEM;
+
+/* Everything the workers touch, kept out of the stack in case they outlive the test */
+typedef struct _TEST_QUEUE
+{
+    KEVENT Done;
+    LONG Remaining;
+    TEST_ITEM Items[ITEM_COUNT];
+} TEST_QUEUE, *PTEST_QUEUE;
+
+static
+VOID
+NTAPI
+WorkerRoutine(
+    IN PVOID Context)
+{
+    PTEST_ITEM Item = Context;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+
+    Item->Passive = KeGetCurrentIrql() == PASSIVE_LEVEL;
+    Item->System = PsIsSystemThread(PsGetCurrentThread());
+
+    if (Item->Wait)
+    {
+        Timeout.QuadPart = -30 * 1000 * 1000 * 10LL;
+        Status = KeWaitForSingleObject(Item->Release, Executive, KernelMode, FALSE, &Timeout);
+        Item->TimedOut = Status == STATUS_TIMEOUT;
+    }
+
+    if (Item->Signal)
+        KeSetEvent(Item->Release, IO_NO_INCREMENT, FALSE);
+
+    Item->Ran = TRUE;
+    if (!InterlockedDecrement(Item->Remaining))
+        KeSetEvent(Item->Done, IO_NO_INCREMENT, FALSE);
+}
+
+static
+VOID
+TestQueue(
+    IN WORK_QUEUE_TYPE QueueType)
+{
+    PTEST_QUEUE Queue;
+    PTEST_ITEM Items;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+    ULONG i, NotRun = 0, NotPassive = 0, NotSystem = 0;
+
+    Queue = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Queue), TAG_TEST);
+    if (skip(Queue != NULL, "No items\n"))
+        return;
+
+    RtlZeroMemory(Queue, sizeof(*Queue));
+    KeInitializeEvent(&Queue->Done, NotificationEvent, FALSE);
+    Queue->Remaining = ITEM_COUNT;
+    Items = Queue->Items;
+
+    /* Queue from every processor, so that all of their queues get used */
+    for (i = 0; i < ITEM_COUNT; i++)
+    {
+        Items[i].Remaining = &Queue->Remaining;
+        Items[i].Done = &Queue->Done;
+        ExInitializeWorkItem(&Items[i].WorkItem, WorkerRoutine, &Items[i]);
+
+        KeSetSystemAffinityThread(AFFINITY_MASK(i % KeNumberProcessors));
+        ExQueueWorkItem(&Items[i].WorkItem, QueueType);
+    }
+    KeRevertToUserAffinityThread();
+
+    Timeout.QuadPart = -30 * 1000 * 1000 * 10LL;
+    Status = KeWaitForSingleObject(&Queue->Done, Executive, KernelMode, FALSE, &Timeout);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+
+    /* Leak what the workers may still use rather than free it */
+    if (Status != STATUS_SUCCESS)
+        return;
+
+    for (i = 0; i < ITEM_COUNT; i++)
+    {
+        if (!Items[i].Ran) NotRun++;
+        if (!Items[i].Passive) NotPassive++;
+        if (!Items[i].System) NotSystem++;
+    }
+    ok(NotRun == 0, "Queue %d: %lu items did not run\n", QueueType, NotRun);
+    ok(NotPassive == 0, "Queue %d: %lu items not at PASSIVE_LEVEL\n", QueueType, NotPassive);
+    ok(NotSystem == 0, "Queue %d: %lu items not in a system thread\n", QueueType, NotSystem);
+
+    ExFreePoolWithTag(Queue, TAG_TEST);
+}
+
+/* Items waiting for a later item of the same queue must not hang it */
+static
+VOID
+TestBlockingItems(VOID)
+{
+    TEST_ITEM Items[BLOCKING_COUNT + 1];
+    KEVENT Done, Release;
+    LONG Remaining = BLOCKING_COUNT + 1;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+    ULONG i, TimedOut = 0;
+
+    RtlZeroMemory(Items, sizeof(Items));
+    KeInitializeEvent(&Done, NotificationEvent, FALSE);
+    KeInitializeEvent(&Release, NotificationEvent, FALSE);
+
+    /* All on the same processor, the last one releases the others */
+    KeSetSystemAffinityThread(AFFINITY_MASK(0));
+    for (i = 0; i <= BLOCKING_COUNT; i++)
+    {
+        Items[i].Remaining = &Remaining;
+        Items[i].Done = &Done;
+        Items[i].Release = &Release;
+        Items[i].Wait = i < BLOCKING_COUNT;
+        Items[i].Signal = i == BLOCKING_COUNT;
+        ExInitializeWorkItem(&Items[i].WorkItem, WorkerRoutine, &Items[i]);
+        ExQueueWorkItem(&Items[i].WorkItem, CriticalWorkQueue);
+    }
+    KeRevertToUserAffinityThread();
+
+    /* The workers time out on their own, so this always ends */
+    Status = KeWaitForSingleObject(&Done, Executive, KernelMode, FALSE, NULL);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+
+    for (i = 0; i < BLOCKING_COUNT; i++)
+    {
+        if (Items[i].TimedOut) TimedOut++;
+    }
+    ok_eq_ulong(TimedOut, 0UL);
+}
+
+START_TEST(ExWorkItem)
+{
+    TestQueue(CriticalWorkQueue);
+    TestQueue(DelayedWorkQueue);
+    TestQueue(HyperCriticalWorkQueue);
+    TestBlockingItems();
+}
@@ -0,0 +1,212 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Kernel-Mode Test Suite Runtime library chunked compression test
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <kmt_test.h>
+
+#define TAG_TEST 'CpmC'
+
+#define CHUNK_SHIFT         12
+#define CHUNK_SIZE          (1 << CHUNK_SHIFT)
+#define NUMBER_OF_CHUNKS    16
+#define DATA_SIZE           (NUMBER_OF_CHUNKS * CHUNK_SIZE - 100)
+
+#define ZERO_CHUNK          2
+#define RANDOM_CHUNK        5
+
+typedef union _TEST_DATA_INFO
+{
+    COMPRESSED_DATA_INFO Info;
+    UCHAR Buffer[FIELD_OFFSET(COMPRESSED_DATA_INFO, CompressedChunkSizes) + NUMBER_OF_CHUNKS * sizeof(ULONG)];
+} TEST_DATA_INFO;
+
+static
+VOID
+FillTestData(
+    PUCHAR Buffer)
+{
+    static const PCSTR Words[] = { "compressed ", "chunk ", "data ", "\r\n" };
+    ULONG Seed = 0x5eed;
+    ULONG i = 0;
+    PCSTR Word;
+
+    while (i < DATA_SIZE)
+    {
+        if (i / CHUNK_SIZE == ZERO_CHUNK)
+        {
+            Buffer[i++] = 0;
+        }
+        else if (i / CHUNK_SIZE == RANDOM_CHUNK)
+        {
+            Buffer[i++] = (UCHAR)RtlRandomEx(&Seed);
+        }
+        else
+        {
+            Word = Words[RtlRandomEx(&Seed) % RTL_NUMBER_OF(Words)];
+            while (*Word && i < DATA_SIZE && i / CHUNK_SIZE != ZERO_CHUNK && i / CHUNK_SIZE != RANDOM_CHUNK)
+                Buffer[i++] = *Word++;
+        }
+    }
+}
+
+static
+VOID
+TestChunks(
+    PUCHAR Data,
+    PUCHAR Compressed,
+    ULONG CompressedSize,
+    PUCHAR Decompressed,
+    PVOID WorkSpace)
+{
+    TEST_DATA_INFO DataInfo;
+    ULONG Offset, i;
+    NTSTATUS Status;
+
+    RtlZeroMemory(&DataInfo, sizeof(DataInfo));
+    DataInfo.Info.CompressionFormatAndEngine = COMPRESSION_FORMAT_LZNT1;
+    DataInfo.Info.ChunkShift = CHUNK_SHIFT;
+
+    /* Too small for the chunk sizes */
+    Status = RtlCompressChunks(Data, DATA_SIZE, Compressed, CompressedSize,
+                               &DataInfo.Info, sizeof(DataInfo) - sizeof(ULONG), WorkSpace);
+    ok_eq_hex(Status, STATUS_BUFFER_TOO_SMALL);
+
+    Status = RtlCompressChunks(Data, DATA_SIZE, Compressed, CompressedSize,
+                               &DataInfo.Info, sizeof(DataInfo), WorkSpace);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_uint(DataInfo.Info.NumberOfChunks, NUMBER_OF_CHUNKS);
+
+    /* Zeroes take no space, incompressible chunks are stored */
+    ok_eq_ulong(DataInfo.Info.CompressedChunkSizes[ZERO_CHUNK], 0UL);
+    ok_eq_ulong(DataInfo.Info.CompressedChunkSizes[RANDOM_CHUNK], (ULONG)CHUNK_SIZE);
+    ok(DataInfo.Info.CompressedChunkSizes[0] < CHUNK_SIZE / 2,
+       "Chunk 0 is %lu bytes\n", DataInfo.Info.CompressedChunkSizes[0]);
+
+    /* All at once */
+    Offset = 0;
+    for (i = 0; i < NUMBER_OF_CHUNKS; i++)
+        Offset += DataInfo.Info.CompressedChunkSizes[i];
+
+    RtlFillMemory(Decompressed, DATA_SIZE, 0x55);
+    Status = RtlDecompressChunks(Decompressed, DATA_SIZE, Compressed, Offset,
+                                 NULL, 0, &DataInfo.Info);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_size(RtlCompareMemory(Decompressed, Data, DATA_SIZE), (SIZE_T)DATA_SIZE);
+
+    /* A single chunk, straight from its offset */
+    Offset = 0;
+    for (i = 0; i < NUMBER_OF_CHUNKS - 1; i++)
+        Offset += DataInfo.Info.CompressedChunkSizes[i];
+
+    DataInfo.Info.CompressedChunkSizes[0] = DataInfo.Info.CompressedChunkSizes[NUMBER_OF_CHUNKS - 1];
+    DataInfo.Info.NumberOfChunks = 1;
+    RtlFillMemory(Decompressed, CHUNK_SIZE, 0x55);
+    Status = RtlDecompressChunks(Decompressed, DATA_SIZE - (NUMBER_OF_CHUNKS - 1) * CHUNK_SIZE,
+                                 Compressed + Offset, DataInfo.Info.CompressedChunkSizes[0],
+                                 NULL, 0, &DataInfo.Info);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_size(RtlCompareMemory(Decompressed, Data + (NUMBER_OF_CHUNKS - 1) * CHUNK_SIZE,
+                                DATA_SIZE - (NUMBER_OF_CHUNKS - 1) * CHUNK_SIZE),
+               (SIZE_T)(DATA_SIZE - (NUMBER_OF_CHUNKS - 1) * CHUNK_SIZE));
+}
+
+static
+VOID
+TestDescribeReserve(
+    PUCHAR Data,
+    PUCHAR Compressed,
+    ULONG CompressedSize,
+    PVOID WorkSpace)
+{
+    PUCHAR Current, End, ChunkBuffer;
+    ULONG FinalSize, ChunkSize, i;
+    NTSTATUS Status;
+
+    /* Walk a compressed buffer chunk by chunk */
+    Status = RtlCompressBuffer(COMPRESSION_FORMAT_LZNT1, Data, DATA_SIZE, Compressed, CompressedSize,
+                               CHUNK_SIZE, &FinalSize, WorkSpace);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+
+    Current = Compressed;
+    End = Compressed + FinalSize;
+    for (i = 0; i < NUMBER_OF_CHUNKS; i++)
+    {
+        Status = RtlDescribeChunk(COMPRESSION_FORMAT_LZNT1, &Current, End, &ChunkBuffer, &ChunkSize);
+        ok_eq_hex(Status, STATUS_SUCCESS);
+        if (!NT_SUCCESS(Status))
+            break;
+
+        if (i == ZERO_CHUNK)
+        {
+            ok_eq_ulong(ChunkSize, 0UL);
+        }
+        else if (i == RANDOM_CHUNK)
+        {
+            ok_eq_ulong(ChunkSize, (ULONG)CHUNK_SIZE);
+            ok_eq_size(RtlCompareMemory(ChunkBuffer, Data + i * CHUNK_SIZE, CHUNK_SIZE), (SIZE_T)CHUNK_SIZE);
+        }
+        else
+        {
+            ok(ChunkSize > 0 && ChunkSize < CHUNK_SIZE, "Chunk %lu is %lu bytes\n", i, ChunkSize);
+        }
+    }
+    ok_eq_pointer(Current, End);
+
+    Status = RtlDescribeChunk(COMPRESSION_FORMAT_LZNT1, &Current, End, &ChunkBuffer, &ChunkSize);
+    ok_eq_hex(Status, STATUS_NO_MORE_ENTRIES);
+    ok_eq_ulong(ChunkSize, 0UL);
+
+    /* Build a buffer from reserved chunks */
+    Current = Compressed;
+    End = Compressed + 2 * CHUNK_SIZE;
+    Status = RtlReserveChunk(COMPRESSION_FORMAT_LZNT1, &Current, End, &ChunkBuffer, 0);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    Status = RtlReserveChunk(COMPRESSION_FORMAT_LZNT1, &Current, End, &ChunkBuffer, CHUNK_SIZE);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    if (NT_SUCCESS(Status))
+        RtlCopyMemory(ChunkBuffer, Data, CHUNK_SIZE);
+    Status = RtlReserveChunk(COMPRESSION_FORMAT_LZNT1, &Current, End, &ChunkBuffer, CHUNK_SIZE);
+    ok_eq_hex(Status, STATUS_BUFFER_TOO_SMALL);
+
+    End = Current;
+    Current = Compressed;
+    Status = RtlDescribeChunk(COMPRESSION_FORMAT_LZNT1, &Current, End, &ChunkBuffer, &ChunkSize);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulong(ChunkSize, 0UL);
+    Status = RtlDescribeChunk(COMPRESSION_FORMAT_LZNT1, &Current, End, &ChunkBuffer, &ChunkSize);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    ok_eq_ulong(ChunkSize, (ULONG)CHUNK_SIZE);
+    ok_eq_size(RtlCompareMemory(ChunkBuffer, Data, CHUNK_SIZE), (SIZE_T)CHUNK_SIZE);
+}
+
+START_TEST(RtlCompressChunks)
+{
+    ULONG WorkSpaceSize, FragmentWorkSpaceSize, CompressedSize;
+    PUCHAR Data, Compressed, Decompressed;
+    PVOID WorkSpace;
+    NTSTATUS Status;
+
+    Status = RtlGetCompressionWorkSpaceSize(COMPRESSION_FORMAT_LZNT1, &WorkSpaceSize, &FragmentWorkSpaceSize);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+
+    CompressedSize = DATA_SIZE + NUMBER_OF_CHUNKS * sizeof(USHORT);
+    Data = ExAllocatePoolWithTag(PagedPool, DATA_SIZE, TAG_TEST);
+    Compressed = ExAllocatePoolWithTag(PagedPool, CompressedSize, TAG_TEST);
+    Decompressed = ExAllocatePoolWithTag(PagedPool, DATA_SIZE, TAG_TEST);
+    WorkSpace = ExAllocatePoolWithTag(PagedPool, WorkSpaceSize, TAG_TEST);
+    if (skip(Data && Compressed && Decompressed && WorkSpace, "Out of memory\n"))
+        goto Cleanup;
+
+    FillTestData(Data);
+    TestChunks(Data, Compressed, CompressedSize, Decompressed, WorkSpace);
+    TestDescribeReserve(Data, Compressed, CompressedSize, WorkSpace);
+
+Cleanup:
+    if (WorkSpace) ExFreePoolWithTag(WorkSpace, TAG_TEST);
+    if (Decompressed) ExFreePoolWithTag(Decompressed, TAG_TEST);
+    if (Compressed) ExFreePoolWithTag(Compressed, TAG_TEST);
+    if (Data) ExFreePoolWithTag(Data, TAG_TEST);
+}
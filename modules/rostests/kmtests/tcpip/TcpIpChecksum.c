@@ -0,0 +1,199 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Kernel-Mode Test Suite TCP/IP checksum routines test
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <kmt_test.h>
+
+#define TAG_TEST 'sCcT'
+
+#define BUFFER_SIZE     0x10000
+#define MAX_OFFSET      16
+
+/* From sdk/lib/drivers/ip/network/checksum.c */
+VOID ChecksumInitialize(VOID);
+ULONG ChecksumFold(ULONG Sum);
+ULONG ChecksumCompute(PVOID Data, UINT Count, ULONG Seed);
+ULONG ChecksumCopy(PVOID Destination, CONST VOID *Source, UINT Count, ULONG Seed);
+ULONG ChecksumCombine(ULONG Sum, ULONG BlockSum, UINT Offset);
+ULONGLONG ChecksumComputeGeneric(PVOID Destination, CONST VOID *Data, UINT Count);
+#if defined(_M_IX86) || defined(_M_AMD64)
+ULONGLONG ChecksumComputeSse2(PVOID Destination, CONST VOID *Data, UINT Count);
+#endif
+
+/* The original routine, summing 16 bits at a time */
+static
+ULONG
+ReferenceChecksum(
+    PVOID Data,
+    UINT Count,
+    ULONG Seed)
+{
+    ULONG Sum = Seed;
+    PUCHAR Buffer = Data;
+
+    while (Count > 1)
+    {
+        Sum += *(USHORT UNALIGNED *)Buffer;
+        Buffer += 2;
+        Count -= 2;
+    }
+
+    if (Count > 0)
+        Sum += *Buffer;
+
+    return ChecksumFold(Sum);
+}
+
+static
+ULONG
+Fold64(
+    ULONGLONG Sum)
+{
+    while (Sum >> 16)
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+
+    return (ULONG)Sum;
+}
+
+static
+VOID
+FillRandom(
+    PUCHAR Buffer,
+    ULONG Length,
+    PULONG Seed)
+{
+    ULONG i;
+
+    for (i = 0; i < Length; i++)
+        Buffer[i] = (UCHAR)(RtlRandomEx(Seed) >> 7);
+}
+
+static
+VOID
+TestKnownValues(
+    PUCHAR Buffer)
+{
+    static const UCHAR Rfc1071[] = { 0x00, 0x01, 0xF2, 0x03, 0xF4, 0xF5, 0xF6, 0xF7 };
+
+    /* RFC 1071 example, 0xDDF2 in network byte order */
+    RtlCopyMemory(Buffer, Rfc1071, sizeof(Rfc1071));
+    ok_eq_hex(ChecksumFold(ChecksumCompute(Buffer, sizeof(Rfc1071), 0)), 0xF2DDUL);
+
+    /* Odd length, the last byte is the high byte in network order */
+    ok_eq_hex(ChecksumFold(ChecksumCompute(Buffer, sizeof(Rfc1071) - 1, 0)), ReferenceChecksum(Buffer, sizeof(Rfc1071) - 1, 0));
+
+    ok_eq_hex(ChecksumFold(ChecksumCompute(Buffer, 0, 0)), 0UL);
+    ok_eq_hex(ChecksumFold(ChecksumCompute(Buffer, 0, 0x1234)), 0x1234UL);
+
+    /* Carries everywhere */
+    RtlFillMemory(Buffer, BUFFER_SIZE, 0xFF);
+    ok_eq_hex(ChecksumFold(ChecksumCompute(Buffer, BUFFER_SIZE, 0)), 0xFFFFUL);
+    ok_eq_hex(ChecksumFold(ChecksumCompute(Buffer, BUFFER_SIZE - 1, 0xFFFFFFFF)), ReferenceChecksum(Buffer, BUFFER_SIZE - 1, 0xFFFF));
+}
+
+static
+VOID
+TestRandomBuffers(
+    PUCHAR Buffer,
+    PUCHAR Copy)
+{
+    ULONG RandomSeed = 0x5eed;
+    ULONG Length, Offset, Seed, Expected, Sum;
+    ULONG Errors = 0, CopyErrors = 0;
+#if defined(_M_IX86) || defined(_M_AMD64)
+    BOOLEAN Sse2 = ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+    KFLOATING_SAVE FloatSave;
+    ULONG Sse2Errors = 0;
+#endif
+
+    FillRandom(Buffer, BUFFER_SIZE, &RandomSeed);
+
+    for (Length = 0; Length < 3000; Length += 1 + Length / 64)
+    {
+        for (Offset = 0; Offset < MAX_OFFSET; Offset++)
+        {
+            Seed = RtlRandomEx(&RandomSeed) & 0xFFFF;
+            Expected = ReferenceChecksum(Buffer + Offset, Length, Seed);
+
+            if (ChecksumFold(ChecksumCompute(Buffer + Offset, Length, Seed)) != Expected)
+                Errors++;
+
+            if (Fold64(Seed + ChecksumComputeGeneric(NULL, Buffer + Offset, Length)) != Expected)
+                Errors++;
+
+            RtlFillMemory(Copy, Length + 2 * MAX_OFFSET, 0xA5);
+            Sum = ChecksumCopy(Copy + MAX_OFFSET - Offset, Buffer + Offset, Length, Seed);
+            if (ChecksumFold(Sum) != Expected)
+                Errors++;
+            if (!RtlEqualMemory(Copy + MAX_OFFSET - Offset, Buffer + Offset, Length) ||
+                Copy[MAX_OFFSET - Offset + Length] != 0xA5 ||
+                Copy[MAX_OFFSET - Offset - 1] != 0xA5)
+                CopyErrors++;
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+            if (Sse2 && NT_SUCCESS(KeSaveFloatingPointState(&FloatSave)))
+            {
+                if (Fold64(Seed + ChecksumComputeSse2(NULL, Buffer + Offset, Length)) != Expected)
+                    Sse2Errors++;
+                if (Fold64(Seed + ChecksumComputeSse2(Copy, Buffer + Offset, Length)) != Expected ||
+                    !RtlEqualMemory(Copy, Buffer + Offset, Length))
+                    Sse2Errors++;
+                KeRestoreFloatingPointState(&FloatSave);
+            }
+#endif
+        }
+    }
+
+    ok_eq_ulong(Errors, 0UL);
+    ok_eq_ulong(CopyErrors, 0UL);
+#if defined(_M_IX86) || defined(_M_AMD64)
+    if (!skip(Sse2, "SSE2 is not available\n"))
+        ok_eq_ulong(Sse2Errors, 0UL);
+#endif
+}
+
+static
+VOID
+TestCombine(
+    PUCHAR Buffer)
+{
+    ULONG RandomSeed = 0xc0ffee;
+    ULONG Length = 1500, Split, Expected, Sum;
+    ULONG Errors = 0;
+
+    FillRandom(Buffer, Length, &RandomSeed);
+    Expected = ReferenceChecksum(Buffer, Length, 0);
+
+    for (Split = 0; Split <= Length; Split++)
+    {
+        Sum = ChecksumCompute(Buffer, Split, 0);
+        Sum = ChecksumCombine(Sum, ChecksumCompute(Buffer + Split, Length - Split, 0), Split);
+        if (ChecksumFold(Sum) != Expected)
+            Errors++;
+    }
+
+    ok_eq_ulong(Errors, 0UL);
+}
+
+START_TEST(TcpIpChecksum)
+{
+    PUCHAR Buffer, Copy;
+
+    ChecksumInitialize();
+
+    Buffer = ExAllocatePoolWithTag(NonPagedPool, BUFFER_SIZE, TAG_TEST);
+    Copy = ExAllocatePoolWithTag(NonPagedPool, BUFFER_SIZE, TAG_TEST);
+    ok(Buffer != NULL && Copy != NULL, "Allocation failed\n");
+    if (!skip(Buffer != NULL && Copy != NULL, "No buffers\n"))
+    {
+        TestKnownValues(Buffer);
+        TestRandomBuffers(Buffer, Copy);
+        TestCombine(Buffer);
+    }
+
+    if (Copy) ExFreePoolWithTag(Copy, TAG_TEST);
+    if (Buffer) ExFreePoolWithTag(Buffer, TAG_TEST);
+}
@@ -364,6 +364,7 @@ retry:
             ASSERT(Refs == 1);
 
             RemoveEntryList(&current->CacheMapVacbListEntry);
+            CcRosRemoveIndexedVacb(current->SharedCacheMap, current);
             RemoveEntryList(&current->VacbLruListEntry);
             InitializeListHead(&current->VacbLruListEntry);
             InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
@@ -452,14 +453,209 @@ CcRosReleaseVacb (
     return STATUS_SUCCESS;
 }
 
-/* Returns with VACB Lock Held! */
+/* The VACB index is a two level sparse array, keyed by the view number
+ * FileOffset / VACB_MAPPING_GRANULARITY. The first level grows with the
+ * highest view of the file, the second level ones are allocated when their
+ * first view gets created and freed with their last one.
+ * All of this is protected by the cache map lock alone, the master lock
+ * isn't needed to find a view. The cache map VACB list is kept as is, in
+ * file offset order, for the callers which go through all the views.
+ */
+
+/* Caller must hold the cache map lock. No reference is taken */
+PROS_VACB
+NTAPI
+CcRosGetIndexedVacb (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset)
+{
+    ULONGLONG View;
+    PROS_VACB_LEVEL Level;
+
+    View = (ULONGLONG)FileOffset / VACB_MAPPING_GRANULARITY;
+    if ((View >> VACB_LEVEL_SHIFT) >= SharedCacheMap->VacbLevelCount)
+    {
+        return NULL;
+    }
+
+    Level = SharedCacheMap->VacbLevels[View >> VACB_LEVEL_SHIFT];
+    if (Level == NULL)
+    {
+        return NULL;
+    }
+
+    return Level->Vacbs[View & (VACB_LEVEL_SIZE - 1)];
+}
+
+/* Returns the VACB mapping the closest view before FileOffset, if any */
+static
+PROS_VACB
+CcRosGetPreviousIndexedVacb (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset)
+{
+    ULONGLONG View;
+    ULONG LevelIndex, Slot;
+    PROS_VACB_LEVEL Level;
+
+    View = (ULONGLONG)FileOffset / VACB_MAPPING_GRANULARITY;
+    if ((View >> VACB_LEVEL_SHIFT) >= SharedCacheMap->VacbLevelCount)
+    {
+        LevelIndex = SharedCacheMap->VacbLevelCount;
+        Slot = 0;
+    }
+    else
+    {
+        LevelIndex = (ULONG)(View >> VACB_LEVEL_SHIFT);
+        Slot = (ULONG)(View & (VACB_LEVEL_SIZE - 1));
+    }
+
+    while (TRUE)
+    {
+        if (LevelIndex < SharedCacheMap->VacbLevelCount)
+        {
+            Level = SharedCacheMap->VacbLevels[LevelIndex];
+            while (Level != NULL && Slot > 0)
+            {
+                Slot--;
+                if (Level->Vacbs[Slot] != NULL)
+                {
+                    return Level->Vacbs[Slot];
+                }
+            }
+        }
+
+        if (LevelIndex == 0)
+        {
+            return NULL;
+        }
+
+        LevelIndex--;
+        Slot = VACB_LEVEL_SIZE;
+    }
+}
+
+static
+NTSTATUS
+CcRosInsertIndexedVacb (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    PROS_VACB Vacb)
+{
+    ULONGLONG View, LevelIndex;
+    ULONG Count;
+    PROS_VACB_LEVEL *Levels;
+    PROS_VACB_LEVEL Level;
+
+    View = (ULONGLONG)Vacb->FileOffset.QuadPart / VACB_MAPPING_GRANULARITY;
+    LevelIndex = View >> VACB_LEVEL_SHIFT;
+
+    /* Grow the first level to cover this view */
+    if (LevelIndex >= SharedCacheMap->VacbLevelCount)
+    {
+        if (LevelIndex >= MAXULONG / sizeof(PROS_VACB_LEVEL))
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        Count = max((ULONG)LevelIndex + 1, SharedCacheMap->VacbLevelCount * 2);
+        Count = min(Count, MAXULONG / sizeof(PROS_VACB_LEVEL));
+        Levels = ExAllocatePoolWithTag(NonPagedPool, Count * sizeof(PROS_VACB_LEVEL), TAG_VACB_INDEX);
+        if (Levels == NULL)
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        RtlZeroMemory(Levels, Count * sizeof(PROS_VACB_LEVEL));
+        if (SharedCacheMap->VacbLevels != NULL)
+        {
+            RtlCopyMemory(Levels, SharedCacheMap->VacbLevels,
+                          SharedCacheMap->VacbLevelCount * sizeof(PROS_VACB_LEVEL));
+            ExFreePoolWithTag(SharedCacheMap->VacbLevels, TAG_VACB_INDEX);
+        }
+
+        SharedCacheMap->VacbLevels = Levels;
+        SharedCacheMap->VacbLevelCount = Count;
+    }
+
+    Level = SharedCacheMap->VacbLevels[LevelIndex];
+    if (Level == NULL)
+    {
+        Level = ExAllocatePoolWithTag(NonPagedPool, sizeof(ROS_VACB_LEVEL), TAG_VACB_INDEX);
+        if (Level == NULL)
+        {
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+
+        RtlZeroMemory(Level, sizeof(ROS_VACB_LEVEL));
+        SharedCacheMap->VacbLevels[LevelIndex] = Level;
+    }
+
+    ASSERT(Level->Vacbs[View & (VACB_LEVEL_SIZE - 1)] == NULL);
+    Level->Vacbs[View & (VACB_LEVEL_SIZE - 1)] = Vacb;
+    Level->ActiveCount++;
+
+    return STATUS_SUCCESS;
+}
+
+/* Caller must hold the cache map lock, and unlink the VACB from the cache map list */
+VOID
+NTAPI
+CcRosRemoveIndexedVacb (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    PROS_VACB Vacb)
+{
+    ULONGLONG View;
+    PROS_VACB_LEVEL Level;
+
+    View = (ULONGLONG)Vacb->FileOffset.QuadPart / VACB_MAPPING_GRANULARITY;
+    ASSERT((View >> VACB_LEVEL_SHIFT) < SharedCacheMap->VacbLevelCount);
+
+    Level = SharedCacheMap->VacbLevels[View >> VACB_LEVEL_SHIFT];
+    ASSERT(Level != NULL);
+    ASSERT(Level->Vacbs[View & (VACB_LEVEL_SIZE - 1)] == Vacb);
+
+    Level->Vacbs[View & (VACB_LEVEL_SIZE - 1)] = NULL;
+    if (--Level->ActiveCount == 0)
+    {
+        SharedCacheMap->VacbLevels[View >> VACB_LEVEL_SHIFT] = NULL;
+        ExFreePoolWithTag(Level, TAG_VACB_INDEX);
+    }
+}
+
+static
+VOID
+CcRosFreeVacbIndex (
+    PROS_SHARED_CACHE_MAP SharedCacheMap)
+{
+    ULONG i;
+
+    if (SharedCacheMap->VacbLevels == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < SharedCacheMap->VacbLevelCount; i++)
+    {
+        /* All the views should be gone by now */
+        ASSERT(SharedCacheMap->VacbLevels[i] == NULL);
+        if (SharedCacheMap->VacbLevels[i] != NULL)
+        {
+            ExFreePoolWithTag(SharedCacheMap->VacbLevels[i], TAG_VACB_INDEX);
+        }
+    }
+
+    ExFreePoolWithTag(SharedCacheMap->VacbLevels, TAG_VACB_INDEX);
+    SharedCacheMap->VacbLevels = NULL;
+    SharedCacheMap->VacbLevelCount = 0;
+}
+
+/* Returns with a reference on the VACB */
 PROS_VACB
 NTAPI
 CcRosLookupVacb (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
     LONGLONG FileOffset)
 {
-    PLIST_ENTRY current_entry;
     PROS_VACB current;
     KIRQL oldIrql;
 
@@ -468,33 +664,20 @@ CcRosLookupVacb (
     DPRINT("CcRosLookupVacb(SharedCacheMap 0x%p, FileOffset %I64u)\n",
            SharedCacheMap, FileOffset);
 
-    oldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-    KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
 
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    current = CcRosGetIndexedVacb(SharedCacheMap, FileOffset);
+    if (current != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
-            return current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        ASSERT(IsPointInRange(current->FileOffset.QuadPart,
+                              VACB_MAPPING_GRANULARITY,
+                              FileOffset));
+        CcRosVacbIncRefCount(current);
     }
 
-    KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
-    return NULL;
+    return current;
 }
 
 VOID
@@ -734,6 +917,7 @@ CcRosFreeUnusedVacb (
 
             /* Reset and move to free list */
             RemoveEntryList(&current->CacheMapVacbListEntry);
+            CcRosRemoveIndexedVacb(current->SharedCacheMap, current);
             RemoveEntryList(&current->VacbLruListEntry);
             InitializeListHead(&current->VacbLruListEntry);
             InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
@@ -784,7 +968,6 @@ CcRosCreateVacb (
 {
     PROS_VACB current;
     PROS_VACB previous;
-    PLIST_ENTRY current_entry;
     NTSTATUS Status;
     KIRQL oldIrql;
     ULONG Refs;
@@ -853,48 +1036,44 @@ Retry:
      * our newly created VACB and return the existing one.
      */
     KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    previous = NULL;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    current = CcRosGetIndexedVacb(SharedCacheMap, FileOffset);
+    if (current != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+        CcRosVacbIncRefCount(current);
+        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
 #if DBG
-            if (SharedCacheMap->Trace)
-            {
-                DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
-                        SharedCacheMap,
-                        (*Vacb),
-                        current);
-            }
+        if (SharedCacheMap->Trace)
+        {
+            DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
+                    SharedCacheMap,
+                    (*Vacb),
+                    current);
+        }
 #endif
-            KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
 
-            Refs = CcRosVacbDecRefCount(*Vacb);
-            ASSERT(Refs == 0);
+        Refs = CcRosVacbDecRefCount(*Vacb);
+        ASSERT(Refs == 0);
 
-            *Vacb = current;
-            return STATUS_SUCCESS;
-        }
-        if (current->FileOffset.QuadPart < FileOffset)
-        {
-            ASSERT(previous == NULL ||
-                   previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
-            previous = current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        *Vacb = current;
+        return STATUS_SUCCESS;
     }
     /* There was no existing VACB. */
     current = *Vacb;
+    Status = CcRosInsertIndexedVacb(SharedCacheMap, current);
+    if (!NT_SUCCESS(Status))
+    {
+        KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, oldIrql);
+
+        Refs = CcRosVacbDecRefCount(current);
+        ASSERT(Refs == 0);
+
+        *Vacb = NULL;
+        return Status;
+    }
+    /* Keep the list sorted */
+    previous = CcRosGetPreviousIndexedVacb(SharedCacheMap, current->FileOffset.QuadPart);
     if (previous)
     {
         InsertHeadList(&previous->CacheMapVacbListEntry, &current->CacheMapVacbListEntry);
@@ -1189,9 +1368,10 @@ CcRosDeleteFileCache (
         while (!IsListEmpty(&SharedCacheMap->CacheMapVacbListHead))
         {
             current_entry = RemoveTailList(&SharedCacheMap->CacheMapVacbListHead);
+            current = CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry);
+            CcRosRemoveIndexedVacb(SharedCacheMap, current);
             KeReleaseSpinLockFromDpcLevel(&SharedCacheMap->CacheMapLock);
 
-            current = CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry);
             RemoveEntryList(&current->VacbLruListEntry);
             InitializeListHead(&current->VacbLruListEntry);
             if (current->Dirty)
@@ -1211,6 +1391,7 @@ CcRosDeleteFileCache (
 
             KeAcquireSpinLockAtDpcLevel(&SharedCacheMap->CacheMapLock);
         }
+        CcRosFreeVacbIndex(SharedCacheMap);
 #if DBG
         SharedCacheMap->Trace = FALSE;
 #endif
@@ -116,8 +116,11 @@ CmpDoFlushAll(IN BOOLEAN ForceFlush)
             /* Only sync if we are forced to or if it won't cause a hive shrink */
             if ((ForceFlush) || (!HvHiveWillShrink(&Hive->Hive)))
             {
-                /* Do the sync */
-                Status = HvSyncHive(&Hive->Hive);
+                /* Do the sync, forced ones also leave nothing behind in the log */
+                if (ForceFlush)
+                    Status = HvReconcileHive(&Hive->Hive);
+                else
+                    Status = HvSyncHive(&Hive->Hive);
 
                 /* If something failed - set the flag and continue looping */
                 if (!NT_SUCCESS(Status)) Result = FALSE;
@@ -288,6 +291,11 @@ CmpSetValueKeyExisting(IN PHHIVE Hive,
     /* Mark the old child cell dirty */
     if (!HvMarkCellDirty(Hive, OldChild, FALSE)) return STATUS_NO_LOG_SPACE;
 
+    /* That can move it out of a view of the file, the caller keeps its reference */
+    Value = (PCM_KEY_VALUE)HvGetCell(Hive, OldChild);
+    if (!Value) return STATUS_INSUFFICIENT_RESOURCES;
+    HvReleaseCell(Hive, OldChild);
+
     /* See if this is a small or normal key */
     WasSmall = CmpIsKeyValueSmall(&Length, Value->DataLength);
 
@@ -798,6 +806,11 @@ DoAgain:
         goto Quickie;
     }
 
+    /* That can move the key out of a view of the file, get it again */
+    HvReleaseCell(Hive, ParentCell);
+    Parent = (PCM_KEY_NODE)HvGetCell(Hive, ParentCell);
+    ASSERT(Parent);
+
     /* Get the storage type */
     Storage = HvGetCellType(Cell);
 
@@ -981,6 +994,12 @@ CmDeleteValueKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
             goto Quickie;
         }
 
+        /* That can move the key out of a view of the file, get it again */
+        HvReleaseCell(Hive, Cell);
+        Parent = (PCM_KEY_NODE)HvGetCell(Hive, Cell);
+        ASSERT(Parent);
+        ChildList = &Parent->ValueList;
+
         /* Get the key value */
         Value = (PCM_KEY_VALUE)HvGetCell(Hive, ChildCell);
         ASSERT(Value);
@@ -1941,6 +1960,7 @@ CmFlushKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
     PCMHIVE CmHive;
     NTSTATUS Status = STATUS_SUCCESS;
     PHHIVE Hive;
+    BOOLEAN Success;
 
     /* Ignore flushes until we're ready */
     if (CmpNoWrite) return STATUS_SUCCESS;
@@ -1978,8 +1998,13 @@ CmFlushKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
             KeReleaseGuardedMutex(CmHive->ViewLock);
         }
 
-        /* Flush only this hive */
-        if (!HvSyncHive(Hive))
+        /* Flush only this hive, all the way to its file if it is being unloaded */
+        if (Hive->HiveFlags & HIVE_IS_UNLOADING)
+            Success = HvReconcileHive(Hive);
+        else
+            Success = HvSyncHive(Hive);
+
+        if (!Success)
         {
             /* Fail */
             Status = STATUS_REGISTRY_IO_FAILED;
@@ -2276,6 +2301,9 @@ CmUnloadKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
     /* Release hive lock */
     CmpUnlockRegistry();
 
+    /* Destroy the view list, the views go away with the file handles */
+    CmpDestroyHiveViewList(CmHive);
+
     /* Close file handles */
     CmpCloseHiveFiles(CmHive);
 
@@ -2289,9 +2317,6 @@ CmUnloadKey(IN PCM_KEY_CONTROL_BLOCK Kcb,
     /* Destroy the security descriptor cache */
     CmpDestroySecurityCache(CmHive);
 
-    /* Destroy the view list */
-    CmpDestroyHiveViewList(CmHive);
-
     /* Delete the flusher lock */
     ExDeleteResourceLite(CmHive->FlusherLock);
     ExFreePoolWithTag(CmHive->FlusherLock, TAG_CMHIVE);
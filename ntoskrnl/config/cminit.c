@@ -182,11 +182,14 @@ CmpInitializeHive(OUT PCMHIVE *CmHive,
                           CmpFileWrite,
                           CmpFileRead,
                           CmpFileFlush,
+                          CmpFileWriteGather,
+                          CmpFileMapView,
                           Cluster,
                           FileName);
     if (!NT_SUCCESS(Status))
     {
         /* Cleanup allocations and fail */
+        CmpDestroyHiveViewList(Hive);
         ExDeleteResourceLite(Hive->FlusherLock);
         ExFreePoolWithTag(Hive->FlusherLock, TAG_CMHIVE);
         ExFreePoolWithTag(Hive->ViewLock, TAG_CMHIVE);
@@ -205,6 +208,7 @@ CmpInitializeHive(OUT PCMHIVE *CmHive,
         if (CheckStatus != 0)
         {
             /* Cleanup allocations and fail */
+            CmpDestroyHiveViewList(Hive);
             ExDeleteResourceLite(Hive->FlusherLock);
             ExFreePoolWithTag(Hive->FlusherLock, TAG_CMHIVE);
             ExFreePoolWithTag(Hive->ViewLock, TAG_CMHIVE);
@@ -213,6 +217,9 @@ CmpInitializeHive(OUT PCMHIVE *CmHive,
         }
     }
 
+    /* The hive is not in use yet, its views are mapped again when needed */
+    CmpTrimHiveViews(Hive, 0);
+
     /* Lock the hive list */
     ExAcquirePushLockExclusive(&CmpHiveListHeadLock);
 
@@ -30,6 +30,244 @@ CmpInitHiveViewList(IN PCMHIVE Hive)
     Hive->UseCount = 0;
 }
 
+/* Reads the bin holding a block into pool, for when its view cannot be mapped */
+static
+BOOLEAN
+NTAPI
+CmpReadHiveBin(IN PCMHIVE Hive,
+               IN ULONG BlockIndex)
+{
+    PHBIN Bin;
+
+    /* Not under the view lock, the read waits for a kernel APC */
+    Bin = HvpReadBin(&Hive->Hive, BlockIndex);
+    if (!Bin) return FALSE;
+
+    KeAcquireGuardedMutex(Hive->ViewLock);
+    Hive->ViewLockOwner = KeGetCurrentThread();
+
+    /* Another lookup may have brought the bin in meanwhile */
+    if (Hive->Hive.Storage[Stable].BlockList[BlockIndex].BlockAddress == 0)
+    {
+        HvpInsertBin(&Hive->Hive, Bin);
+        Bin = NULL;
+    }
+
+    Hive->ViewLockOwner = NULL;
+    KeReleaseGuardedMutex(Hive->ViewLock);
+
+    if (Bin) Hive->Hive.Free(Bin, 0);
+    return TRUE;
+}
+
+BOOLEAN
+NTAPI
+CmpFileMapView(IN PHHIVE RegistryHive,
+               IN ULONG BlockIndex)
+{
+    PCMHIVE Hive = (PCMHIVE)RegistryHive;
+    HANDLE HiveHandle = Hive->FileHandles[HFILE_TYPE_PRIMARY];
+    PCM_VIEW_OF_FILE View = NULL;
+    PFILE_OBJECT FileObject;
+    PLIST_ENTRY NextEntry;
+    LARGE_INTEGER ViewOffset;
+    BOOLEAN Mapped, Result = FALSE;
+    NTSTATUS Status;
+    ULONG ViewStart;
+
+    /* The bins come after the base block in the file */
+    ViewStart = ROUND_DOWN(HBLOCK_SIZE + BlockIndex * HBLOCK_SIZE, CM_VIEW_SIZE);
+
+    /* Just fail if no file is associated with this hive */
+    if (HiveHandle == NULL) return FALSE;
+
+    /* Views are mapped through the cache map of the primary file */
+    if (!Hive->FileObject)
+    {
+        Status = ObReferenceObjectByHandle(HiveHandle,
+                                           0,
+                                           *IoFileObjectType,
+                                           KernelMode,
+                                           (PVOID*)&FileObject,
+                                           NULL);
+        if (!NT_SUCCESS(Status)) return CmpReadHiveBin(Hive, BlockIndex);
+
+        Hive->FileObject = FileObject;
+    }
+
+    /* A file opened without buffering has none */
+    FileObject = Hive->FileObject;
+    if (!(FileObject->SectionObjectPointer) ||
+        !(FileObject->SectionObjectPointer->SharedCacheMap))
+    {
+        return CmpReadHiveBin(Hive, BlockIndex);
+    }
+
+    KeAcquireGuardedMutex(Hive->ViewLock);
+    Hive->ViewLockOwner = KeGetCurrentThread();
+
+    /* Look for the view, recently used ones come first */
+    for (NextEntry = Hive->LRUViewListHead.Flink;
+         NextEntry != &Hive->LRUViewListHead;
+         NextEntry = NextEntry->Flink)
+    {
+        View = CONTAINING_RECORD(NextEntry, CM_VIEW_OF_FILE, LRUViewList);
+        if (View->FileOffset == ViewStart)
+        {
+            /* Keep the most recently used view first */
+            RemoveEntryList(&View->LRUViewList);
+            InsertHeadList(&Hive->LRUViewListHead, &View->LRUViewList);
+            break;
+        }
+
+        View = NULL;
+    }
+
+    if (!View)
+    {
+        View = ExAllocatePoolWithTag(PagedPool, sizeof(CM_VIEW_OF_FILE), TAG_CM);
+        if (View)
+        {
+            /* The last view stops at the end of the hive */
+            View->FileOffset = ViewStart;
+            View->Size = min(CM_VIEW_SIZE,
+                             HBLOCK_SIZE + RegistryHive->BaseBlock->Length - ViewStart);
+            View->ViewAddress = NULL;
+            View->Bcb = NULL;
+            View->UseCount = 0;
+            InitializeListHead(&View->PinViewList);
+
+            ViewOffset.QuadPart = ViewStart;
+            _SEH2_TRY
+            {
+                Mapped = CcMapData(FileObject,
+                                   &ViewOffset,
+                                   View->Size,
+                                   MAP_WAIT,
+                                   &View->Bcb,
+                                   (PVOID*)&View->ViewAddress);
+            }
+            _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+            {
+                Mapped = FALSE;
+            }
+            _SEH2_END;
+
+            if (Mapped)
+            {
+                InsertHeadList(&Hive->LRUViewListHead, &View->LRUViewList);
+                Hive->MappedViews++;
+            }
+            else
+            {
+                DPRINT1("Failed to map view at 0x%lx of hive %p\n", ViewStart, Hive);
+                ExFreePoolWithTag(View, TAG_CM);
+                View = NULL;
+            }
+        }
+    }
+
+    /* Let the bins of the view be used, trimming cannot run while we hold the lock */
+    if (View) Result = HvpMapViewBins(RegistryHive, View);
+
+    Hive->ViewLockOwner = NULL;
+    KeReleaseGuardedMutex(Hive->ViewLock);
+
+    /* Cell lookups must not fail, so fall back to reading the bin */
+    if (!View) Result = CmpReadHiveBin(Hive, BlockIndex);
+
+    return Result;
+}
+
+VOID
+NTAPI
+CmpTrimHiveViews(IN PCMHIVE Hive,
+                 IN ULONG MaxViews)
+{
+    PCM_VIEW_OF_FILE CmView;
+    PLIST_ENTRY EntryList;
+
+    /*
+     * Cells are not reference counted, so the caller has to make sure that
+     * nobody holds a pointer into the hive. Bins that were copied out when
+     * they got dirty are not in any view anymore.
+     */
+    KeAcquireGuardedMutex(Hive->ViewLock);
+    Hive->ViewLockOwner = KeGetCurrentThread();
+
+    /* Unmap the least recently used views first */
+    while (Hive->MappedViews > MaxViews)
+    {
+        EntryList = RemoveTailList(&Hive->LRUViewListHead);
+        CmView = CONTAINING_RECORD(EntryList, CM_VIEW_OF_FILE, LRUViewList);
+
+        /* The bins are mapped again on their next lookup */
+        HvpUnmapViewBins(&Hive->Hive, CmView);
+        if (CmView->Bcb) CcUnpinData(CmView->Bcb);
+
+        ExFreePoolWithTag(CmView, TAG_CM);
+        Hive->MappedViews--;
+    }
+
+    Hive->ViewLockOwner = NULL;
+    KeReleaseGuardedMutex(Hive->ViewLock);
+}
+
+VOID
+NTAPI
+CmpTrimViews(VOID)
+{
+    PLIST_ENTRY NextEntry;
+    PCMHIVE Hive;
+
+    /* Only the exclusive owner of the registry lock can get here */
+    CMP_ASSERT_EXCLUSIVE_REGISTRY_LOCK();
+
+    ExAcquirePushLockShared(&CmpHiveListHeadLock);
+    for (NextEntry = CmpHiveListHead.Flink;
+         NextEntry != &CmpHiveListHead;
+         NextEntry = NextEntry->Flink)
+    {
+        Hive = CONTAINING_RECORD(NextEntry, CMHIVE, HiveList);
+        if (Hive->MappedViews > CM_MAX_MAPPED_VIEWS)
+            CmpTrimHiveViews(Hive, CM_MAX_MAPPED_VIEWS);
+    }
+    ExReleasePushLock(&CmpHiveListHeadLock);
+}
+
+BOOLEAN
+NTAPI
+CmpReleaseHiveViews(IN PCMHIVE Hive)
+{
+    PHMAP_ENTRY BlockList = Hive->Hive.Storage[Stable].BlockList;
+    ULONG Block;
+
+    /* Nothing to do if the hive is not used from its file */
+    if (!Hive->Hive.FileMapView) return TRUE;
+
+    /*
+     * Copy the bins out of the file, the caller holds the registry
+     * exclusively. Views are unmapped as we go, to map few at a time.
+     */
+    for (Block = 0; Block < Hive->Hive.Storage[Stable].Length; Block++)
+    {
+        if (BlockList[Block].MemAlloc != 0) continue;
+
+        if (!HvpCopyBinFromView(&Hive->Hive, Block))
+        {
+            /* The views have to stay, and the file with them */
+            DPRINT1("No memory to copy the bins of hive %p\n", Hive);
+            return FALSE;
+        }
+
+        CmpTrimHiveViews(Hive, 1);
+    }
+
+    /* Now nothing points into the views anymore */
+    if (Hive->MappedViews || Hive->FileObject) CmpDestroyHiveViewList(Hive);
+    return TRUE;
+}
+
 VOID
 NTAPI
 CmpDestroyHiveViewList(IN PCMHIVE Hive)
@@ -47,7 +285,8 @@ CmpDestroyHiveViewList(IN PCMHIVE Hive)
 
         CmView = CONTAINING_RECORD(EntryList, CM_VIEW_OF_FILE, PinViewList);
 
-        /* FIXME: Unmap the view if it is mapped */
+        /* Unmap the view if it is mapped */
+        if (CmView->Bcb) CcUnpinData(CmView->Bcb);
 
         ExFreePool(CmView);
 
@@ -65,7 +304,8 @@ CmpDestroyHiveViewList(IN PCMHIVE Hive)
 
         CmView = CONTAINING_RECORD(EntryList, CM_VIEW_OF_FILE, LRUViewList);
 
-        /* FIXME: Unmap the view if it is mapped */
+        /* Unmap the view if it is mapped */
+        if (CmView->Bcb) CcUnpinData(CmView->Bcb);
 
         ExFreePool(CmView);
 
@@ -75,6 +315,13 @@ CmpDestroyHiveViewList(IN PCMHIVE Hive)
     /* The LRU View List should be empty */
     ASSERT(IsListEmpty(&Hive->LRUViewListHead) == TRUE);
     ASSERT(Hive->MappedViews == 0);
+
+    /* The views were holding on to the file object */
+    if (Hive->FileObject)
+    {
+        ObDereferenceObject(Hive->FileObject);
+        Hive->FileObject = NULL;
+    }
 }
 
 /* EOF */
@@ -772,6 +772,9 @@ CmpCreateLinkNode(IN PHHIVE Hive,
         /* Hive exists! */
         ChildCell = KeyCell;
 
+        /* Mark the cell dirty */
+        HvMarkCellDirty(Context->ChildHive.KeyHive, ChildCell, FALSE);
+
         /* Get the node data */
         KeyNode = (PCM_KEY_NODE)HvGetCell(Context->ChildHive.KeyHive, ChildCell);
         if (!KeyNode)
@@ -888,7 +891,8 @@ CmpCreateLinkNode(IN PHHIVE Hive,
         KeyNode->ChildHiveReference.KeyCell = ChildCell;
         HvReleaseCell(Hive, LinkCell);
 
-        /* Get the parent node */
+        /* Mark the parent dirty and get it */
+        HvMarkCellDirty(Hive, Cell, FALSE);
         KeyNode = HvGetCell(Hive, Cell);
         if (!KeyNode)
         {
@@ -299,7 +299,7 @@ CmpInitHiveFromFile(IN PCUNICODE_STRING HiveName,
     /* Assume failure */
     *Hive = NULL;
 
-    /* Open or create the hive files */
+    /* Open or create the hive files, cached so that the hive can be mapped */
     Status = CmpOpenHiveFiles(HiveName,
                               L".LOG",
                               &FileHandle,
@@ -308,7 +308,7 @@ CmpInitHiveFromFile(IN PCUNICODE_STRING HiveName,
                               &LogDisposition,
                               *New,
                               FALSE,
-                              TRUE,
+                              FALSE,
                               NULL);
     if (!NT_SUCCESS(Status)) return Status;
 
@@ -2017,6 +2017,13 @@ CmpUnlockRegistry(VOID)
         CmpLazyFlush();
     }
 
+    /* Nobody else is in the registry, so no cell of a view can be in use */
+    if (CmpTestRegistryLockExclusive() &&
+        ExIsResourceAcquiredSharedLite(&CmpRegistryLock) == 1)
+    {
+        CmpTrimViews();
+    }
+
     /* Release the lock and leave the critical region */
     ExReleaseResourceLite(&CmpRegistryLock);
     KeLeaveCriticalRegion();
@@ -2109,7 +2116,8 @@ CmShutdownSystem(VOID)
     {
         Hive = CONTAINING_RECORD(ListEntry, CMHIVE, HiveList);
 
-        CmpCloseHiveFiles(Hive);
+        /* Bins used in place from the file have to be copied out first */
+        if (CmpReleaseHiveViews(Hive)) CmpCloseHiveFiles(Hive);
 
         ListEntry = ListEntry->Flink;
     }
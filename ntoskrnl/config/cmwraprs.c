@@ -120,6 +120,75 @@ CmpFileWrite(IN PHHIVE RegistryHive,
     return NT_SUCCESS(Status) ? TRUE : FALSE;
 }
 
+BOOLEAN
+NTAPI
+CmpFileWriteGather(IN PHHIVE RegistryHive,
+                   IN ULONG FileType,
+                   IN PHV_WRITE_SEGMENT Segments,
+                   IN ULONG SegmentCount)
+{
+    PCMHIVE CmHive = (PCMHIVE)RegistryHive;
+    HANDLE HiveHandle = CmHive->FileHandles[FileType];
+    LARGE_INTEGER _FileOffset;
+    IO_STATUS_BLOCK IoStatusBlock;
+    NTSTATUS Status = STATUS_SUCCESS;
+    PUCHAR GatherBuffer = NULL;
+    ULONG i, Last, Length;
+
+    /* Just return success if no file is associated with this hive */
+    if (HiveHandle == NULL)
+        return TRUE;
+
+    /* Don't do anything if we're not supposed to */
+    if (CmpNoWrite)
+        return TRUE;
+
+    for (i = 0; i < SegmentCount; i = Last + 1)
+    {
+        /* Find the segments that follow this one in the file, up to the gather buffer size */
+        Length = Segments[i].Length;
+        for (Last = i; Last + 1 < SegmentCount; Last++)
+        {
+            if (Segments[Last + 1].FileOffset != Segments[Last].FileOffset + Segments[Last].Length ||
+                Length + Segments[Last + 1].Length > CMP_WRITE_GATHER_SIZE)
+            {
+                break;
+            }
+            Length += Segments[Last + 1].Length;
+        }
+
+        /* They were only split because their bins are apart in memory, gather them */
+        if (Last != i && !GatherBuffer)
+        {
+            GatherBuffer = ExAllocatePoolWithTag(PagedPool, CMP_WRITE_GATHER_SIZE, TAG_CM);
+        }
+
+        _FileOffset.QuadPart = Segments[i].FileOffset;
+        if (Last != i && GatherBuffer)
+        {
+            for (Length = 0; i <= Last; i++)
+            {
+                RtlCopyMemory(GatherBuffer + Length, Segments[i].Buffer, Segments[i].Length);
+                Length += Segments[i].Length;
+            }
+            Status = ZwWriteFile(HiveHandle, NULL, NULL, NULL, &IoStatusBlock,
+                                 GatherBuffer, Length, &_FileOffset, NULL);
+        }
+        else
+        {
+            /* Out of memory, or a single segment: write it as it is */
+            Last = i;
+            Status = ZwWriteFile(HiveHandle, NULL, NULL, NULL, &IoStatusBlock,
+                                 Segments[i].Buffer, Segments[i].Length, &_FileOffset, NULL);
+        }
+
+        if (!NT_SUCCESS(Status)) break;
+    }
+
+    if (GatherBuffer) ExFreePoolWithTag(GatherBuffer, TAG_CM);
+    return NT_SUCCESS(Status) ? TRUE : FALSE;
+}
+
 BOOLEAN
 NTAPI
 CmpFileSetSize(IN PHHIVE RegistryHive,
@@ -657,6 +657,9 @@ NTAPI
 INIT_FUNCTION
 ExpInitSystemPhase1(VOID)
 {
+    /* All processors are running, give each one its own pool tag table */
+    ExpInitializePoolTrackTables();
+
     /* Initialize worker threads */
     ExpInitializeWorkerThreads();
 
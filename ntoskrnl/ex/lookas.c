@@ -18,6 +18,15 @@
 
 /* GLOBALS *******************************************************************/
 
+/* Lookaside lists are never made shallower than this */
+#define EX_MINIMUM_LOOKASIDE_DEPTH          4
+
+/* Lists with fewer allocations per scan are shrunk quickly */
+#define EX_MINIMUM_ALLOCATION_THRESHOLD     25
+
+/* Lists missing less than this per thousand allocations are shrunk slowly */
+#define EX_MINIMUM_MISS_RATIO               5
+
 LIST_ENTRY ExpNonPagedLookasideListHead;
 KSPIN_LOCK ExpNonPagedLookasideListLock;
 LIST_ENTRY ExpPagedLookasideListHead;
@@ -123,6 +132,114 @@ ExpInitLookasideLists(VOID)
     }
 }
 
+/*
+ * Computes the new depth of a lookaside list from the allocations and misses
+ * since the last scan. Lists that are hardly used give their entries back,
+ * lists that miss grow in proportion to their miss ratio.
+ */
+static
+USHORT
+ExpComputeLookasideDepth(IN ULONG Allocates,
+                         IN ULONG Misses,
+                         IN USHORT MaximumDepth,
+                         IN USHORT Depth)
+{
+    ULONG Ratio, Target;
+
+    /* Check if the list is cold */
+    if (Allocates < EX_MINIMUM_ALLOCATION_THRESHOLD)
+    {
+        /* Shrink it quickly, it only holds on to memory */
+        return (Depth > EX_MINIMUM_LOOKASIDE_DEPTH + 10) ?
+               Depth - 10 : EX_MINIMUM_LOOKASIDE_DEPTH;
+    }
+
+    /* Get the misses per thousand allocations */
+    Ratio = (ULONG)(((ULONGLONG)min(Misses, Allocates) * 1000) / Allocates);
+    if (Ratio < EX_MINIMUM_MISS_RATIO)
+    {
+        /* Almost everything hits, see if a smaller list does the job */
+        return (Depth > EX_MINIMUM_LOOKASIDE_DEPTH) ? Depth - 1 : Depth;
+    }
+
+    /* Check if the list can't grow anymore */
+    if (Depth >= MaximumDepth) return Depth;
+
+    /* Grow by part of the room left, more so the more we miss */
+    Target = Depth + ((Ratio * (MaximumDepth - Depth)) / (1000 * 2)) + 5;
+    return (USHORT)min(Target, MaximumDepth);
+}
+
+static
+VOID
+ExpScanGeneralLookasideList(IN PLIST_ENTRY ListHead,
+                            IN PKSPIN_LOCK SpinLock OPTIONAL,
+                            IN BOOLEAN ListUsesMisses)
+{
+    PGENERAL_LOOKASIDE Lookaside;
+    PLIST_ENTRY ListEntry;
+    ULONG Allocates, Misses;
+    KIRQL OldIrql = PASSIVE_LEVEL;
+
+    /* Lock the list if it's a dynamic one */
+    if (SpinLock) KeAcquireSpinLock(SpinLock, &OldIrql);
+
+    /* Loop all the lookaside lists */
+    for (ListEntry = ListHead->Flink;
+         ListEntry != ListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Lookaside = CONTAINING_RECORD(ListEntry, GENERAL_LOOKASIDE, ListEntry);
+
+        /* Get the allocations and misses since the last scan */
+        Allocates = Lookaside->TotalAllocates - Lookaside->LastTotalAllocates;
+        if (ListUsesMisses)
+        {
+            Misses = Lookaside->AllocateMisses - Lookaside->LastAllocateMisses;
+        }
+        else
+        {
+            /* The pool lists count hits instead */
+            Misses = Allocates - (Lookaside->AllocateHits - Lookaside->LastAllocateHits);
+        }
+
+        /* Remember the counters for the next scan */
+        Lookaside->LastTotalAllocates = Lookaside->TotalAllocates;
+        Lookaside->LastAllocateMisses = Lookaside->AllocateMisses;
+
+        /* Set the new depth */
+        Lookaside->Depth = ExpComputeLookasideDepth(Allocates,
+                                                    Misses,
+                                                    Lookaside->MaximumDepth,
+                                                    Lookaside->Depth);
+    }
+
+    /* Release the lock */
+    if (SpinLock) KeReleaseSpinLock(SpinLock, OldIrql);
+}
+
+/*
+ * Called by the balance set manager every second. Entries above the new
+ * depth of a shrunk list are not released here, they drain as the list
+ * gets used, since frees beyond the depth go back to the pool.
+ */
+VOID
+NTAPI
+ExAdjustLookasideDepth(VOID)
+{
+    /* Scan the pool and system lookaside lists, which never go away */
+    ExpScanGeneralLookasideList(&ExPoolLookasideListHead, NULL, FALSE);
+    ExpScanGeneralLookasideList(&ExSystemLookasideListHead, NULL, TRUE);
+
+    /* Scan the lists of drivers and components */
+    ExpScanGeneralLookasideList(&ExpNonPagedLookasideListHead,
+                                &ExpNonPagedLookasideListLock,
+                                TRUE);
+    ExpScanGeneralLookasideList(&ExpPagedLookasideListHead,
+                                &ExpPagedLookasideListLock,
+                                TRUE);
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*
@@ -731,12 +731,12 @@ QSI_DEF(SystemPerformanceInformation)
     Spi->TransitionCount = 0; /* FIXME */
     Spi->CacheTransitionCount = 0; /* FIXME */
     Spi->DemandZeroCount = 0; /* FIXME */
-    Spi->PageReadCount = 0; /* FIXME */
-    Spi->PageReadIoCount = 0; /* FIXME */
+    Spi->PageReadCount = MmPageFilePagesRead;
+    Spi->PageReadIoCount = MmPageFileReadIoCount;
     Spi->CacheReadCount = 0; /* FIXME */
     Spi->CacheIoCount = 0; /* FIXME */
-    Spi->DirtyPagesWriteCount = 0; /* FIXME */
-    Spi->DirtyWriteIoCount = 0; /* FIXME */
+    Spi->DirtyPagesWriteCount = MmPageFilePagesWritten;
+    Spi->DirtyWriteIoCount = MmPageFileWriteIoCount;
     Spi->MappedPagesWriteCount = 0; /* FIXME */
     Spi->MappedWriteIoCount = 0; /* FIXME */
 
@@ -2099,7 +2099,7 @@ ExpCopyLookasideInformation(
     /* Loop as long as we have lookaside lists and free array elements */
     for (ListEntry = ListHead->Flink;
          (ListEntry != ListHead) && (Remaining > 0);
-         ListEntry = ListEntry->Flink, Remaining--)
+         ListEntry = ListEntry->Flink, Info++, Remaining--)
     {
         LookasideList = CONTAINING_RECORD(ListEntry, GENERAL_LOOKASIDE, ListEntry);
 
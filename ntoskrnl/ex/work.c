@@ -23,17 +23,42 @@
 #define EX_DELAYED_WORK_THREADS                     3
 #define EX_CRITICAL_WORK_THREADS                    5
 
+/* Minimum number of worker threads for each per-processor queue */
+#define EX_MINIMUM_WORK_THREADS_PER_QUEUE           2
+
 /* Magic flag for dynamic worker threads */
 #define EX_DYNAMIC_WORK_THREAD                      0x80000000
 
+/* The worker thread context also holds the processor of its queue */
+#define EX_WORK_THREAD_PROCESSOR_SHIFT              8
+#define EX_WORK_THREAD_QUEUE_TYPE(Context) \
+    ((WORK_QUEUE_TYPE)((ULONG_PTR)(Context) & 0xFF))
+#define EX_WORK_THREAD_PROCESSOR(Context) \
+    (((ULONG_PTR)(Context) & ~EX_DYNAMIC_WORK_THREAD) >> EX_WORK_THREAD_PROCESSOR_SHIFT)
+
 /* Worker thread priority increments (added to base priority) */
 #define EX_HYPERCRITICAL_QUEUE_PRIORITY_INCREMENT   7
 #define EX_CRITICAL_QUEUE_PRIORITY_INCREMENT        5
 #define EX_DELAYED_QUEUE_PRIORITY_INCREMENT         4
 
-/* The actual worker queue array */
+/* Statistics kept for each worker queue */
+typedef struct _EXP_WORK_QUEUE_COUNTERS
+{
+    ULONG WorkItemsQueued;
+    ULONG WorkItemsStolen;
+    ULONG PeakDepth;
+    ULONG LongestRunTime;
+    LARGE_INTEGER TotalRunTime;
+} EXP_WORK_QUEUE_COUNTERS, *PEXP_WORK_QUEUE_COUNTERS;
+
+/* The worker queue array of the boot processor, which owns the only hypercritical queue */
 EX_WORK_QUEUE ExWorkerQueue[MaximumWorkQueue];
 
+/* The worker queue arrays of each processor, the first one is ExWorkerQueue */
+PEX_WORK_QUEUE ExpWorkerQueues[MAXIMUM_PROCESSORS];
+ULONG ExpWorkerQueueCount;
+EXP_WORK_QUEUE_COUNTERS ExpWorkQueueCounters[MAXIMUM_PROCESSORS][MaximumWorkQueue];
+
 /* Accounting of the total threads and registry hacked threads */
 ULONG ExCriticalWorkerThreads;
 ULONG ExDelayedWorkerThreads;
@@ -55,6 +80,134 @@ PETHREAD ExpLastWorkerThread;
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
+FORCEINLINE
+PEX_WORK_QUEUE
+ExpGetWorkQueue(IN ULONG Processor,
+                IN WORK_QUEUE_TYPE WorkQueueType)
+{
+    /* There is only one hypercritical queue */
+    if (WorkQueueType == HyperCriticalWorkQueue) Processor = 0;
+    return &ExpWorkerQueues[Processor][WorkQueueType];
+}
+
+/*++
+ * @name ExpSelectWorkQueue
+ *
+ *     The ExpSelectWorkQueue routine picks the queue a new work item goes to.
+ *
+ * @param WorkQueueType
+ *        Type of the queue the item is for.
+ *
+ * @param Processor
+ *        Receives the processor owning the selected queue.
+ *
+ * @return The selected queue.
+ *
+ * @remarks Items go to the queue of the current processor, unless none of
+ *          its workers is waiting for work while one of another processor
+ *          is. When every worker is busy, the item stays local and idle
+ *          workers steal it later on. The wait lists are read without the
+ *          dispatcher lock, a wrong guess only costs some locality.
+ *
+ *--*/
+PEX_WORK_QUEUE
+NTAPI
+ExpSelectWorkQueue(IN WORK_QUEUE_TYPE WorkQueueType,
+                   OUT PULONG Processor)
+{
+    PEX_WORK_QUEUE WorkQueue;
+    ULONG Current, Candidate, i;
+
+    /* Check if there is anything to choose from */
+    if ((WorkQueueType == HyperCriticalWorkQueue) || (ExpWorkerQueueCount <= 1))
+    {
+        *Processor = 0;
+        return &ExWorkerQueue[WorkQueueType];
+    }
+
+    /* Use our own queue if one of its workers is idle */
+    Current = KeGetCurrentProcessorNumber();
+    if (Current >= ExpWorkerQueueCount) Current = 0;
+    *Processor = Current;
+    WorkQueue = &ExpWorkerQueues[Current][WorkQueueType];
+    if (!IsListEmpty(&WorkQueue->WorkerQueue.Header.WaitListHead)) return WorkQueue;
+
+    /* Otherwise look for another processor with an idle worker */
+    for (i = 1; i < ExpWorkerQueueCount; i++)
+    {
+        Candidate = (Current + i) % ExpWorkerQueueCount;
+        if (!IsListEmpty(&ExpWorkerQueues[Candidate][WorkQueueType].WorkerQueue.Header.WaitListHead))
+        {
+            *Processor = Candidate;
+            return &ExpWorkerQueues[Candidate][WorkQueueType];
+        }
+    }
+
+    /* Everybody is busy, keep it local */
+    return WorkQueue;
+}
+
+/*++
+ * @name ExpStealWorkItem
+ *
+ *     The ExpStealWorkItem routine takes a pending work item from the queue
+ *     of another processor.
+ *
+ * @param Processor
+ *        Processor owning the queue of the calling worker.
+ *
+ * @param WorkQueueType
+ *        Type of the queue of the calling worker.
+ *
+ * @param Victim
+ *        Receives the processor the item was taken from.
+ *
+ * @return The queue entry of the work item, or NULL if there was none.
+ *
+ * @remarks Only entries which could not be handed to a worker of their own
+ *          queue are pending, so this never races with idle workers. The
+ *          calling thread becomes associated with the queue it took the
+ *          item from until it waits on its own queue again.
+ *
+ *--*/
+PLIST_ENTRY
+NTAPI
+ExpStealWorkItem(IN ULONG Processor,
+                 IN WORK_QUEUE_TYPE WorkQueueType,
+                 OUT PULONG Victim)
+{
+    LARGE_INTEGER Timeout;
+    PLIST_ENTRY QueueEntry;
+    PEX_WORK_QUEUE WorkQueue;
+    ULONG i;
+
+    /* There is only one hypercritical queue */
+    if (WorkQueueType == HyperCriticalWorkQueue) return NULL;
+
+    /* Don't wait, we only want what is already there */
+    Timeout.QuadPart = 0;
+
+    /* Start with the next processor so that victims are spread out */
+    for (i = 1; i < ExpWorkerQueueCount; i++)
+    {
+        *Victim = (Processor + i) % ExpWorkerQueueCount;
+        WorkQueue = &ExpWorkerQueues[*Victim][WorkQueueType];
+        if (!KeReadStateQueue(&WorkQueue->WorkerQueue)) continue;
+
+        /* Try to take it, somebody else may have been faster */
+        QueueEntry = KeRemoveQueue(&WorkQueue->WorkerQueue,
+                                   KernelMode,
+                                   &Timeout);
+        if ((NTSTATUS)(ULONG_PTR)QueueEntry != STATUS_TIMEOUT)
+        {
+            InterlockedIncrement((PLONG)&ExpWorkQueueCounters[*Victim][WorkQueueType].WorkItemsStolen);
+            return QueueEntry;
+        }
+    }
+
+    return NULL;
+}
+
 /*++
  * @name ExpWorkerThreadEntryPoint
  *
@@ -62,14 +215,17 @@ PETHREAD ExpLastWorkerThread;
  *     worker thread created by teh system.
  *
  * @param Context
- *        Contains the work queue type masked with a flag specifing whether the
- *        thread is dynamic or not.
+ *        Contains the work queue type and processor masked with a flag
+ *        specifing whether the thread is dynamic or not.
  *
  * @return None.
  *
  * @remarks A dynamic thread can timeout after 10 minutes of waiting on a queue
  *          while a static thread will never timeout.
  *
+ *          Before waiting on its own queue, a worker whose queue is empty
+ *          takes pending items from the queues of other processors.
+ *
  *          Worker threads must return at IRQL == PASSIVE_LEVEL, must not have
  *          active impersonation info, and must not have disabled APCs.
  *
@@ -85,6 +241,9 @@ ExpWorkerThreadEntryPoint(IN PVOID Context)
     PLIST_ENTRY QueueEntry;
     WORK_QUEUE_TYPE WorkQueueType;
     PEX_WORK_QUEUE WorkQueue;
+    PEXP_WORK_QUEUE_COUNTERS Counters;
+    ULONG Processor, Source;
+    ULONGLONG StartTime, RunTime;
     LARGE_INTEGER Timeout;
     PLARGE_INTEGER TimeoutPointer = NULL;
     PETHREAD Thread = PsGetCurrentThread();
@@ -99,10 +258,10 @@ ExpWorkerThreadEntryPoint(IN PVOID Context)
         TimeoutPointer = &Timeout;
     }
 
-    /* Get Queue Type and Worker Queue */
-    WorkQueueType = (WORK_QUEUE_TYPE)((ULONG_PTR)Context &
-                                      ~EX_DYNAMIC_WORK_THREAD);
-    WorkQueue = &ExWorkerQueue[WorkQueueType];
+    /* Get Queue Type, Processor and Worker Queue */
+    WorkQueueType = EX_WORK_THREAD_QUEUE_TYPE(Context);
+    Processor = (ULONG)EX_WORK_THREAD_PROCESSOR(Context);
+    WorkQueue = ExpGetWorkQueue(Processor, WorkQueueType);
 
     /* Select the wait mode */
     WaitMode = (UCHAR)WorkQueue->Info.WaitMode;
@@ -141,16 +300,28 @@ ExpWorkerThreadEntryPoint(IN PVOID Context)
 ProcessLoop:
     for (;;)
     {
-        /* Wait for something to happen on the queue */
-        QueueEntry = KeRemoveQueue(&WorkQueue->WorkerQueue,
-                                   WaitMode,
-                                   TimeoutPointer);
+        /* Help the other processors out if we have nothing to do */
+        QueueEntry = NULL;
+        if (!KeReadStateQueue(&WorkQueue->WorkerQueue))
+        {
+            QueueEntry = ExpStealWorkItem(Processor, WorkQueueType, &Source);
+        }
 
-        /* Check if we timed out and quit this loop in that case */
-        if ((NTSTATUS)(ULONG_PTR)QueueEntry == STATUS_TIMEOUT) break;
+        if (!QueueEntry)
+        {
+            /* Wait for something to happen on the queue */
+            QueueEntry = KeRemoveQueue(&WorkQueue->WorkerQueue,
+                                       WaitMode,
+                                       TimeoutPointer);
+
+            /* Check if we timed out and quit this loop in that case */
+            if ((NTSTATUS)(ULONG_PTR)QueueEntry == STATUS_TIMEOUT) break;
+            Source = Processor;
+        }
 
-        /* Increment Processed Work Items */
-        InterlockedIncrement((PLONG)&WorkQueue->WorkItemsProcessed);
+        /* Increment Processed Work Items of the queue the item came from */
+        InterlockedIncrement((PLONG)&ExpGetWorkQueue(Source, WorkQueueType)->WorkItemsProcessed);
+        Counters = &ExpWorkQueueCounters[Source][WorkQueueType];
 
         /* Get the Work Item */
         WorkItem = CONTAINING_RECORD(QueueEntry, WORK_QUEUE_ITEM, List);
@@ -158,8 +329,12 @@ ProcessLoop:
         /* Make sure nobody is trying to play smart with us */
         ASSERT((ULONG_PTR)WorkItem->WorkerRoutine > MmUserProbeAddress);
 
-        /* Call the Worker Routine */
+        /* Call the Worker Routine and account for the time it took */
+        StartTime = KeQueryInterruptTime();
         WorkItem->WorkerRoutine(WorkItem->Parameter);
+        RunTime = min(KeQueryInterruptTime() - StartTime, MAXULONG);
+        ExInterlockedAddLargeStatistic(&Counters->TotalRunTime, (ULONG)RunTime);
+        if (RunTime > Counters->LongestRunTime) Counters->LongestRunTime = (ULONG)RunTime;
 
         /* Make sure APCs are not disabled */
         if (Thread->Tcb.CombinedApcDisable != 0)
@@ -238,6 +413,9 @@ ProcessLoop:
  *          - CriticalWorkQueue
  *          - HyperCriticalWorkQueue
  *
+ * @param Processor
+ *        Processor owning the queue. The thread prefers running there.
+ *
  * @param Dynamic
  *        Specifies whether or not this thread is a dynamic thread.
  *
@@ -252,6 +430,7 @@ ProcessLoop:
 VOID
 NTAPI
 ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
+                      IN ULONG Processor,
                       IN BOOLEAN Dynamic)
 {
     PETHREAD Thread;
@@ -260,7 +439,7 @@ ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
     KPRIORITY Priority;
 
     /* Check if this is going to be a dynamic thread */
-    Context = WorkQueueType;
+    Context = WorkQueueType | (Processor << EX_WORK_THREAD_PROCESSOR_SHIFT);
 
     /* Add the dynamic mask */
     if (Dynamic) Context |= EX_DYNAMIC_WORK_THREAD;
@@ -278,7 +457,7 @@ ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
     if (Dynamic)
     {
         /* Increase the count */
-        InterlockedIncrement(&ExWorkerQueue[WorkQueueType].DynamicThreadCount);
+        InterlockedIncrement(&ExpGetWorkQueue(Processor, WorkQueueType)->DynamicThreadCount);
     }
 
     /* Set the priority */
@@ -306,8 +485,9 @@ ExpCreateWorkerThread(WORK_QUEUE_TYPE WorkQueueType,
                               (PVOID*)&Thread,
                               NULL);
 
-    /* Set the Priority */
+    /* Set the Priority and keep it close to its queue */
     KeSetBasePriorityThread(&Thread->Tcb, Priority);
+    KeSetIdealProcessorThread(&Thread->Tcb, (UCHAR)Processor);
 
     /* Dereference and close handle */
     ObDereferenceObject(Thread);
@@ -333,30 +513,36 @@ VOID
 NTAPI
 ExpDetectWorkerThreadDeadlock(VOID)
 {
-    ULONG i;
+    ULONG i, Processor;
     PEX_WORK_QUEUE Queue;
 
-    /* Loop the 3 queues */
-    for (i = 0; i < MaximumWorkQueue; i++)
+    /* Loop the 3 queues of every processor */
+    for (Processor = 0; Processor < ExpWorkerQueueCount; Processor++)
     {
-        /* Get the queue */
-        Queue = &ExWorkerQueue[i];
-        ASSERT(Queue->DynamicThreadCount <= 16);
-
-        /* Check if stuff is on the queue that still is unprocessed */
-        if ((Queue->QueueDepthLastPass) &&
-            (Queue->WorkItemsProcessed == Queue->WorkItemsProcessedLastPass) &&
-            (Queue->DynamicThreadCount < 16))
+        for (i = 0; i < MaximumWorkQueue; i++)
         {
-            /* Stuff is still on the queue and nobody did anything about it */
-            DPRINT1("EX: Work Queue Deadlock detected: %lu\n", i);
-            ExpCreateWorkerThread(i, TRUE);
-            DPRINT1("Dynamic threads queued %d\n", Queue->DynamicThreadCount);
-        }
+            /* The hypercritical queue only exists once */
+            if ((Processor) && (i == HyperCriticalWorkQueue)) continue;
+
+            /* Get the queue */
+            Queue = &ExpWorkerQueues[Processor][i];
+            ASSERT(Queue->DynamicThreadCount <= 16);
 
-        /* Update our data */
-        Queue->WorkItemsProcessedLastPass = Queue->WorkItemsProcessed;
-        Queue->QueueDepthLastPass = KeReadStateQueue(&Queue->WorkerQueue);
+            /* Check if stuff is on the queue that still is unprocessed */
+            if ((Queue->QueueDepthLastPass) &&
+                (Queue->WorkItemsProcessed == Queue->WorkItemsProcessedLastPass) &&
+                (Queue->DynamicThreadCount < 16))
+            {
+                /* Stuff is still on the queue and nobody did anything about it */
+                DPRINT1("EX: Work Queue Deadlock detected: %lu on CPU %lu\n", i, Processor);
+                ExpCreateWorkerThread(i, Processor, TRUE);
+                DPRINT1("Dynamic threads queued %d\n", Queue->DynamicThreadCount);
+            }
+
+            /* Update our data */
+            Queue->WorkItemsProcessedLastPass = Queue->WorkItemsProcessed;
+            Queue->QueueDepthLastPass = KeReadStateQueue(&Queue->WorkerQueue);
+        }
     }
 }
 
@@ -378,25 +564,31 @@ VOID
 NTAPI
 ExpCheckDynamicThreadCount(VOID)
 {
-    ULONG i;
+    ULONG i, Processor;
     PEX_WORK_QUEUE Queue;
 
-    /* Loop the 3 queues */
-    for (i = 0; i < MaximumWorkQueue; i++)
+    /* Loop the 3 queues of every processor */
+    for (Processor = 0; Processor < ExpWorkerQueueCount; Processor++)
     {
-        /* Get the queue */
-        Queue = &ExWorkerQueue[i];
-
-        /* Check if still need a new thread. See ExQueueWorkItem */
-        if ((Queue->Info.MakeThreadsAsNecessary) &&
-            (!IsListEmpty(&Queue->WorkerQueue.EntryListHead)) &&
-            (Queue->WorkerQueue.CurrentCount <
-             Queue->WorkerQueue.MaximumCount) &&
-            (Queue->DynamicThreadCount < 16))
+        for (i = 0; i < MaximumWorkQueue; i++)
         {
-            /* Create a new thread */
-            DPRINT1("EX: Creating new dynamic thread as requested\n");
-            ExpCreateWorkerThread(i, TRUE);
+            /* The hypercritical queue only exists once */
+            if ((Processor) && (i == HyperCriticalWorkQueue)) continue;
+
+            /* Get the queue */
+            Queue = &ExpWorkerQueues[Processor][i];
+
+            /* Check if still need a new thread. See ExQueueWorkItem */
+            if ((Queue->Info.MakeThreadsAsNecessary) &&
+                (!IsListEmpty(&Queue->WorkerQueue.EntryListHead)) &&
+                (Queue->WorkerQueue.CurrentCount <
+                 Queue->WorkerQueue.MaximumCount) &&
+                (Queue->DynamicThreadCount < 16))
+            {
+                /* Create a new thread */
+                DPRINT1("EX: Creating new dynamic thread as requested\n");
+                ExpCreateWorkerThread(i, Processor, TRUE);
+            }
         }
     }
 }
@@ -512,7 +704,12 @@ ExpWorkerThreadBalanceManager(IN PVOID Context)
  *
  * @return None.
  *
- * @remarks This routine is only called once during system initialization.
+ * @remarks This routine is only called once during system initialization,
+ *          after all processors have been started.
+ *
+ *          Every processor gets its own critical and delayed queues, with
+ *          the configured number of threads spread over them. There is only
+ *          one hypercritical queue.
  *
  *--*/
 VOID
@@ -524,7 +721,8 @@ ExpInitializeWorkerThreads(VOID)
     ULONG CriticalThreads, DelayedThreads;
     HANDLE ThreadHandle;
     PETHREAD Thread;
-    ULONG i;
+    PEX_WORK_QUEUE WorkQueue;
+    ULONG Processor, i;
 
     /* Setup the stack swap support */
     ExInitializeFastMutex(&ExpWorkerSwapinMutex);
@@ -545,16 +743,43 @@ ExpInitializeWorkerThreads(VOID)
     DelayedThreads += ExpAdditionalDelayedWorkerThreads;
     CriticalThreads += ExpAdditionalCriticalWorkerThreads;
 
-    /* Initialize the Array */
-    for (WorkQueueType = 0; WorkQueueType < MaximumWorkQueue; WorkQueueType++)
+    /* The boot processor uses the static array, the others get their own */
+    ExpWorkerQueues[0] = ExWorkerQueue;
+    ExpWorkerQueueCount = 1;
+    for (Processor = 1; Processor < (ULONG)KeNumberProcessors; Processor++)
     {
-        /* Clear the structure and initialize the queue */
-        RtlZeroMemory(&ExWorkerQueue[WorkQueueType], sizeof(EX_WORK_QUEUE));
-        KeInitializeQueue(&ExWorkerQueue[WorkQueueType].WorkerQueue, 0);
+        WorkQueue = ExAllocatePoolWithTag(NonPagedPool,
+                                          MaximumWorkQueue * sizeof(EX_WORK_QUEUE),
+                                          TAG_WORK_QUEUE);
+        if (!WorkQueue) break;
+
+        ExpWorkerQueues[Processor] = WorkQueue;
+        ExpWorkerQueueCount++;
     }
 
-    /* Dynamic threads are only used for the critical queue */
-    ExWorkerQueue[CriticalWorkQueue].Info.MakeThreadsAsNecessary = TRUE;
+    /* Spread the threads over the processors, but keep a few on each */
+    if (ExpWorkerQueueCount > 1)
+    {
+        CriticalThreads = max((CriticalThreads + ExpWorkerQueueCount - 1) / ExpWorkerQueueCount,
+                              EX_MINIMUM_WORK_THREADS_PER_QUEUE);
+        DelayedThreads = max((DelayedThreads + ExpWorkerQueueCount - 1) / ExpWorkerQueueCount,
+                             EX_MINIMUM_WORK_THREADS_PER_QUEUE);
+    }
+
+    /* Initialize the Arrays */
+    for (Processor = 0; Processor < ExpWorkerQueueCount; Processor++)
+    {
+        for (WorkQueueType = 0; WorkQueueType < MaximumWorkQueue; WorkQueueType++)
+        {
+            /* Clear the structure and initialize the queue */
+            WorkQueue = &ExpWorkerQueues[Processor][WorkQueueType];
+            RtlZeroMemory(WorkQueue, sizeof(EX_WORK_QUEUE));
+            KeInitializeQueue(&WorkQueue->WorkerQueue, 0);
+        }
+
+        /* Dynamic threads are only used for the critical queues */
+        ExpWorkerQueues[Processor][CriticalWorkQueue].Info.MakeThreadsAsNecessary = TRUE;
+    }
 
     /* Initialize the balance set manager events */
     KeInitializeEvent(&ExpThreadSetManagerEvent, SynchronizationEvent, FALSE);
@@ -562,24 +787,27 @@ ExpInitializeWorkerThreads(VOID)
                       NotificationEvent,
                       FALSE);
 
-    /* Create the built-in worker threads for the critical queue */
-    for (i = 0; i < CriticalThreads; i++)
+    for (Processor = 0; Processor < ExpWorkerQueueCount; Processor++)
     {
-        /* Create the thread */
-        ExpCreateWorkerThread(CriticalWorkQueue, FALSE);
-        ExCriticalWorkerThreads++;
-    }
+        /* Create the built-in worker threads for the critical queue */
+        for (i = 0; i < CriticalThreads; i++)
+        {
+            /* Create the thread */
+            ExpCreateWorkerThread(CriticalWorkQueue, Processor, FALSE);
+            ExCriticalWorkerThreads++;
+        }
 
-    /* Create the built-in worker threads for the delayed queue */
-    for (i = 0; i < DelayedThreads; i++)
-    {
-        /* Create the thread */
-        ExpCreateWorkerThread(DelayedWorkQueue, FALSE);
-        ExDelayedWorkerThreads++;
+        /* Create the built-in worker threads for the delayed queue */
+        for (i = 0; i < DelayedThreads; i++)
+        {
+            /* Create the thread */
+            ExpCreateWorkerThread(DelayedWorkQueue, Processor, FALSE);
+            ExDelayedWorkerThreads++;
+        }
     }
 
     /* Create the built-in worker thread for the hypercritical queue */
-    ExpCreateWorkerThread(HyperCriticalWorkQueue, FALSE);
+    ExpCreateWorkerThread(HyperCriticalWorkQueue, 0, FALSE);
 
     /* Create the balance set manager thread */
     PsCreateSystemThread(&ThreadHandle,
@@ -711,13 +939,18 @@ Next:
  *
  *          Callers of this routine must be running at IRQL <= DISPATCH_LEVEL.
  *
+ *          The item goes to a queue of the current processor when possible,
+ *          see ExpSelectWorkQueue.
+ *
  *--*/
 VOID
 NTAPI
 ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
                 IN WORK_QUEUE_TYPE QueueType)
 {
-    PEX_WORK_QUEUE WorkQueue = &ExWorkerQueue[QueueType];
+    PEX_WORK_QUEUE WorkQueue;
+    PEXP_WORK_QUEUE_COUNTERS Counters;
+    ULONG Processor, Depth;
     ASSERT(QueueType < MaximumWorkQueue);
     ASSERT(WorkItem->List.Flink == NULL);
 
@@ -733,9 +966,15 @@ ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
     }
 
     /* Insert the Queue */
-    KeInsertQueue(&WorkQueue->WorkerQueue, &WorkItem->List);
+    WorkQueue = ExpSelectWorkQueue(QueueType, &Processor);
+    Depth = (ULONG)KeInsertQueue(&WorkQueue->WorkerQueue, &WorkItem->List);
     ASSERT(!WorkQueue->Info.QueueDisabled);
 
+    /* Update the statistics, the peak is only approximate */
+    Counters = &ExpWorkQueueCounters[Processor][QueueType];
+    InterlockedIncrement((PLONG)&Counters->WorkItemsQueued);
+    if (Depth >= Counters->PeakDepth) Counters->PeakDepth = Depth + 1;
+
     /*
      * Check if we need a new thread. Our decision is as follows:
      *  - This queue type must support Dynamic Threads (duh!)
@@ -757,4 +996,44 @@ ExQueueWorkItem(IN PWORK_QUEUE_ITEM WorkItem,
     }
 }
 
+#if DBG && defined(KDBG)
+BOOLEAN
+ExpKdbgExtWorkQueues(ULONG Argc, PCHAR Argv[])
+{
+    static const PCSTR QueueNames[MaximumWorkQueue] = { "Critical", "Delayed", "HyperCritical" };
+    PEX_WORK_QUEUE Queue;
+    PEXP_WORK_QUEUE_COUNTERS Counters;
+    ULONG Processor, i;
+
+    KdbpPrint("CPU Queue          Threads Dynamic Depth  Peak   Queued     Processed  Stolen     AvgRun(us) MaxRun(us)\n");
+    for (Processor = 0; Processor < ExpWorkerQueueCount; Processor++)
+    {
+        for (i = 0; i < MaximumWorkQueue; i++)
+        {
+            if ((Processor) && (i == HyperCriticalWorkQueue)) continue;
+
+            Queue = &ExpWorkerQueues[Processor][i];
+            Counters = &ExpWorkQueueCounters[Processor][i];
+
+            /* Run times are kept in 100ns units */
+            KdbpPrint("%-3lu %-14s %-7lu %-7ld %-6ld %-6lu %-10lu %-10lu %-10lu %-10I64u %-10lu\n",
+                      Processor,
+                      QueueNames[i],
+                      (ULONG)Queue->Info.WorkerCount,
+                      Queue->DynamicThreadCount,
+                      KeReadStateQueue(&Queue->WorkerQueue),
+                      Counters->PeakDepth,
+                      Counters->WorkItemsQueued,
+                      Queue->WorkItemsProcessed,
+                      Counters->WorkItemsStolen,
+                      Queue->WorkItemsProcessed ?
+                          Counters->TotalRunTime.QuadPart / Queue->WorkItemsProcessed / 10 : 0,
+                      Counters->LongestRunTime / 10);
+        }
+    }
+
+    return TRUE;
+}
+#endif
+
 /* EOF */
@@ -167,6 +167,17 @@ typedef struct _PFSN_PREFETCHER_GLOBALS
     LONG ActivePrefetches;
 } PFSN_PREFETCHER_GLOBALS, *PPFSN_PREFETCHER_GLOBALS;
 
+/* Each level of the VACB index covers VACB_LEVEL_SIZE * VACB_MAPPING_GRANULARITY
+ * bytes of the file, 32MB */
+#define VACB_LEVEL_SHIFT 7
+#define VACB_LEVEL_SIZE (1 << VACB_LEVEL_SHIFT)
+
+typedef struct _ROS_VACB_LEVEL
+{
+    ULONG ActiveCount;
+    struct _ROS_VACB *Vacbs[VACB_LEVEL_SIZE];
+} ROS_VACB_LEVEL, *PROS_VACB_LEVEL;
+
 typedef struct _ROS_SHARED_CACHE_MAP
 {
     CSHORT NodeTypeCode;
@@ -188,6 +199,10 @@ typedef struct _ROS_SHARED_CACHE_MAP
 
     /* ROS specific */
     LIST_ENTRY CacheMapVacbListHead;
+    /* Sparse index of the VACBs by FileOffset / VACB_MAPPING_GRANULARITY,
+     * protected by CacheMapLock */
+    PROS_VACB_LEVEL *VacbLevels;
+    ULONG VacbLevelCount;
     ULONG TimeStamp;
     BOOLEAN PinAccess;
     KSPIN_LOCK CacheMapLock;
@@ -370,6 +385,20 @@ CcRosMarkDirtyFile(
     LONGLONG FileOffset
 );
 
+PROS_VACB
+NTAPI
+CcRosGetIndexedVacb(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset
+);
+
+VOID
+NTAPI
+CcRosRemoveIndexedVacb(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    PROS_VACB Vacb
+);
+
 VOID
 NTAPI
 CcRosMarkDirtyVacb(
@@ -113,6 +113,21 @@
 //
 #define MAXIMUM_CACHED_DATA                             2 * PAGE_SIZE
 
+//
+// Largest write built from hive blocks that are contiguous in the file only
+//
+#define CMP_WRITE_GATHER_SIZE                           (64 * 1024)
+
+//
+// Size of a view of a hive file, one cache manager mapping
+//
+#define CM_VIEW_SIZE                                    VACB_MAPPING_GRANULARITY
+
+//
+// Views of a hive file left mapped when the registry lock is released
+//
+#define CM_MAX_MAPPED_VIEWS                             16
+
 //
 // Hives to load on startup
 //
@@ -558,6 +573,32 @@ CmpDestroyHiveViewList(
     IN PCMHIVE Hive
 );
 
+BOOLEAN
+NTAPI
+CmpReleaseHiveViews(
+    IN PCMHIVE Hive
+);
+
+BOOLEAN
+NTAPI
+CmpFileMapView(
+    IN PHHIVE RegistryHive,
+    IN ULONG BlockIndex
+);
+
+VOID
+NTAPI
+CmpTrimHiveViews(
+    IN PCMHIVE Hive,
+    IN ULONG MaxViews
+);
+
+VOID
+NTAPI
+CmpTrimViews(
+    VOID
+);
+
 //
 // Security Cache Functions
 //
@@ -1255,6 +1296,15 @@ CmpFileWrite(
     IN SIZE_T BufferLength
 );
 
+BOOLEAN
+NTAPI
+CmpFileWriteGather(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PHV_WRITE_SEGMENT Segments,
+    IN ULONG SegmentCount
+);
+
 BOOLEAN
 NTAPI
 CmpFileSetSize(
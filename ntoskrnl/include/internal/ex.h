@@ -197,6 +197,10 @@ VOID
 NTAPI
 ExpInitializeWorkerThreads(VOID);
 
+VOID
+NTAPI
+ExpInitializePoolTrackTables(VOID);
+
 VOID
 NTAPI
 ExSwapinWorkerThreads(IN BOOLEAN AllowSwap);
@@ -205,6 +209,10 @@ VOID
 NTAPI
 ExpInitLookasideLists(VOID);
 
+VOID
+NTAPI
+ExAdjustLookasideDepth(VOID);
+
 VOID
 NTAPI
 ExInitializeSystemLookasideList(
@@ -71,6 +71,21 @@ IopUnQueueIrpFromThread(IN PIRP Irp)
     InitializeListHead(&Irp->ThreadListEntry);
 }
 
+FORCEINLINE
+BOOLEAN
+IopSkipCompletionPort(IN PFILE_OBJECT FileObject,
+                      IN NTSTATUS Status,
+                      IN BOOLEAN PendingReturned)
+{
+    /*
+     * With FILE_SKIP_COMPLETION_PORT_ON_SUCCESS, the caller handles
+     * requests that succeed right away by itself, so don't queue them
+     */
+    return (FileObject->Flags & FO_SKIP_COMPLETION_PORT) &&
+           !(PendingReturned) &&
+           NT_SUCCESS(Status);
+}
+
 static
 __inline
 VOID
@@ -9,6 +9,10 @@ struct _EPROCESS;
 extern PMMSUPPORT MmKernelAddressSpace;
 extern PFN_COUNT MiFreeSwapPages;
 extern PFN_COUNT MiUsedSwapPages;
+extern ULONG MmPageFileReadIoCount;
+extern ULONG MmPageFilePagesRead;
+extern ULONG MmPageFileWriteIoCount;
+extern ULONG MmPageFilePagesWritten;
 extern PFN_COUNT MmNumberOfPhysicalPages;
 extern UCHAR MmDisablePagingExecutive;
 extern PFN_NUMBER MmLowestPhysicalPage;
@@ -434,6 +438,7 @@ typedef struct _MMPAGING_FILE
     PFILE_OBJECT FileObject;
     UNICODE_STRING PageFileName;
     PRTL_BITMAP Bitmap;
+    ULONG AllocationHint;
     HANDLE FileHandle;
 }
 MMPAGING_FILE, *PMMPAGING_FILE;
@@ -647,6 +652,14 @@ MmWriteToSwapPage(
     PFN_NUMBER Page
 );
 
+VOID
+NTAPI
+MmBeginSwapCluster(VOID);
+
+VOID
+NTAPI
+MmEndSwapCluster(VOID);
+
 VOID
 NTAPI
 MmShowOutOfSpaceMessagePagingFile(VOID);
@@ -725,6 +738,14 @@ MmPageFault(
     ULONG ErrorCode
 );
 
+/* pagfault.c ****************************************************************/
+
+VOID
+NTAPI
+MiCopyPfn(
+    _In_ PFN_NUMBER DestPage,
+    _In_ PFN_NUMBER SrcPage);
+
 /* special.c *****************************************************************/
 
 VOID
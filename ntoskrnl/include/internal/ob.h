@@ -115,6 +115,21 @@ typedef struct _OBP_FIND_HANDLE_DATA
     POBJECT_HANDLE_INFORMATION HandleInformation;
 } OBP_FIND_HANDLE_DATA, *POBP_FIND_HANDLE_DATA;
 
+//
+// Kernel-side state of a directory object, allocated right after its
+// OBJECT_DIRECTORY. HashTable is the larger bucket array replacing
+// HashBuckets once the directory holds too many entries, NULL until then.
+//
+typedef struct _OBP_DIRECTORY_EXTENSION
+{
+    POBJECT_DIRECTORY_ENTRY *HashTable;
+    ULONG HashTableSize;
+    ULONG EntryCount;
+} OBP_DIRECTORY_EXTENSION, *POBP_DIRECTORY_EXTENSION;
+
+#define ObpGetDirectoryExtension(d) \
+    ((POBP_DIRECTORY_EXTENSION)((POBJECT_DIRECTORY)(d) + 1))
+
 //
 // Cached Security Descriptor Header
 //
@@ -174,6 +189,12 @@ ObShutdownSystem(
 //
 // Directory Namespace Functions
 //
+VOID
+NTAPI
+ObpDeleteDirectory(
+    IN PVOID ObjectBody
+);
+
 BOOLEAN
 NTAPI
 ObpDeleteEntryDirectory(
@@ -142,6 +142,9 @@ KiIdleLoop(VOID)
             /* Enable interrupts */
             _enable();
 
+            /* Lock the PRCB, other CPUs may still be replacing the thread */
+            KiAcquirePrcbLock(Prcb);
+
             /* Capture current thread data */
             OldThread = Prcb->CurrentThread;
             NewThread = Prcb->NextThread;
@@ -153,6 +156,9 @@ KiIdleLoop(VOID)
             /* The thread is now running */
             NewThread->State = Running;
 
+            /* Release the PRCB lock */
+            KiReleasePrcbLock(Prcb);
+
             /* Do the swap at SYNCH_LEVEL */
             KfRaiseIrql(SYNCH_LEVEL);
 
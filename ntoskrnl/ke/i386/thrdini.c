@@ -300,6 +300,9 @@ KiIdleLoop(VOID)
             /* Enable interrupts */
             _enable();
 
+            /* Lock the PRCB, other CPUs may still be replacing the thread */
+            KiAcquirePrcbLock(Prcb);
+
             /* Capture current thread data */
             OldThread = Prcb->CurrentThread;
             NewThread = Prcb->NextThread;
@@ -311,6 +314,9 @@ KiIdleLoop(VOID)
             /* The thread is now running */
             NewThread->State = Running;
 
+            /* Release the PRCB lock */
+            KiReleasePrcbLock(Prcb);
+
             /* Switch away from the idle thread */
             KiSwapContext(APC_LEVEL, OldThread);
         }
@@ -230,13 +230,11 @@ KeReadStateQueue(IN PKQUEUE Queue)
     return Queue->Header.SignalState;
 }
 
-/*
- * @implemented
- */
+static
 PLIST_ENTRY
-NTAPI
-KeRemoveQueue(IN PKQUEUE Queue,
+KiRemoveQueue(IN PKQUEUE Queue,
               IN KPROCESSOR_MODE WaitMode,
+              IN BOOLEAN Alertable,
               IN PLARGE_INTEGER Timeout OPTIONAL)
 {
     PLIST_ENTRY QueueEntry;
@@ -344,12 +342,12 @@ KeRemoveQueue(IN PKQUEUE Queue,
             }
             else
             {
-                /* Fail if there's a User APC Pending */
-                if ((WaitMode != KernelMode) &&
-                    (Thread->ApcState.UserApcPending))
+                /* Fail if we were alerted or there's a User APC Pending */
+                Status = KiCheckAlertability(Thread, Alertable, WaitMode);
+                if (Status != STATUS_WAIT_0)
                 {
                     /* Return the status and increase the pending threads */
-                    QueueEntry = (PLIST_ENTRY)STATUS_USER_APC;
+                    QueueEntry = (PLIST_ENTRY)Status;
                     Queue->CurrentCount++;
                     break;
                 }
@@ -430,6 +428,75 @@ KeRemoveQueue(IN PKQUEUE Queue,
     return QueueEntry;
 }
 
+/*
+ * @implemented
+ */
+PLIST_ENTRY
+NTAPI
+KeRemoveQueue(IN PKQUEUE Queue,
+              IN KPROCESSOR_MODE WaitMode,
+              IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    /* Remove a single entry, without alerts */
+    return KiRemoveQueue(Queue, WaitMode, FALSE, Timeout);
+}
+
+/*
+ * @implemented
+ *
+ * Waits for an entry like KeRemoveQueue, then takes up to Count - 1 more
+ * entries which are already queued, without waiting for them. If the wait
+ * fails, EntryArray[0] holds the status (STATUS_TIMEOUT, STATUS_USER_APC or
+ * STATUS_ALERTED) instead of an entry.
+ */
+ULONG
+NTAPI
+KeRemoveQueueEx(IN PKQUEUE Queue,
+                IN KPROCESSOR_MODE WaitMode,
+                IN BOOLEAN Alertable,
+                IN PLARGE_INTEGER Timeout OPTIONAL,
+                OUT PLIST_ENTRY *EntryArray,
+                IN ULONG Count)
+{
+    PLIST_ENTRY QueueEntry;
+    ULONG Removed;
+    KIRQL OldIrql;
+    ASSERT_QUEUE(Queue);
+    ASSERT(Count != 0);
+
+    /* Wait for the first entry */
+    QueueEntry = KiRemoveQueue(Queue, WaitMode, Alertable, Timeout);
+    EntryArray[0] = QueueEntry;
+    Removed = 1;
+
+    /* Check if we got an entry and the caller wants more */
+    if ((Count > 1) &&
+        ((NTSTATUS)(ULONG_PTR)QueueEntry != STATUS_TIMEOUT) &&
+        ((NTSTATUS)(ULONG_PTR)QueueEntry != STATUS_USER_APC) &&
+        ((NTSTATUS)(ULONG_PTR)QueueEntry != STATUS_ALERTED))
+    {
+        /* Lock the dispatcher */
+        OldIrql = KiAcquireDispatcherLock();
+
+        /* The thread already counts as running, so just take what's there */
+        while ((Removed < Count) && !IsListEmpty(&Queue->EntryListHead))
+        {
+            /* Decrease the number of entries */
+            Queue->Header.SignalState--;
+
+            /* Remove the Entry */
+            QueueEntry = RemoveHeadList(&Queue->EntryListHead);
+            QueueEntry->Flink = NULL;
+            EntryArray[Removed++] = QueueEntry;
+        }
+
+        /* Release the lock */
+        KiReleaseDispatcherLock(OldIrql);
+    }
+
+    return Removed;
+}
+
 /*
  * @implemented
  */
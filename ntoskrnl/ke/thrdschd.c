@@ -15,9 +15,17 @@
 #ifdef _WIN64
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr64((PLONG64)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd64((PLONG64)Destination, SetMember);
+# define BitScanForwardSetMember(Index, Set) \
+    BitScanForward64(Index, Set);
 #else
 # define InterlockedOrSetMember(Destination, SetMember) \
     InterlockedOr((PLONG)Destination, SetMember);
+# define InterlockedAndSetMember(Destination, SetMember) \
+    InterlockedAnd((PLONG)Destination, SetMember);
+# define BitScanForwardSetMember(Index, Set) \
+    BitScanForward(Index, Set);
 #endif
 
 /* GLOBALS *******************************************************************/
@@ -83,6 +91,9 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     ULONG Processor = 0;
     KPRIORITY OldPriority;
     PKTHREAD NextThread;
+#ifdef CONFIG_SMP
+    KAFFINITY Affinity, IdleSet;
+#endif
 
     /* Sanity checks */
     ASSERT(Thread->State == DeferredReady);
@@ -228,6 +239,72 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
     OldPriority = Thread->Priority;
     Thread->Preempted = FALSE;
 
+#ifdef CONFIG_SMP
+    /* Check if any of the CPUs this thread can run on is idle */
+    Affinity = Thread->Affinity;
+    IdleSet = KiIdleSummary & Affinity;
+    if (IdleSet)
+    {
+        /* Prefer the ideal CPU, then the one it last ran on, then this one */
+        Processor = Thread->IdealProcessor;
+        if (!(IdleSet & AFFINITY_MASK(Processor)))
+        {
+            Processor = Thread->NextProcessor;
+            if (!(IdleSet & AFFINITY_MASK(Processor)))
+            {
+                Processor = KeGetCurrentProcessorNumber();
+                if (!(IdleSet & AFFINITY_MASK(Processor)))
+                {
+                    /* Any idle one will do */
+                    BitScanForwardSetMember(&Processor, IdleSet);
+                }
+            }
+        }
+
+        /* Get the PRCB and lock it */
+        Prcb = KiProcessorBlock[Processor];
+        KiAcquirePrcbLock(Prcb);
+
+        /* It's not going to be idle anymore either way */
+        InterlockedAndSetMember(&KiIdleSummary, ~AFFINITY_MASK(Processor));
+
+        /* Make sure nobody else gave it a thread in the meantime */
+        if ((Prcb->CurrentThread == Prcb->IdleThread) && !(Prcb->NextThread))
+        {
+            /* Set this thread as the next one */
+            Thread->NextProcessor = (UCHAR)Processor;
+            Thread->State = Standby;
+            Prcb->NextThread = Thread;
+
+            /* Unlock the PRCB and wake the CPU up if it's another one */
+            KiReleasePrcbLock(Prcb);
+            if (KeGetCurrentProcessorNumber() != Processor)
+            {
+                KiIpiSend(AFFINITY_MASK(Processor), IPI_DPC);
+            }
+            return;
+        }
+
+        /* Lost the race, go the normal way */
+        KiReleasePrcbLock(Prcb);
+    }
+
+    /* No idle CPU, so queue it on the ideal CPU if possible, or the last one */
+    Processor = Thread->IdealProcessor;
+    if (!(Affinity & AFFINITY_MASK(Processor)))
+    {
+        Processor = Thread->NextProcessor;
+        if (!(Affinity & AFFINITY_MASK(Processor)))
+        {
+            BitScanForwardSetMember(&Processor, Affinity & KeActiveProcessors);
+        }
+    }
+
+    /* Get the PRCB and lock it */
+    Thread->NextProcessor = (UCHAR)Processor;
+    Prcb = KiProcessorBlock[Processor];
+    KiAcquirePrcbLock(Prcb);
+#else
     /* Queue the thread on CPU 0 and get the PRCB and lock it */
     Thread->NextProcessor = 0;
     Prcb = KiProcessorBlock[0];
@@ -248,6 +325,7 @@ KiDeferredReadyThread(IN PKTHREAD Thread)
 
     /* Set the CPU number */
     Thread->NextProcessor = (UCHAR)Processor;
+#endif
 
     /* Get the next scheduled thread */
     NextThread = Prcb->NextThread;
@@ -341,7 +419,6 @@ KiSelectNextThread(IN PKPRCB Prcb)
         Prcb->IdleSchedule = TRUE;
 
         /* FIXME: SMT support */
-        ASSERTMSG("SMP: Not yet implemented\n", FALSE);
     }
 
     /* Sanity checks and return the thread */
@@ -680,6 +757,113 @@ KiSetPriorityThread(IN PKTHREAD Thread,
     }
 }
 
+#ifdef CONFIG_SMP
+static
+VOID
+KiRescheduleAffinityThread(IN PKTHREAD Thread)
+{
+    PKPRCB Prcb;
+    ULONG Processor;
+    PKTHREAD NewThread;
+    BOOLEAN RequestInterrupt = FALSE;
+
+    /* Loop in case the thread changes state under us */
+    for (;;)
+    {
+        /* Only ready, standby and running threads have a CPU */
+        if (((Thread->State != Ready) || (Thread->ProcessReadyQueue)) &&
+            (Thread->State != Standby) &&
+            (Thread->State != Running))
+        {
+            /* Deferred ones pick it when they get ready */
+            break;
+        }
+
+        /* Get the PRCB for the thread and lock it */
+        Processor = Thread->NextProcessor;
+        Prcb = KiProcessorBlock[Processor];
+        KiAcquirePrcbLock(Prcb);
+
+        /* Nothing to do if it can stay there */
+        if (Thread->Affinity & Prcb->SetMember)
+        {
+            KiReleasePrcbLock(Prcb);
+            break;
+        }
+
+        if (Thread->State == Ready)
+        {
+            /* Make sure the thread is still ready and on this CPU */
+            if (Thread->NextProcessor != Prcb->Number)
+            {
+                KiReleasePrcbLock(Prcb);
+                continue;
+            }
+
+            /* Remove it from the current queue */
+            if (RemoveEntryList(&Thread->WaitListEntry))
+            {
+                /* Update the ready summary */
+                Prcb->ReadySummary ^= PRIORITY_MASK(Thread->Priority);
+            }
+
+            /* And make it ready again, somewhere else */
+            KiInsertDeferredReadyList(Thread);
+        }
+        else if (Thread->State == Standby)
+        {
+            /* Check if we're still the next thread to run */
+            if (Thread != Prcb->NextThread)
+            {
+                KiReleasePrcbLock(Prcb);
+                continue;
+            }
+
+            /* Replace it with a ready thread, or let the idle loop pick one */
+            NewThread = KiSelectReadyThread(0, Prcb);
+            if (NewThread) NewThread->State = Standby;
+            Prcb->NextThread = NewThread;
+
+            /* And make it ready again somewhere else */
+            KiInsertDeferredReadyList(Thread);
+        }
+        else if (Thread->State == Running)
+        {
+            /* Check if we're still the current thread running */
+            if (Thread != Prcb->CurrentThread)
+            {
+                KiReleasePrcbLock(Prcb);
+                continue;
+            }
+
+            /* Have it preempted, it will be queued elsewhere when it is */
+            if (!Prcb->NextThread)
+            {
+                NewThread = KiSelectNextThread(Prcb);
+                NewThread->State = Standby;
+                Prcb->NextThread = NewThread;
+                RequestInterrupt = TRUE;
+            }
+        }
+        else
+        {
+            /* The state changed, try again */
+            KiReleasePrcbLock(Prcb);
+            continue;
+        }
+
+        /* Release the lock and check if we need an interrupt */
+        KiReleasePrcbLock(Prcb);
+        if ((RequestInterrupt) && (KeGetCurrentProcessorNumber() != Processor))
+        {
+            /* We are on another CPU, send an IPI */
+            KiIpiSend(AFFINITY_MASK(Processor), IPI_DPC);
+        }
+        break;
+    }
+}
+#endif
+
 KAFFINITY
 FASTCALL
 KiSetAffinityThread(IN PKTHREAD Thread,
@@ -701,12 +885,23 @@ KiSetAffinityThread(IN PKTHREAD Thread,
     /* Update the new affinity */
     Thread->UserAffinity = Affinity;
 
+    /* Make sure the ideal CPU is still part of it */
+    if (!(Affinity & AFFINITY_MASK(Thread->UserIdealProcessor)))
+    {
+        /* Pick the next one which is */
+        Thread->UserIdealProcessor = KeFindNextRightSetAffinity(Thread->UserIdealProcessor,
+                                                                Affinity);
+    }
+
     /* Check if system affinity is disabled */
     if (!Thread->SystemAffinityActive)
     {
+        /* It is, so the new affinity takes effect right away */
+        Thread->Affinity = Affinity;
+        Thread->IdealProcessor = Thread->UserIdealProcessor;
 #ifdef CONFIG_SMP
-        /* FIXME: TODO */
-        DPRINT1("Affinity support disabled!\n");
+        /* Move the thread away if it can't stay where it is */
+        KiRescheduleAffinityThread(Thread);
 #endif
     }
 
@@ -26,6 +26,7 @@ typedef struct _POOL_DPC_CONTEXT
 {
     PPOOL_TRACKER_TABLE PoolTrackTable;
     SIZE_T PoolTrackTableSize;
+    ULONG PoolTrackTableCount;
     PPOOL_TRACKER_TABLE PoolTrackTableExpansion;
     SIZE_T PoolTrackTableSizeExpansion;
 } POOL_DPC_CONTEXT, *PPOOL_DPC_CONTEXT;
@@ -38,6 +39,7 @@ PKGUARDED_MUTEX ExpPagedPoolMutex;
 SIZE_T PoolTrackTableSize, PoolTrackTableMask;
 SIZE_T PoolBigPageTableSize, PoolBigPageTableHash;
 PPOOL_TRACKER_TABLE PoolTrackTable;
+PPOOL_TRACKER_TABLE ExpPoolTrackTables[MAXIMUM_PROCESSORS];
 PPOOL_TRACKER_BIG_PAGES PoolBigPageTable;
 KSPIN_LOCK ExpTaggedPoolLock;
 ULONG PoolHitTag;
@@ -442,6 +444,91 @@ ExpComputeHashForTag(IN ULONG Tag,
     return (ULONG)BucketMask & ((ULONG)Result ^ (Result >> 32));
 }
 
+FORCEINLINE
+PPOOL_TRACKER_TABLE
+ExpGetPoolTrackTable(VOID)
+{
+    PPOOL_TRACKER_TABLE Table;
+
+    //
+    // Each processor updates its own tracker table, so that the counters of
+    // hot tags don't bounce between processors on every allocation and free.
+    // Until the per-processor tables exist, everyone shares the boot table.
+    //
+    // Note that the thread might move to another processor right after this,
+    // which is why the counters are still updated with interlocked operations
+    //
+    Table = ExpPoolTrackTables[KeGetCurrentProcessorNumber()];
+    return Table ? Table : PoolTrackTable;
+}
+
+PPOOL_TRACKER_TABLE
+NTAPI
+ExpFindPoolTracker(IN PPOOL_TRACKER_TABLE Table,
+                   IN ULONG Key,
+                   IN BOOLEAN Create)
+{
+    ULONG Hash, Index;
+    KIRQL OldIrql;
+    PPOOL_TRACKER_TABLE TableEntry;
+
+    //
+    // Compute the hash for this key, and loop all the possible buckets
+    //
+    Hash = ExpComputeHashForTag(Key, PoolTrackTableMask);
+    Index = Hash;
+    while (TRUE)
+    {
+        //
+        // Do we already have an entry for this tag?
+        //
+        TableEntry = &Table[Hash];
+        if (TableEntry->Key == Key) return TableEntry;
+
+        //
+        // Entries are never removed, so an empty bucket means the tag is not
+        // in this table. Create it there if the caller asked us to.
+        //
+        if (!TableEntry->Key)
+        {
+            if (!Create) return NULL;
+
+            //
+            // We need to hold the lock while creating a new entry, since other
+            // processors might be in this code path as well
+            //
+            ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
+            if (!TableEntry->Key)
+            {
+                //
+                // We've won the race, so now create this entry in the bucket
+                //
+                TableEntry->Key = Key;
+            }
+            ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
+
+            //
+            // Now we force the loop to run again, and we should now end up in
+            // the code path above which returns the entry
+            //
+            continue;
+        }
+
+        //
+        // This path is hit when we don't have an entry, and the current bucket
+        // is full, so we simply try the next one
+        //
+        Hash = (Hash + 1) & PoolTrackTableMask;
+        if (Hash == Index) break;
+    }
+
+    //
+    // And finally this path is hit when all the buckets are full, and we need
+    // some expansion. This path is not yet supported in ReactOS.
+    //
+    return NULL;
+}
+
 FORCEINLINE
 ULONG
 ExpComputePartialHashForAddress(IN PVOID BaseAddress)
@@ -490,7 +577,10 @@ VOID
 MiDumpPoolConsumers(BOOLEAN CalledFromDbg, ULONG Tag, ULONG Mask, ULONG Flags)
 {
     SIZE_T i;
+    ULONG Table, Other;
     BOOLEAN Verbose;
+    POOL_TRACKER_TABLE Totals;
+    PPOOL_TRACKER_TABLE OtherEntry;
 
     //
     // Only print header if called from OOM situation
@@ -528,64 +618,116 @@ MiDumpPoolConsumers(BOOLEAN CalledFromDbg, ULONG Tag, ULONG Mask, ULONG Flags)
     }
 
     //
-    // We'll extract allocations for all the tracked pools
+    // We'll extract allocations for all the tracked pools, from the tables
+    // of all the processors. We can't allocate memory here, so each tag is
+    // summed up when first seen, and skipped in the tables after that one.
     //
-    for (i = 0; i < PoolTrackTableSize; ++i)
+    for (Table = 0; Table < (ULONG)KeNumberProcessors; ++Table)
     {
-        PPOOL_TRACKER_TABLE TableEntry;
-
-        TableEntry = &PoolTrackTable[i];
+        if (!ExpPoolTrackTables[Table]) continue;
 
-        //
-        // We only care about tags which have allocated memory
-        //
-        if (TableEntry->NonPagedBytes != 0 || TableEntry->PagedBytes != 0)
+        for (i = 0; i < PoolTrackTableSize; ++i)
         {
+            PPOOL_TRACKER_TABLE TableEntry;
+
+            TableEntry = &ExpPoolTrackTables[Table][i];
+            if (Table != 0 && !TableEntry->Key) continue;
+
+            for (Other = 0; Other < Table; ++Other)
+            {
+                if (ExpPoolTrackTables[Other] &&
+                    ExpFindPoolTracker(ExpPoolTrackTables[Other], TableEntry->Key, FALSE))
+                {
+                    break;
+                }
+            }
+            if (Other != Table) continue;
+
+            Totals = *TableEntry;
+            for (Other = Table + 1; Other < (ULONG)KeNumberProcessors; ++Other)
+            {
+                if (!ExpPoolTrackTables[Other]) continue;
+
+                OtherEntry = ExpFindPoolTracker(ExpPoolTrackTables[Other], TableEntry->Key, FALSE);
+                if (!OtherEntry) continue;
+
+                Totals.NonPagedAllocs += OtherEntry->NonPagedAllocs;
+                Totals.NonPagedFrees += OtherEntry->NonPagedFrees;
+                Totals.NonPagedBytes += OtherEntry->NonPagedBytes;
+                Totals.PagedAllocs += OtherEntry->PagedAllocs;
+                Totals.PagedFrees += OtherEntry->PagedFrees;
+                Totals.PagedBytes += OtherEntry->PagedBytes;
+            }
+            TableEntry = &Totals;
+
             //
-            // If there's a tag, attempt to do a pretty print
-            // only if it matches the caller's tag, or if
-            // any tag is allowed
-            // For checking whether it matches caller's tag,
-            // use the mask to make sure not to mess with the wildcards
+            // We only care about tags which have allocated memory
             //
-            if (TableEntry->Key != 0 && TableEntry->Key != TAG_NONE &&
-                (Tag == 0 || (TableEntry->Key & Mask) == (Tag & Mask)))
+            if (TableEntry->NonPagedBytes != 0 || TableEntry->PagedBytes != 0)
             {
-                CHAR Tag[4];
-
                 //
-                // Extract each 'component' and check whether they are printable
+                // If there's a tag, attempt to do a pretty print
+                // only if it matches the caller's tag, or if
+                // any tag is allowed
+                // For checking whether it matches caller's tag,
+                // use the mask to make sure not to mess with the wildcards
                 //
-                Tag[0] = TableEntry->Key & 0xFF;
-                Tag[1] = TableEntry->Key >> 8 & 0xFF;
-                Tag[2] = TableEntry->Key >> 16 & 0xFF;
-                Tag[3] = TableEntry->Key >> 24 & 0xFF;
-
-                if (ExpTagAllowPrint(Tag[0]) && ExpTagAllowPrint(Tag[1]) && ExpTagAllowPrint(Tag[2]) && ExpTagAllowPrint(Tag[3]))
+                if (TableEntry->Key != 0 && TableEntry->Key != TAG_NONE &&
+                    (Tag == 0 || (TableEntry->Key & Mask) == (Tag & Mask)))
                 {
+                    CHAR Tag[4];
+
                     //
-                    // Print in direct order to make !poolused TAG usage easier
+                    // Extract each 'component' and check whether they are printable
                     //
-                    if (Verbose)
+                    Tag[0] = TableEntry->Key & 0xFF;
+                    Tag[1] = TableEntry->Key >> 8 & 0xFF;
+                    Tag[2] = TableEntry->Key >> 16 & 0xFF;
+                    Tag[3] = TableEntry->Key >> 24 & 0xFF;
+
+                    if (ExpTagAllowPrint(Tag[0]) && ExpTagAllowPrint(Tag[1]) && ExpTagAllowPrint(Tag[2]) && ExpTagAllowPrint(Tag[3]))
                     {
-                        MiDumperPrint(CalledFromDbg, "'%c%c%c%c'\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n", Tag[0], Tag[1], Tag[2], Tag[3],
-                                      TableEntry->NonPagedAllocs, TableEntry->NonPagedFrees,
-                                      (TableEntry->NonPagedAllocs - TableEntry->NonPagedFrees), TableEntry->NonPagedBytes,
-                                      TableEntry->PagedAllocs, TableEntry->PagedFrees,
-                                      (TableEntry->PagedAllocs - TableEntry->PagedFrees), TableEntry->PagedBytes);
+                        //
+                        // Print in direct order to make !poolused TAG usage easier
+                        //
+                        if (Verbose)
+                        {
+                            MiDumperPrint(CalledFromDbg, "'%c%c%c%c'\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n", Tag[0], Tag[1], Tag[2], Tag[3],
+                                          TableEntry->NonPagedAllocs, TableEntry->NonPagedFrees,
+                                          (TableEntry->NonPagedAllocs - TableEntry->NonPagedFrees), TableEntry->NonPagedBytes,
+                                          TableEntry->PagedAllocs, TableEntry->PagedFrees,
+                                          (TableEntry->PagedAllocs - TableEntry->PagedFrees), TableEntry->PagedBytes);
+                        }
+                        else
+                        {
+                            MiDumperPrint(CalledFromDbg, "'%c%c%c%c'\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n", Tag[0], Tag[1], Tag[2], Tag[3],
+                                          TableEntry->NonPagedAllocs, TableEntry->NonPagedBytes,
+                                          TableEntry->PagedAllocs, TableEntry->PagedBytes);
+                        }
                     }
                     else
                     {
-                        MiDumperPrint(CalledFromDbg, "'%c%c%c%c'\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n", Tag[0], Tag[1], Tag[2], Tag[3],
-                                      TableEntry->NonPagedAllocs, TableEntry->NonPagedBytes,
-                                      TableEntry->PagedAllocs, TableEntry->PagedBytes);
+                        if (Verbose)
+                        {
+                            MiDumperPrint(CalledFromDbg, "%x\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n", TableEntry->Key,
+                                          TableEntry->NonPagedAllocs, TableEntry->NonPagedFrees,
+                                          (TableEntry->NonPagedAllocs - TableEntry->NonPagedFrees), TableEntry->NonPagedBytes,
+                                          TableEntry->PagedAllocs, TableEntry->PagedFrees,
+                                          (TableEntry->PagedAllocs - TableEntry->PagedFrees), TableEntry->PagedBytes);
+                        }
+                        else
+                        {
+                            MiDumperPrint(CalledFromDbg, "%x\t%ld\t\t%ld\t\t%ld\t\t%ld\n", TableEntry->Key,
+                                          TableEntry->NonPagedAllocs, TableEntry->NonPagedBytes,
+                                          TableEntry->PagedAllocs, TableEntry->PagedBytes);
+                        }
                     }
                 }
-                else
+                else if (Tag == 0 || (Tag & Mask) == (TAG_NONE & Mask))
                 {
                     if (Verbose)
                     {
-                        MiDumperPrint(CalledFromDbg, "%x\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n", TableEntry->Key,
+                        MiDumperPrint(CalledFromDbg, "Anon\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n",
                                       TableEntry->NonPagedAllocs, TableEntry->NonPagedFrees,
                                       (TableEntry->NonPagedAllocs - TableEntry->NonPagedFrees), TableEntry->NonPagedBytes,
                                       TableEntry->PagedAllocs, TableEntry->PagedFrees,
@@ -593,29 +735,12 @@ MiDumpPoolConsumers(BOOLEAN CalledFromDbg, ULONG Tag, ULONG Mask, ULONG Flags)
                     }
                     else
                     {
-                        MiDumperPrint(CalledFromDbg, "%x\t%ld\t\t%ld\t\t%ld\t\t%ld\n", TableEntry->Key,
+                        MiDumperPrint(CalledFromDbg, "Anon\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n",
                                       TableEntry->NonPagedAllocs, TableEntry->NonPagedBytes,
                                       TableEntry->PagedAllocs, TableEntry->PagedBytes);
                     }
                 }
             }
-            else if (Tag == 0 || (Tag & Mask) == (TAG_NONE & Mask))
-            {
-                if (Verbose)
-                {
-                    MiDumperPrint(CalledFromDbg, "Anon\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n",
-                                  TableEntry->NonPagedAllocs, TableEntry->NonPagedFrees,
-                                  (TableEntry->NonPagedAllocs - TableEntry->NonPagedFrees), TableEntry->NonPagedBytes,
-                                  TableEntry->PagedAllocs, TableEntry->PagedFrees,
-                                  (TableEntry->PagedAllocs - TableEntry->PagedFrees), TableEntry->PagedBytes);
-                }
-                else
-                {
-                    MiDumperPrint(CalledFromDbg, "Anon\t\t%ld\t\t%ld\t\t%ld\t\t%ld\n",
-                                  TableEntry->NonPagedAllocs, TableEntry->NonPagedBytes,
-                                  TableEntry->PagedAllocs, TableEntry->PagedBytes);
-                }
-            }
         }
     }
 
@@ -631,10 +756,9 @@ MiDumpPoolConsumers(BOOLEAN CalledFromDbg, ULONG Tag, ULONG Mask, ULONG Flags)
 VOID
 NTAPI
 INIT_SECTION
-ExpSeedHotTags(VOID)
+ExpSeedHotTags(IN PPOOL_TRACKER_TABLE TrackTable)
 {
     ULONG i, Key, Hash, Index;
-    PPOOL_TRACKER_TABLE TrackTable = PoolTrackTable;
     ULONG TagList[] =
     {
         '  oI',
@@ -755,9 +879,7 @@ ExpRemovePoolTracker(IN ULONG Key,
                      IN SIZE_T NumberOfBytes,
                      IN POOL_TYPE PoolType)
 {
-    ULONG Hash, Index;
-    PPOOL_TRACKER_TABLE Table, TableEntry;
-    SIZE_T TableMask, TableSize;
+    PPOOL_TRACKER_TABLE TableEntry;
 
     //
     // Remove the PROTECTED_POOL flag which is not part of the tag
@@ -771,73 +893,34 @@ ExpRemovePoolTracker(IN ULONG Key,
     if (Key == PoolHitTag) DbgBreakPoint();
 
     //
-    // Why the double indirection? Because normally this function is also used
-    // when doing session pool allocations, which has another set of tables,
-    // sizes, and masks that live in session pool. Now we don't support session
-    // pool so we only ever use the regular tables, but I'm keeping the code this
-    // way so that the day we DO support session pool, it won't require that
-    // many changes
-    //
-    Table = PoolTrackTable;
-    TableMask = PoolTrackTableMask;
-    TableSize = PoolTrackTableSize;
-    DBG_UNREFERENCED_LOCAL_VARIABLE(TableSize);
-
+    // Find the entry for this tag in the current processor's table. The block
+    // may have been allocated on another processor, so the entry is created
+    // if needed and the tables only balance out once they are merged.
     //
-    // Compute the hash for this key, and loop all the possible buckets
-    //
-    Hash = ExpComputeHashForTag(Key, TableMask);
-    Index = Hash;
-    while (TRUE)
+    TableEntry = ExpFindPoolTracker(ExpGetPoolTrackTable(), Key, TRUE);
+    if (!TableEntry)
     {
         //
-        // Have we found the entry for this tag? */
-        //
-        TableEntry = &Table[Hash];
-        if (TableEntry->Key == Key)
-        {
-            //
-            // Decrement the counters depending on if this was paged or nonpaged
-            // pool
-            //
-            if ((PoolType & BASE_POOL_TYPE_MASK) == NonPagedPool)
-            {
-                InterlockedIncrement(&TableEntry->NonPagedFrees);
-                InterlockedExchangeAddSizeT(&TableEntry->NonPagedBytes,
-                                            -(SSIZE_T)NumberOfBytes);
-                return;
-            }
-            InterlockedIncrement(&TableEntry->PagedFrees);
-            InterlockedExchangeAddSizeT(&TableEntry->PagedBytes,
-                                        -(SSIZE_T)NumberOfBytes);
-            return;
-        }
-
-        //
-        // We should have only ended up with an empty entry if we've reached
-        // the last bucket
-        //
-        if (!TableEntry->Key)
-        {
-            DPRINT1("Empty item reached in tracker table. Hash=0x%lx, TableMask=0x%lx, Tag=0x%08lx, NumberOfBytes=%lu, PoolType=%d\n",
-                    Hash, TableMask, Key, (ULONG)NumberOfBytes, PoolType);
-            ASSERT(Hash == TableMask);
-        }
-
-        //
-        // This path is hit when we don't have an entry, and the current bucket
-        // is full, so we simply try the next one
+        // All the buckets are full, and we need some expansion. This path is
+        // not yet supported in ReactOS and so we'll ignore the tag
         //
-        Hash = (Hash + 1) & TableMask;
-        if (Hash == Index) break;
+        DPRINT1("Out of pool tag space, ignoring...\n");
+        return;
     }
 
     //
-    // And finally this path is hit when all the buckets are full, and we need
-    // some expansion. This path is not yet supported in ReactOS and so we'll
-    // ignore the tag
+    // Decrement the counters depending on if this was paged or nonpaged pool
     //
-    DPRINT1("Out of pool tag space, ignoring...\n");
+    if ((PoolType & BASE_POOL_TYPE_MASK) == NonPagedPool)
+    {
+        InterlockedIncrement(&TableEntry->NonPagedFrees);
+        InterlockedExchangeAddSizeT(&TableEntry->NonPagedBytes,
+                                    -(SSIZE_T)NumberOfBytes);
+        return;
+    }
+    InterlockedIncrement(&TableEntry->PagedFrees);
+    InterlockedExchangeAddSizeT(&TableEntry->PagedBytes,
+                                -(SSIZE_T)NumberOfBytes);
 }
 
 VOID
@@ -846,10 +929,7 @@ ExpInsertPoolTracker(IN ULONG Key,
                      IN SIZE_T NumberOfBytes,
                      IN POOL_TYPE PoolType)
 {
-    ULONG Hash, Index;
-    KIRQL OldIrql;
-    PPOOL_TRACKER_TABLE Table, TableEntry;
-    SIZE_T TableMask, TableSize;
+    PPOOL_TRACKER_TABLE TableEntry;
 
     //
     // Remove the PROTECTED_POOL flag which is not part of the tag
@@ -871,91 +951,34 @@ ExpInsertPoolTracker(IN ULONG Key,
     // ASSERT on ReactOS features not yet supported
     //
     ASSERT(!(PoolType & SESSION_POOL_MASK));
-    ASSERT(KeGetCurrentProcessorNumber() == 0);
-
-    //
-    // Why the double indirection? Because normally this function is also used
-    // when doing session pool allocations, which has another set of tables,
-    // sizes, and masks that live in session pool. Now we don't support session
-    // pool so we only ever use the regular tables, but I'm keeping the code this
-    // way so that the day we DO support session pool, it won't require that
-    // many changes
-    //
-    Table = PoolTrackTable;
-    TableMask = PoolTrackTableMask;
-    TableSize = PoolTrackTableSize;
-    DBG_UNREFERENCED_LOCAL_VARIABLE(TableSize);
 
     //
-    // Compute the hash for this key, and loop all the possible buckets
+    // Find or create the entry for this tag in the current processor's table.
+    // Session pool would have its own set of tables here, but we don't support
+    // it yet so we only ever use the regular ones.
     //
-    Hash = ExpComputeHashForTag(Key, TableMask);
-    Index = Hash;
-    while (TRUE)
+    TableEntry = ExpFindPoolTracker(ExpGetPoolTrackTable(), Key, TRUE);
+    if (!TableEntry)
     {
         //
-        // Do we already have an entry for this tag? */
-        //
-        TableEntry = &Table[Hash];
-        if (TableEntry->Key == Key)
-        {
-            //
-            // Increment the counters depending on if this was paged or nonpaged
-            // pool
-            //
-            if ((PoolType & BASE_POOL_TYPE_MASK) == NonPagedPool)
-            {
-                InterlockedIncrement(&TableEntry->NonPagedAllocs);
-                InterlockedExchangeAddSizeT(&TableEntry->NonPagedBytes, NumberOfBytes);
-                return;
-            }
-            InterlockedIncrement(&TableEntry->PagedAllocs);
-            InterlockedExchangeAddSizeT(&TableEntry->PagedBytes, NumberOfBytes);
-            return;
-        }
-
-        //
-        // We don't have an entry yet, but we've found a free bucket for it
+        // All the buckets are full, and we need some expansion. This path is
+        // not yet supported in ReactOS and so we'll ignore the tag
         //
-        if (!(TableEntry->Key) && (Hash != PoolTrackTableSize - 1))
-        {
-            //
-            // We need to hold the lock while creating a new entry, since other
-            // processors might be in this code path as well
-            //
-            ExAcquireSpinLock(&ExpTaggedPoolLock, &OldIrql);
-            if (!PoolTrackTable[Hash].Key)
-            {
-                //
-                // We've won the race, so now create this entry in the bucket
-                //
-                ASSERT(Table[Hash].Key == 0);
-                PoolTrackTable[Hash].Key = Key;
-                TableEntry->Key = Key;
-            }
-            ExReleaseSpinLock(&ExpTaggedPoolLock, OldIrql);
-
-            //
-            // Now we force the loop to run again, and we should now end up in
-            // the code path above which does the interlocked increments...
-            //
-            continue;
-        }
-
-        //
-        // This path is hit when we don't have an entry, and the current bucket
-        // is full, so we simply try the next one
-        //
-        Hash = (Hash + 1) & TableMask;
-        if (Hash == Index) break;
+        DPRINT1("Out of pool tag space, ignoring...\n");
+        return;
     }
 
     //
-    // And finally this path is hit when all the buckets are full, and we need
-    // some expansion. This path is not yet supported in ReactOS and so we'll
-    // ignore the tag
+    // Increment the counters depending on if this was paged or nonpaged pool
     //
-    DPRINT1("Out of pool tag space, ignoring...\n");
+    if ((PoolType & BASE_POOL_TYPE_MASK) == NonPagedPool)
+    {
+        InterlockedIncrement(&TableEntry->NonPagedAllocs);
+        InterlockedExchangeAddSizeT(&TableEntry->NonPagedBytes, NumberOfBytes);
+        return;
+    }
+    InterlockedIncrement(&TableEntry->PagedAllocs);
+    InterlockedExchangeAddSizeT(&TableEntry->PagedBytes, NumberOfBytes);
 }
 
 VOID
@@ -1109,7 +1132,8 @@ InitializePool(IN POOL_TYPE PoolType,
         //
         // Finally, add the most used tags to speed up those allocations
         //
-        ExpSeedHotTags();
+        ExpSeedHotTags(PoolTrackTable);
+        ExpPoolTrackTables[0] = PoolTrackTable;
 
         //
         // We now do the exact same thing with the tracker table for big pages
@@ -1260,6 +1284,46 @@ InitializePool(IN POOL_TYPE PoolType,
     }
 }
 
+VOID
+NTAPI
+INIT_SECTION
+ExpInitializePoolTrackTables(VOID)
+{
+    PPOOL_TRACKER_TABLE Table;
+    SIZE_T TableBytes;
+    ULONG i;
+
+    //
+    // The boot processor keeps the table built by InitializePool, the others
+    // get a copy of the same size now that they are all running
+    //
+    TableBytes = PoolTrackTableSize * sizeof(POOL_TRACKER_TABLE);
+    for (i = 1; i < (ULONG)KeNumberProcessors; i++)
+    {
+        //
+        // A processor without a table of its own keeps using the boot table
+        //
+        Table = MiAllocatePoolPages(NonPagedPool, TableBytes);
+        if (!Table)
+        {
+            DPRINT1("EXPOOL: No tracker table for processor %lu\n", i);
+            continue;
+        }
+
+        //
+        // Seed the hot tags here too, so that they keep their first bucket
+        //
+        RtlZeroMemory(Table, TableBytes);
+        ExpSeedHotTags(Table);
+
+        //
+        // Account for the table, then let the processor start using it
+        //
+        ExpInsertPoolTracker('looP', ROUND_TO_PAGES(TableBytes), NonPagedPool);
+        InterlockedExchangePointer((PVOID*)&ExpPoolTrackTables[i], Table);
+    }
+}
+
 FORCEINLINE
 KIRQL
 ExLockPool(IN PPOOL_DESCRIPTOR Descriptor)
@@ -1316,6 +1380,8 @@ ExpGetPoolTagInfoTarget(IN PKDPC Dpc,
                         IN PVOID SystemArgument2)
 {
     PPOOL_DPC_CONTEXT Context = DeferredContext;
+    PPOOL_TRACKER_TABLE Destination;
+    ULONG i;
     UNREFERENCED_PARAMETER(Dpc);
     ASSERT(KeGetCurrentIrql() == DISPATCH_LEVEL);
 
@@ -1324,9 +1390,25 @@ ExpGetPoolTagInfoTarget(IN PKDPC Dpc,
     //
     if (KeSignalCallDpcSynchronize(SystemArgument2))
     {
-        RtlCopyMemory(Context->PoolTrackTable,
-                      PoolTrackTable,
-                      Context->PoolTrackTableSize * sizeof(POOL_TRACKER_TABLE));
+        //
+        // Copy the table of each processor one after the other. Processors
+        // still sharing the boot table get an empty one.
+        //
+        for (i = 0; i < Context->PoolTrackTableCount; i++)
+        {
+            Destination = Context->PoolTrackTable + i * Context->PoolTrackTableSize;
+            if (ExpPoolTrackTables[i])
+            {
+                RtlCopyMemory(Destination,
+                              ExpPoolTrackTables[i],
+                              Context->PoolTrackTableSize * sizeof(POOL_TRACKER_TABLE));
+            }
+            else
+            {
+                RtlZeroMemory(Destination,
+                              Context->PoolTrackTableSize * sizeof(POOL_TRACKER_TABLE));
+            }
+        }
 
         //
         // This is here because ReactOS does not yet support expansion
@@ -1350,10 +1432,10 @@ ExGetPoolTagInfo(IN PSYSTEM_POOLTAG_INFORMATION SystemInformation,
                  IN OUT PULONG ReturnLength OPTIONAL)
 {
     ULONG TableSize, CurrentLength;
-    ULONG EntryCount;
+    ULONG EntryCount, TableCount;
     NTSTATUS Status = STATUS_SUCCESS;
     PSYSTEM_POOLTAG TagEntry;
-    PPOOL_TRACKER_TABLE Buffer, TrackerEntry;
+    PPOOL_TRACKER_TABLE Buffer, TrackerEntry, MergedEntry;
     POOL_DPC_CONTEXT Context;
     ASSERT(KeGetCurrentIrql() == PASSIVE_LEVEL);
 
@@ -1370,10 +1452,11 @@ ExGetPoolTagInfo(IN PSYSTEM_POOLTAG_INFORMATION SystemInformation,
 
     //
     // Capture the number of entries, and the total size needed to make a copy
-    // of the table
+    // of the table of each processor
     //
     EntryCount = (ULONG)PoolTrackTableSize;
-    TableSize = EntryCount * sizeof(POOL_TRACKER_TABLE);
+    TableCount = (ULONG)KeNumberProcessors;
+    TableSize = TableCount * EntryCount * sizeof(POOL_TRACKER_TABLE);
 
     //
     // Allocate the "Generic DPC" temporary buffer
@@ -1386,10 +1469,37 @@ ExGetPoolTagInfo(IN PSYSTEM_POOLTAG_INFORMATION SystemInformation,
     //
     Context.PoolTrackTable = Buffer;
     Context.PoolTrackTableSize = PoolTrackTableSize;
+    Context.PoolTrackTableCount = TableCount;
     Context.PoolTrackTableExpansion = NULL;
     Context.PoolTrackTableSizeExpansion = 0;
     KeGenericCallDpc(ExpGetPoolTagInfoTarget, &Context);
 
+    //
+    // Merge the copies of the other processors' tables into the first one.
+    // A block freed on another processor than the one which allocated it
+    // shows up in both tables, so only the sums are meaningful.
+    //
+    for (TrackerEntry = Buffer + EntryCount;
+         TrackerEntry < (Buffer + TableCount * EntryCount);
+         TrackerEntry++)
+    {
+        if (!TrackerEntry->Key) continue;
+
+        MergedEntry = ExpFindPoolTracker(Buffer, TrackerEntry->Key, TRUE);
+        if (!MergedEntry)
+        {
+            DPRINT1("Out of pool tag space, ignoring...\n");
+            continue;
+        }
+
+        MergedEntry->NonPagedAllocs += TrackerEntry->NonPagedAllocs;
+        MergedEntry->NonPagedFrees += TrackerEntry->NonPagedFrees;
+        MergedEntry->NonPagedBytes += TrackerEntry->NonPagedBytes;
+        MergedEntry->PagedAllocs += TrackerEntry->PagedAllocs;
+        MergedEntry->PagedFrees += TrackerEntry->PagedFrees;
+        MergedEntry->PagedBytes += TrackerEntry->PagedBytes;
+    }
+
     //
     // Now parse the results
     //
@@ -19,6 +19,7 @@
 
 PMMPTE MmFirstReservedMappingPte, MmLastReservedMappingPte;
 PMMPTE MiFirstReservedZeroingPte;
+PMMPTE MiReservedZeroingPtes[MAXIMUM_PROCESSORS];
 MMPTE HyperTemplatePte;
 PEPROCESS HyperProcess;
 KIRQL HyperIrql;
@@ -125,9 +126,13 @@ MiMapPagesInZeroSpace(IN PMMPFN Pfn1,
     ASSERT(NumberOfPages <= (MI_ZERO_PTES - 1));
 
     //
-    // Pick the first zeroing PTE
+    // Pick the first zeroing PTE of this processor. Each one has its own
+    // set, used only by its zero page worker which never leaves it, so
+    // flushing the local TB when wrapping around is enough
     //
-    PointerPte = MiFirstReservedZeroingPte;
+    ASSERT(KeGetCurrentThread()->Affinity == AFFINITY_MASK(KeGetCurrentProcessorNumber()));
+    PointerPte = MiReservedZeroingPtes[KeGetCurrentProcessorNumber()];
+    ASSERT(PointerPte != NULL);
 
     //
     // Now get the first free PTE
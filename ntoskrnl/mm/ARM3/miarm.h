@@ -539,6 +539,7 @@ extern PVOID MmSessionBase;
 extern SIZE_T MmSessionSize;
 extern PMMPTE MmFirstReservedMappingPte, MmLastReservedMappingPte;
 extern PMMPTE MiFirstReservedZeroingPte;
+extern PMMPTE MiReservedZeroingPtes[MAXIMUM_PROCESSORS];
 extern MI_PFN_CACHE_ATTRIBUTE MiPlatformCacheAttributes[2][MmMaximumCacheType];
 extern PPHYSICAL_MEMORY_DESCRIPTOR MmPhysicalMemoryBlock;
 extern SIZE_T MmBootImageSize;
@@ -17,9 +17,17 @@
 
 /* GLOBALS ********************************************************************/
 
+/* Pages zeroed per PFN lock acquisition, they are mapped all at once */
+#define MI_ZERO_PAGE_BATCH 16
+C_ASSERT(MI_ZERO_PAGE_BATCH <= (MI_ZERO_PTES - 1));
+
 BOOLEAN MmZeroingPageThreadActive;
 KEVENT MmZeroingPageEvent;
 
+/* Protected by the PFN lock */
+static ULONG MiZeroingPageWorkersActive;
+static ULONG MiZeroingPageWorkers;
+
 /* PRIVATE FUNCTIONS **********************************************************/
 
 VOID
@@ -32,26 +40,34 @@ NTAPI
 MiFreeInitializationCode(IN PVOID StartVa,
 IN PVOID EndVa);
 
+/* Pages zeroed ahead of demand are not touched again soon, keep them out of the caches */
+static
 VOID
-NTAPI
-MmZeroPageThread(VOID)
+MiZeroPagesNonTemporal(IN PVOID Address,
+                       IN ULONG Size)
+{
+#if defined(_M_AMD64)
+    KiZeroPagesNonTemporal(Address, Size);
+#elif defined(_M_IX86)
+    if (KeFeatureBits & KF_XMMI64)
+        KiZeroPagesNonTemporal(Address, Size);
+    else
+        KeZeroPages(Address, Size);
+#else
+    KeZeroPages(Address, Size);
+#endif
+}
+
+static
+VOID
+MiZeroPageLoop(VOID)
 {
-    PKTHREAD Thread = KeGetCurrentThread();
-    PVOID StartAddress, EndAddress;
     PVOID WaitObjects[2];
     KIRQL OldIrql;
     PVOID ZeroAddress;
-    PFN_NUMBER PageIndex, FreePage;
-    PMMPFN Pfn1;
-
-    /* Get the discardable sections to free them */
-    MiFindInitializationCode(&StartAddress, &EndAddress);
-    if (StartAddress) MiFreeInitializationCode(StartAddress, EndAddress);
-    DPRINT("Free non-cache pages: %lx\n", MmAvailablePages + MiMemoryConsumers[MC_CACHE].PagesUsed);
-
-    /* Set our priority to 0 */
-    Thread->BasePriority = 0;
-    KeSetPriorityThread(Thread, 0);
+    PFN_NUMBER PageIndex, FreePage, Count, i;
+    PFN_NUMBER Pages[MI_ZERO_PAGE_BATCH];
+    PMMPFN Pfn1, FirstPfn;
 
     /* Setup the wait objects */
     WaitObjects[0] = &MmZeroingPageEvent;
@@ -68,47 +84,152 @@ MmZeroPageThread(VOID)
                                  NULL,
                                  NULL);
         OldIrql = MiAcquirePfnLock();
+        MiZeroingPageWorkersActive++;
         MmZeroingPageThreadActive = TRUE;
 
         while (TRUE)
         {
-            if (!MmFreePageListHead.Total)
+            /* Take a batch of pages, chained through u1.Flink for mapping */
+            FirstPfn = (PMMPFN)LIST_HEAD;
+            for (Count = 0; (Count < MI_ZERO_PAGE_BATCH) && (MmFreePageListHead.Total); Count++)
+            {
+                PageIndex = MmFreePageListHead.Flink;
+                ASSERT(PageIndex != LIST_HEAD);
+                Pfn1 = MiGetPfnEntry(PageIndex);
+                MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
+                MI_SET_PROCESS2("Kernel 0 Loop");
+                FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
+
+                /* The first global free page should also be the first on its own list */
+                if (FreePage != PageIndex)
+                {
+                    KeBugCheckEx(PFN_LIST_CORRUPT,
+                                 0x8F,
+                                 FreePage,
+                                 PageIndex,
+                                 0);
+                }
+
+                Pfn1->u1.Flink = (ULONG_PTR)FirstPfn;
+                FirstPfn = Pfn1;
+                Pages[Count] = PageIndex;
+            }
+
+            if (!Count)
             {
-                MmZeroingPageThreadActive = FALSE;
+                if (!--MiZeroingPageWorkersActive) MmZeroingPageThreadActive = FALSE;
                 MiReleasePfnLock(OldIrql);
                 break;
             }
 
-            PageIndex = MmFreePageListHead.Flink;
-            ASSERT(PageIndex != LIST_HEAD);
-            Pfn1 = MiGetPfnEntry(PageIndex);
-            MI_SET_USAGE(MI_USAGE_ZERO_LOOP);
-            MI_SET_PROCESS2("Kernel 0 Loop");
-            FreePage = MiRemoveAnyPage(MI_GET_PAGE_COLOR(PageIndex));
-
-            /* The first global free page should also be the first on its own list */
-            if (FreePage != PageIndex)
+            /* Wake up another worker if there is more than we can take */
+            if ((MmFreePageListHead.Total >= MI_ZERO_PAGE_BATCH) &&
+                (MiZeroingPageWorkersActive < MiZeroingPageWorkers))
             {
-                KeBugCheckEx(PFN_LIST_CORRUPT,
-                             0x8F,
-                             FreePage,
-                             PageIndex,
-                             0);
+                KeSetEvent(&MmZeroingPageEvent, IO_NO_INCREMENT, FALSE);
             }
 
-            Pfn1->u1.Flink = LIST_HEAD;
             MiReleasePfnLock(OldIrql);
 
-            ZeroAddress = MiMapPagesInZeroSpace(Pfn1, 1);
+            ZeroAddress = MiMapPagesInZeroSpace(FirstPfn, Count);
             ASSERT(ZeroAddress);
-            RtlZeroMemory(ZeroAddress, PAGE_SIZE);
-            MiUnmapPagesInZeroSpace(ZeroAddress, 1);
+            MiZeroPagesNonTemporal(ZeroAddress, Count * PAGE_SIZE);
+            MiUnmapPagesInZeroSpace(ZeroAddress, Count);
 
             OldIrql = MiAcquirePfnLock();
 
-            MiInsertPageInList(&MmZeroedPageListHead, PageIndex);
+            for (i = 0; i < Count; i++)
+            {
+                MiInsertPageInList(&MmZeroedPageListHead, Pages[i]);
+            }
+        }
+    }
+}
+
+static
+VOID
+NTAPI
+MiZeroPageWorkerThread(IN PVOID Context)
+{
+    PKTHREAD Thread = KeGetCurrentThread();
+
+    /* Stay on our processor, its zeroing PTEs are only valid there */
+    KeSetSystemAffinityThread(AFFINITY_MASK((ULONG_PTR)Context));
+
+    /* Set our priority to 0 */
+    Thread->BasePriority = 0;
+    KeSetPriorityThread(Thread, 0);
+
+    MiZeroPageLoop();
+}
+
+static
+VOID
+MiStartZeroPageWorkers(VOID)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE ThreadHandle;
+    PMMPTE PointerPte;
+    NTSTATUS Status;
+    ULONG i;
+
+    /* The boot processor uses the zeroing PTEs reserved at initialization */
+    MiReservedZeroingPtes[0] = MiFirstReservedZeroingPte;
+    MiZeroingPageWorkers = 1;
+
+    /* Every other processor gets its own worker, running when it is idle */
+    for (i = 1; i < (ULONG)KeNumberProcessors; i++)
+    {
+        /* Reserve its zeroing PTEs and set the counter to maximum */
+        PointerPte = MiReserveSystemPtes(MI_ZERO_PTES, SystemPteSpace);
+        if (!PointerPte) break;
+        RtlZeroMemory(PointerPte, MI_ZERO_PTES * sizeof(MMPTE));
+        PointerPte->u.Hard.PageFrameNumber = MI_ZERO_PTES - 1;
+        MiReservedZeroingPtes[i] = PointerPte;
+
+        InitializeObjectAttributes(&ObjectAttributes, NULL, OBJ_KERNEL_HANDLE, NULL, NULL);
+        Status = PsCreateSystemThread(&ThreadHandle,
+                                      THREAD_ALL_ACCESS,
+                                      &ObjectAttributes,
+                                      NULL,
+                                      NULL,
+                                      MiZeroPageWorkerThread,
+                                      (PVOID)(ULONG_PTR)i);
+        if (!NT_SUCCESS(Status))
+        {
+            MiReleaseSystemPtes(PointerPte, MI_ZERO_PTES, SystemPteSpace);
+            MiReservedZeroingPtes[i] = NULL;
+            break;
         }
+
+        ZwClose(ThreadHandle);
+        MiZeroingPageWorkers++;
     }
+
+    DPRINT("%lu zero page workers\n", MiZeroingPageWorkers);
+}
+
+VOID
+NTAPI
+MmZeroPageThread(VOID)
+{
+    PKTHREAD Thread = KeGetCurrentThread();
+    PVOID StartAddress, EndAddress;
+
+    /* Get the discardable sections to free them */
+    MiFindInitializationCode(&StartAddress, &EndAddress);
+    if (StartAddress) MiFreeInitializationCode(StartAddress, EndAddress);
+    DPRINT("Free non-cache pages: %lx\n", MmAvailablePages + MiMemoryConsumers[MC_CACHE].PagesUsed);
+
+    /* We are the worker of the boot processor */
+    KeSetSystemAffinityThread(AFFINITY_MASK(0));
+    MiStartZeroPageWorkers();
+
+    /* Set our priority to 0 */
+    Thread->BasePriority = 0;
+    KeSetPriorityThread(Thread, 0);
+
+    MiZeroPageLoop();
 }
 
 /* EOF */
@@ -183,6 +183,9 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
 
     (*NrFreedPages) = 0;
 
+    /* Gather the pages we swap out into larger writes */
+    MmBeginSwapCluster();
+
     CurrentPage = MmGetLRUFirstUserPage();
     while (CurrentPage != 0 && Target > 0)
     {
@@ -203,6 +206,8 @@ MmTrimUserMemory(ULONG Target, ULONG Priority, PULONG NrFreedPages)
         CurrentPage = NextPage;
     }
 
+    MmEndSwapCluster();
+
     return STATUS_SUCCESS;
 }
 
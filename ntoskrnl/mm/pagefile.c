@@ -91,6 +91,66 @@ static BOOLEAN MmSwapSpaceMessage = FALSE;
 
 static BOOLEAN MmSystemPageFileLocated = FALSE;
 
+/*
+ * Largest paging file I/O, in pages (64 KB on x86).
+ */
+#define MM_SWAP_CLUSTER_PAGES         (16)
+
+/*
+ * Number of read-ahead pages kept for upcoming faults, and the number of
+ * available pages below which no read-ahead is done.
+ */
+#define MM_SWAP_READ_AHEAD_PAGES      (64)
+#define MM_SWAP_READ_AHEAD_THRESHOLD  (1024)
+
+/*
+ * Protects the write cluster, the read-ahead pages and the write counters
+ * below. It is never held while waiting for paging file I/O.
+ */
+static KGUARDED_MUTEX MiSwapClusterLock;
+
+/*
+ * Pages written by the owning thread, not yet sent to the paging file.
+ * They are contiguous in the paging file and their data is copied into
+ * pages the cluster owns, so the callers are free to release theirs.
+ * While the cluster is being written it can't change, but its pages still
+ * serve faults on its slots. MiSwapClusterWritten is signaled when no
+ * write is in progress.
+ */
+static PETHREAD MiSwapClusterOwner;
+static ULONG MiSwapClusterFile;
+static ULONG_PTR MiSwapClusterOffset;
+static ULONG MiSwapClusterCount;
+static PFN_NUMBER MiSwapClusterPages[MM_SWAP_CLUSTER_PAGES];
+static BOOLEAN MiSwapClusterWriting;
+static KEVENT MiSwapClusterWritten;
+
+/*
+ * Single page writes in progress, and a count of all writes ever started.
+ * A read-ahead that overlapped a write may hold stale data and is dropped.
+ */
+static ULONG MiSwapWritesInProgress;
+static ULONG MiSwapWriteSequence;
+
+/*
+ * Pages read along with a faulting one, which will likely be needed next.
+ */
+typedef struct _MM_SWAP_READ_AHEAD
+{
+    ULONG PageFileIndex;
+    ULONG_PTR PageFileOffset;
+    PFN_NUMBER Page;
+} MM_SWAP_READ_AHEAD, *PMM_SWAP_READ_AHEAD;
+
+static MM_SWAP_READ_AHEAD MiSwapReadAhead[MM_SWAP_READ_AHEAD_PAGES];
+static ULONG MiSwapReadAheadNext;
+
+/* Paging file I/O statistics */
+ULONG MmPageFileReadIoCount;
+ULONG MmPageFilePagesRead;
+ULONG MmPageFileWriteIoCount;
+ULONG MmPageFilePagesWritten;
+
 /* FUNCTIONS *****************************************************************/
 
 VOID
@@ -132,18 +192,235 @@ MmShowOutOfSpaceMessagePagingFile(VOID)
     }
 }
 
+static
 NTSTATUS
-NTAPI
-MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+MiDoPagingFileIo(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset,
+    _In_ PPFN_NUMBER Pages,
+    _In_ ULONG Count,
+    _In_ BOOLEAN Write)
 {
-    ULONG i;
-    ULONG_PTR offset;
     LARGE_INTEGER file_offset;
     IO_STATUS_BLOCK Iosb;
     NTSTATUS Status;
     KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(ULONG)];
+    UCHAR MdlBase[sizeof(MDL) + MM_SWAP_CLUSTER_PAGES * sizeof(PFN_NUMBER)];
     PMDL Mdl = (PMDL)MdlBase;
+    PMMPAGING_FILE PagingFile;
+
+    ASSERT(Count != 0 && Count <= MM_SWAP_CLUSTER_PAGES);
+
+    PagingFile = MmPagingFile[PageFileIndex];
+    if (PagingFile == NULL || PagingFile->FileObject == NULL ||
+            PagingFile->FileObject->DeviceObject == NULL)
+    {
+        DPRINT1("Bad paging file %u\n", PageFileIndex);
+        KeBugCheck(MEMORY_MANAGEMENT);
+    }
+
+    MmInitializeMdl(Mdl, NULL, Count * PAGE_SIZE);
+    MmBuildMdlFromPages(Mdl, Pages);
+    Mdl->MdlFlags |= MDL_PAGES_LOCKED;
+
+    file_offset.QuadPart = (LONGLONG)PageFileOffset * PAGE_SIZE;
+
+    KeInitializeEvent(&Event, NotificationEvent, FALSE);
+    if (Write)
+    {
+        Status = IoSynchronousPageWrite(PagingFile->FileObject,
+                                        Mdl,
+                                        &file_offset,
+                                        &Event,
+                                        &Iosb);
+        InterlockedIncrement((PLONG)&MmPageFileWriteIoCount);
+        InterlockedExchangeAdd((PLONG)&MmPageFilePagesWritten, Count);
+    }
+    else
+    {
+        Status = IoPageRead(PagingFile->FileObject,
+                            Mdl,
+                            &file_offset,
+                            &Event,
+                            &Iosb);
+        InterlockedIncrement((PLONG)&MmPageFileReadIoCount);
+        InterlockedExchangeAdd((PLONG)&MmPageFilePagesRead, Count);
+    }
+
+    if (Status == STATUS_PENDING)
+    {
+        KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
+        Status = Iosb.Status;
+    }
+
+    if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+    {
+        MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
+    }
+    return(Status);
+}
+
+static
+BOOLEAN
+MiIsInSwapCluster(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset)
+{
+    return (MiSwapClusterCount != 0 &&
+            MiSwapClusterFile == PageFileIndex &&
+            PageFileOffset >= MiSwapClusterOffset &&
+            PageFileOffset < MiSwapClusterOffset + MiSwapClusterCount);
+}
+
+/*
+ * Sends the cluster and waits until it is empty. Called and returns with
+ * MiSwapClusterLock held, but drops it while waiting for the write.
+ */
+static
+VOID
+MiFlushSwapCluster(VOID)
+{
+    NTSTATUS Status;
+
+    /* Wait for a write started by someone else */
+    while (MiSwapClusterWriting)
+    {
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        KeWaitForSingleObject(&MiSwapClusterWritten, Executive, KernelMode, FALSE, NULL);
+        KeAcquireGuardedMutex(&MiSwapClusterLock);
+    }
+
+    if (MiSwapClusterCount == 0)
+    {
+        return;
+    }
+
+    MiSwapClusterWriting = TRUE;
+    KeClearEvent(&MiSwapClusterWritten);
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+
+    Status = MiDoPagingFileIo(MiSwapClusterFile,
+                              MiSwapClusterOffset,
+                              MiSwapClusterPages,
+                              MiSwapClusterCount,
+                              TRUE);
+    if (!NT_SUCCESS(Status))
+    {
+        /* The owners already let go of these pages, their data would be lost */
+        DPRINT1("MM: Failed to write %lu pages to swap (Status was 0x%.8X)\n",
+                MiSwapClusterCount, Status);
+        KeBugCheckEx(MEMORY_MANAGEMENT,
+                     Status,
+                     MiSwapClusterFile,
+                     MiSwapClusterOffset,
+                     MiSwapClusterCount);
+    }
+
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+
+    /* The pages are ours, they are simply reused for the next cluster */
+    MiSwapClusterCount = 0;
+    MiSwapClusterWriting = FALSE;
+    KeSetEvent(&MiSwapClusterWritten, IO_NO_INCREMENT, FALSE);
+}
+
+static
+PMM_SWAP_READ_AHEAD
+MiFindSwapReadAhead(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset)
+{
+    ULONG i;
+
+    for (i = 0; i < MM_SWAP_READ_AHEAD_PAGES; i++)
+    {
+        if (MiSwapReadAhead[i].Page != 0 &&
+                MiSwapReadAhead[i].PageFileIndex == PageFileIndex &&
+                MiSwapReadAhead[i].PageFileOffset == PageFileOffset)
+        {
+            return &MiSwapReadAhead[i];
+        }
+    }
+
+    return NULL;
+}
+
+static
+VOID
+MiDropSwapReadAhead(
+    _In_ PMM_SWAP_READ_AHEAD ReadAhead)
+{
+    if (ReadAhead != NULL && ReadAhead->Page != 0)
+    {
+        MmReleasePageMemoryConsumer(MC_SYSTEM, ReadAhead->Page);
+        ReadAhead->Page = 0;
+    }
+}
+
+/*
+ * Called with MiSwapClusterLock held before the slot is written, without
+ * dropping the lock until the write is visible in the cluster or counted
+ * in MiSwapWritesInProgress.
+ */
+static
+VOID
+MiInvalidateSwapReadAhead(
+    _In_ ULONG PageFileIndex,
+    _In_ ULONG_PTR PageFileOffset)
+{
+    MiDropSwapReadAhead(MiFindSwapReadAhead(PageFileIndex, PageFileOffset));
+
+    /* Reads in progress must not keep what they read ahead */
+    MiSwapWriteSequence++;
+}
+
+VOID
+NTAPI
+MmBeginSwapCluster(VOID)
+{
+    ULONG i;
+
+    /* Writes of this thread are now gathered until MmEndSwapCluster */
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+    ASSERT(MiSwapClusterOwner == NULL);
+    MiSwapClusterOwner = PsGetCurrentThread();
+
+    /* Get the pages of the cluster once, without them pages are written one by one */
+    for (i = 0; i < MM_SWAP_CLUSTER_PAGES && MiSwapClusterPages[i] == 0; i++)
+    {
+        if (!NT_SUCCESS(MmRequestPageMemoryConsumer(MC_SYSTEM, FALSE, &MiSwapClusterPages[i])))
+        {
+            MiSwapClusterPages[i] = 0;
+            while (i-- > 0)
+            {
+                MmReleasePageMemoryConsumer(MC_SYSTEM, MiSwapClusterPages[i]);
+                MiSwapClusterPages[i] = 0;
+            }
+            break;
+        }
+    }
+
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+}
+
+VOID
+NTAPI
+MmEndSwapCluster(VOID)
+{
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+    ASSERT(MiSwapClusterOwner == PsGetCurrentThread());
+    MiFlushSwapCluster();
+    MiSwapClusterOwner = NULL;
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+}
+
+NTSTATUS
+NTAPI
+MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
+{
+    ULONG i;
+    ULONG_PTR offset;
+    NTSTATUS Status;
 
     DPRINT("MmWriteToSwapPage\n");
 
@@ -163,28 +440,56 @@ MmWriteToSwapPage(SWAPENTRY SwapEntry, PFN_NUMBER Page)
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
-    Mdl->MdlFlags |= MDL_PAGES_LOCKED;
-
-    file_offset.QuadPart = offset * PAGE_SIZE;
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
 
-    KeInitializeEvent(&Event, NotificationEvent, FALSE);
-    Status = IoSynchronousPageWrite(MmPagingFile[i]->FileObject,
-                                    Mdl,
-                                    &file_offset,
-                                    &Event,
-                                    &Iosb);
-    if (Status == STATUS_PENDING)
+    if (MiSwapClusterOwner == PsGetCurrentThread() &&
+            MiSwapClusterPages[MM_SWAP_CLUSTER_PAGES - 1] != 0)
     {
-        KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
-        Status = Iosb.Status;
+        /* Send the cluster if this page doesn't extend it or it is being written */
+        if (MiSwapClusterWriting ||
+                (MiSwapClusterCount != 0 &&
+                 (MiSwapClusterFile != i ||
+                  MiSwapClusterOffset + MiSwapClusterCount != offset)))
+        {
+            MiFlushSwapCluster();
+        }
+
+        /* Whatever we read ahead for this slot is about to be stale */
+        MiInvalidateSwapReadAhead(i, offset);
+
+        if (MiSwapClusterCount == 0)
+        {
+            MiSwapClusterFile = i;
+            MiSwapClusterOffset = offset;
+        }
+
+        /* Keep a copy of the page until it is written, the caller may free it now */
+        MiCopyPfn(MiSwapClusterPages[MiSwapClusterCount++], Page);
+
+        if (MiSwapClusterCount == MM_SWAP_CLUSTER_PAGES)
+        {
+            MiFlushSwapCluster();
+        }
+
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        return STATUS_SUCCESS;
     }
 
-    if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+    /* The slot's previous contents must not overwrite this page later */
+    while (MiIsInSwapCluster(i, offset))
     {
-        MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
+        MiFlushSwapCluster();
     }
+
+    MiInvalidateSwapReadAhead(i, offset);
+    MiSwapWritesInProgress++;
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+
+    Status = MiDoPagingFileIo(i, offset, &Page, 1, TRUE);
+
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+    MiSwapWritesInProgress--;
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
     return(Status);
 }
 
@@ -203,13 +508,12 @@ MiReadPageFile(
     _In_ ULONG PageFileIndex,
     _In_ ULONG_PTR PageFileOffset)
 {
-    LARGE_INTEGER file_offset;
-    IO_STATUS_BLOCK Iosb;
     NTSTATUS Status;
-    KEVENT Event;
-    UCHAR MdlBase[sizeof(MDL) + sizeof(ULONG)];
-    PMDL Mdl = (PMDL)MdlBase;
     PMMPAGING_FILE PagingFile;
+    PMM_SWAP_READ_AHEAD ReadAhead;
+    PFN_NUMBER Pages[MM_SWAP_CLUSTER_PAGES];
+    ULONG_PTR Offset;
+    ULONG Count, Sequence, i;
 
     DPRINT("MiReadSwapFile\n");
 
@@ -229,27 +533,101 @@ MiReadPageFile(
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    MmInitializeMdl(Mdl, NULL, PAGE_SIZE);
-    MmBuildMdlFromPages(Mdl, &Page);
-    Mdl->MdlFlags |= MDL_PAGES_LOCKED;
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
 
-    file_offset.QuadPart = PageFileOffset * PAGE_SIZE;
+    /* The page may not even be written yet */
+    if (MiIsInSwapCluster(PageFileIndex, PageFileOffset))
+    {
+        MiCopyPfn(Page, MiSwapClusterPages[PageFileOffset - MiSwapClusterOffset]);
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        return STATUS_SUCCESS;
+    }
 
-    KeInitializeEvent(&Event, NotificationEvent, FALSE);
-    Status = IoPageRead(PagingFile->FileObject,
-                        Mdl,
-                        &file_offset,
-                        &Event,
-                        &Iosb);
-    if (Status == STATUS_PENDING)
+    /* Or it was read along with a previous fault */
+    ReadAhead = MiFindSwapReadAhead(PageFileIndex, PageFileOffset);
+    if (ReadAhead != NULL)
     {
-        KeWaitForSingleObject(&Event, Executive, KernelMode, FALSE, NULL);
-        Status = Iosb.Status;
+        MiCopyPfn(Page, ReadAhead->Page);
+        MiDropSwapReadAhead(ReadAhead);
+        KeReleaseGuardedMutex(&MiSwapClusterLock);
+        return STATUS_SUCCESS;
     }
-    if (Mdl->MdlFlags & MDL_MAPPED_TO_SYSTEM_VA)
+
+    /*
+     * Bring in the following slots as well, as long as they are in use
+     * and we can spare the memory. They were likely written together.
+     * Don't bother while a write may be changing them under us.
+     */
+    Pages[0] = Page;
+    Count = 1;
+    if (MmAvailablePages > MM_SWAP_READ_AHEAD_THRESHOLD && MiSwapWritesInProgress == 0)
     {
-        MmUnmapLockedPages (Mdl->MappedSystemVa, Mdl);
+        for (Offset = PageFileOffset + 1;
+             Count < MM_SWAP_CLUSTER_PAGES && Offset < PagingFile->Bitmap->SizeOfBitMap;
+             Offset++)
+        {
+            if (!RtlCheckBit(PagingFile->Bitmap, (ULONG)Offset) ||
+                    MiIsInSwapCluster(PageFileIndex, Offset) ||
+                    MiFindSwapReadAhead(PageFileIndex, Offset) != NULL)
+            {
+                break;
+            }
+
+            if (!NT_SUCCESS(MmRequestPageMemoryConsumer(MC_SYSTEM, FALSE, &Pages[Count])))
+            {
+                break;
+            }
+            Count++;
+        }
     }
+
+    Sequence = MiSwapWriteSequence;
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+
+    Status = MiDoPagingFileIo(PageFileIndex, PageFileOffset, Pages, Count, FALSE);
+    if (!NT_SUCCESS(Status) && Count > 1)
+    {
+        /* Maybe the read-ahead went past the end of the file, try alone */
+        for (i = 1; i < Count; i++)
+        {
+            MmReleasePageMemoryConsumer(MC_SYSTEM, Pages[i]);
+        }
+        Count = 1;
+        Status = MiDoPagingFileIo(PageFileIndex, PageFileOffset, Pages, Count, FALSE);
+    }
+
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+
+    /* Some of the extra pages may have been written meanwhile */
+    if (MiSwapWriteSequence != Sequence)
+    {
+        for (i = 1; i < Count; i++)
+        {
+            MmReleasePageMemoryConsumer(MC_SYSTEM, Pages[i]);
+        }
+        Count = 1;
+    }
+
+    /* Keep the extra pages, replacing the oldest ones */
+    for (i = 1; i < Count; i++)
+    {
+        /* Another fault may have read the same slot ahead */
+        if (MiFindSwapReadAhead(PageFileIndex, PageFileOffset + i) != NULL)
+        {
+            MmReleasePageMemoryConsumer(MC_SYSTEM, Pages[i]);
+            continue;
+        }
+
+        ReadAhead = &MiSwapReadAhead[MiSwapReadAheadNext];
+        MiSwapReadAheadNext = (MiSwapReadAheadNext + 1) % MM_SWAP_READ_AHEAD_PAGES;
+
+        MiDropSwapReadAhead(ReadAhead);
+        ReadAhead->PageFileIndex = PageFileIndex;
+        ReadAhead->PageFileOffset = PageFileOffset + i;
+        ReadAhead->Page = Pages[i];
+    }
+
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
     return(Status);
 }
 
@@ -261,6 +639,8 @@ MmInitPagingFile(VOID)
     ULONG i;
 
     KeInitializeGuardedMutex(&MmPageFileCreationLock);
+    KeInitializeGuardedMutex(&MiSwapClusterLock);
+    KeInitializeEvent(&MiSwapClusterWritten, NotificationEvent, TRUE);
 
     MiFreeSwapPages = 0;
     MiUsedSwapPages = 0;
@@ -284,6 +664,11 @@ MmFreeSwapPage(SWAPENTRY Entry)
     i = FILE_FROM_ENTRY(Entry);
     off = OFFSET_FROM_ENTRY(Entry) - 1;
 
+    /* Forget what we read ahead for this slot */
+    KeAcquireGuardedMutex(&MiSwapClusterLock);
+    MiDropSwapReadAhead(MiFindSwapReadAhead(i, off));
+    KeReleaseGuardedMutex(&MiSwapClusterLock);
+
     KeAcquireGuardedMutex(&MmPageFileCreationLock);
 
     PagingFile = MmPagingFile[i];
@@ -292,7 +677,7 @@ MmFreeSwapPage(SWAPENTRY Entry)
         KeBugCheck(MEMORY_MANAGEMENT);
     }
 
-    RtlClearBit(PagingFile->Bitmap, off >> 5);
+    RtlClearBit(PagingFile->Bitmap, (ULONG)off);
 
     PagingFile->FreeSpace++;
     PagingFile->CurrentUsage--;
@@ -324,13 +709,21 @@ MmAllocSwapPage(VOID)
         if (MmPagingFile[i] != NULL &&
                 MmPagingFile[i]->FreeSpace >= 1)
         {
-            off = RtlFindClearBitsAndSet(MmPagingFile[i]->Bitmap, 1, 0);
+            /*
+             * Continue after the last slot we handed out, so that pages
+             * swapped out together get contiguous slots, and can be
+             * written and read back in clusters.
+             */
+            off = RtlFindClearBitsAndSet(MmPagingFile[i]->Bitmap, 1, MmPagingFile[i]->AllocationHint);
             if (off == 0xFFFFFFFF)
             {
                 KeBugCheck(MEMORY_MANAGEMENT);
                 KeReleaseGuardedMutex(&MmPageFileCreationLock);
                 return(STATUS_UNSUCCESSFUL);
             }
+            MmPagingFile[i]->AllocationHint = off + 1;
+            MmPagingFile[i]->FreeSpace--;
+            MmPagingFile[i]->CurrentUsage++;
             MiUsedSwapPages++;
             MiFreeSwapPages--;
             KeReleaseGuardedMutex(&MmPageFileCreationLock);
@@ -1094,6 +1094,7 @@
 @ stdcall RtlCreateUnicodeString(ptr wstr)
 @ stdcall RtlCustomCPToUnicodeN(ptr wstr long ptr ptr long)
 @ stdcall RtlDecompressBuffer(long ptr long ptr long ptr)
+@ stdcall RtlDecompressBufferEx(long ptr long ptr long ptr ptr)
 @ stdcall RtlDecompressChunks(ptr long ptr long ptr long ptr)
 @ stdcall RtlDecompressFragment(long ptr long ptr long long ptr ptr)
 @ stdcall RtlDelete(ptr)
@@ -20,8 +20,106 @@
 BOOLEAN ObpLUIDDeviceMapsEnabled;
 POBJECT_TYPE ObpDirectoryObjectType = NULL;
 
+/*
+ * Bucket counts a directory goes through as it fills up. They are all prime
+ * so that the name hash spreads evenly, and fit in the USHORT hash index of
+ * the lookup context.
+ */
+static const ULONG ObpDirectoryHashSizes[] =
+{
+    NUMBER_HASH_BUCKETS, 149, 599, 2399, 9601, 38431
+};
+
+/* Average chain length above which the bucket array is grown */
+#define OBP_DIRECTORY_MAX_LOAD  4
+
 /* PRIVATE FUNCTIONS ******************************************************/
 
+FORCEINLINE
+POBJECT_DIRECTORY_ENTRY *
+ObpGetDirectoryBuckets(IN POBJECT_DIRECTORY Directory)
+{
+    POBP_DIRECTORY_EXTENSION Extension = ObpGetDirectoryExtension(Directory);
+
+    /* Small directories use the embedded buckets */
+    return Extension->HashTable ? Extension->HashTable : Directory->HashBuckets;
+}
+
+FORCEINLINE
+ULONG
+ObpGetDirectoryBucketCount(IN POBJECT_DIRECTORY Directory)
+{
+    POBP_DIRECTORY_EXTENSION Extension = ObpGetDirectoryExtension(Directory);
+
+    return Extension->HashTable ? Extension->HashTableSize : NUMBER_HASH_BUCKETS;
+}
+
+/*++
+* @name ObpExpandDirectory
+*
+*     The ObpExpandDirectory routine moves the entries of a directory to a
+*     bucket array of the next larger size.
+*
+* @param Directory
+*        Directory to expand. Its lock must be held exclusively.
+*
+* @return None.
+*
+* @remarks The directory keeps its current buckets if the new array cannot
+*          be allocated or it already has the largest size.
+*
+*--*/
+static
+VOID
+ObpExpandDirectory(IN POBJECT_DIRECTORY Directory)
+{
+    POBP_DIRECTORY_EXTENSION Extension = ObpGetDirectoryExtension(Directory);
+    POBJECT_DIRECTORY_ENTRY *OldBuckets, *NewBuckets;
+    POBJECT_DIRECTORY_ENTRY CurrentEntry, NextEntry;
+    ULONG OldCount, NewCount, i;
+
+    /* Find the next size */
+    OldCount = ObpGetDirectoryBucketCount(Directory);
+    for (i = 0; i < RTL_NUMBER_OF(ObpDirectoryHashSizes); i++)
+    {
+        if (ObpDirectoryHashSizes[i] > OldCount) break;
+    }
+    if (i == RTL_NUMBER_OF(ObpDirectoryHashSizes)) return;
+    NewCount = ObpDirectoryHashSizes[i];
+
+    /* Allocate the new buckets */
+    NewBuckets = ExAllocatePoolWithTag(PagedPool,
+                                       NewCount * sizeof(POBJECT_DIRECTORY_ENTRY),
+                                       OB_DIR_TAG);
+    if (!NewBuckets) return;
+    RtlZeroMemory(NewBuckets, NewCount * sizeof(POBJECT_DIRECTORY_ENTRY));
+
+    /* Rehash every entry with the hash value saved at insertion */
+    OldBuckets = ObpGetDirectoryBuckets(Directory);
+    for (i = 0; i < OldCount; i++)
+    {
+        for (CurrentEntry = OldBuckets[i]; CurrentEntry; CurrentEntry = NextEntry)
+        {
+            NextEntry = CurrentEntry->ChainLink;
+            CurrentEntry->ChainLink = NewBuckets[CurrentEntry->HashValue % NewCount];
+            NewBuckets[CurrentEntry->HashValue % NewCount] = CurrentEntry;
+        }
+    }
+
+    /* Switch to the new buckets */
+    if (Extension->HashTable)
+    {
+        ExFreePoolWithTag(Extension->HashTable, OB_DIR_TAG);
+    }
+    else
+    {
+        RtlZeroMemory(Directory->HashBuckets, sizeof(Directory->HashBuckets));
+    }
+
+    Extension->HashTable = NewBuckets;
+    Extension->HashTableSize = NewCount;
+}
+
 /*++
 * @name ObpInsertEntryDirectory
 *
@@ -50,6 +148,7 @@ ObpInsertEntryDirectory(IN POBJECT_DIRECTORY Parent,
     POBJECT_DIRECTORY_ENTRY *AllocatedEntry;
     POBJECT_DIRECTORY_ENTRY NewEntry;
     POBJECT_HEADER_NAME_INFO HeaderNameInfo;
+    POBP_DIRECTORY_EXTENSION Extension;
 
     /* Make sure we have a name */
     ASSERT(ObjectHeader->NameInfoOffset != 0);
@@ -79,7 +178,8 @@ ObpInsertEntryDirectory(IN POBJECT_DIRECTORY Parent,
     HeaderNameInfo = OBJECT_HEADER_TO_NAME_INFO(ObjectHeader);
 
     /* Get the Allocated entry */
-    AllocatedEntry = &Parent->HashBuckets[Context->HashIndex];
+    ASSERT(Context->HashIndex == Context->HashValue % ObpGetDirectoryBucketCount(Parent));
+    AllocatedEntry = &ObpGetDirectoryBuckets(Parent)[Context->HashIndex];
 
     /* Set it */
     NewEntry->ChainLink = *AllocatedEntry;
@@ -90,6 +190,14 @@ ObpInsertEntryDirectory(IN POBJECT_DIRECTORY Parent,
 
     /* Associate the Directory */
     HeaderNameInfo->Directory = Parent;
+
+    /* Grow the buckets if the chains got too long */
+    Extension = ObpGetDirectoryExtension(Parent);
+    Extension->EntryCount++;
+    if (Extension->EntryCount > ObpGetDirectoryBucketCount(Parent) * OBP_DIRECTORY_MAX_LOAD)
+    {
+        ObpExpandDirectory(Parent);
+    }
     return TRUE;
 }
 
@@ -171,24 +279,24 @@ ObpLookupEntryDirectory(IN POBJECT_DIRECTORY Directory,
         else HashValue += (CurrentChar - ('a'-'A'));
     }
 
-    /* Merge it with our number of hash buckets */
-    HashIndex = HashValue % 37;
+    /* Check if the directory is already locked */
+    if (!Context->DirectoryLocked)
+    {
+        /* Lock it */
+        ObpAcquireDirectoryLockShared(Directory, Context);
+    }
+
+    /* Merge it with our number of hash buckets, which can only change under the lock */
+    HashIndex = HashValue % ObpGetDirectoryBucketCount(Directory);
 
     /* Save the result */
     Context->HashValue = HashValue;
     Context->HashIndex = (USHORT)HashIndex;
 
     /* Get the root entry and set it as our lookup bucket */
-    AllocatedEntry = &Directory->HashBuckets[HashIndex];
+    AllocatedEntry = &ObpGetDirectoryBuckets(Directory)[HashIndex];
     LookupBucket = AllocatedEntry;
 
-    /* Check if the directory is already locked */
-    if (!Context->DirectoryLocked)
-    {
-        /* Lock it */
-        ObpAcquireDirectoryLockShared(Directory, Context);
-    }
-
     /* Start looping */
     while ((CurrentEntry = *AllocatedEntry))
     {
@@ -318,12 +426,14 @@ ObpDeleteEntryDirectory(POBP_LOOKUP_CONTEXT Context)
     if (!Directory) return FALSE;
 
     /* Get the Entry */
-    AllocatedEntry = &Directory->HashBuckets[Context->HashIndex];
+    ASSERT(Context->HashIndex == Context->HashValue % ObpGetDirectoryBucketCount(Directory));
+    AllocatedEntry = &ObpGetDirectoryBuckets(Directory)[Context->HashIndex];
     CurrentEntry = *AllocatedEntry;
 
     /* Unlink the Entry */
     *AllocatedEntry = CurrentEntry->ChainLink;
     CurrentEntry->ChainLink = NULL;
+    ObpGetDirectoryExtension(Directory)->EntryCount--;
 
     /* Free it */
     ExFreePoolWithTag(CurrentEntry, OB_DIR_TAG);
@@ -332,6 +442,37 @@ ObpDeleteEntryDirectory(POBP_LOOKUP_CONTEXT Context)
     return TRUE;
 }
 
+/*++
+* @name ObpDeleteDirectory
+*
+*     The ObpDeleteDirectory routine is the delete procedure of directory
+*     objects and frees the bucket array the directory grew into.
+*
+* @param ObjectBody
+*        Directory being deleted.
+*
+* @return None.
+*
+* @remarks The directory is empty at this point, since every named object
+*          in it holds a reference to it.
+*
+*--*/
+VOID
+NTAPI
+ObpDeleteDirectory(IN PVOID ObjectBody)
+{
+    POBP_DIRECTORY_EXTENSION Extension = ObpGetDirectoryExtension(ObjectBody);
+
+    ASSERT(Extension->EntryCount == 0);
+
+    /* Free the grown buckets, if any */
+    if (Extension->HashTable)
+    {
+        ExFreePoolWithTag(Extension->HashTable, OB_DIR_TAG);
+        Extension->HashTable = NULL;
+    }
+}
+
 /* FUNCTIONS **************************************************************/
 
 /*++
@@ -544,10 +685,10 @@ NtQueryDirectoryObject(IN HANDLE DirectoryHandle,
 
     /* Set default status and start looping */
     Status = STATUS_NO_MORE_ENTRIES;
-    for (Hash = 0; Hash < 37; Hash++)
+    for (Hash = 0; Hash < ObpGetDirectoryBucketCount(Directory); Hash++)
     {
         /* Get this entry and loop all of them */
-        Entry = Directory->HashBuckets[Hash];
+        Entry = ObpGetDirectoryBuckets(Directory)[Hash];
         while (Entry)
         {
             /* Check if we should process this entry */
@@ -760,14 +901,15 @@ NtCreateDirectoryObject(OUT PHANDLE DirectoryHandle,
                             ObjectAttributes,
                             PreviousMode,
                             NULL,
-                            sizeof(OBJECT_DIRECTORY),
+                            sizeof(OBJECT_DIRECTORY) +
+                            sizeof(OBP_DIRECTORY_EXTENSION),
                             0,
                             0,
                             (PVOID*)&Directory);
     if (!NT_SUCCESS(Status)) return Status;
 
-    /* Setup the object */
-    RtlZeroMemory(Directory, sizeof(OBJECT_DIRECTORY));
+    /* Setup the object and the kernel-side state after it */
+    RtlZeroMemory(Directory, sizeof(OBJECT_DIRECTORY) + sizeof(OBP_DIRECTORY_EXTENSION));
     ExInitializePushLock(&Directory->Lock);
     Directory->SessionId = -1;
 
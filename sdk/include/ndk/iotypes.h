@@ -355,6 +355,14 @@ typedef enum _FSINFOCLASS
 
 #endif
 
+#if (NTDDI_VERSION < NTDDI_VISTA)
+//
+// Completion notification modes were also added to Windows 2003 SP2
+//
+#define FileIoCompletionNotificationInformation \
+    ((FILE_INFORMATION_CLASS)(FileShortNameInformation + 1))
+#endif
+
 //
 // Dock Profile Status
 //
@@ -595,6 +603,11 @@ typedef struct _FILE_COMPLETION_INFORMATION
     PVOID Key;
 } FILE_COMPLETION_INFORMATION, *PFILE_COMPLETION_INFORMATION;
 
+typedef struct _FILE_IO_COMPLETION_NOTIFICATION_INFORMATION
+{
+    ULONG Flags;
+} FILE_IO_COMPLETION_NOTIFICATION_INFORMATION, *PFILE_IO_COMPLETION_NOTIFICATION_INFORMATION;
+
 typedef struct _FILE_LINK_INFORMATION
 {
     BOOLEAN ReplaceIfExists;
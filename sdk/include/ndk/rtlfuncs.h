@@ -994,7 +994,7 @@ RtlLockHeap(
 
 _Must_inspect_result_
 NTSYSAPI
-NTSTATUS
+ULONG
 NTAPI
 RtlMultipleAllocateHeap (
     _In_ HANDLE HeapHandle,
@@ -1005,7 +1005,7 @@ RtlMultipleAllocateHeap (
     );
 
 NTSYSAPI
-NTSTATUS
+ULONG
 NTAPI
 RtlMultipleFreeHeap (
     _In_ HANDLE HeapHandle,
@@ -3155,6 +3155,20 @@ RtlDecompressBuffer(
     _Out_ PULONG FinalUncompressedSize
 );
 
+_IRQL_requires_max_(APC_LEVEL)
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlDecompressBufferEx(
+    _In_ USHORT CompressionFormat,
+    _Out_writes_bytes_to_(UncompressedBufferSize, *FinalUncompressedSize) PUCHAR UncompressedBuffer,
+    _In_ ULONG UncompressedBufferSize,
+    _In_reads_bytes_(CompressedBufferSize) PUCHAR CompressedBuffer,
+    _In_ ULONG CompressedBufferSize,
+    _Out_ PULONG FinalUncompressedSize,
+    _In_opt_ PVOID WorkSpace
+);
+
 NTSYSAPI
 NTSTATUS
 NTAPI
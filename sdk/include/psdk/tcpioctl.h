@@ -99,6 +99,11 @@
 
 /* TCP connection options */
 #define TCP_SOCKET_NODELAY 1
+#define TCP_SOCKET_WINDOW  6
+/* Non public option used to set SO_SNDBUF */
+#ifdef __REACTOS__
+#define TCP_SOCKET_SNDBUF  0x100
+#endif
 
 typedef struct IFEntry
 {
@@ -2828,6 +2828,25 @@ $endif (_NTIFS_)
 
 #endif /* (NTDDI_VERSION >= NTDDI_WIN7) */
 
+$if (_NTIFS_)
+#if (NTDDI_VERSION >= NTDDI_WIN8)
+
+_IRQL_requires_max_(APC_LEVEL)
+NTSYSAPI
+NTSTATUS
+NTAPI
+RtlDecompressBufferEx(
+  _In_ USHORT CompressionFormat,
+  _Out_writes_bytes_to_(UncompressedBufferSize, *FinalUncompressedSize) PUCHAR UncompressedBuffer,
+  _In_ ULONG UncompressedBufferSize,
+  _In_reads_bytes_(CompressedBufferSize) PUCHAR CompressedBuffer,
+  _In_ ULONG CompressedBufferSize,
+  _Out_ PULONG FinalUncompressedSize,
+  _In_opt_ PVOID WorkSpace);
+
+#endif /* (NTDDI_VERSION >= NTDDI_WIN8) */
+$endif (_NTIFS_)
+
 $if (_WDMDDK_)
 
 #if !defined(MIDL_PASS)
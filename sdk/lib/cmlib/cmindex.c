@@ -1150,8 +1150,10 @@ CmpSplitLeaf(IN PHHIVE Hive,
     /* Compute the total size */
     TotalSize = (EntrySize * LastHalf) + FIELD_OFFSET(CM_KEY_INDEX, List) + 1;
 
-    /* Mark the leaf cell dirty */
+    /* Mark the leaf cell dirty, this can move it out of a view of the file */
     HvMarkCellDirty(Hive, LeafCell, FALSE);
+    LeafKey = (PCM_KEY_INDEX)HvGetCell(Hive, LeafCell);
+    if (!LeafKey) return HCELL_NIL;
 
     /* Make sure its type is the same */
     ASSERT(HvGetCellType(LeafCell) == Type);
@@ -1593,8 +1595,14 @@ CmpAddSubKey(IN PHHIVE Hive,
         {
             DPRINT("Doing Fast->Slow Leaf conversion\n");
 
-            /* Mark this cell as dirty */
+            /* Mark this cell as dirty, and get it again from where it is now */
             HvMarkCellDirty(Hive, CellToRelease, FALSE);
+            Index = (PCM_KEY_INDEX)HvGetCell(Hive, CellToRelease);
+            if (!Index)
+            {
+                /* Not handled */
+                ASSERT(FALSE);
+            }
 
             /* Convert */
             OldIndex = (PCM_KEY_FAST_INDEX)Index;
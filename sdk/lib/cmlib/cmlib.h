@@ -375,6 +375,8 @@ HvInitialize(
     PFILE_WRITE_ROUTINE FileWrite,
     PFILE_READ_ROUTINE FileRead,
     PFILE_FLUSH_ROUTINE FileFlush,
+    PFILE_WRITE_GATHER_ROUTINE FileWriteGather OPTIONAL,
+    PFILE_MAP_VIEW_ROUTINE FileMapView OPTIONAL,
     ULONG Cluster OPTIONAL,
     PCUNICODE_STRING FileName OPTIONAL);
 
@@ -444,6 +446,10 @@ BOOLEAN CMAPI
 HvSyncHive(
    PHHIVE RegistryHive);
 
+BOOLEAN CMAPI
+HvReconcileHive(
+   PHHIVE RegistryHive);
+
 BOOLEAN CMAPI
 HvWriteHive(
    PHHIVE RegistryHive);
@@ -472,6 +478,36 @@ HvpAddBin(
    ULONG Size,
    HSTORAGE_TYPE Storage);
 
+BOOLEAN CMAPI
+HvpMapViewBins(
+   PHHIVE Hive,
+   PCM_VIEW_OF_FILE CmView);
+
+VOID CMAPI
+HvpUnmapViewBins(
+   PHHIVE Hive,
+   PCM_VIEW_OF_FILE CmView);
+
+BOOLEAN CMAPI
+HvpMapBin(
+   PHHIVE Hive,
+   ULONG BlockIndex);
+
+BOOLEAN CMAPI
+HvpCopyBinFromView(
+   PHHIVE Hive,
+   ULONG BlockIndex);
+
+PHBIN CMAPI
+HvpReadBin(
+   PHHIVE Hive,
+   ULONG BlockIndex);
+
+VOID CMAPI
+HvpInsertBin(
+   PHHIVE Hive,
+   PHBIN Bin);
+
 NTSTATUS CMAPI
 HvpCreateHiveFreeCellList(
    PHHIVE Hive);
@@ -480,6 +516,31 @@ ULONG CMAPI
 HvpHiveHeaderChecksum(
    PHBASE_BLOCK HiveHeader);
 
+typedef struct _HV_LOG_HASH
+{
+    ULONG Low;
+    ULONG High;
+} HV_LOG_HASH, *PHV_LOG_HASH;
+
+VOID CMAPI
+HvpLogHashInitialize(
+   PHV_LOG_HASH Hash);
+
+VOID CMAPI
+HvpLogHashUpdate(
+   PHV_LOG_HASH Hash,
+   PVOID Buffer,
+   ULONG Length);
+
+ULONGLONG CMAPI
+HvpLogHashFinish(
+   PHV_LOG_HASH Hash);
+
+BOOLEAN CMAPI
+HvpGrowLoggedVector(
+   PHHIVE RegistryHive,
+   ULONG BlockCount);
+
 
 /* Old-style Public "Cmlib" functions */
 
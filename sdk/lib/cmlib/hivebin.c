@@ -7,6 +7,8 @@
  */
 
 #include "cmlib.h"
+#define NDEBUG
+#include <debug.h>
 
 PHBIN CMAPI
 HvpAddBin(
@@ -63,6 +65,8 @@ HvpAddBin(
         RegistryHive->Storage[Storage].BlockList[OldBlockListSize + i].BlockAddress =
             ((ULONG_PTR)Bin + (i * HBLOCK_SIZE));
         RegistryHive->Storage[Storage].BlockList[OldBlockListSize + i].BinAddress = (ULONG_PTR)Bin;
+        RegistryHive->Storage[Storage].BlockList[OldBlockListSize + i].CmView = NULL;
+        RegistryHive->Storage[Storage].BlockList[OldBlockListSize + i].MemAlloc = (ULONG)BinSize;
     }
 
     /* Initialize a free block in this heap. */
@@ -105,3 +109,240 @@ HvpAddBin(
 
     return Bin;
 }
+
+/**
+ * @name HvpMapViewBins
+ *
+ * Internal function to let the bins that lie wholly in a view of the primary
+ * file be used in place. Bins already in pool or already mapped are left as
+ * they are. Called by the FileMapView routine with the view lock held.
+ */
+BOOLEAN CMAPI
+HvpMapViewBins(
+    IN PHHIVE Hive,
+    IN PCM_VIEW_OF_FILE CmView)
+{
+    PHMAP_ENTRY BlockList = Hive->Storage[Stable].BlockList;
+    ULONG BlockIndex, LastBlock, i;
+    PHBIN Bin;
+
+    /* The base block comes first in the file, the bins after it */
+    BlockIndex = CmView->FileOffset ? CmView->FileOffset / HBLOCK_SIZE - 1 : 0;
+    LastBlock = (CmView->FileOffset + CmView->Size) / HBLOCK_SIZE - 1;
+    if (LastBlock > Hive->Storage[Stable].Length)
+        LastBlock = Hive->Storage[Stable].Length;
+
+    while (BlockIndex < LastBlock)
+    {
+        /* A bin in pool may have started in the previous view */
+        if (BlockList[BlockIndex].MemAlloc != 0)
+        {
+            Bin = (PHBIN)BlockList[BlockIndex].BinAddress;
+            BlockIndex = (Bin->FileOffset + Bin->Size) / HBLOCK_SIZE;
+            continue;
+        }
+
+        Bin = (PHBIN)((ULONG_PTR)CmView->ViewAddress +
+                      HBLOCK_SIZE + BlockIndex * HBLOCK_SIZE - CmView->FileOffset);
+        if (Bin->Signature != HV_BIN_SIGNATURE ||
+            Bin->FileOffset != BlockIndex * HBLOCK_SIZE ||
+            Bin->Size == 0 ||
+            (Bin->Size % HBLOCK_SIZE) != 0 ||
+            Bin->Size / HBLOCK_SIZE > Hive->Storage[Stable].Length - BlockIndex)
+        {
+            DPRINT1("Invalid bin at BlockIndex %lu, Signature 0x%x, Size 0x%x\n",
+                    BlockIndex, (unsigned)Bin->Signature, (unsigned)Bin->Size);
+            return FALSE;
+        }
+
+        /* A bin that goes on in the next view has to be read into pool */
+        if (Bin->Size / HBLOCK_SIZE > LastBlock - BlockIndex)
+            break;
+
+        /* The block address goes last, it is what cell lookups check */
+        if (BlockList[BlockIndex].BlockAddress == 0)
+        {
+            for (i = 0; i < Bin->Size / HBLOCK_SIZE; i++)
+            {
+                BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)Bin;
+                BlockList[BlockIndex + i].CmView = CmView;
+                BlockList[BlockIndex + i].BlockAddress = (ULONG_PTR)Bin + i * HBLOCK_SIZE;
+            }
+        }
+
+        BlockIndex += Bin->Size / HBLOCK_SIZE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * @name HvpUnmapViewBins
+ *
+ * Internal function to forget the bins that were used from a view that is
+ * about to be unmapped. They are mapped again on their next lookup.
+ */
+VOID CMAPI
+HvpUnmapViewBins(
+    IN PHHIVE Hive,
+    IN PCM_VIEW_OF_FILE CmView)
+{
+    PHMAP_ENTRY BlockList = Hive->Storage[Stable].BlockList;
+    ULONG BlockIndex, LastBlock;
+
+    BlockIndex = CmView->FileOffset ? CmView->FileOffset / HBLOCK_SIZE - 1 : 0;
+    LastBlock = (CmView->FileOffset + CmView->Size) / HBLOCK_SIZE - 1;
+    if (LastBlock > Hive->Storage[Stable].Length)
+        LastBlock = Hive->Storage[Stable].Length;
+
+    for (; BlockIndex < LastBlock; BlockIndex++)
+    {
+        if (BlockList[BlockIndex].CmView != CmView)
+            continue;
+
+        BlockList[BlockIndex].BlockAddress = 0;
+        BlockList[BlockIndex].BinAddress = 0;
+        BlockList[BlockIndex].CmView = NULL;
+    }
+}
+
+/**
+ * @name HvpMapBin
+ *
+ * Internal function to make sure the bin holding a stable block can be
+ * accessed, mapping its view of the primary file if needed.
+ */
+BOOLEAN CMAPI
+HvpMapBin(
+    IN PHHIVE Hive,
+    IN ULONG BlockIndex)
+{
+    PHMAP_ENTRY Entry = &Hive->Storage[Stable].BlockList[BlockIndex];
+
+    if (Entry->BlockAddress != 0)
+        return TRUE;
+
+    if (Hive->FileMapView == NULL ||
+        !Hive->FileMapView(Hive, BlockIndex))
+    {
+        DPRINT1("Failed to map block %lu of hive %p\n", BlockIndex, Hive);
+        return FALSE;
+    }
+
+    return Entry->BlockAddress != 0;
+}
+
+/**
+ * @name HvpCopyBinFromView
+ *
+ * Internal function to move a bin that is used from a view of the primary
+ * file into pool, before anything in it is changed. Cache views are only
+ * mapped for reading, and the primary must not see changes before the log.
+ */
+BOOLEAN CMAPI
+HvpCopyBinFromView(
+    IN PHHIVE Hive,
+    IN ULONG BlockIndex)
+{
+    PHMAP_ENTRY BlockList = Hive->Storage[Stable].BlockList;
+    PHBIN Bin, NewBin;
+
+    if (Hive->FileMapView == NULL || BlockList[BlockIndex].MemAlloc != 0)
+        return TRUE;
+
+    if (!HvpMapBin(Hive, BlockIndex))
+        return FALSE;
+
+    Bin = (PHBIN)BlockList[BlockIndex].BinAddress;
+    NewBin = Hive->Allocate(Bin->Size, TRUE, TAG_CM);
+    if (NewBin == NULL)
+    {
+        DPRINT1("No memory to copy bin 0x%x of hive %p\n", (unsigned)Bin->FileOffset, Hive);
+        return FALSE;
+    }
+
+    RtlCopyMemory(NewBin, Bin, Bin->Size);
+
+    /* The view stays usable until MemAlloc shows the bin is in pool */
+    HvpInsertBin(Hive, NewBin);
+
+    return TRUE;
+}
+
+/**
+ * @name HvpReadBin
+ *
+ * Internal function to read the bin holding a stable block from the primary
+ * file into pool, for when its view cannot be mapped. The bin is not put in
+ * the block list, see HvpInsertBin.
+ */
+PHBIN CMAPI
+HvpReadBin(
+    IN PHHIVE Hive,
+    IN ULONG BlockIndex)
+{
+    HBIN BinHeader;
+    PHBIN Bin;
+    ULONG Block, Offset;
+
+    /* Look back for the header of the bin, the block may be in its middle */
+    for (Block = BlockIndex + 1; Block-- > 0; )
+    {
+        Offset = HBLOCK_SIZE + Block * HBLOCK_SIZE;
+        if (!Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &Offset, &BinHeader, sizeof(HBIN)))
+            return NULL;
+
+        if (BinHeader.Signature == HV_BIN_SIGNATURE &&
+            BinHeader.FileOffset == Block * HBLOCK_SIZE)
+        {
+            break;
+        }
+    }
+
+    if (Block == (ULONG)-1 ||
+        BinHeader.Size == 0 ||
+        (BinHeader.Size % HBLOCK_SIZE) != 0 ||
+        Block + BinHeader.Size / HBLOCK_SIZE <= BlockIndex ||
+        Block + BinHeader.Size / HBLOCK_SIZE > Hive->Storage[Stable].Length)
+    {
+        DPRINT1("No valid bin holds block %lu of hive %p\n", BlockIndex, Hive);
+        return NULL;
+    }
+
+    Bin = Hive->Allocate(BinHeader.Size, TRUE, TAG_CM);
+    if (Bin == NULL)
+        return NULL;
+
+    Offset = HBLOCK_SIZE + Block * HBLOCK_SIZE;
+    if (!Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &Offset, Bin, BinHeader.Size))
+    {
+        Hive->Free(Bin, 0);
+        return NULL;
+    }
+
+    return Bin;
+}
+
+/**
+ * @name HvpInsertBin
+ *
+ * Internal function to use a bin in pool for all of its blocks. When lookups
+ * can run at the same time, the caller holds the view lock.
+ */
+VOID CMAPI
+HvpInsertBin(
+    IN PHHIVE Hive,
+    IN PHBIN Bin)
+{
+    PHMAP_ENTRY BlockList = Hive->Storage[Stable].BlockList;
+    ULONG BlockIndex, i;
+
+    BlockIndex = Bin->FileOffset / HBLOCK_SIZE;
+    for (i = 0; i < Bin->Size / HBLOCK_SIZE; i++)
+    {
+        BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)Bin;
+        BlockList[BlockIndex + i].CmView = NULL;
+        BlockList[BlockIndex + i].BlockAddress = (ULONG_PTR)Bin + i * HBLOCK_SIZE;
+        BlockList[BlockIndex + i].MemAlloc = Bin->Size;
+    }
+}
@@ -28,7 +28,22 @@ HvpGetCellHeader(
 
         ASSERT(CellBlock < RegistryHive->Storage[CellType].Length);
         Block = (PVOID)RegistryHive->Storage[CellType].BlockList[CellBlock].BlockAddress;
-        ASSERT(Block != NULL);
+        if (Block == NULL)
+        {
+            /*
+             * The bin is in a view of the primary file that is not mapped.
+             * Callers rely on valid cells being there, and FileMapView reads
+             * the bin into pool when the view cannot be mapped, so failing
+             * here means the file itself cannot be read anymore.
+             */
+            ASSERT(CellType == Stable);
+            if (!HvpMapBin(RegistryHive, CellBlock))
+            {
+                KeBugCheckEx(REGISTRY_ERROR, 3, 1, (ULONG_PTR)RegistryHive, CellIndex);
+            }
+
+            Block = (PVOID)RegistryHive->Storage[Stable].BlockList[CellBlock].BlockAddress;
+        }
         return (PVOID)((ULONG_PTR)Block + CellOffset);
     }
     else
@@ -59,6 +74,11 @@ HvIsCellAllocated(IN PHHIVE RegistryHive,
     if (RegistryHive->Storage[Type].BlockList[Block].BlockAddress)
         return TRUE;
 
+    /* Bins that are not in pool are in the primary file */
+    if (RegistryHive->FileMapView &&
+        RegistryHive->Storage[Type].BlockList[Block].MemAlloc == 0)
+        return TRUE;
+
     /* No valid block, fail */
     return FALSE;
 }
@@ -68,8 +88,11 @@ HvGetCell(
     PHHIVE RegistryHive,
     HCELL_INDEX CellIndex)
 {
+    PHCELL CellHeader;
+
     ASSERT(CellIndex != HCELL_NIL);
-    return (PVOID)(HvpGetCellHeader(RegistryHive, CellIndex) + 1);
+    CellHeader = HvpGetCellHeader(RegistryHive, CellIndex);
+    return (PVOID)(CellHeader + 1);
 }
 
 static __inline LONG CMAPI
@@ -116,6 +139,10 @@ HvMarkCellDirty(
     CellBlock     = HvGetCellBlock(CellIndex);
     CellLastBlock = HvGetCellBlock(CellIndex + HBLOCK_SIZE - 1);
 
+    /* Cells are changed right after this, they cannot stay in a view */
+    if (!HvpCopyBinFromView(RegistryHive, CellBlock))
+        return FALSE;
+
     RtlSetBits(&RegistryHive->DirtyVector,
                CellBlock, CellLastBlock - CellBlock);
     RegistryHive->DirtyCount++;
@@ -453,15 +480,22 @@ HvFreeCell(
     CMLTRACE(CMLIB_HCELL_DEBUG, "%s - Hive %p, CellIndex %08lx\n",
              __FUNCTION__, RegistryHive, CellIndex);
 
+    CellType = HvGetCellType(CellIndex);
+    CellBlock = HvGetCellBlock(CellIndex);
+
+    /* The free lists are kept in the free cells, so the bin has to be in pool */
+    if (CellType == Stable && !HvpCopyBinFromView(RegistryHive, CellBlock))
+    {
+        DPRINT1("Cell %08lx of hive %p is leaked\n", CellIndex, RegistryHive);
+        return;
+    }
+
     Free = HvpGetCellHeader(RegistryHive, CellIndex);
 
     ASSERT(Free->Size < 0);
 
     Free->Size = -Free->Size;
 
-    CellType = HvGetCellType(CellIndex);
-    CellBlock = HvGetCellBlock(CellIndex);
-
     /* FIXME: Merge free blocks */
     Bin = (PHBIN)RegistryHive->Storage[CellType].BlockList[CellBlock].BinAddress;
 
@@ -45,6 +45,7 @@
 #define HV_LOG_HEADER_SIZE              FIELD_OFFSET(HBASE_BLOCK, Reserved2)
 #define HV_SIGNATURE                    0x66676572  // "regf"
 #define HV_BIN_SIGNATURE                0x6e696268  // "hbin"
+#define HV_LOG_ENTRY_SIGNATURE          0x454c7648  // "HvLE"
 
 //
 // Hive versions
@@ -185,6 +186,51 @@ typedef struct _HCELL
     LONG Size;
 } HCELL, *PHCELL;
 
+/**
+ * @name HV_LOG_ENTRY
+ *
+ * On-disk header of an entry of the hive log file. The log starts with the
+ * first HV_LOG_HEADER_SIZE bytes of the base block, then each sync appends
+ * one entry: this header, DirtyPageCount HV_LOG_DIRTY_PAGE references, the
+ * data of these pages, and padding up to a multiple of the sector size.
+ */
+typedef struct _HV_LOG_ENTRY
+{
+    /* Entry identifier "HvLE" (0x454C7648) */
+    ULONG Signature;
+
+    /* Size in bytes of the whole entry, multiple of the sector size */
+    ULONG Size;
+
+    ULONG Flags;
+
+    /* Update counter, the first entry has the one of the log header */
+    ULONG Sequence;
+
+    /* Size in bytes of the hive, minus the header, when the entry was written */
+    ULONG HiveLength;
+
+    /* Number of page references following this header */
+    ULONG DirtyPageCount;
+
+    /* Hash of the rest of the entry, after this header */
+    ULONGLONG Hash1;
+
+    /* Hash of the header up to this field */
+    ULONGLONG Hash2;
+} HV_LOG_ENTRY, *PHV_LOG_ENTRY;
+
+C_ASSERT(sizeof(HV_LOG_ENTRY) == 40);
+
+typedef struct _HV_LOG_DIRTY_PAGE
+{
+    /* Offset in bytes from the byte after the end of the base block */
+    ULONG Offset;
+
+    /* Size in bytes of the run of pages, multiple of the block size (4KB) */
+    ULONG Size;
+} HV_LOG_DIRTY_PAGE, *PHV_LOG_DIRTY_PAGE;
+
 #include <poppack.h>
 
 struct _HHIVE;
@@ -232,6 +278,35 @@ typedef BOOLEAN
     SIZE_T BufferLength
 );
 
+//
+// A piece of a gathered write. Consecutive segments may be contiguous in the
+// file while their buffers are not, because bins are allocated separately.
+//
+typedef struct _HV_WRITE_SEGMENT
+{
+    ULONG FileOffset;
+    ULONG Length;
+    PVOID Buffer;
+} HV_WRITE_SEGMENT, *PHV_WRITE_SEGMENT;
+
+typedef BOOLEAN
+(CMAPI *PFILE_WRITE_GATHER_ROUTINE)(
+    struct _HHIVE *RegistryHive,
+    ULONG FileType,
+    PHV_WRITE_SEGMENT Segments,
+    ULONG SegmentCount
+);
+
+//
+// Maps the view of the primary file that holds BlockIndex and, with the view
+// lock held, gives it to HvpMapViewBins. Returns FALSE if it cannot be mapped.
+//
+typedef BOOLEAN
+(CMAPI *PFILE_MAP_VIEW_ROUTINE)(
+    struct _HHIVE *RegistryHive,
+    ULONG BlockIndex
+);
+
 typedef BOOLEAN
 (CMAPI *PFILE_SET_SIZE_ROUTINE)(
     struct _HHIVE *RegistryHive,
@@ -288,6 +363,8 @@ typedef struct _HHIVE
     PFILE_WRITE_ROUTINE FileWrite;
     PFILE_READ_ROUTINE FileRead;
     PFILE_FLUSH_ROUTINE FileFlush;
+    PFILE_WRITE_GATHER_ROUTINE FileWriteGather;
+    PFILE_MAP_VIEW_ROUTINE FileMapView;
 #if (NTDDI_VERSION >= NTDDI_WIN7)
     PVOID HiveLoadFailure; // PHIVE_LOAD_FAILURE
 #endif
@@ -320,6 +397,12 @@ typedef struct _HHIVE
     ULONG StorageTypeCount;
     ULONG Version;
     DUAL Storage[HTYPE_COUNT];
+
+    /* ReactOS: append-only log state, see hivewrt.c */
+    BOOLEAN LogEnabled;
+    ULONG LogOffset;
+    ULONG LogSequence;
+    RTL_BITMAP LoggedVector;
 } HHIVE, *PHHIVE;
 
 #define IsFreeCell(Cell)    ((Cell)->Size >= 0)
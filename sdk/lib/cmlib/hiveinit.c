@@ -67,7 +67,10 @@ HvpFreeHiveBins(
             if (Hive->Storage[Storage].BlockList[i].BinAddress != (ULONG_PTR)Bin)
             {
                 Bin = (PHBIN)Hive->Storage[Storage].BlockList[i].BinAddress;
-                Hive->Free((PHBIN)Hive->Storage[Storage].BlockList[i].BinAddress, 0);
+
+                /* Bins in a view of the file go away with the view */
+                if (Hive->Storage[Storage].BlockList[i].CmView == NULL)
+                    Hive->Free(Bin, 0);
             }
             Hive->Storage[Storage].BlockList[i].BinAddress = (ULONG_PTR)NULL;
             Hive->Storage[Storage].BlockList[i].BlockAddress = (ULONG_PTR)NULL;
@@ -288,19 +291,15 @@ HvpInitializeMemoryHive(
             return STATUS_NO_MEMORY;
         }
 
-        Hive->Storage[Stable].BlockList[BlockIndex].BinAddress = (ULONG_PTR)NewBin;
-        Hive->Storage[Stable].BlockList[BlockIndex].BlockAddress = (ULONG_PTR)NewBin;
-
         RtlCopyMemory(NewBin, Bin, Bin->Size);
 
-        if (Bin->Size > HBLOCK_SIZE)
+        for (i = 0; i < Bin->Size / HBLOCK_SIZE; i++)
         {
-            for (i = 1; i < Bin->Size / HBLOCK_SIZE; i++)
-            {
-                Hive->Storage[Stable].BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)NewBin;
-                Hive->Storage[Stable].BlockList[BlockIndex + i].BlockAddress =
-                    ((ULONG_PTR)NewBin + (i * HBLOCK_SIZE));
-            }
+            Hive->Storage[Stable].BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)NewBin;
+            Hive->Storage[Stable].BlockList[BlockIndex + i].BlockAddress =
+                ((ULONG_PTR)NewBin + (i * HBLOCK_SIZE));
+            Hive->Storage[Stable].BlockList[BlockIndex + i].CmView = NULL;
+            Hive->Storage[Stable].BlockList[BlockIndex + i].MemAlloc = Bin->Size;
         }
 
         BlockIndex += Bin->Size / HBLOCK_SIZE;
@@ -403,7 +402,25 @@ HvpGetHiveHeader(IN PHHIVE Hive,
     if (!Result) return NotHive;
 
     /* Do validation */
-    if (!HvpVerifyHiveHeader(BaseBlock)) return NotHive;
+    if (!HvpVerifyHiveHeader(BaseBlock))
+    {
+        /*
+         * A write of the hive file that did not complete leaves only the
+         * update counters apart. The log may still have what it was missing.
+         */
+        if (BaseBlock->Signature != HV_SIGNATURE ||
+            BaseBlock->Type != HFILE_TYPE_PRIMARY ||
+            BaseBlock->Format != HBASE_FORMAT_MEMORY ||
+            BaseBlock->Sequence1 == BaseBlock->Sequence2 ||
+            HvpHiveHeaderChecksum(BaseBlock) != BaseBlock->CheckSum)
+        {
+            return NotHive;
+        }
+
+        *HiveBaseBlock = BaseBlock;
+        *TimeStamp = BaseBlock->TimeStamp;
+        return RecoverData;
+    }
 
     /* Return information */
     *HiveBaseBlock = BaseBlock;
@@ -411,6 +428,349 @@ HvpGetHiveHeader(IN PHHIVE Hive,
     return HiveSuccess;
 }
 
+/**
+ * @name HvpReadLogHeader
+ *
+ * Internal function to check that the log file was started for the current
+ * contents of the primary, and to get the update counter of its first entry.
+ */
+static RESULT CMAPI
+HvpReadLogHeader(
+    IN PHHIVE Hive,
+    IN PHBASE_BLOCK BaseBlock,
+    OUT PULONG Sequence)
+{
+    PHBASE_BLOCK LogHeader;
+    ULONG Offset = 0;
+    BOOLEAN Valid;
+
+    LogHeader = Hive->Allocate(sizeof(HBASE_BLOCK), TRUE, TAG_CM);
+    if (!LogHeader) return NoMemory;
+
+    /* Read the log header, a missing or short log leaves it zeroed */
+    RtlZeroMemory(LogHeader, sizeof(HBASE_BLOCK));
+    Valid = Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset,
+                           LogHeader, HV_LOG_HEADER_SIZE) &&
+            LogHeader->Signature == HV_SIGNATURE &&
+            LogHeader->Type == HFILE_TYPE_LOG &&
+            LogHeader->Sequence1 == LogHeader->Sequence2 &&
+            LogHeader->Sequence2 == BaseBlock->Sequence2 &&
+            HvpHiveHeaderChecksum(LogHeader) == LogHeader->CheckSum;
+    *Sequence = LogHeader->Sequence2;
+    Hive->Free(LogHeader, 0);
+
+    /* The log is older than the primary, there is nothing to replay */
+    return Valid ? HiveSuccess : Fail;
+}
+
+/**
+ * @name HvpReplayLog
+ *
+ * Internal function to apply the entries of the log file to a hive read from
+ * its primary file. The log only belongs to the primary if it was started
+ * with the same update counter, and the replay stops at the first entry that
+ * is torn or out of sequence. The blocks replayed are marked as logged, so
+ * they are written to the primary the next time the hive is reconciled.
+ */
+static RESULT CMAPI
+HvpReplayLog(
+    IN PHHIVE Hive,
+    IN OUT PHBASE_BLOCK *HiveData,
+    IN OUT PULONG FileSize)
+{
+    PHBASE_BLOCK BaseBlock = *HiveData;
+    HV_LOG_ENTRY Entry;
+    PHV_LOG_DIRTY_PAGE DirtyPages;
+    HV_LOG_HASH Hash;
+    PUCHAR Buffer, Data, NewData;
+    ULONG Offset, EntryOffset, Sequence;
+    ULONG DataSize, EntryCount, i;
+    BOOLEAN Valid;
+    RESULT Result;
+
+    Result = HvpReadLogHeader(Hive, BaseBlock, &Sequence);
+    if (Result != HiveSuccess) return Result;
+
+    EntryOffset = HV_LOG_HEADER_SIZE;
+    for (EntryCount = 0; ; EntryCount++, Sequence++)
+    {
+        /* Check the entry header on its own first */
+        RtlZeroMemory(&Entry, sizeof(HV_LOG_ENTRY));
+        Offset = EntryOffset;
+        if (!Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset, &Entry, sizeof(HV_LOG_ENTRY)) ||
+            Entry.Signature != HV_LOG_ENTRY_SIGNATURE ||
+            Entry.Sequence != Sequence ||
+            Entry.Size < sizeof(HV_LOG_ENTRY) ||
+            (Entry.Size % HSECTOR_SIZE) != 0 ||
+            (Entry.HiveLength % HBLOCK_SIZE) != 0 ||
+            Entry.DirtyPageCount > (Entry.Size - sizeof(HV_LOG_ENTRY)) / sizeof(HV_LOG_DIRTY_PAGE))
+        {
+            break;
+        }
+
+        HvpLogHashInitialize(&Hash);
+        HvpLogHashUpdate(&Hash, &Entry, FIELD_OFFSET(HV_LOG_ENTRY, Hash2));
+        if (HvpLogHashFinish(&Hash) != Entry.Hash2) break;
+
+        /* Now read and check the whole entry */
+        Buffer = Hive->Allocate(Entry.Size, TRUE, TAG_CM);
+        if (!Buffer) return NoMemory;
+
+        RtlZeroMemory(Buffer, Entry.Size);
+        Offset = EntryOffset;
+        Valid = Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset, Buffer, Entry.Size);
+        if (Valid)
+        {
+            HvpLogHashInitialize(&Hash);
+            HvpLogHashUpdate(&Hash, Buffer + sizeof(HV_LOG_ENTRY),
+                             Entry.Size - sizeof(HV_LOG_ENTRY));
+            Valid = (HvpLogHashFinish(&Hash) == Entry.Hash1);
+        }
+
+        /* The page references must fit in the entry and in the hive */
+        DirtyPages = (PHV_LOG_DIRTY_PAGE)(Buffer + sizeof(HV_LOG_ENTRY));
+        Data = (PUCHAR)(DirtyPages + Entry.DirtyPageCount);
+        DataSize = Entry.Size - (ULONG)(Data - Buffer);
+        for (i = 0; Valid && i < Entry.DirtyPageCount; i++)
+        {
+            Valid = (DirtyPages[i].Offset % HBLOCK_SIZE) == 0 &&
+                    (DirtyPages[i].Size % HBLOCK_SIZE) == 0 &&
+                    DirtyPages[i].Offset < Entry.HiveLength &&
+                    DirtyPages[i].Size <= Entry.HiveLength - DirtyPages[i].Offset &&
+                    DirtyPages[i].Size <= DataSize;
+            DataSize -= DirtyPages[i].Size;
+        }
+
+        if (!Valid)
+        {
+            Hive->Free(Buffer, 0);
+            break;
+        }
+
+        /* The hive grew since the primary was written */
+        if (Entry.HiveLength > BaseBlock->Length)
+        {
+            NewData = Hive->Allocate(HBLOCK_SIZE + Entry.HiveLength, TRUE, TAG_CM);
+            if (!NewData)
+            {
+                Hive->Free(Buffer, 0);
+                return NoMemory;
+            }
+
+            RtlCopyMemory(NewData, *HiveData, *FileSize);
+            RtlZeroMemory(NewData + *FileSize, HBLOCK_SIZE + Entry.HiveLength - *FileSize);
+            Hive->Free(*HiveData, *FileSize);
+
+            *HiveData = BaseBlock = (PHBASE_BLOCK)NewData;
+            *FileSize = HBLOCK_SIZE + Entry.HiveLength;
+            BaseBlock->Length = Entry.HiveLength;
+        }
+
+        if (!HvpGrowLoggedVector(Hive, Entry.HiveLength / HBLOCK_SIZE))
+        {
+            Hive->Free(Buffer, 0);
+            return NoMemory;
+        }
+
+        /* Apply the pages */
+        for (i = 0; i < Entry.DirtyPageCount; i++)
+        {
+            RtlCopyMemory((PUCHAR)BaseBlock + HBLOCK_SIZE + DirtyPages[i].Offset,
+                          Data, DirtyPages[i].Size);
+            RtlSetBits(&Hive->LoggedVector,
+                       DirtyPages[i].Offset / HBLOCK_SIZE,
+                       DirtyPages[i].Size / HBLOCK_SIZE);
+            Data += DirtyPages[i].Size;
+        }
+
+        Hive->Free(Buffer, 0);
+        EntryOffset += Entry.Size;
+    }
+
+    if (EntryCount != 0)
+    {
+        DPRINT1("Replayed %lu log entries\n", EntryCount);
+    }
+
+    /* Go on appending to this log */
+    Hive->LogOffset = EntryOffset;
+    Hive->LogSequence = Sequence;
+    return HiveSuccess;
+}
+
+/**
+ * @name HvpLogHasEntries
+ *
+ * Internal function to check whether the log file has anything to replay on
+ * top of the primary. Only the header of the first entry is looked at, the
+ * replay does the full validation.
+ */
+static BOOLEAN CMAPI
+HvpLogHasEntries(
+    IN PHHIVE Hive,
+    IN PHBASE_BLOCK BaseBlock)
+{
+    HV_LOG_ENTRY Entry;
+    ULONG Offset, Sequence;
+    RESULT Result;
+
+    /* Let the replay fail on its own if we are out of memory */
+    Result = HvpReadLogHeader(Hive, BaseBlock, &Sequence);
+    if (Result == NoMemory) return TRUE;
+    if (Result != HiveSuccess) return FALSE;
+
+    RtlZeroMemory(&Entry, sizeof(HV_LOG_ENTRY));
+    Offset = HV_LOG_HEADER_SIZE;
+    return Hive->FileRead(Hive, HFILE_TYPE_LOG, &Offset, &Entry, sizeof(HV_LOG_ENTRY)) &&
+           Entry.Signature == HV_LOG_ENTRY_SIGNATURE &&
+           Entry.Sequence == Sequence;
+}
+
+/**
+ * @name HvpBinHasFreeCells
+ *
+ * Internal function to check whether a bin has any free cell in it.
+ */
+static BOOLEAN CMAPI
+HvpBinHasFreeCells(
+    IN PHBIN Bin)
+{
+    PHCELL Cell;
+    ULONG Offset;
+
+    for (Offset = sizeof(HBIN); Offset < Bin->Size; Offset -= Cell->Size)
+    {
+        Cell = (PHCELL)((ULONG_PTR)Bin + Offset);
+        if (Cell->Size >= 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/**
+ * @name HvpInitializeMappedHive
+ *
+ * Internal function to initialize hive descriptor structure for a hive whose
+ * primary file is up to date. The bins are left in the views of the file,
+ * which the caller can unmap once the hive is loaded. Bins with free cells
+ * and bins that do not fit in a view are read into memory.
+ */
+static NTSTATUS CMAPI
+HvpInitializeMappedHive(
+    IN PHHIVE Hive,
+    IN PCUNICODE_STRING FileName OPTIONAL)
+{
+    PHBASE_BLOCK BaseBlock = Hive->BaseBlock;
+    PHMAP_ENTRY BlockList;
+    HBIN BinHeader;
+    PHBIN Bin;
+    ULONG BlockIndex, BlockCount, Offset, i;
+    ULONG BitmapSize;
+    PULONG BitmapBuffer;
+
+    if ((BaseBlock->Length % HBLOCK_SIZE) != 0)
+    {
+        DPRINT1("Registry is corrupt: hive length 0x%x\n", BaseBlock->Length);
+        return STATUS_REGISTRY_CORRUPT;
+    }
+
+    BlockCount = BaseBlock->Length / HBLOCK_SIZE;
+    BlockList = Hive->Allocate(BlockCount * sizeof(HMAP_ENTRY), FALSE, TAG_CM);
+    if (BlockList == NULL)
+    {
+        DPRINT1("Allocating block list failed\n");
+        return STATUS_NO_MEMORY;
+    }
+
+    /* Blocks not filled in yet are skipped by HvpFreeHiveBins */
+    RtlZeroMemory(BlockList, BlockCount * sizeof(HMAP_ENTRY));
+    Hive->Storage[Stable].BlockList = BlockList;
+    Hive->Storage[Stable].Length = BlockCount;
+
+    for (BlockIndex = 0; BlockIndex < BlockCount; BlockIndex += Bin->Size / HBLOCK_SIZE)
+    {
+        /* Mapping the view fills in the bins that lie wholly in it */
+        if (BlockList[BlockIndex].BlockAddress == 0)
+            Hive->FileMapView(Hive, BlockIndex);
+
+        Bin = (PHBIN)BlockList[BlockIndex].BinAddress;
+        if (Bin == NULL)
+        {
+            /* Not mapped, or it goes on in the next view: read it like before */
+            Offset = HBLOCK_SIZE + BlockIndex * HBLOCK_SIZE;
+            if (!Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &Offset, &BinHeader, sizeof(HBIN)))
+                BinHeader.Signature = 0;
+
+            if (BinHeader.Signature != HV_BIN_SIGNATURE ||
+                BinHeader.Size == 0 ||
+                (BinHeader.Size % HBLOCK_SIZE) != 0 ||
+                BinHeader.Size / HBLOCK_SIZE > BlockCount - BlockIndex)
+            {
+                DPRINT1("Invalid bin at BlockIndex %lu, Signature 0x%x, Size 0x%x\n",
+                        BlockIndex, (unsigned)BinHeader.Signature, (unsigned)BinHeader.Size);
+                HvpFreeHiveBins(Hive);
+                return STATUS_REGISTRY_CORRUPT;
+            }
+
+            Bin = Hive->Allocate(BinHeader.Size, TRUE, TAG_CM);
+            if (Bin == NULL)
+            {
+                HvpFreeHiveBins(Hive);
+                return STATUS_NO_MEMORY;
+            }
+
+            Offset = HBLOCK_SIZE + BlockIndex * HBLOCK_SIZE;
+            if (!Hive->FileRead(Hive, HFILE_TYPE_PRIMARY, &Offset, Bin, BinHeader.Size))
+            {
+                Hive->Free(Bin, 0);
+                HvpFreeHiveBins(Hive);
+                return STATUS_NOT_REGISTRY_FILE;
+            }
+
+            for (i = 0; i < BinHeader.Size / HBLOCK_SIZE; i++)
+            {
+                BlockList[BlockIndex + i].BinAddress = (ULONG_PTR)Bin;
+                BlockList[BlockIndex + i].BlockAddress = (ULONG_PTR)Bin + i * HBLOCK_SIZE;
+                BlockList[BlockIndex + i].CmView = NULL;
+                BlockList[BlockIndex + i].MemAlloc = BinHeader.Size;
+            }
+        }
+        else if (HvpBinHasFreeCells(Bin))
+        {
+            /* The free lists are linked through the free cells */
+            if (!HvpCopyBinFromView(Hive, BlockIndex))
+            {
+                HvpFreeHiveBins(Hive);
+                return STATUS_NO_MEMORY;
+            }
+
+            Bin = (PHBIN)BlockList[BlockIndex].BinAddress;
+        }
+    }
+
+    if (HvpCreateHiveFreeCellList(Hive))
+    {
+        HvpFreeHiveBins(Hive);
+        return STATUS_NO_MEMORY;
+    }
+
+    BitmapSize = ROUND_UP(BlockCount, sizeof(ULONG) * 8) / 8;
+    BitmapBuffer = (PULONG)Hive->Allocate(BitmapSize, TRUE, TAG_CM);
+    if (BitmapBuffer == NULL)
+    {
+        HvpFreeHiveBins(Hive);
+        return STATUS_NO_MEMORY;
+    }
+
+    RtlInitializeBitMap(&Hive->DirtyVector, BitmapBuffer, BitmapSize * 8);
+    RtlClearAllBits(&Hive->DirtyVector);
+
+    HvpInitFileName(BaseBlock, FileName);
+
+    return STATUS_SUCCESS;
+}
+
 NTSTATUS CMAPI
 HvLoadHive(IN PHHIVE Hive,
            IN PCUNICODE_STRING FileName OPTIONAL)
@@ -441,6 +801,13 @@ HvLoadHive(IN PHHIVE Hive,
 
         /* Has recovery data */
         case RecoverData:
+
+            /* Only the log can complete the hive file */
+            if (Hive->LogEnabled) break;
+
+            Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+            return STATUS_REGISTRY_CORRUPT;
+
         case RecoverHeader:
 
             /* Fail */
@@ -454,6 +821,21 @@ HvLoadHive(IN PHHIVE Hive,
     Hive->BaseBlock = BaseBlock;
     Hive->Version = BaseBlock->Minor;
 
+    /*
+     * A primary file that is up to date is used in place, through views of
+     * the file. Only one that the log has to complete is read as a whole.
+     */
+    if (Hive->FileMapView &&
+        Result == HiveSuccess &&
+        !(Hive->LogEnabled && HvpLogHasEntries(Hive, BaseBlock)))
+    {
+        Status = HvpInitializeMappedHive(Hive, FileName);
+        if (!NT_SUCCESS(Status))
+            Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+
+        return Status;
+    }
+
     /* Allocate a buffer large enough to hold the hive */
     FileSize = HBLOCK_SIZE + BaseBlock->Length; // == sizeof(HBASE_BLOCK) + BaseBlock->Length;
     HiveData = Hive->Allocate(FileSize, TRUE, TAG_CM);
@@ -476,15 +858,47 @@ HvLoadHive(IN PHHIVE Hive,
         return STATUS_NOT_REGISTRY_FILE;
     }
 
+    /* Bring the hive up to date with its log */
+    if (Hive->LogEnabled)
+    {
+        Result = HvpReplayLog(Hive, (PHBASE_BLOCK*)&HiveData, &FileSize);
+        if (Result == HiveSuccess)
+        {
+            /* The primary is complete now, as far as this hive goes */
+            ((PHBASE_BLOCK)HiveData)->Sequence1 = ((PHBASE_BLOCK)HiveData)->Sequence2;
+            ((PHBASE_BLOCK)HiveData)->CheckSum = HvpHiveHeaderChecksum(HiveData);
+        }
+        else if (Result == NoMemory || BaseBlock->Sequence1 != BaseBlock->Sequence2)
+        {
+            if (Hive->LoggedVector.Buffer)
+            {
+                Hive->Free(Hive->LoggedVector.Buffer, 0);
+                RtlInitializeBitMap(&Hive->LoggedVector, NULL, 0);
+            }
+
+            Hive->Free(HiveData, FileSize);
+            Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
+            return (Result == NoMemory) ? STATUS_INSUFFICIENT_RESOURCES :
+                                          STATUS_REGISTRY_CORRUPT;
+        }
+    }
+
     // This is a HACK!
     /* Free our base block... it's usless in this implementation */
     Hive->Free(BaseBlock, Hive->BaseBlockAlloc);
 
-    /* Initialize the hive directly from memory */
+    /* Initialize the hive from memory, it keeps its own copy of the data */
     Status = HvpInitializeMemoryHive(Hive, HiveData, FileName);
     if (!NT_SUCCESS(Status))
-        Hive->Free(HiveData, FileSize);
+    {
+        if (Hive->LoggedVector.Buffer)
+        {
+            Hive->Free(Hive->LoggedVector.Buffer, 0);
+            RtlInitializeBitMap(&Hive->LoggedVector, NULL, 0);
+        }
+    }
 
+    Hive->Free(HiveData, FileSize);
     return Status;
 }
 
@@ -531,6 +945,8 @@ HvInitialize(
     PFILE_WRITE_ROUTINE FileWrite,
     PFILE_READ_ROUTINE FileRead,
     PFILE_FLUSH_ROUTINE FileFlush,
+    PFILE_WRITE_GATHER_ROUTINE FileWriteGather OPTIONAL,
+    PFILE_MAP_VIEW_ROUTINE FileMapView OPTIONAL,
     ULONG Cluster OPTIONAL,
     PCUNICODE_STRING FileName OPTIONAL)
 {
@@ -549,6 +965,8 @@ HvInitialize(
     Hive->FileWrite = FileWrite;
     Hive->FileRead = FileRead;
     Hive->FileFlush = FileFlush;
+    Hive->FileWriteGather = FileWriteGather;
+    Hive->FileMapView = FileMapView;
 
     Hive->RefreshCount = 0;
     Hive->StorageTypeCount = HTYPE_COUNT;
@@ -577,6 +995,9 @@ HvInitialize(
 
         case HINIT_FILE:
         {
+            /* Only hives loaded from their file get their log replayed */
+            Hive->LogEnabled = (FileType == HFILE_TYPE_LOG);
+
             Status = HvLoadHive(Hive, FileName);
             if ((Status != STATUS_SUCCESS) &&
                 (Status != STATUS_REGISTRY_RECOVERED))
@@ -630,6 +1051,12 @@ HvFree(
             RegistryHive->Free(RegistryHive->DirtyVector.Buffer, 0);
         }
 
+        /* Release log bitmap */
+        if (RegistryHive->LoggedVector.Buffer)
+        {
+            RegistryHive->Free(RegistryHive->LoggedVector.Buffer, 0);
+        }
+
         HvpFreeHiveBins(RegistryHive);
 
         /* Free the BaseBlock */
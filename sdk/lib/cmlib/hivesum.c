@@ -30,3 +30,81 @@ HvpHiveHeaderChecksum(
 
     return Sum;
 }
+
+/*
+ * Log entries are hashed with Marvin32, seeded with a fixed value. The data
+ * is always a multiple of 4 bytes long, so it can be hashed piecewise.
+ */
+#define HV_LOG_HASH_SEED    0x82EF4D887A4E55C5ULL
+
+#define HvpRotateLeft(Value, Count) \
+    (((Value) << (Count)) | ((Value) >> (32 - (Count))))
+
+static VOID
+HvpLogHashBlock(
+    PHV_LOG_HASH Hash)
+{
+    Hash->High ^= Hash->Low;
+    Hash->Low = HvpRotateLeft(Hash->Low, 20);
+    Hash->Low += Hash->High;
+    Hash->High = HvpRotateLeft(Hash->High, 9);
+    Hash->High ^= Hash->Low;
+    Hash->Low = HvpRotateLeft(Hash->Low, 27);
+    Hash->Low += Hash->High;
+    Hash->High = HvpRotateLeft(Hash->High, 19);
+}
+
+/**
+ * @name HvpLogHashInitialize
+ *
+ * Start the hash of a log entry.
+ */
+
+VOID CMAPI
+HvpLogHashInitialize(
+    PHV_LOG_HASH Hash)
+{
+    Hash->Low = (ULONG)HV_LOG_HASH_SEED;
+    Hash->High = (ULONG)(HV_LOG_HASH_SEED >> 32);
+}
+
+/**
+ * @name HvpLogHashUpdate
+ *
+ * Add data to the hash of a log entry. Length must be a multiple of 4.
+ */
+
+VOID CMAPI
+HvpLogHashUpdate(
+    PHV_LOG_HASH Hash,
+    PVOID Buffer,
+    ULONG Length)
+{
+    PULONG Data = (PULONG)Buffer;
+    ULONG i;
+
+    ASSERT((Length % sizeof(ULONG)) == 0);
+
+    for (i = 0; i < Length / sizeof(ULONG); i++)
+    {
+        Hash->Low += Data[i];
+        HvpLogHashBlock(Hash);
+    }
+}
+
+/**
+ * @name HvpLogHashFinish
+ *
+ * Complete the hash of a log entry and return it.
+ */
+
+ULONGLONG CMAPI
+HvpLogHashFinish(
+    PHV_LOG_HASH Hash)
+{
+    Hash->Low += 0x80;
+    HvpLogHashBlock(Hash);
+    HvpLogHashBlock(Hash);
+
+    return ((ULONGLONG)Hash->High << 32) | Hash->Low;
+}
@@ -9,135 +9,337 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Number of segments gathered before they are handed to the file routines */
+#define HV_WRITE_BATCH_SEGMENTS 32
+
+/* Size the log grows to before the logged blocks are written to the hive file */
+#define HV_LOG_RECONCILE_SIZE   (1024 * 1024)
+
+typedef struct _HV_WRITE_BATCH
+{
+    PHHIVE RegistryHive;
+    ULONG FileType;
+    ULONG Count;
+    HV_WRITE_SEGMENT Segments[HV_WRITE_BATCH_SEGMENTS];
+} HV_WRITE_BATCH, *PHV_WRITE_BATCH;
+
 static BOOLEAN CMAPI
-HvpWriteLog(
-    PHHIVE RegistryHive)
+HvpFlushWriteBatch(
+    PHV_WRITE_BATCH Batch)
 {
+    PHHIVE RegistryHive = Batch->RegistryHive;
     ULONG FileOffset;
-    UINT32 BufferSize;
-    UINT32 BitmapSize;
-    PUCHAR Buffer;
-    PUCHAR Ptr;
-    ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
-    BOOLEAN Success;
-    static ULONG PrintCount = 0;
+    ULONG i;
 
-    if (PrintCount++ == 0)
+    if (Batch->Count == 0)
     {
-        UNIMPLEMENTED;
+        return TRUE;
     }
+
+    /* Hand the whole batch over at once if the hive can take it */
+    if (RegistryHive->FileWriteGather)
+    {
+        if (!RegistryHive->FileWriteGather(RegistryHive, Batch->FileType,
+                                           Batch->Segments, Batch->Count))
+        {
+            return FALSE;
+        }
+    }
+    else
+    {
+        for (i = 0; i < Batch->Count; i++)
+        {
+            FileOffset = Batch->Segments[i].FileOffset;
+            if (!RegistryHive->FileWrite(RegistryHive, Batch->FileType, &FileOffset,
+                                         Batch->Segments[i].Buffer,
+                                         Batch->Segments[i].Length))
+            {
+                return FALSE;
+            }
+        }
+    }
+
+    Batch->Count = 0;
     return TRUE;
+}
 
-    ASSERT(RegistryHive->ReadOnly == FALSE);
-    ASSERT(RegistryHive->BaseBlock->Length ==
-           RegistryHive->Storage[Stable].Length * HBLOCK_SIZE);
+static BOOLEAN CMAPI
+HvpQueueWrite(
+    PHV_WRITE_BATCH Batch,
+    ULONG FileOffset,
+    PVOID Buffer,
+    ULONG Length)
+{
+    PHV_WRITE_SEGMENT Segment;
 
-    DPRINT("HvpWriteLog called\n");
+    /* Extend the last segment if this one follows it both in the file and in memory */
+    if (Batch->Count != 0)
+    {
+        Segment = &Batch->Segments[Batch->Count - 1];
+        if (Segment->FileOffset + Segment->Length == FileOffset &&
+            (PUCHAR)Segment->Buffer + Segment->Length == Buffer)
+        {
+            Segment->Length += Length;
+            return TRUE;
+        }
+    }
 
-    if (RegistryHive->BaseBlock->Sequence1 !=
-        RegistryHive->BaseBlock->Sequence2)
+    if (Batch->Count == HV_WRITE_BATCH_SEGMENTS && !HvpFlushWriteBatch(Batch))
     {
         return FALSE;
     }
 
-    BitmapSize = RegistryHive->DirtyVector.SizeOfBitMap;
-    BufferSize = HV_LOG_HEADER_SIZE + sizeof(ULONG) + BitmapSize;
-    BufferSize = ROUND_UP(BufferSize, HBLOCK_SIZE);
+    Segment = &Batch->Segments[Batch->Count++];
+    Segment->FileOffset = FileOffset;
+    Segment->Length = Length;
+    Segment->Buffer = Buffer;
+    return TRUE;
+}
+
+BOOLEAN CMAPI
+HvpGrowLoggedVector(
+    PHHIVE RegistryHive,
+    ULONG BlockCount)
+{
+    PULONG BitmapBuffer;
+    ULONG BitmapSize;
 
-    DPRINT("Bitmap size %u  buffer size: %u\n", BitmapSize, BufferSize);
+    /* Calculate bitmap size in bytes (always a multiple of 32 bits). */
+    BitmapSize = ROUND_UP(BlockCount, sizeof(ULONG) * 8) / 8;
+    if (BitmapSize <= RegistryHive->LoggedVector.SizeOfBitMap / 8)
+    {
+        return TRUE;
+    }
 
-    Buffer = RegistryHive->Allocate(BufferSize, TRUE, TAG_CM);
-    if (Buffer == NULL)
+    BitmapBuffer = RegistryHive->Allocate(BitmapSize, TRUE, TAG_CM);
+    if (BitmapBuffer == NULL)
     {
         return FALSE;
     }
 
-    /* Update first update counter and CheckSum */
-    RegistryHive->BaseBlock->Type = HFILE_TYPE_LOG;
-    RegistryHive->BaseBlock->Sequence1++;
-    RegistryHive->BaseBlock->CheckSum =
-        HvpHiveHeaderChecksum(RegistryHive->BaseBlock);
+    RtlZeroMemory(BitmapBuffer, BitmapSize);
+    if (RegistryHive->LoggedVector.SizeOfBitMap > 0)
+    {
+        RtlCopyMemory(BitmapBuffer,
+                      RegistryHive->LoggedVector.Buffer,
+                      RegistryHive->LoggedVector.SizeOfBitMap / 8);
+        RegistryHive->Free(RegistryHive->LoggedVector.Buffer, 0);
+    }
+    RtlInitializeBitMap(&RegistryHive->LoggedVector, BitmapBuffer,
+                        BitmapSize * 8);
+
+    return TRUE;
+}
+
+static BOOLEAN CMAPI
+HvpStartLog(
+    PHHIVE RegistryHive)
+{
+    PHBASE_BLOCK LogHeader;
+    ULONG FileOffset;
+    BOOLEAN Success;
+
+    if (RegistryHive->BaseBlock->Sequence1 !=
+        RegistryHive->BaseBlock->Sequence2)
+    {
+        return FALSE;
+    }
+
+    /* The log header is the start of the base block, tagged as a log */
+    LogHeader = RegistryHive->Allocate(HV_LOG_HEADER_SIZE, TRUE, TAG_CM);
+    if (LogHeader == NULL)
+    {
+        return FALSE;
+    }
 
-    /* Copy hive header */
-    RtlCopyMemory(Buffer, RegistryHive->BaseBlock, HV_LOG_HEADER_SIZE);
-    Ptr = Buffer + HV_LOG_HEADER_SIZE;
-    RtlCopyMemory(Ptr, "DIRT", 4);
-    Ptr += 4;
-    RtlCopyMemory(Ptr, RegistryHive->DirtyVector.Buffer, BitmapSize);
+    RtlCopyMemory(LogHeader, RegistryHive->BaseBlock, HV_LOG_HEADER_SIZE);
+    LogHeader->Type = HFILE_TYPE_LOG;
+    LogHeader->CheckSum = HvpHiveHeaderChecksum(LogHeader);
 
-    /* Write hive block and block bitmap */
+    /*
+     * Write it and cut the entries of the previous log on their own, before
+     * any new entry, so that none of them can ever be taken for ours.
+     */
     FileOffset = 0;
     Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                      &FileOffset, Buffer, BufferSize);
-    RegistryHive->Free(Buffer, 0);
+                                      &FileOffset, LogHeader,
+                                      HV_LOG_HEADER_SIZE);
+    RegistryHive->Free(LogHeader, 0);
 
-    if (!Success)
+    if (!Success ||
+        !RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG,
+                                   HV_LOG_HEADER_SIZE, HV_LOG_HEADER_SIZE) ||
+        !RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0))
     {
+        DPRINT1("Failed to start the log\n");
         return FALSE;
     }
 
-    /* Write dirty blocks */
-    FileOffset = BufferSize;
-    BlockIndex = 0;
-    while (BlockIndex < RegistryHive->Storage[Stable].Length)
+    RegistryHive->LogOffset = HV_LOG_HEADER_SIZE;
+    RegistryHive->LogSequence = RegistryHive->BaseBlock->Sequence2;
+    return TRUE;
+}
+
+static BOOLEAN CMAPI
+HvpWriteLog(
+    PHHIVE RegistryHive)
+{
+    ULONG FileOffset;
+    ULONG BlockCount;
+    ULONG BlockIndex;
+    ULONG DirtyPageCount;
+    ULONG HeaderSize;
+    ULONG BufferSize;
+    ULONG PaddingSize;
+    ULONG EntrySize;
+    ULONG i;
+    PUCHAR Buffer;
+    PHV_LOG_ENTRY Entry;
+    PHV_LOG_DIRTY_PAGE DirtyPages;
+    PVOID BlockPtr;
+    PULONG LoggedBits;
+    PULONG DirtyBits;
+    HV_LOG_HASH Hash;
+    HV_WRITE_BATCH Batch;
+    BOOLEAN Success;
+
+    ASSERT(RegistryHive->ReadOnly == FALSE);
+    ASSERT(RegistryHive->BaseBlock->Length ==
+           RegistryHive->Storage[Stable].Length * HBLOCK_SIZE);
+
+    DPRINT("HvpWriteLog called\n");
+
+    BlockCount = RegistryHive->Storage[Stable].Length;
+    if (!HvpGrowLoggedVector(RegistryHive, RegistryHive->DirtyVector.SizeOfBitMap))
     {
-        LastIndex = BlockIndex;
-        BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-        if (BlockIndex == ~0U || BlockIndex < LastIndex)
+        return FALSE;
+    }
+
+    /* Nothing was logged since the primary was last written, start over */
+    if (RegistryHive->LogOffset == 0 && !HvpStartLog(RegistryHive))
+    {
+        return FALSE;
+    }
+
+    /* Each run of dirty blocks gets one page reference */
+    DirtyPageCount = 0;
+    for (BlockIndex = 0; BlockIndex < BlockCount; BlockIndex++)
+    {
+        if (RtlCheckBit(&RegistryHive->DirtyVector, BlockIndex) &&
+            (BlockIndex == 0 || !RtlCheckBit(&RegistryHive->DirtyVector, BlockIndex - 1)))
         {
-            break;
+            DirtyPageCount++;
         }
+    }
 
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
+    /* The padding of the entry is written from the end of the same buffer */
+    HeaderSize = sizeof(HV_LOG_ENTRY) + DirtyPageCount * sizeof(HV_LOG_DIRTY_PAGE);
+    BufferSize = ROUND_UP(HeaderSize, HSECTOR_SIZE);
+    PaddingSize = BufferSize - HeaderSize;
 
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                         &FileOffset, BlockPtr, HBLOCK_SIZE);
-        if (!Success)
+    Buffer = RegistryHive->Allocate(BufferSize, TRUE, TAG_CM);
+    if (Buffer == NULL)
+    {
+        return FALSE;
+    }
+    RtlZeroMemory(Buffer, BufferSize);
+
+    Entry = (PHV_LOG_ENTRY)Buffer;
+    DirtyPages = (PHV_LOG_DIRTY_PAGE)(Entry + 1);
+
+    i = 0;
+    EntrySize = BufferSize;
+    for (BlockIndex = 0; BlockIndex < BlockCount; BlockIndex++)
+    {
+        if (!RtlCheckBit(&RegistryHive->DirtyVector, BlockIndex))
+            continue;
+
+        if (BlockIndex == 0 || !RtlCheckBit(&RegistryHive->DirtyVector, BlockIndex - 1))
         {
-            return FALSE;
+            DirtyPages[i].Offset = BlockIndex * HBLOCK_SIZE;
+            DirtyPages[i].Size = 0;
+            i++;
         }
+        DirtyPages[i - 1].Size += HBLOCK_SIZE;
+        EntrySize += HBLOCK_SIZE;
+    }
 
-        BlockIndex++;
+    Entry->Signature = HV_LOG_ENTRY_SIGNATURE;
+    Entry->Size = EntrySize;
+    Entry->Flags = 0;
+    Entry->Sequence = RegistryHive->LogSequence;
+    Entry->HiveLength = BlockCount * HBLOCK_SIZE;
+    Entry->DirtyPageCount = DirtyPageCount;
+
+    /* Hash the entry the way it is laid out in the file */
+    HvpLogHashInitialize(&Hash);
+    HvpLogHashUpdate(&Hash, DirtyPages, HeaderSize - sizeof(HV_LOG_ENTRY));
+    for (BlockIndex = 0; BlockIndex < BlockCount; BlockIndex++)
+    {
+        if (RtlCheckBit(&RegistryHive->DirtyVector, BlockIndex))
+        {
+            BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
+            HvpLogHashUpdate(&Hash, BlockPtr, HBLOCK_SIZE);
+        }
+    }
+    HvpLogHashUpdate(&Hash, Buffer + HeaderSize, PaddingSize);
+    Entry->Hash1 = HvpLogHashFinish(&Hash);
+
+    HvpLogHashInitialize(&Hash);
+    HvpLogHashUpdate(&Hash, Entry, FIELD_OFFSET(HV_LOG_ENTRY, Hash2));
+    Entry->Hash2 = HvpLogHashFinish(&Hash);
+
+    /*
+     * Queue the entry: the header, the dirty blocks straight from the bins,
+     * then the padding. It is all contiguous in the file.
+     */
+    Batch.RegistryHive = RegistryHive;
+    Batch.FileType = HFILE_TYPE_LOG;
+    Batch.Count = 0;
+
+    FileOffset = RegistryHive->LogOffset;
+    Success = HvpQueueWrite(&Batch, FileOffset, Buffer, HeaderSize);
+    FileOffset += HeaderSize;
+
+    for (BlockIndex = 0; Success && BlockIndex < BlockCount; BlockIndex++)
+    {
+        if (!RtlCheckBit(&RegistryHive->DirtyVector, BlockIndex))
+            continue;
+
+        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
+        Success = HvpQueueWrite(&Batch, FileOffset, BlockPtr, HBLOCK_SIZE);
         FileOffset += HBLOCK_SIZE;
     }
 
-    Success = RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG, FileOffset, FileOffset);
-    if (!Success)
+    if (Success && PaddingSize != 0)
     {
-        DPRINT("FileSetSize failed\n");
-        return FALSE;
+        Success = HvpQueueWrite(&Batch, FileOffset, Buffer + HeaderSize, PaddingSize);
     }
 
-    /* Flush the log file */
-    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0);
-    if (!Success)
+    /* Write what is left */
+    if (Success)
     {
-        DPRINT("FileFlush failed\n");
+        Success = HvpFlushWriteBatch(&Batch);
     }
+    RegistryHive->Free(Buffer, 0);
 
-    /* Update second update counter and CheckSum */
-    RegistryHive->BaseBlock->Sequence2++;
-    RegistryHive->BaseBlock->CheckSum =
-        HvpHiveHeaderChecksum(RegistryHive->BaseBlock);
-
-    /* Write hive header again with updated sequence counter. */
-    FileOffset = 0;
-    Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                      &FileOffset, RegistryHive->BaseBlock,
-                                      HV_LOG_HEADER_SIZE);
-    if (!Success)
+    /* The blocks are only safe once the log is on the disk */
+    if (!Success ||
+        !RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0))
     {
+        DPRINT1("Failed to write the log\n");
         return FALSE;
     }
 
-    /* Flush the log file */
-    Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_LOG, NULL, 0);
-    if (!Success)
+    RegistryHive->LogOffset += EntrySize;
+    RegistryHive->LogSequence++;
+
+    /* The dirty blocks are now logged, they only miss from the primary */
+    LoggedBits = RegistryHive->LoggedVector.Buffer;
+    DirtyBits = RegistryHive->DirtyVector.Buffer;
+    for (i = 0; i < RegistryHive->DirtyVector.SizeOfBitMap / 32; i++)
     {
-        DPRINT("FileFlush failed\n");
+        LoggedBits[i] |= DirtyBits[i];
     }
 
     return TRUE;
@@ -146,13 +348,14 @@ HvpWriteLog(
 static BOOLEAN CMAPI
 HvpWriteHive(
     PHHIVE RegistryHive,
-    BOOLEAN OnlyDirty)
+    PRTL_BITMAP BlockVector OPTIONAL)
 {
     ULONG FileOffset;
     ULONG BlockIndex;
     ULONG LastIndex;
     PVOID BlockPtr;
     BOOLEAN Success;
+    HV_WRITE_BATCH Batch;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
     ASSERT(RegistryHive->BaseBlock->Length ==
@@ -182,26 +385,39 @@ HvpWriteHive(
         return FALSE;
     }
 
+    /*
+     * Queue the blocks to write. Runs of blocks that are contiguous both in
+     * the file and in memory become a single segment, and the segments are
+     * written in batches instead of one block at a time.
+     */
+    Batch.RegistryHive = RegistryHive;
+    Batch.FileType = HFILE_TYPE_PRIMARY;
+    Batch.Count = 0;
+
     BlockIndex = 0;
     while (BlockIndex < RegistryHive->Storage[Stable].Length)
     {
-        if (OnlyDirty)
+        if (BlockVector)
         {
             LastIndex = BlockIndex;
-            BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
+            BlockIndex = RtlFindSetBits(BlockVector, 1, BlockIndex);
             if (BlockIndex == ~0U || BlockIndex < LastIndex)
             {
                 break;
             }
         }
 
+        /* Clean blocks may not be mapped, dirty ones are always in pool */
+        if (!HvpMapBin(RegistryHive, BlockIndex))
+        {
+            return FALSE;
+        }
+
         BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
         FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
 
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
-                                          &FileOffset, BlockPtr, HBLOCK_SIZE);
-        if (!Success)
+        /* Queue hive block */
+        if (!HvpQueueWrite(&Batch, FileOffset, BlockPtr, HBLOCK_SIZE))
         {
             return FALSE;
         }
@@ -209,6 +425,12 @@ HvpWriteHive(
         BlockIndex++;
     }
 
+    /* Write what is left */
+    if (!HvpFlushWriteBatch(&Batch))
+    {
+        return FALSE;
+    }
+
     Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
     if (!Success)
     {
@@ -239,39 +461,100 @@ HvpWriteHive(
     return TRUE;
 }
 
-BOOLEAN CMAPI
-HvSyncHive(
-    PHHIVE RegistryHive)
+static BOOLEAN CMAPI
+HvpSyncHive(
+    PHHIVE RegistryHive,
+    BOOLEAN Reconcile)
 {
     ASSERT(RegistryHive->ReadOnly == FALSE);
 
     if (RtlFindSetBits(&RegistryHive->DirtyVector, 1, 0) == ~0U)
     {
-        return TRUE;
+        /* Nothing new, but the logged blocks may still have to be written */
+        if (!Reconcile || !RegistryHive->LogEnabled ||
+            RtlFindSetBits(&RegistryHive->LoggedVector, 1, 0) == ~0U)
+        {
+            return TRUE;
+        }
     }
+    else
+    {
+        /* Update hive header modification time */
+        KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
 
-    /* Update hive header modification time */
-    KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
+        /* Without a log to replay, the dirty blocks go to the hive file at once */
+        if (!RegistryHive->LogEnabled)
+        {
+            if (!HvpWriteHive(RegistryHive, &RegistryHive->DirtyVector))
+            {
+                return FALSE;
+            }
 
-    /* Update log file */
-    if (!HvpWriteLog(RegistryHive))
-    {
-        return FALSE;
+            /* Clear dirty bitmap. */
+            RtlClearAllBits(&RegistryHive->DirtyVector);
+            RegistryHive->DirtyCount = 0;
+
+            return TRUE;
+        }
+
+        /* Append the dirty blocks to the log file */
+        if (!HvpWriteLog(RegistryHive))
+        {
+            return FALSE;
+        }
+
+        /* Clear dirty bitmap. */
+        RtlClearAllBits(&RegistryHive->DirtyVector);
+        RegistryHive->DirtyCount = 0;
+
+        /* Leave the hive file alone until the log has grown enough */
+        if (!Reconcile && RegistryHive->LogOffset < HV_LOG_RECONCILE_SIZE)
+        {
+            return TRUE;
+        }
     }
 
-    /* Update hive file */
-    if (!HvpWriteHive(RegistryHive, TRUE))
+    /* Update hive file with all that was logged, in one pass */
+    if (!HvpWriteHive(RegistryHive, &RegistryHive->LoggedVector))
     {
         return FALSE;
     }
 
-    /* Clear dirty bitmap. */
-    RtlClearAllBits(&RegistryHive->DirtyVector);
-    RegistryHive->DirtyCount = 0;
+    /* The log is not needed anymore, the next sync starts a new one */
+    RtlClearAllBits(&RegistryHive->LoggedVector);
+    RegistryHive->LogOffset = 0;
 
     return TRUE;
 }
 
+/**
+ * @name HvSyncHive
+ *
+ * Make the dirty blocks of a hive safe on the disk. When the hive has a log,
+ * they are appended to it and the hive file itself is only written once the
+ * log gets large; a crash in between is recovered by HvLoadHive.
+ */
+BOOLEAN CMAPI
+HvSyncHive(
+    PHHIVE RegistryHive)
+{
+    return HvpSyncHive(RegistryHive, FALSE);
+}
+
+/**
+ * @name HvReconcileHive
+ *
+ * Like HvSyncHive, but also write everything the log holds to the hive file,
+ * so that the file is complete without its log. Used before the hive goes
+ * away, as other readers of the file do not replay the log.
+ */
+BOOLEAN CMAPI
+HvReconcileHive(
+    PHHIVE RegistryHive)
+{
+    return HvpSyncHive(RegistryHive, TRUE);
+}
+
 BOOLEAN
 CMAPI
 HvHiveWillShrink(IN PHHIVE RegistryHive)
@@ -291,10 +574,14 @@ HvWriteHive(
     KeQuerySystemTime(&RegistryHive->BaseBlock->TimeStamp);
 
     /* Update hive file */
-    if (!HvpWriteHive(RegistryHive, FALSE))
+    if (!HvpWriteHive(RegistryHive, NULL))
     {
         return FALSE;
     }
 
+    /* Nothing the log holds is missing from the hive file anymore */
+    RtlClearAllBits(&RegistryHive->LoggedVector);
+    RegistryHive->LogOffset = 0;
+
     return TRUE;
 }
@@ -0,0 +1,437 @@
+/*
+ * PROJECT:   Registry manipulation library
+ * LICENSE:   GPL - See COPYING in the top level directory
+ * PURPOSE:   Host test for replaying the hive log after a crash
+ * COPYRIGHT: Copyright 2026 ReactOS Team
+ */
+
+#ifndef CMLIB_HOST
+#define CMLIB_HOST
+#endif
+#include <cmlib.h>
+#include <stdlib.h>
+
+#ifdef _MSC_VER
+#include <io.h>
+#define TestTruncate(File, Size) (_chsize(_fileno(File), (long)(Size)) == 0)
+#else
+#include <unistd.h>
+#define TestTruncate(File, Size) (ftruncate(fileno(File), (off_t)(Size)) == 0)
+#endif
+
+/* The hive and the files behind it, the callbacks find the files from the hive */
+typedef struct _TEST_HIVE
+{
+    HHIVE Hive;
+    FILE *Files[HFILE_TYPE_MAX];
+} TEST_HIVE, *PTEST_HIVE;
+
+/* The stable storage of a hive at some point */
+typedef struct _TEST_SNAPSHOT
+{
+    ULONG Length;
+    PUCHAR Blocks;
+} TEST_SNAPSHOT, *PTEST_SNAPSHOT;
+
+static ULONG Failures;
+
+#define ok(Condition, ...) \
+    do { if (!(Condition)) { Failures++; printf(__VA_ARGS__); } } while (0)
+
+PVOID CMAPI
+CmpAllocate(
+    IN SIZE_T Size,
+    IN BOOLEAN Paged,
+    IN ULONG Tag)
+{
+    return calloc(1, Size);
+}
+
+VOID CMAPI
+CmpFree(
+    IN PVOID Ptr,
+    IN ULONG Quota)
+{
+    free(Ptr);
+}
+
+static BOOLEAN CMAPI
+TestFileRead(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PULONG FileOffset,
+    OUT PVOID Buffer,
+    IN SIZE_T BufferLength)
+{
+    FILE *File = ((PTEST_HIVE)RegistryHive)->Files[FileType];
+
+    return (fseek(File, *FileOffset, SEEK_SET) == 0 &&
+            fread(Buffer, 1, BufferLength, File) == BufferLength);
+}
+
+static BOOLEAN CMAPI
+TestFileWrite(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PULONG FileOffset,
+    IN PVOID Buffer,
+    IN SIZE_T BufferLength)
+{
+    FILE *File = ((PTEST_HIVE)RegistryHive)->Files[FileType];
+
+    return (fseek(File, *FileOffset, SEEK_SET) == 0 &&
+            fwrite(Buffer, 1, BufferLength, File) == BufferLength);
+}
+
+static BOOLEAN CMAPI
+TestFileSetSize(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN ULONG FileSize,
+    IN ULONG OldFileSize)
+{
+    FILE *File = ((PTEST_HIVE)RegistryHive)->Files[FileType];
+
+    return (fflush(File) == 0 && TestTruncate(File, FileSize));
+}
+
+static BOOLEAN CMAPI
+TestFileFlush(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    PLARGE_INTEGER FileOffset,
+    ULONG Length)
+{
+    return (fflush(((PTEST_HIVE)RegistryHive)->Files[FileType]) == 0);
+}
+
+static long
+FileSize(
+    IN FILE *File)
+{
+    fflush(File);
+    fseek(File, 0, SEEK_END);
+    return ftell(File);
+}
+
+/* Copies a file, stopping at Size bytes if that comes first */
+static FILE *
+CopyFile(
+    IN FILE *Source,
+    IN long Size)
+{
+    FILE *File = tmpfile();
+    char Buffer[4096];
+    long Length = min(Size, FileSize(Source));
+    size_t Chunk;
+
+    fseek(Source, 0, SEEK_SET);
+    while (Length > 0)
+    {
+        Chunk = fread(Buffer, 1, min(Length, (long)sizeof(Buffer)), Source);
+        if (!Chunk) break;
+        fwrite(Buffer, 1, Chunk, File);
+        Length -= (long)Chunk;
+    }
+
+    fflush(File);
+    return File;
+}
+
+static BOOLEAN
+SameFile(
+    IN FILE *File1,
+    IN FILE *File2)
+{
+    int Char1, Char2;
+
+    if (FileSize(File1) != FileSize(File2))
+        return FALSE;
+
+    fseek(File1, 0, SEEK_SET);
+    fseek(File2, 0, SEEK_SET);
+    do
+    {
+        Char1 = fgetc(File1);
+        Char2 = fgetc(File2);
+        if (Char1 != Char2) return FALSE;
+    } while (Char1 != EOF);
+
+    return TRUE;
+}
+
+static NTSTATUS
+LoadHive(
+    OUT PTEST_HIVE TestHive,
+    IN FILE *Primary,
+    IN FILE *Log)
+{
+    NTSTATUS Status;
+
+    RtlZeroMemory(TestHive, sizeof(*TestHive));
+    TestHive->Files[HFILE_TYPE_PRIMARY] = Primary;
+    TestHive->Files[HFILE_TYPE_LOG] = Log;
+
+    Status = HvInitialize(&TestHive->Hive,
+                          HINIT_FILE,
+                          0,
+                          HFILE_TYPE_LOG,
+                          NULL,
+                          CmpAllocate,
+                          CmpFree,
+                          TestFileSetSize,
+                          TestFileWrite,
+                          TestFileRead,
+                          TestFileFlush,
+                          NULL,
+                          NULL,
+                          1,
+                          NULL);
+
+    /* HvInitialize clears the hive, files included */
+    TestHive->Files[HFILE_TYPE_PRIMARY] = Primary;
+    TestHive->Files[HFILE_TYPE_LOG] = Log;
+    return Status;
+}
+
+static VOID
+TakeSnapshot(
+    IN PHHIVE Hive,
+    OUT PTEST_SNAPSHOT Snapshot)
+{
+    ULONG i;
+
+    Snapshot->Length = Hive->Storage[Stable].Length;
+    Snapshot->Blocks = malloc(Snapshot->Length);
+    for (i = 0; i < Snapshot->Length / HBLOCK_SIZE; i++)
+    {
+        memcpy(Snapshot->Blocks + i * HBLOCK_SIZE,
+               (PVOID)Hive->Storage[Stable].BlockList[i].BlockAddress,
+               HBLOCK_SIZE);
+    }
+}
+
+static BOOLEAN
+SameHive(
+    IN PHHIVE Hive,
+    IN PTEST_SNAPSHOT Snapshot)
+{
+    ULONG i;
+
+    if (Hive->Storage[Stable].Length != Snapshot->Length)
+        return FALSE;
+
+    for (i = 0; i < Snapshot->Length / HBLOCK_SIZE; i++)
+    {
+        if (memcmp(Snapshot->Blocks + i * HBLOCK_SIZE,
+                   (PVOID)Hive->Storage[Stable].BlockList[i].BlockAddress,
+                   HBLOCK_SIZE))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Fills new cells with a pattern, so that every sync logs something different */
+static VOID
+DirtyCells(
+    IN PHHIVE Hive,
+    IN ULONG Count,
+    IN ULONG Size)
+{
+    static UCHAR Pattern = 1;
+    HCELL_INDEX Cell;
+    PVOID Data;
+
+    while (Count--)
+    {
+        Cell = HvAllocateCell(Hive, Size, Stable, HCELL_NIL);
+        if (Cell == HCELL_NIL)
+        {
+            Failures++;
+            printf("Allocating a cell failed\n");
+            return;
+        }
+
+        Data = HvGetCell(Hive, Cell);
+        memset(Data, Pattern++, Size);
+        HvReleaseCell(Hive, Cell);
+        HvMarkCellDirty(Hive, Cell, FALSE);
+    }
+}
+
+/* Writes an empty hive the way mkhive does, with no log */
+static FILE *
+CreatePrimary(VOID)
+{
+    TEST_HIVE TestHive;
+    NTSTATUS Status;
+
+    RtlZeroMemory(&TestHive, sizeof(TestHive));
+    Status = HvInitialize(&TestHive.Hive,
+                          HINIT_CREATE,
+                          HIVE_NOLAZYFLUSH,
+                          HFILE_TYPE_PRIMARY,
+                          NULL,
+                          CmpAllocate,
+                          CmpFree,
+                          TestFileSetSize,
+                          TestFileWrite,
+                          TestFileRead,
+                          TestFileFlush,
+                          NULL,
+                          NULL,
+                          1,
+                          NULL);
+    if (!NT_SUCCESS(Status) || !CmCreateRootNode(&TestHive.Hive, L"LogTest"))
+        return NULL;
+
+    TestHive.Files[HFILE_TYPE_PRIMARY] = tmpfile();
+    if (!HvWriteHive(&TestHive.Hive))
+        return NULL;
+
+    HvFree(&TestHive.Hive);
+    return TestHive.Files[HFILE_TYPE_PRIMARY];
+}
+
+int main(void)
+{
+    TEST_HIVE Live, Loaded;
+    TEST_SNAPSHOT AfterFirst, AfterSecond, AfterThird;
+    HBASE_BLOCK BaseBlock;
+    UCHAR Junk[HBLOCK_SIZE];
+    FILE *Primary, *Original, *Copy;
+    ULONG LogOffset[3], i;
+    NTSTATUS Status;
+
+    Primary = CreatePrimary();
+    if (!Primary)
+    {
+        printf("Creating the hive failed\n");
+        return 1;
+    }
+    Original = CopyFile(Primary, LONG_MAX);
+
+    Status = LoadHive(&Live, Primary, tmpfile());
+    ok(Status == STATUS_SUCCESS, "Loading the hive failed with 0x%lx\n", (unsigned long)Status);
+    if (!NT_SUCCESS(Status))
+        return 1;
+    ok(Live.Hive.LogEnabled, "No log for a hive loaded from its file\n");
+
+    /* Three syncs, the second one grows the hive */
+    DirtyCells(&Live.Hive, 10, 64);
+    ok(HvSyncHive(&Live.Hive), "First sync failed\n");
+    TakeSnapshot(&Live.Hive, &AfterFirst);
+    LogOffset[0] = Live.Hive.LogOffset;
+
+    DirtyCells(&Live.Hive, 300, 512);
+    ok(HvSyncHive(&Live.Hive), "Second sync failed\n");
+    TakeSnapshot(&Live.Hive, &AfterSecond);
+    LogOffset[1] = Live.Hive.LogOffset;
+
+    DirtyCells(&Live.Hive, 5, 2000);
+    ok(HvSyncHive(&Live.Hive), "Third sync failed\n");
+    TakeSnapshot(&Live.Hive, &AfterThird);
+    LogOffset[2] = Live.Hive.LogOffset;
+
+    ok(AfterSecond.Length > AfterFirst.Length, "The hive did not grow\n");
+    ok(LogOffset[0] < LogOffset[1] && LogOffset[1] < LogOffset[2],
+       "Log offsets %lu %lu %lu\n", (unsigned long)LogOffset[0],
+       (unsigned long)LogOffset[1], (unsigned long)LogOffset[2]);
+
+    /* The syncs only appended to the log */
+    ok(SameFile(Primary, Original), "The primary was written before the log filled up\n");
+
+    /* Crash: the untouched primary and the log must give back the live hive */
+    Status = LoadHive(&Loaded, CopyFile(Primary, LONG_MAX), CopyFile(Live.Files[HFILE_TYPE_LOG], LONG_MAX));
+    ok(Status == STATUS_SUCCESS, "Replay failed with 0x%lx\n", (unsigned long)Status);
+    if (NT_SUCCESS(Status))
+    {
+        ok(SameHive(&Loaded.Hive, &AfterThird), "The replayed hive differs\n");
+        ok(Loaded.Hive.LogOffset == LogOffset[2], "Replay stopped at %lu instead of %lu\n",
+           (unsigned long)Loaded.Hive.LogOffset, (unsigned long)LogOffset[2]);
+        HvFree(&Loaded.Hive);
+    }
+
+    /* An entry cut short by the crash is dropped, along with nothing before it */
+    Status = LoadHive(&Loaded, CopyFile(Primary, LONG_MAX),
+                      CopyFile(Live.Files[HFILE_TYPE_LOG], LogOffset[2] - 100));
+    ok(Status == STATUS_SUCCESS, "Replay of a cut log failed with 0x%lx\n", (unsigned long)Status);
+    if (NT_SUCCESS(Status))
+    {
+        ok(SameHive(&Loaded.Hive, &AfterSecond), "The hive from a cut log differs\n");
+        ok(Loaded.Hive.LogOffset == LogOffset[1], "Cut log replay stopped at %lu instead of %lu\n",
+           (unsigned long)Loaded.Hive.LogOffset, (unsigned long)LogOffset[1]);
+
+        /* Appending goes on right after the last good entry */
+        DirtyCells(&Loaded.Hive, 3, 100);
+        ok(HvSyncHive(&Loaded.Hive), "Sync after a cut log failed\n");
+        HvFree(&Loaded.Hive);
+    }
+
+    /* So is an entry whose data does not match its hash */
+    Copy = CopyFile(Live.Files[HFILE_TYPE_LOG], LONG_MAX);
+    fseek(Copy, LogOffset[1] + HBLOCK_SIZE, SEEK_SET);
+    fputc(~fgetc(Copy) & 0xFF, Copy);
+    fseek(Copy, LogOffset[1] + HBLOCK_SIZE, SEEK_SET);
+    fputc(0x5A, Copy);
+    Status = LoadHive(&Loaded, CopyFile(Primary, LONG_MAX), Copy);
+    ok(Status == STATUS_SUCCESS, "Replay of a damaged log failed with 0x%lx\n", (unsigned long)Status);
+    if (NT_SUCCESS(Status))
+    {
+        ok(SameHive(&Loaded.Hive, &AfterSecond), "The hive from a damaged log differs\n");
+        HvFree(&Loaded.Hive);
+    }
+
+    /* A crash in the middle of writing the primary: new header, some blocks garbage */
+    Copy = CopyFile(Primary, LONG_MAX);
+    fseek(Copy, 0, SEEK_SET);
+    fread(&BaseBlock, 1, sizeof(BaseBlock), Copy);
+    BaseBlock.Sequence1++;
+    BaseBlock.Length = AfterThird.Length;
+    BaseBlock.CheckSum = HvpHiveHeaderChecksum(&BaseBlock);
+    fseek(Copy, 0, SEEK_SET);
+    fwrite(&BaseBlock, 1, sizeof(BaseBlock), Copy);
+    memset(Junk, 0xCC, sizeof(Junk));
+    for (i = 0; i < AfterThird.Length / HBLOCK_SIZE; i++)
+    {
+        if (RtlCheckBit(&Live.Hive.LoggedVector, i))
+        {
+            fseek(Copy, (i + 1) * HBLOCK_SIZE, SEEK_SET);
+            fwrite(Junk, 1, sizeof(Junk), Copy);
+        }
+    }
+    fflush(Copy);
+
+    Status = LoadHive(&Loaded, CopyFile(Copy, LONG_MAX), CopyFile(Live.Files[HFILE_TYPE_LOG], LONG_MAX));
+    ok(Status == STATUS_SUCCESS, "Recovering a torn primary failed with 0x%lx\n", (unsigned long)Status);
+    if (NT_SUCCESS(Status))
+    {
+        ok(SameHive(&Loaded.Hive, &AfterThird), "The recovered primary differs\n");
+        HvFree(&Loaded.Hive);
+    }
+
+    /* Without its log, the torn primary is corrupt */
+    Status = LoadHive(&Loaded, Copy, tmpfile());
+    ok(Status == STATUS_REGISTRY_CORRUPT, "Loading a torn primary without log returned 0x%lx\n",
+       (unsigned long)Status);
+    if (NT_SUCCESS(Status))
+        HvFree(&Loaded.Hive);
+
+    /* After a reconcile, the primary is complete on its own */
+    ok(HvReconcileHive(&Live.Hive), "Reconcile failed\n");
+    Status = LoadHive(&Loaded, CopyFile(Primary, LONG_MAX), tmpfile());
+    ok(Status == STATUS_SUCCESS, "Loading the reconciled primary failed with 0x%lx\n", (unsigned long)Status);
+    if (NT_SUCCESS(Status))
+    {
+        ok(SameHive(&Loaded.Hive, &AfterThird), "The reconciled primary differs\n");
+        HvFree(&Loaded.Hive);
+    }
+
+    HvFree(&Live.Hive);
+
+    printf("hivelog: %lu failures\n", (unsigned long)Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,441 @@
+/*
+ * PROJECT:   Registry manipulation library
+ * LICENSE:   GPL - See COPYING in the top level directory
+ * PURPOSE:   Host test and load measurement for hives used from views of their file
+ * COPYRIGHT: Copyright 2026 ReactOS Team
+ */
+
+#ifndef CMLIB_HOST
+#define CMLIB_HOST
+#endif
+#include <cmlib.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Same as the kernel, one cache mapping granule */
+#define TEST_VIEW_SIZE  (256 * 1024)
+#define TEST_MAX_VIEWS  64
+
+/* Cells that fill a bin of one block each, so these bins have no free cell */
+#define TEST_CELL_SIZE  (HBLOCK_SIZE - sizeof(HBIN) - sizeof(HCELL))
+#define TEST_CELL_COUNT 768
+
+/*
+ * The hive and the files behind it. The primary file is also kept in memory
+ * as a whole, the way the cache would have it, and views point into it.
+ */
+typedef struct _TEST_HIVE
+{
+    HHIVE Hive;
+    FILE *Files[HFILE_TYPE_MAX];
+    PUCHAR Image;
+    ULONG ImageSize;
+    PCM_VIEW_OF_FILE Views[TEST_MAX_VIEWS];
+    ULONG MappedViews;
+    BOOLEAN FailMapping;
+} TEST_HIVE, *PTEST_HIVE;
+
+static ULONG Failures;
+static SIZE_T PoolInUse;
+
+#define ok(Condition, ...) \
+    do { if (!(Condition)) { Failures++; printf(__VA_ARGS__); } } while (0)
+
+PVOID CMAPI
+CmpAllocate(
+    IN SIZE_T Size,
+    IN BOOLEAN Paged,
+    IN ULONG Tag)
+{
+    PSIZE_T Block = calloc(1, sizeof(SIZE_T) + Size);
+
+    if (!Block) return NULL;
+    *Block = Size;
+    PoolInUse += Size;
+    return Block + 1;
+}
+
+VOID CMAPI
+CmpFree(
+    IN PVOID Ptr,
+    IN ULONG Quota)
+{
+    PSIZE_T Block = (PSIZE_T)Ptr - 1;
+
+    if (!Ptr) return;
+    PoolInUse -= *Block;
+    free(Block);
+}
+
+static BOOLEAN CMAPI
+TestFileRead(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PULONG FileOffset,
+    OUT PVOID Buffer,
+    IN SIZE_T BufferLength)
+{
+    FILE *File = ((PTEST_HIVE)RegistryHive)->Files[FileType];
+
+    return (fseek(File, *FileOffset, SEEK_SET) == 0 &&
+            fread(Buffer, 1, BufferLength, File) == BufferLength);
+}
+
+static BOOLEAN CMAPI
+TestFileWrite(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PULONG FileOffset,
+    IN PVOID Buffer,
+    IN SIZE_T BufferLength)
+{
+    FILE *File = ((PTEST_HIVE)RegistryHive)->Files[FileType];
+
+    return (fseek(File, *FileOffset, SEEK_SET) == 0 &&
+            fwrite(Buffer, 1, BufferLength, File) == BufferLength);
+}
+
+static BOOLEAN CMAPI
+TestFileSetSize(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN ULONG FileSize,
+    IN ULONG OldFileSize)
+{
+    return TRUE;
+}
+
+static BOOLEAN CMAPI
+TestFileFlush(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    PLARGE_INTEGER FileOffset,
+    ULONG Length)
+{
+    return (fflush(((PTEST_HIVE)RegistryHive)->Files[FileType]) == 0);
+}
+
+/* Does what CmpFileMapView does, with the image standing in for the cache */
+static BOOLEAN CMAPI
+TestFileMapView(
+    IN PHHIVE RegistryHive,
+    IN ULONG BlockIndex)
+{
+    PTEST_HIVE TestHive = (PTEST_HIVE)RegistryHive;
+    PCM_VIEW_OF_FILE View;
+    ULONG ViewStart;
+    PHBIN Bin;
+
+    if (TestHive->FailMapping)
+    {
+        /* The cache could not map the view, the bin is read into pool */
+        Bin = HvpReadBin(RegistryHive, BlockIndex);
+        if (!Bin) return FALSE;
+
+        if (RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress == 0)
+            HvpInsertBin(RegistryHive, Bin);
+        else
+            CmpFree(Bin, 0);
+        return TRUE;
+    }
+
+    ViewStart = ROUND_DOWN(HBLOCK_SIZE + BlockIndex * HBLOCK_SIZE, TEST_VIEW_SIZE);
+    View = TestHive->Views[ViewStart / TEST_VIEW_SIZE];
+    if (!View)
+    {
+        View = calloc(1, sizeof(CM_VIEW_OF_FILE));
+        View->FileOffset = ViewStart;
+        View->Size = min(TEST_VIEW_SIZE, TestHive->ImageSize - ViewStart);
+        View->ViewAddress = (PULONG_PTR)(TestHive->Image + ViewStart);
+        TestHive->Views[ViewStart / TEST_VIEW_SIZE] = View;
+        TestHive->MappedViews++;
+    }
+
+    return HvpMapViewBins(RegistryHive, View);
+}
+
+/* Unmaps every view, as the kernel does once a hive is loaded */
+static VOID
+UnmapViews(
+    IN PTEST_HIVE TestHive)
+{
+    ULONG i;
+
+    for (i = 0; i < TEST_MAX_VIEWS; i++)
+    {
+        if (!TestHive->Views[i]) continue;
+
+        HvpUnmapViewBins(&TestHive->Hive, TestHive->Views[i]);
+        free(TestHive->Views[i]);
+        TestHive->Views[i] = NULL;
+        TestHive->MappedViews--;
+    }
+}
+
+static PUCHAR
+ReadImage(
+    IN FILE *File,
+    OUT PULONG Size)
+{
+    PUCHAR Image;
+
+    fflush(File);
+    fseek(File, 0, SEEK_END);
+    *Size = (ULONG)ftell(File);
+    Image = malloc(*Size);
+    fseek(File, 0, SEEK_SET);
+    if (fread(Image, 1, *Size, File) != *Size)
+    {
+        free(Image);
+        return NULL;
+    }
+
+    return Image;
+}
+
+static NTSTATUS
+LoadHive(
+    OUT PTEST_HIVE TestHive,
+    IN FILE *Primary,
+    IN BOOLEAN Mapped)
+{
+    NTSTATUS Status;
+    FILE *Log = tmpfile();
+
+    RtlZeroMemory(TestHive, sizeof(*TestHive));
+    TestHive->Image = ReadImage(Primary, &TestHive->ImageSize);
+    TestHive->Files[HFILE_TYPE_PRIMARY] = Primary;
+    TestHive->Files[HFILE_TYPE_LOG] = Log;
+
+    Status = HvInitialize(&TestHive->Hive,
+                          HINIT_FILE,
+                          0,
+                          HFILE_TYPE_LOG,
+                          NULL,
+                          CmpAllocate,
+                          CmpFree,
+                          TestFileSetSize,
+                          TestFileWrite,
+                          TestFileRead,
+                          TestFileFlush,
+                          NULL,
+                          Mapped ? TestFileMapView : NULL,
+                          1,
+                          NULL);
+
+    /* HvInitialize clears the hive, files included */
+    TestHive->Files[HFILE_TYPE_PRIMARY] = Primary;
+    TestHive->Files[HFILE_TYPE_LOG] = Log;
+    return Status;
+}
+
+static VOID
+FreeHive(
+    IN PTEST_HIVE TestHive)
+{
+    HvFree(&TestHive->Hive);
+    UnmapViews(TestHive);
+    free(TestHive->Image);
+}
+
+/* The cell that was allocated Index-th, one per bin after the first one */
+static HCELL_INDEX
+TestCell(
+    IN ULONG Index)
+{
+    return (Index + 1) * HBLOCK_SIZE + sizeof(HBIN);
+}
+
+static BOOLEAN
+CheckCell(
+    IN PHHIVE Hive,
+    IN ULONG Index,
+    IN UCHAR Pattern)
+{
+    PUCHAR Data = HvGetCell(Hive, TestCell(Index));
+    ULONG i;
+
+    if (!Data) return FALSE;
+    for (i = 0; i < TEST_CELL_SIZE; i++)
+    {
+        if (Data[i] != Pattern) return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Writes a hive of about 3 MB, the way mkhive does */
+static FILE *
+CreatePrimary(VOID)
+{
+    TEST_HIVE TestHive;
+    HCELL_INDEX Cell;
+    NTSTATUS Status;
+    ULONG i;
+
+    RtlZeroMemory(&TestHive, sizeof(TestHive));
+    Status = HvInitialize(&TestHive.Hive,
+                          HINIT_CREATE,
+                          HIVE_NOLAZYFLUSH,
+                          HFILE_TYPE_PRIMARY,
+                          NULL,
+                          CmpAllocate,
+                          CmpFree,
+                          TestFileSetSize,
+                          TestFileWrite,
+                          TestFileRead,
+                          TestFileFlush,
+                          NULL,
+                          NULL,
+                          1,
+                          NULL);
+    if (!NT_SUCCESS(Status) || !CmCreateRootNode(&TestHive.Hive, L"MapTest"))
+        return NULL;
+
+    /* The first bin is filled so that the test cells come one per bin */
+    do
+    {
+        Cell = HvAllocateCell(&TestHive.Hive, sizeof(ULONG), Stable, HCELL_NIL);
+        if (Cell == HCELL_NIL)
+            return NULL;
+    } while (Cell + sizeof(HCELL) + HvGetCellSize(&TestHive.Hive, HvGetCell(&TestHive.Hive, Cell)) < HBLOCK_SIZE);
+
+    for (i = 0; i < TEST_CELL_COUNT; i++)
+    {
+        Cell = HvAllocateCell(&TestHive.Hive, TEST_CELL_SIZE, Stable, HCELL_NIL);
+        if (Cell != TestCell(i))
+            return NULL;
+
+        memset(HvGetCell(&TestHive.Hive, Cell), (UCHAR)i, TEST_CELL_SIZE);
+    }
+
+    TestHive.Files[HFILE_TYPE_PRIMARY] = tmpfile();
+    if (!HvWriteHive(&TestHive.Hive))
+        return NULL;
+
+    HvFree(&TestHive.Hive);
+    return TestHive.Files[HFILE_TYPE_PRIMARY];
+}
+
+int main(void)
+{
+    TEST_HIVE Mapped, Copied;
+    SIZE_T MappedPool, CopiedPool;
+    clock_t Start, MappedTime, CopiedTime;
+    PUCHAR Original, Data;
+    ULONG i, Size;
+    NTSTATUS Status;
+    FILE *Primary;
+
+    Primary = CreatePrimary();
+    if (!Primary)
+    {
+        printf("Creating the hive failed\n");
+        return 1;
+    }
+
+    /* Load the hive both ways, counting what is left in pool after the load */
+    Start = clock();
+    Status = LoadHive(&Copied, Primary, FALSE);
+    CopiedTime = clock() - Start;
+    CopiedPool = PoolInUse;
+    ok(Status == STATUS_SUCCESS, "Loading the hive failed with 0x%lx\n", (unsigned long)Status);
+    if (!NT_SUCCESS(Status))
+        return 1;
+
+    Start = clock();
+    Status = LoadHive(&Mapped, Primary, TRUE);
+    UnmapViews(&Mapped);
+    MappedTime = clock() - Start;
+    MappedPool = PoolInUse - CopiedPool;
+    ok(Status == STATUS_SUCCESS, "Loading the mapped hive failed with 0x%lx\n", (unsigned long)Status);
+    if (!NT_SUCCESS(Status))
+        return 1;
+
+    printf("hivemap: %lu KB hive, loaded into %lu KB of pool in %lu us, %lu KB in %lu us when copied\n",
+           (unsigned long)(Mapped.ImageSize / 1024),
+           (unsigned long)(MappedPool / 1024),
+           (unsigned long)(MappedTime * 1000000 / CLOCKS_PER_SEC),
+           (unsigned long)(CopiedPool / 1024),
+           (unsigned long)(CopiedTime * 1000000 / CLOCKS_PER_SEC));
+    ok(MappedPool < Mapped.ImageSize / 8, "The mapped hive took %lu bytes of pool\n",
+       (unsigned long)MappedPool);
+
+    /* Both loads build the same free lists */
+    ok(!memcmp(Mapped.Hive.Storage[Stable].FreeDisplay, Copied.Hive.Storage[Stable].FreeDisplay,
+               sizeof(Mapped.Hive.Storage[Stable].FreeDisplay)),
+       "The free lists differ\n");
+
+    /* A lookup maps only the view the cell is in */
+    ok(CheckCell(&Mapped.Hive, 500, (UCHAR)500), "Cell 500 differs\n");
+    ok(Mapped.MappedViews == 1, "%lu views mapped for one cell\n", (unsigned long)Mapped.MappedViews);
+    for (i = 0; i < TEST_CELL_COUNT; i++)
+        ok(CheckCell(&Mapped.Hive, i, (UCHAR)i), "Cell %lu differs\n", (unsigned long)i);
+    ok(Mapped.MappedViews == Mapped.ImageSize / TEST_VIEW_SIZE + 1,
+       "%lu views mapped for the whole hive\n", (unsigned long)Mapped.MappedViews);
+
+    /* Released views are mapped again on the next lookup */
+    UnmapViews(&Mapped);
+    ok(CheckCell(&Mapped.Hive, 100, (UCHAR)100), "Cell 100 differs after its view was released\n");
+    ok(HvIsCellAllocated(&Mapped.Hive, TestCell(700)), "A cell that is not mapped is not allocated\n");
+
+    /* Lookups do not fail when views cannot be mapped, the bins are read instead */
+    UnmapViews(&Mapped);
+    Mapped.FailMapping = TRUE;
+    for (i = 200; i < 210; i++)
+    {
+        ok(CheckCell(&Mapped.Hive, i, (UCHAR)i), "Cell %lu differs when read\n", (unsigned long)i);
+        ok(Mapped.Hive.Storage[Stable].BlockList[TestCell(i) / HBLOCK_SIZE].MemAlloc == HBLOCK_SIZE,
+           "Cell %lu is not in pool\n", (unsigned long)i);
+    }
+    ok(Mapped.MappedViews == 0, "%lu views mapped when mapping fails\n", (unsigned long)Mapped.MappedViews);
+    Mapped.FailMapping = FALSE;
+
+    /* Changes go to a copy of the bin, never to the view */
+    Original = malloc(Mapped.ImageSize);
+    memcpy(Original, Mapped.Image, Mapped.ImageSize);
+    for (i = 0; i < TEST_CELL_COUNT; i += 7)
+    {
+        ok(HvMarkCellDirty(&Mapped.Hive, TestCell(i), FALSE), "Marking cell %lu failed\n", (unsigned long)i);
+        Data = HvGetCell(&Mapped.Hive, TestCell(i));
+        memset(Data, 0xA5, TEST_CELL_SIZE);
+        ok(Mapped.Hive.Storage[Stable].BlockList[TestCell(i) / HBLOCK_SIZE].CmView == NULL,
+           "Dirty cell %lu is still in a view\n", (unsigned long)i);
+    }
+    HvFreeCell(&Mapped.Hive, TestCell(3));
+    ok(!memcmp(Original, Mapped.Image, Mapped.ImageSize), "A view was written to\n");
+
+    /* Views can go while dirty bins stay */
+    UnmapViews(&Mapped);
+    ok(CheckCell(&Mapped.Hive, 7, 0xA5) && CheckCell(&Mapped.Hive, 8, 8),
+       "Cells differ after the views were released\n");
+
+    /* What is written back is what was changed */
+    ok(HvSyncHive(&Mapped.Hive), "Sync failed\n");
+    ok(HvReconcileHive(&Mapped.Hive), "Reconcile failed\n");
+    FreeHive(&Mapped);
+
+    Size = PoolInUse;
+    Status = LoadHive(&Mapped, Primary, TRUE);
+    ok(Status == STATUS_SUCCESS, "Reloading the hive failed with 0x%lx\n", (unsigned long)Status);
+    if (NT_SUCCESS(Status))
+    {
+        for (i = 0; i < TEST_CELL_COUNT; i++)
+        {
+            if (i == 3) continue;
+            ok(CheckCell(&Mapped.Hive, i, (i % 7) ? (UCHAR)i : 0xA5),
+               "Cell %lu differs after reload\n", (unsigned long)i);
+        }
+        ok(!HvIsCellAllocated(&Mapped.Hive, TestCell(3)) ||
+           ((PHCELL)HvGetCell(&Mapped.Hive, TestCell(3)) - 1)->Size > 0,
+           "The freed cell is still allocated\n");
+        FreeHive(&Mapped);
+    }
+    ok(PoolInUse == Size, "%lu bytes of pool leaked\n", (unsigned long)(PoolInUse - Size));
+
+    FreeHive(&Copied);
+    free(Original);
+
+    printf("hivemap: %lu failures\n", (unsigned long)Failures);
+    return Failures ? 1 : 0;
+}
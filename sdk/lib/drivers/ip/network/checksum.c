@@ -11,6 +11,40 @@
 
 #include "precomp.h"
 
+#if defined(_M_IX86) || defined(_M_AMD64) || defined(__i386__) || defined(__x86_64__)
+#define CHECKSUM_SSE2
+#include <emmintrin.h>
+
+#if defined(__GNUC__) && !defined(__x86_64__)
+#define SSE2_ROUTINE __attribute__((target("sse2")))
+#else
+#define SSE2_ROUTINE
+#endif
+
+/*
+ * On x86 the FPU state has to be saved before touching XMM registers
+ * in kernel mode, which only pays off for large buffers
+ */
+#if defined(_M_IX86) || defined(__i386__)
+#define CHECKSUM_SSE2_SAVE_STATE
+#define CHECKSUM_SSE2_MIN 2048
+#else
+#define CHECKSUM_SSE2_MIN 64
+#endif
+
+static BOOLEAN ChecksumSse2Present = FALSE;
+#endif /* x86 || amd64 */
+
+
+VOID ChecksumInitialize(VOID)
+/*
+ * FUNCTION: Selects the checksum routines for the processor we run on
+ */
+{
+#ifdef CHECKSUM_SSE2
+  ChecksumSse2Present = ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+#endif
+}
 
 ULONG ChecksumFold(
   ULONG Sum)
@@ -24,6 +58,149 @@ ULONG ChecksumFold(
   return Sum;
 }
 
+static ULONG ChecksumFold64(
+  ULONGLONG Sum)
+{
+  /* Fold 64-bit sum to 32 bits, 2^32 is 1 in one's complement arithmetic */
+  Sum = (Sum & 0xFFFFFFFF) + (Sum >> 32);
+  Sum = (Sum & 0xFFFFFFFF) + (Sum >> 32);
+
+  return (ULONG)Sum;
+}
+
+ULONGLONG ChecksumComputeGeneric(
+  PVOID Destination,
+  CONST VOID *Data,
+  UINT Count)
+/*
+ * FUNCTION: Sum a buffer 32 bits at a time into a 64-bit accumulator
+ * ARGUMENTS:
+ *     Destination = Optional buffer to copy the data to
+ *     Data        = Pointer to buffer with data
+ *     Count       = Number of bytes in buffer
+ * RETURNS:
+ *     Unfolded sum of the buffer
+ */
+{
+  CONST UCHAR *Source = Data;
+  PUCHAR Target = Destination;
+  ULONGLONG Sum = 0;
+  ULONG Value;
+
+  while (Count >= sizeof(ULONG))
+    {
+      Value = *(ULONG UNALIGNED *)Source;
+      if (Target)
+        {
+          *(ULONG UNALIGNED *)Target = Value;
+          Target += sizeof(ULONG);
+        }
+
+      Sum += Value;
+      Source += sizeof(ULONG);
+      Count -= sizeof(ULONG);
+    }
+
+  if (Count >= sizeof(USHORT))
+    {
+      Value = *(USHORT UNALIGNED *)Source;
+      if (Target)
+        {
+          *(USHORT UNALIGNED *)Target = (USHORT)Value;
+          Target += sizeof(USHORT);
+        }
+
+      Sum += Value;
+      Source += sizeof(USHORT);
+      Count -= sizeof(USHORT);
+    }
+
+  /* Add left-over byte, if any */
+  if (Count > 0)
+    {
+      if (Target)
+        *Target = *Source;
+
+      Sum += *Source;
+    }
+
+  return Sum;
+}
+
+#ifdef CHECKSUM_SSE2
+SSE2_ROUTINE
+ULONGLONG ChecksumComputeSse2(
+  PVOID Destination,
+  CONST VOID *Data,
+  UINT Count)
+/*
+ * FUNCTION: Sum a buffer 128 bits at a time into two 64-bit lanes
+ * ARGUMENTS:
+ *     Destination = Optional buffer to copy the data to
+ *     Data        = Pointer to buffer with data
+ *     Count       = Number of bytes in buffer
+ * RETURNS:
+ *     Unfolded sum of the buffer
+ * NOTES:
+ *     The caller makes sure SSE2 is present and usable
+ */
+{
+  CONST UCHAR *Source = Data;
+  PUCHAR Target = Destination;
+  __m128i Zero = _mm_setzero_si128();
+  __m128i Low = Zero, High = Zero, Value;
+  ULONGLONG Lanes[2];
+
+  while (Count >= sizeof(__m128i))
+    {
+      Value = _mm_loadu_si128((const __m128i *)Source);
+      if (Target)
+        {
+          _mm_storeu_si128((__m128i *)Target, Value);
+          Target += sizeof(__m128i);
+        }
+
+      /* Widen the 32-bit words so that the lanes never overflow */
+      Low = _mm_add_epi64(Low, _mm_unpacklo_epi32(Value, Zero));
+      High = _mm_add_epi64(High, _mm_unpackhi_epi32(Value, Zero));
+
+      Source += sizeof(__m128i);
+      Count -= sizeof(__m128i);
+    }
+
+  _mm_storeu_si128((__m128i *)Lanes, _mm_add_epi64(Low, High));
+
+  return Lanes[0] + Lanes[1] + ChecksumComputeGeneric(Target, Source, Count);
+}
+#endif /* CHECKSUM_SSE2 */
+
+static ULONGLONG ChecksumSum(
+  PVOID Destination,
+  CONST VOID *Data,
+  UINT Count)
+{
+#ifdef CHECKSUM_SSE2
+  if (ChecksumSse2Present && Count >= CHECKSUM_SSE2_MIN)
+    {
+#ifdef CHECKSUM_SSE2_SAVE_STATE
+      KFLOATING_SAVE FloatSave;
+      ULONGLONG Sum;
+
+      if (NT_SUCCESS(KeSaveFloatingPointState(&FloatSave)))
+        {
+          Sum = ChecksumComputeSse2(Destination, Data, Count);
+          KeRestoreFloatingPointState(&FloatSave);
+          return Sum;
+        }
+#else
+      return ChecksumComputeSse2(Destination, Data, Count);
+#endif
+    }
+#endif /* CHECKSUM_SSE2 */
+
+  return ChecksumComputeGeneric(Destination, Data, Count);
+}
+
 ULONG ChecksumCompute(
   PVOID Data,
   UINT Count,
@@ -35,25 +212,53 @@ ULONG ChecksumCompute(
  *     Count = Number of bytes in buffer
  *     Seed  = Previously calculated checksum (if any)
  * RETURNS:
- *     Checksum of buffer
+ *     Checksum of buffer, not folded to 16 bits
  */
 {
-  register ULONG Sum = Seed;
+  return ChecksumFold64(Seed + ChecksumSum(NULL, Data, Count));
+}
 
-  while (Count > 1)
-    {
-      Sum += *(PUSHORT)Data;
-      Count -= 2;
-      Data = (PVOID)((ULONG_PTR) Data + 2);
-    }
+ULONG ChecksumCopy(
+  PVOID Destination,
+  CONST VOID *Source,
+  UINT Count,
+  ULONG Seed)
+/*
+ * FUNCTION: Copy a buffer and calculate its checksum in one pass
+ * ARGUMENTS:
+ *     Destination = Pointer to buffer to copy to
+ *     Source      = Pointer to buffer with data
+ *     Count       = Number of bytes to copy
+ *     Seed        = Previously calculated checksum (if any)
+ * RETURNS:
+ *     Checksum of buffer, not folded to 16 bits
+ */
+{
+  return ChecksumFold64(Seed + ChecksumSum(Destination, Source, Count));
+}
 
-  /* Add left-over byte, if any */
-  if (Count > 0)
-    {
-      Sum += *(PUCHAR)Data;
-    }
+ULONG ChecksumCombine(
+  ULONG Sum,
+  ULONG BlockSum,
+  UINT Offset)
+/*
+ * FUNCTION: Add the checksum of a block to the checksum of what precedes it
+ * ARGUMENTS:
+ *     Sum      = Checksum of the data before the block
+ *     BlockSum = Checksum of the block, computed on its own
+ *     Offset   = Offset of the block from the start of the data
+ * RETURNS:
+ *     Checksum of both, not folded to 16 bits
+ * NOTES:
+ *     A block starting at an odd offset was summed with its bytes
+ *     paired the other way around, swapping the folded sum fixes that
+ */
+{
+  BlockSum = ChecksumFold(BlockSum);
+  if (Offset & 1)
+    BlockSum = ((BlockSum & 0xFF) << 8) | (BlockSum >> 8);
 
-  return Sum;
+  return ChecksumFold64((ULONGLONG)Sum + BlockSum);
 }
 
 ULONG
@@ -61,45 +266,26 @@ UDPv4ChecksumCalculate(
   PIPv4_HEADER IPHeader,
   PUCHAR PacketBuffer,
   ULONG DataLength)
+/*
+ * FUNCTION: Calculate the UDP checksum of a datagram
+ * ARGUMENTS:
+ *     IPHeader     = IP header of the datagram, for the pseudo header
+ *     PacketBuffer = UDP header followed by the data
+ *     DataLength   = Length of UDP header and data
+ * RETURNS:
+ *     One's complement of the checksum in host byte order
+ */
 {
-  ULONG Sum = 0;
-  USHORT TmpSum;
-  ULONG i;
-  BOOLEAN Pad;
+  ULONG Sum;
 
-  /* Pad the data if needed */
-  Pad = (DataLength & 1);
-  if (Pad)
-      DataLength++;
+  /* Add the addresses, proto number and length of the pseudo header */
+  Sum = ChecksumCompute(&IPHeader->SrcAddr, sizeof(IPv4_RAW_ADDRESS), 0);
+  Sum = ChecksumCompute(&IPHeader->DstAddr, sizeof(IPv4_RAW_ADDRESS), Sum);
+  Sum += WH2N(IPPROTO_UDP) + WH2N((USHORT)DataLength);
 
   /* Add from the UDP header and data */
-  for (i = 0; i < DataLength; i += 2)
-  {
-       TmpSum = ((PacketBuffer[i] << 8) & 0xFF00) +
-                ((Pad && i == DataLength - 2) ? 0 : (PacketBuffer[i+1] & 0x00FF));
-       Sum += TmpSum;
-  }
-
-  /* Add the source address */
-  for (i = 0; i < sizeof(IPv4_RAW_ADDRESS); i += 2)
-  {
-       TmpSum = ((((PUCHAR)&IPHeader->SrcAddr)[i] << 8) & 0xFF00) +
-                (((PUCHAR)&IPHeader->SrcAddr)[i+1] & 0x00FF);
-       Sum += TmpSum;
-  }
-
-  /* Add the destination address */
-  for (i = 0; i < sizeof(IPv4_RAW_ADDRESS); i += 2)
-  {
-       TmpSum = ((((PUCHAR)&IPHeader->DstAddr)[i] << 8) & 0xFF00) +
-                (((PUCHAR)&IPHeader->DstAddr)[i+1] & 0x00FF);
-       Sum += TmpSum;
-  }
-
-  /* Add the proto number and length */
-  Sum += IPPROTO_UDP + (DataLength - (Pad ? 1 : 0));
-
-  /* Fold the checksum and return the one's complement */
-  return ~ChecksumFold(Sum);
-}
+  Sum = ChecksumFold(ChecksumCompute(PacketBuffer, DataLength, Sum));
 
+  /* Return the one's complement of the checksum in host byte order */
+  return ~WN2H((USHORT)Sum);
+}
@@ -421,6 +421,8 @@ NTSTATUS IPStartup(PUNICODE_STRING RegistryPath)
 
     TI_DbgPrint(MAX_TRACE, ("Called.\n"));
 
+    ChecksumInitialize();
+
     /* Initialize lookaside lists */
     ExInitializeNPagedLookasideList(
       &IPDRList,                      /* Lookaside list */
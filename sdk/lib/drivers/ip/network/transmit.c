@@ -75,6 +75,7 @@ BOOLEAN PrepareNextFragment(
     PIPv4_HEADER Header;
     BOOLEAN MoreFragments;
     USHORT FragOfs;
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
 
     TI_DbgPrint(MAX_TRACE, ("Called. IFC (0x%X)\n", IFC));
 
@@ -83,10 +84,9 @@ BOOLEAN PrepareNextFragment(
         TI_DbgPrint(MAX_TRACE, ("Preparing 1 fragment.\n"));
 
         MaxData  = IFC->PathMTU - IFC->HeaderSize;
-        /* Make fragment a multiplum of 64bit */
-        MaxData -= MaxData % 8;
         if (IFC->BytesLeft > MaxData) {
-            DataSize      = MaxData;
+            /* Make fragment a multiplum of 64bit */
+            DataSize      = MaxData - MaxData % 8;
             MoreFragments = TRUE;
         } else {
             DataSize      = IFC->BytesLeft;
@@ -112,9 +112,12 @@ BOOLEAN PrepareNextFragment(
 
         /* FIXME: Handle options */
 
-        /* Calculate checksum of IP header */
+        /* Calculate checksum of IP header, unless the adapter does */
+        ChecksumInfo.Value = (ULONG)(ULONG_PTR)NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket,
+                                                                                TcpIpChecksumPacketInfo);
         Header->Checksum = 0;
-        Header->Checksum = (USHORT)IPv4Checksum(Header, IFC->HeaderSize, 0);
+        if (!ChecksumInfo.Transmit.NdisPacketIpChecksum)
+            Header->Checksum = (USHORT)IPv4Checksum(Header, IFC->HeaderSize, 0);
 	TI_DbgPrint(MID_TRACE,("IP Check: %x\n", Header->Checksum));
 
         /* Update pointers */
@@ -177,6 +180,12 @@ NTSTATUS SendFragments(
         return NdisStatus;
     }
 
+    /* Pass on what the adapter has to do for this datagram */
+    NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket, TcpIpChecksumPacketInfo) =
+        NDIS_PER_PACKET_INFO_FROM_PACKET(IPPacket->NdisPacket, TcpIpChecksumPacketInfo);
+    NDIS_PER_PACKET_INFO_FROM_PACKET(IFC->NdisPacket, TcpLargeSendPacketInfo) =
+        NDIS_PER_PACKET_INFO_FROM_PACKET(IPPacket->NdisPacket, TcpLargeSendPacketInfo);
+
     GetDataPtr( IFC->NdisPacket, 0, (PCHAR *)&Data, &InSize );
 
     IFC->Header       = ((PCHAR)Data);
@@ -238,6 +247,13 @@ NTSTATUS IPSendDatagram(PIP_PACKET IPPacket, PNEIGHBOR_CACHE_ENTRY NCE)
 
     DISPLAY_IP_PACKET(IPPacket);
 
+    /* The adapter cuts large sends into MTU sized frames itself */
+    if (NDIS_PER_PACKET_INFO_FROM_PACKET(IPPacket->NdisPacket, TcpLargeSendPacketInfo))
+    {
+        TI_DbgPrint(MID_TRACE,("Large send: %d\n", IPPacket->TotalSize));
+        return SendFragments(IPPacket, NCE, IPPacket->TotalSize);
+    }
+
     /* Fetch path MTU now, because it may change */
     TI_DbgPrint(MID_TRACE,("PathMTU: %d\n", NCE->Interface->MTU));
 
@@ -0,0 +1,165 @@
+/*
+ * PROJECT:     ReactOS TCP/IP protocol driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Host test comparing the checksum routines with each other
+ * COPYRIGHT:   Copyright 2026 ReactOS Team
+ */
+
+#include "precomp.h"
+
+#if defined(_M_IX86) || defined(_M_AMD64) || defined(__i386__) || defined(__x86_64__)
+#define TEST_SSE2
+#endif
+
+#define TEST_BUFFER_SIZE 0x11000
+#define TEST_MAX_LENGTH  2300
+#define TEST_ALIGNMENTS  16
+
+static UCHAR Data[TEST_BUFFER_SIZE];
+static UCHAR Copy[TEST_BUFFER_SIZE];
+static ULONG Failures;
+
+#define ok(Condition, ...) \
+    do { if (!(Condition)) { Failures++; printf(__VA_ARGS__); } } while (0)
+
+/* RFC 1071, 16 bits at a time, the way the driver used to do it */
+static ULONG ReferenceChecksum(CONST UCHAR *Buffer, UINT Count, ULONG Seed)
+{
+    ULONGLONG Sum = Seed;
+
+    while (Count > 1)
+    {
+        Sum += *(USHORT *)Buffer;
+        Buffer += sizeof(USHORT);
+        Count -= sizeof(USHORT);
+    }
+
+    if (Count > 0)
+        Sum += *Buffer;
+
+    while (Sum >> 16)
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+
+    return (ULONG)Sum;
+}
+
+static ULONG Fold64(ULONGLONG Sum)
+{
+    while (Sum >> 16)
+        Sum = (Sum & 0xFFFF) + (Sum >> 16);
+
+    return (ULONG)Sum;
+}
+
+static void TestVariants(void)
+{
+    UINT Length, Source, Target;
+    ULONG Seed, Expected;
+
+    for (Length = 0; Length <= TEST_MAX_LENGTH; Length += (Length < 300) ? 1 : 7)
+    {
+        for (Source = 0; Source < TEST_ALIGNMENTS; Source++)
+        {
+            Seed = (ULONG)rand() * 0x10001;
+            Expected = ReferenceChecksum(Data + Source, Length, ChecksumFold(Seed));
+
+            ok(Fold64(ChecksumComputeGeneric(NULL, Data + Source, Length) + Seed) == Expected,
+               "Generic: length %u, offset %u\n", Length, Source);
+#ifdef TEST_SSE2
+            ok(Fold64(ChecksumComputeSse2(NULL, Data + Source, Length) + Seed) == Expected,
+               "SSE2: length %u, offset %u\n", Length, Source);
+#endif
+            ok(ChecksumFold(ChecksumCompute(Data + Source, Length, Seed)) == Expected,
+               "Compute: length %u, offset %u\n", Length, Source);
+
+            /* The copy must not touch anything past the end either */
+            Target = (Source * 5 + 3) % TEST_ALIGNMENTS;
+            memset(Copy, 0xCC, Length + 2 * TEST_ALIGNMENTS);
+            ok(ChecksumFold(ChecksumCopy(Copy + Target, Data + Source, Length, Seed)) == Expected,
+               "Copy: length %u, offsets %u/%u\n", Length, Source, Target);
+            ok(memcmp(Copy + Target, Data + Source, Length) == 0 &&
+               Copy[Target + Length] == 0xCC,
+               "Copy data: length %u, offsets %u/%u\n", Length, Source, Target);
+#ifdef TEST_SSE2
+            memset(Copy, 0xCC, Length + 2 * TEST_ALIGNMENTS);
+            ok(Fold64(ChecksumComputeSse2(Copy + Target, Data + Source, Length) + Seed) == Expected,
+               "SSE2 copy: length %u, offsets %u/%u\n", Length, Source, Target);
+            ok(memcmp(Copy + Target, Data + Source, Length) == 0 &&
+               Copy[Target + Length] == 0xCC,
+               "SSE2 copy data: length %u, offsets %u/%u\n", Length, Source, Target);
+#endif
+        }
+    }
+}
+
+static void TestCombine(void)
+{
+    UINT Length, Split, Source;
+    ULONG Sum;
+
+    for (Length = 1; Length <= 1500; Length += 97)
+    {
+        for (Source = 0; Source < 4; Source++)
+        {
+            for (Split = 0; Split <= Length; Split++)
+            {
+                Sum = ChecksumCombine(ChecksumCompute(Data + Source, Split, 0),
+                                      ChecksumCompute(Data + Source + Split, Length - Split, 0),
+                                      Split);
+                ok(ChecksumFold(Sum) == ReferenceChecksum(Data + Source, Length, 0),
+                   "Combine: length %u, offset %u, split %u\n", Length, Source, Split);
+            }
+        }
+    }
+}
+
+static void TestEdges(void)
+{
+    static CONST UCHAR Rfc1071[] = { 0x00, 0x01, 0xF2, 0x03, 0xF4, 0xF5, 0xF6, 0xF7 };
+    IPv4_HEADER Header;
+    ULONG Sum;
+
+    /* The example from RFC 1071, which sums to 0xDDF2 in network order */
+    Sum = ChecksumFold(ChecksumCompute((PVOID)Rfc1071, sizeof(Rfc1071), 0));
+    ok(WN2H((USHORT)Sum) == 0xDDF2, "RFC 1071 example: got 0x%x\n", WN2H((USHORT)Sum));
+
+    /* A largest datagram of 0xFF bytes must not overflow the accumulator */
+    memset(Copy, 0xFF, 0x10000);
+    ok(ChecksumFold(ChecksumCompute(Copy, 0x10000, 0xFFFFFFFF)) == 0xFFFF,
+       "All ones: got 0x%x\n", ChecksumFold(ChecksumCompute(Copy, 0x10000, 0xFFFFFFFF)));
+    ok(ChecksumFold(ChecksumCompute(Copy, 0xFFFF, 0xFFFFFFFF)) == ReferenceChecksum(Copy, 0xFFFF, 0xFFFF),
+       "All ones, odd length\n");
+
+    /* UDP adds the pseudo header, check it against a single pass over all of it */
+    Header.SrcAddr = 0x0100A8C0;
+    Header.DstAddr = 0x0200A8C0;
+    memcpy(Copy, &Header.SrcAddr, 4);
+    memcpy(Copy + 4, &Header.DstAddr, 4);
+    Copy[8] = 0;
+    Copy[9] = IPPROTO_UDP;
+    Copy[10] = 0;
+    Copy[11] = 101;
+    memcpy(Copy + 12, Data, 101);
+    Copy[113] = 0;
+    Sum = ReferenceChecksum(Copy, 114, 0);
+    ok(UDPv4ChecksumCalculate(&Header, Data, 101) == (ULONG)~WN2H((USHORT)Sum),
+       "UDP checksum: got 0x%x\n", UDPv4ChecksumCalculate(&Header, Data, 101));
+}
+
+int main(void)
+{
+    UINT i;
+
+    srand(0x1071);
+    for (i = 0; i < TEST_BUFFER_SIZE; i++)
+        Data[i] = (UCHAR)rand();
+
+    ChecksumInitialize();
+
+    TestVariants();
+    TestCombine();
+    TestEdges();
+
+    printf("checksum_test: %lu failures\n", (unsigned long)Failures);
+    return Failures ? 1 : 0;
+}
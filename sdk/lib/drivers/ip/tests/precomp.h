@@ -0,0 +1,36 @@
+/*
+ * PROJECT:     ReactOS TCP/IP protocol driver
+ * LICENSE:     GPL-2.0+ (https://spdx.org/licenses/GPL-2.0+)
+ * PURPOSE:     Just enough of the driver environment to build checksum.c on the host
+ * COPYRIGHT:   Copyright 2026 ReactOS Team
+ */
+
+#pragma once
+
+#include <typedefs.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CONST const
+#define UNALIGNED
+
+/* The test calls each routine directly, so let ChecksumCompute pick SSE2 too */
+#define PF_XMMI64_INSTRUCTIONS_AVAILABLE 10
+#define ExIsProcessorFeaturePresent(Feature) TRUE
+
+typedef ULONG KFLOATING_SAVE;
+#define KeSaveFloatingPointState(FloatSave) 0
+#define KeRestoreFloatingPointState(FloatSave)
+
+typedef ULONG IPv4_RAW_ADDRESS;
+
+typedef struct IPv4_HEADER {
+    IPv4_RAW_ADDRESS SrcAddr;
+    IPv4_RAW_ADDRESS DstAddr;
+} IPv4_HEADER, *PIPv4_HEADER;
+
+#define IPPROTO_UDP 17
+#define WN2H(w) ((USHORT)((((w) & 0xFF) << 8) | (((w) & 0xFF00) >> 8)))
+#define WH2N(w) WN2H(w)
+
+#include <checksum.h>
@@ -7,6 +7,98 @@
 #include "lwip/api.h"
 #include "lwip/tcpip.h"
 
+static
+VOID
+TCPPrepareOffload(
+    struct netif *netif,
+    u8_t Flags,
+    PIP_PACKET Packet,
+    PIP_INTERFACE IF)
+/*
+ * FUNCTION: Hands the work lwIP left out of a TCP segment to the adapter
+ * ARGUMENTS:
+ *     netif  = lwIP interface the segment was built for
+ *     Flags  = pbuf flags of the segment
+ *     Packet = IP packet about to be sent
+ *     IF     = Interface the packet is routed to
+ * NOTES:
+ *     lwIP leaves the TCP checksum to adapters that can compute it (the
+ *     field only holds the pseudo header sum) and queues segments larger
+ *     than the MSS for adapters that cut them. If the route goes through
+ *     an interface that can't (e.g. loopback) we finish the checksum here
+ *     and let IP fragment the segment. The same goes for packets to our
+ *     own addresses, NDIS loops those back without passing them to the
+ *     miniport.
+ */
+{
+    NDIS_TCP_IP_CHECKSUM_PACKET_INFO ChecksumInfo;
+    TCPv4_PSEUDO_HEADER PseudoHeader;
+    PIPv4_HEADER Header = Packet->Header;
+    PTCPv4_HEADER TcpHeader;
+    ULONG HeaderLength, TcpLength, Mss;
+    ULONG ChecksumOffload = 0, LargeSendSize = 0;
+    BOOLEAN LargeSend;
+
+    if (Header->Protocol != IPPROTO_TCP)
+        return;
+
+    if (!AddrLocateInterface(&Packet->DstAddr))
+    {
+        ChecksumOffload = IF->ChecksumOffload;
+        LargeSendSize = IF->LargeSendSize;
+    }
+
+    HeaderLength = (Header->VerIHL & 0x0F) << 2;
+    TcpHeader = (PTCPv4_HEADER)((PCHAR)Header + HeaderLength);
+    TcpLength = Packet->TotalSize - HeaderLength;
+    Mss = IF->MTU - HeaderLength - TCP_DATA_OFFSET(TcpHeader->DataOffset);
+
+    LargeSend = (Flags & PBUF_FLAG_TCP_LSO) &&
+                LargeSendSize >= TcpLength - TCP_DATA_OFFSET(TcpHeader->DataOffset);
+
+    ChecksumInfo.Value = 0;
+
+    if (ChecksumOffload & IP_OFFLOAD_IP_CHECKSUM)
+    {
+        ChecksumInfo.Transmit.NdisPacketChecksumV4 = 1;
+        ChecksumInfo.Transmit.NdisPacketIpChecksum = 1;
+    }
+
+    if (!NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_TCP))
+    {
+        if ((ChecksumOffload & IP_OFFLOAD_TCP_CHECKSUM) &&
+            (LargeSend || !(Flags & PBUF_FLAG_TCP_LSO)))
+        {
+            ChecksumInfo.Transmit.NdisPacketChecksumV4 = 1;
+            ChecksumInfo.Transmit.NdisPacketTcpChecksum = 1;
+        }
+        else
+        {
+            PseudoHeader.SourceAddress = Header->SrcAddr;
+            PseudoHeader.DestinationAddress = Header->DstAddr;
+            PseudoHeader.Zero = 0;
+            PseudoHeader.Protocol = IPPROTO_TCP;
+            PseudoHeader.TCPLength = WH2N((USHORT)TcpLength);
+
+            TcpHeader->Checksum = 0;
+            TcpHeader->Checksum = (USHORT)IPv4Checksum(TcpHeader,
+                                                       TcpLength,
+                                                       ChecksumCompute(&PseudoHeader,
+                                                                       sizeof(PseudoHeader),
+                                                                       0));
+        }
+    }
+
+    /* These are NOT pointers. MSDN explicitly says so. */
+    NDIS_PER_PACKET_INFO_FROM_PACKET(Packet->NdisPacket,
+                                     TcpIpChecksumPacketInfo) = (PVOID)(ULONG_PTR)ChecksumInfo.Value;
+    if (LargeSend)
+    {
+        NDIS_PER_PACKET_INFO_FROM_PACKET(Packet->NdisPacket,
+                                         TcpLargeSendPacketInfo) = (PVOID)(ULONG_PTR)Mss;
+    }
+}
+
 err_t
 TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
 {
@@ -17,6 +109,7 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
     PIPv4_HEADER Header;
     ULONG Length;
     ULONG TotalLength;
+    u8_t Flags = p->flags;
 
     /* The caller frees the pbuf struct */
 
@@ -70,6 +163,8 @@ TCPSendDataCallback(struct netif *netif, struct pbuf *p, struct ip_addr *dest)
     Packet.SrcAddr = LocalAddress;
     Packet.DstAddr = RemoteAddress;
 
+    TCPPrepareOffload(netif, Flags, &Packet, NCE->Interface);
+
     NdisStatus = IPSendDatagram(&Packet, NCE);
     if (!NT_SUCCESS(NdisStatus))
         return ERR_RTE;
@@ -96,6 +191,7 @@ err_t
 TCPInterfaceInit(struct netif *netif)
 {
     PIP_INTERFACE IF = netif->state;
+    u16_t ChecksumFlags;
     
     netif->hwaddr_len = IF->AddressLength;
     RtlCopyMemory(netif->hwaddr, IF->Address, netif->hwaddr_len);
@@ -107,6 +203,18 @@ TCPInterfaceInit(struct netif *netif)
     netif->name[1] = 'n';
     
     netif->flags |= NETIF_FLAG_BROADCAST;
+
+    /* Leave what the adapter offloads out of the software path */
+    ChecksumFlags = NETIF_CHECKSUM_ENABLE_ALL;
+    if (IF->ChecksumOffload & IP_OFFLOAD_IP_CHECKSUM)
+        ChecksumFlags &= ~NETIF_CHECKSUM_GEN_IP;
+    if (IF->ChecksumOffload & IP_OFFLOAD_TCP_CHECKSUM)
+        ChecksumFlags &= ~NETIF_CHECKSUM_GEN_TCP;
+    /* LibIPInsertPacket verifies TCP checksums while copying the packet */
+    ChecksumFlags &= ~NETIF_CHECKSUM_CHECK_TCP;
+    NETIF_SET_CHECKSUM_CTRL(netif, ChecksumFlags);
+
+    netif->lso_max_size = IF->LargeSendSize;
     
     TCPUpdateInterfaceLinkStatus(IF);
     
@@ -691,6 +691,39 @@ TCPSetNoDelay(
     return STATUS_SUCCESS;
 }
 
+NTSTATUS
+TCPSetReceiveWindow(
+    PCONNECTION_ENDPOINT Connection,
+    ULONG Size)
+{
+    if (!Connection)
+        return STATUS_UNSUCCESSFUL;
+
+    /* Remembered so that it also applies to the PCB created by TCPSocket */
+    Connection->ReceiveWindowSize = Size;
+
+    if (Connection->SocketContext == NULL)
+        return STATUS_SUCCESS;
+
+    return TCPTranslateError(LibTCPSetBufferSizes(Connection));
+}
+
+NTSTATUS
+TCPSetSendBuffer(
+    PCONNECTION_ENDPOINT Connection,
+    ULONG Size)
+{
+    if (!Connection)
+        return STATUS_UNSUCCESSFUL;
+
+    Connection->SendBufferSize = Size;
+
+    if (Connection->SocketContext == NULL)
+        return STATUS_SUCCESS;
+
+    return TCPTranslateError(LibTCPSetBufferSizes(Connection));
+}
+
 NTSTATUS
 TCPGetSocketStatus(
     PCONNECTION_ENDPOINT Connection,
@@ -112,9 +112,21 @@
   #error "MEMP_NUM_REASSDATA > IP_REASS_MAX_PBUFS doesn't make sense since each struct ip_reassdata must hold 2 pbufs at least!"
 #endif
 #endif /* !MEMP_MEM_MALLOC */
+#if !LWIP_WND_SCALE
 #if (LWIP_TCP && (TCP_WND > 0xffff))
-  #error "If you want to use TCP, TCP_WND must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
+  #error "If you want to use TCP, TCP_WND must fit in an u16_t, so, you have to reduce it in your lwipopts.h (or enable window scaling)"
 #endif
+#if (LWIP_TCP && (TCP_SND_BUF > 0xffff))
+  #error "If you want to use TCP, TCP_SND_BUF must fit in an u16_t, so, you have to reduce it in your lwipopts.h (or enable window scaling)"
+#endif
+#else /* !LWIP_WND_SCALE */
+#if (LWIP_TCP && (TCP_RCV_SCALE > 14))
+  #error "TCP_RCV_SCALE must be in the range of [0..14] (RFC 7323)"
+#endif
+#if (LWIP_TCP && ((TCP_WND >> TCP_RCV_SCALE) > 0xffff))
+  #error "TCP_WND does not fit into the window field with TCP_RCV_SCALE, so, you have to reduce it or raise TCP_RCV_SCALE in your lwipopts.h"
+#endif
+#endif /* !LWIP_WND_SCALE */
 #if (LWIP_TCP && (TCP_SND_QUEUELEN > 0xffff))
   #error "If you want to use TCP, TCP_SND_QUEUELEN must fit in an u16_t, so, you have to reduce it in your lwipopts.h"
 #endif
@@ -127,6 +139,9 @@
 #if (LWIP_TCP && TCP_LISTEN_BACKLOG && (TCP_DEFAULT_LISTEN_BACKLOG < 0) || (TCP_DEFAULT_LISTEN_BACKLOG > 0xff))
   #error "If you want to use TCP backlog, TCP_DEFAULT_LISTEN_BACKLOG must fit into an u8_t"
 #endif
+#if (LWIP_TCP && LWIP_TCP_LSO && LWIP_CHECKSUM_ON_COPY)
+  #error "LWIP_TCP_LSO can't split segments checksummed on copy, so, you have to disable LWIP_CHECKSUM_ON_COPY in your lwipopts.h"
+#endif
 #if (LWIP_NETIF_API && (NO_SYS==1))
   #error "If you want to use NETIF API, you have to define NO_SYS=0 in your lwipopts.h"
 #endif
@@ -147,6 +147,12 @@ netif_add(struct netif *netif, ip_addr_t *ipaddr, ip_addr_t *netmask,
   ip_addr_set_zero(&netif->netmask);
   ip_addr_set_zero(&netif->gw);
   netif->flags = 0;
+#if LWIP_CHECKSUM_CTRL_PER_NETIF
+  netif->chksum_flags = NETIF_CHECKSUM_ENABLE_ALL;
+#endif /* LWIP_CHECKSUM_CTRL_PER_NETIF */
+#if LWIP_TCP_LSO
+  netif->lso_max_size = 0;
+#endif /* LWIP_TCP_LSO */
 #if LWIP_DHCP
   /* netif not under DHCP control by default */
   netif->dhcp = NULL;
@@ -80,6 +80,63 @@
 /* Forward declarations.*/
 static void tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb);
 
+#if LWIP_TCP_LSO
+/** Largest payload of a segment handed to a netif for segmentation, so that
+ * the IP datagram length (with any options) still fits in 16 bits */
+#define TCP_LSO_MAX_PAYLOAD (0xFFFF - IP_HLEN - TCP_HLEN - 40)
+#endif /* LWIP_TCP_LSO */
+
+#if CHECKSUM_GEN_TCP
+/**
+ * Sum of the TCP pseudo header, not complemented. This is what goes into the
+ * checksum field of segments whose checksum the hardware computes.
+ *
+ * @param src source ip address
+ * @param dest destination ip address
+ * @param proto_len TCP length (header and data) to include
+ * @return the folded pseudo header sum in network byte order
+ */
+static u16_t
+tcp_pseudo_hdr_chksum(ip_addr_t *src, ip_addr_t *dest, u16_t proto_len)
+{
+  u32_t acc;
+  u32_t addr;
+
+  addr = ip4_addr_get_u32(src);
+  acc = (addr & 0xffffUL);
+  acc += ((addr >> 16) & 0xffffUL);
+  addr = ip4_addr_get_u32(dest);
+  acc += (addr & 0xffffUL);
+  acc += ((addr >> 16) & 0xffffUL);
+  acc += (u32_t)htons((u16_t)IP_PROTO_TCP);
+  acc += (u32_t)htons(proto_len);
+
+  acc = FOLD_U32T(acc);
+  acc = FOLD_U32T(acc);
+  return (u16_t)acc;
+}
+
+/**
+ * Fill in the checksum of a TCP segment built outside of tcp_output_segment,
+ * or just the pseudo header sum if the outgoing netif computes it.
+ *
+ * @param p the segment, p->payload pointing to the TCP header
+ * @param src source ip address
+ * @param dest destination ip address
+ */
+static void
+tcp_output_chksum(struct pbuf *p, ip_addr_t *src, ip_addr_t *dest)
+{
+  struct tcp_hdr *tcphdr = (struct tcp_hdr *)p->payload;
+
+  if (!NETIF_CHECKSUM_ENABLED(ip_route(dest), NETIF_CHECKSUM_GEN_TCP)) {
+    tcphdr->chksum = tcp_pseudo_hdr_chksum(src, dest, p->tot_len);
+  } else {
+    tcphdr->chksum = inet_chksum_pseudo(p, src, dest, IP_PROTO_TCP, p->tot_len);
+  }
+}
+#endif /* CHECKSUM_GEN_TCP */
+
 /** Allocate a pbuf and create a tcphdr at p->payload, used for output
  * functions other than the default tcp_output -> tcp_output_segment
  * (e.g. tcp_send_empty_ack, etc.)
@@ -105,7 +162,7 @@ tcp_output_alloc_header(struct tcp_pcb *pcb, u16_t optlen, u16_t datalen,
     tcphdr->seqno = seqno_be;
     tcphdr->ackno = htonl(pcb->rcv_nxt);
     TCPH_HDRLEN_FLAGS_SET(tcphdr, (5 + optlen / 4), TCP_ACK);
-    tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+    tcphdr->wnd = htons(TCPWND16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
     tcphdr->chksum = 0;
     tcphdr->urgp = 0;
 
@@ -284,6 +341,149 @@ tcp_seg_add_chksum(u16_t chksum, u16_t len, u16_t *seg_chksum,
 }
 #endif /* TCP_CHECKSUM_ON_COPY */
 
+#if LWIP_TCP_LSO
+/**
+ * Returns the largest segment (payload and options) tcp_write may queue.
+ * If the netif towards the remote host cuts large segments itself, this is a
+ * multiple of the MSS, otherwise mss_local is returned unchanged.
+ *
+ * @param pcb the tcp_pcb data is queued for
+ * @param mss_local the segment size tcp_write would use otherwise
+ * @param optlen length of the options in every segment
+ */
+static u16_t
+tcp_lso_seg_size(struct tcp_pcb *pcb, u16_t mss_local, u8_t optlen)
+{
+  struct netif *netif;
+  u32_t max_len;
+  u16_t payload = pcb->mss - optlen;
+
+  if (mss_local != pcb->mss) {
+    return mss_local;
+  }
+  /* the netif cuts at its MTU, which must match the MSS we send with */
+  netif = ip_route(&(pcb->remote_ip));
+  if ((netif == NULL) || (netif->lso_max_size == 0) ||
+      (pcb->mss + IP_HLEN + TCP_HLEN != netif->mtu)) {
+    return mss_local;
+  }
+  /* still no bigger than half the maximum window we ever received */
+  max_len = LWIP_MIN(netif->lso_max_size, pcb->snd_wnd_max / 2);
+  max_len = LWIP_MIN(max_len, TCP_LSO_MAX_PAYLOAD);
+  if (max_len < 2 * (u32_t)payload) {
+    return mss_local;
+  }
+  return (u16_t)((max_len / payload) * payload + optlen);
+}
+
+/**
+ * Split the first segment on the unsent queue so that it carries split bytes
+ * and the rest goes into a new segment queued right after it.
+ *
+ * @param pcb the tcp_pcb whose unsent queue is split
+ * @param split number of bytes to leave in the first segment
+ * @return ERR_OK if split (or nothing to do), ERR_MEM if out of memory
+ */
+static err_t
+tcp_split_unsent_seg(struct tcp_pcb *pcb, u16_t split)
+{
+  struct tcp_seg *seg, *useg = pcb->unsent;
+  struct pbuf *p;
+  u8_t optlen;
+  u8_t split_flags;
+  u8_t remainder_flags;
+  u16_t remainder;
+  u16_t offset;
+
+  if ((useg == NULL) || (split == 0) || (useg->len <= split)) {
+    return ERR_OK;
+  }
+
+  optlen = LWIP_TCP_OPT_LENGTH(useg->flags);
+  remainder = useg->len - split;
+
+  /* the remainder gets a copy of the data, headers are built by tcp_output */
+  p = pbuf_alloc(PBUF_TRANSPORT, remainder + optlen, PBUF_RAM);
+  if (p == NULL) {
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 2, ("tcp_split_unsent_seg: no memory.\n"));
+    return ERR_MEM;
+  }
+  /* skip whatever headers are in front of the data */
+  offset = useg->p->tot_len - useg->len + split;
+  if (pbuf_copy_partial(useg->p, (u8_t *)p->payload + optlen, remainder, offset) != remainder) {
+    pbuf_free(p);
+    return ERR_BUF;
+  }
+
+  /* PSH and FIN belong to the end of the data */
+  split_flags = TCPH_FLAGS(useg->tcphdr);
+  remainder_flags = 0;
+  if (split_flags & TCP_PSH) {
+    split_flags &= ~TCP_PSH;
+    remainder_flags |= TCP_PSH;
+  }
+  if (split_flags & TCP_FIN) {
+    split_flags &= ~TCP_FIN;
+    remainder_flags |= TCP_FIN;
+  }
+
+  seg = tcp_create_segment(pcb, p, remainder_flags, ntohl(useg->tcphdr->seqno) + split, useg->flags);
+  if (seg == NULL) {
+    return ERR_MEM;
+  }
+
+  /* trim the original segment, the total amount of data (snd_buf) stays the same */
+  pcb->snd_queuelen -= pbuf_clen(useg->p);
+  pbuf_realloc(useg->p, useg->p->tot_len - remainder);
+  useg->len -= remainder;
+  TCPH_FLAGS_SET(useg->tcphdr, split_flags);
+  pcb->snd_queuelen += pbuf_clen(useg->p);
+  pcb->snd_queuelen += pbuf_clen(seg->p);
+
+#if TCP_OVERSIZE
+  if (useg->next == NULL) {
+    /* the new tail has no room left at its end */
+    pcb->unsent_oversize = 0;
+  }
+#if TCP_OVERSIZE_DBGCHECK
+  useg->oversize_left = 0;
+#endif /* TCP_OVERSIZE_DBGCHECK */
+#endif /* TCP_OVERSIZE */
+
+  seg->next = useg->next;
+  useg->next = seg;
+  return ERR_OK;
+}
+
+/**
+ * A large segment at the head of the unsent queue is only sent once the
+ * window covers all of it, which may never happen (e.g. cwnd after a
+ * retransmission timeout). Cut it down to the MSS sized segments that fit.
+ *
+ * @param pcb the tcp_pcb about to send
+ * @param wnd the current send window (min of snd_wnd and cwnd)
+ */
+static void
+tcp_lso_fit_unsent(struct tcp_pcb *pcb, u32_t wnd)
+{
+  struct tcp_seg *seg = pcb->unsent;
+  u32_t inflight, fit;
+  u16_t payload;
+
+  if (seg == NULL) {
+    return;
+  }
+  payload = pcb->mss - LWIP_TCP_OPT_LENGTH(seg->flags);
+  inflight = ntohl(seg->tcphdr->seqno) - pcb->lastack;
+  if ((seg->len <= payload) || (inflight + seg->len <= wnd)) {
+    return;
+  }
+  fit = (wnd > inflight) ? (wnd - inflight) : 0;
+  fit = LWIP_MAX(fit - fit % payload, payload);
+  tcp_split_unsent_seg(pcb, (u16_t)fit);
+}
+#endif /* LWIP_TCP_LSO */
+
 /** Checks if tcp_write is allowed or not (checks state, snd_buf and snd_queuelen).
  *
  * @param pcb the tcp pcb to check for
@@ -306,7 +506,7 @@ tcp_write_checks(struct tcp_pcb *pcb, u16_t len)
 
   /* fail on too much data */
   if (len > pcb->snd_buf) {
-    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too much data (len=%"U16_F" > snd_buf=%"U16_F")\n",
+    LWIP_DEBUGF(TCP_OUTPUT_DEBUG | 3, ("tcp_write: too much data (len=%"U16_F" > snd_buf=%"TCPWNDSIZE_F")\n",
       len, pcb->snd_buf));
     pcb->flags |= TF_NAGLEMEMERR;
     return ERR_MEM;
@@ -370,7 +570,7 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 #endif /* TCP_CHECKSUM_ON_COPY */
   err_t err;
   /* don't allocate segments bigger than half the maximum window we ever received */
-  u16_t mss_local = LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
+  u16_t mss_local = (u16_t)LWIP_MIN(pcb->mss, pcb->snd_wnd_max/2);
 
 #if LWIP_NETIF_TX_SINGLE_PBUF
   /* Always copy to try to create single pbufs for TX */
@@ -395,6 +595,10 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
   }
 #endif /* LWIP_TCP_TIMESTAMPS */
 
+#if LWIP_TCP_LSO
+  mss_local = tcp_lso_seg_size(pcb, mss_local, optlen);
+#endif /* LWIP_TCP_LSO */
+
 
   /*
    * TCP segmentation is done in three phases with increasing complexity:
@@ -429,6 +633,12 @@ tcp_write(struct tcp_pcb *pcb, const void *arg, u16_t len, u8_t apiflags)
 
     /* Usable space at the end of the last unsent segment */
     unsent_optlen = LWIP_TCP_OPT_LENGTH(last_unsent->flags);
+#if LWIP_TCP_LSO
+    /* the segment may have been queued with a larger mss_local */
+    if (last_unsent->len + unsent_optlen >= mss_local) {
+      space = 0;
+    } else
+#endif /* LWIP_TCP_LSO */
     space = mss_local - (last_unsent->len + unsent_optlen);
 
     /*
@@ -742,6 +952,13 @@ tcp_enqueue_flags(struct tcp_pcb *pcb, u8_t flags)
 
   if (flags & TCP_SYN) {
     optflags = TF_SEG_OPTS_MSS;
+#if LWIP_WND_SCALE
+    if ((pcb->state != SYN_RCVD) || (pcb->flags & TF_WND_SCALE)) {
+      /* In a <SYN,ACK> (sent in state SYN_RCVD), the window scale option may only
+         be sent if we received a window scale option from the remote host. */
+      optflags |= TF_SEG_OPTS_WND_SCALE;
+    }
+#endif /* LWIP_WND_SCALE */
   }
 #if LWIP_TCP_TIMESTAMPS
   if ((pcb->flags & TF_TIMESTAMP)) {
@@ -872,8 +1089,7 @@ tcp_send_empty_ack(struct tcp_pcb *pcb)
 #endif 
 
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, &(pcb->local_ip), &(pcb->remote_ip),
-        IP_PROTO_TCP, p->tot_len);
+  tcp_output_chksum(p, &(pcb->local_ip), &(pcb->remote_ip));
 #endif
 #if LWIP_NETIF_HWADDRHINT
   ip_output_hinted(p, &(pcb->local_ip), &(pcb->remote_ip), pcb->ttl, pcb->tos,
@@ -917,6 +1133,9 @@ tcp_output(struct tcp_pcb *pcb)
 
   wnd = LWIP_MIN(pcb->snd_wnd, pcb->cwnd);
 
+#if LWIP_TCP_LSO
+  tcp_lso_fit_unsent(pcb, wnd);
+#endif /* LWIP_TCP_LSO */
   seg = pcb->unsent;
 
   /* If the TF_ACK_NOW flag is set and no data will be sent (either
@@ -945,13 +1164,13 @@ tcp_output(struct tcp_pcb *pcb)
 #endif /* TCP_OUTPUT_DEBUG */
 #if TCP_CWND_DEBUG
   if (seg == NULL) {
-    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"U16_F
-                                 ", cwnd %"U16_F", wnd %"U32_F
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F
+                                 ", cwnd %"TCPWNDSIZE_F", wnd %"U32_F
                                  ", seg == NULL, ack %"U32_F"\n",
                                  pcb->snd_wnd, pcb->cwnd, wnd, pcb->lastack));
   } else {
     LWIP_DEBUGF(TCP_CWND_DEBUG, 
-                ("tcp_output: snd_wnd %"U16_F", cwnd %"U16_F", wnd %"U32_F
+                ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F
                  ", effwnd %"U32_F", seq %"U32_F", ack %"U32_F"\n",
                  pcb->snd_wnd, pcb->cwnd, wnd,
                  ntohl(seg->tcphdr->seqno) - pcb->lastack + seg->len,
@@ -975,7 +1194,7 @@ tcp_output(struct tcp_pcb *pcb)
       break;
     }
 #if TCP_CWND_DEBUG
-    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"U16_F", cwnd %"U16_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
+    LWIP_DEBUGF(TCP_CWND_DEBUG, ("tcp_output: snd_wnd %"TCPWNDSIZE_F", cwnd %"TCPWNDSIZE_F", wnd %"U32_F", effwnd %"U32_F", seq %"U32_F", ack %"U32_F", i %"S16_F"\n",
                             pcb->snd_wnd, pcb->cwnd, wnd,
                             ntohl(seg->tcphdr->seqno) + seg->len -
                             pcb->lastack,
@@ -1026,6 +1245,9 @@ tcp_output(struct tcp_pcb *pcb)
     } else {
       tcp_seg_free(seg);
     }
+#if LWIP_TCP_LSO
+    tcp_lso_fit_unsent(pcb, wnd);
+#endif /* LWIP_TCP_LSO */
     seg = pcb->unsent;
   }
 #if TCP_OVERSIZE
@@ -1039,6 +1261,7 @@ tcp_output(struct tcp_pcb *pcb)
   return ERR_OK;
 }
 
+
 /**
  * Called by tcp_output() to actually send a TCP segment over IP.
  *
@@ -1060,7 +1283,16 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
   seg->tcphdr->ackno = htonl(pcb->rcv_nxt);
 
   /* advertise our receive window size in this TCP segment */
-  seg->tcphdr->wnd = htons(pcb->rcv_ann_wnd);
+#if LWIP_WND_SCALE
+  if (seg->flags & TF_SEG_OPTS_WND_SCALE) {
+    /* The Window field in a SYN segment itself (the only type where we send
+       the window scale option) is never scaled. */
+    seg->tcphdr->wnd = htons(TCPWND16(pcb->rcv_ann_wnd));
+  } else
+#endif /* LWIP_WND_SCALE */
+  {
+    seg->tcphdr->wnd = htons(TCPWND16(RCV_WND_SCALE(pcb, pcb->rcv_ann_wnd)));
+  }
 
   pcb->rcv_ann_right_edge = pcb->rcv_nxt + pcb->rcv_ann_wnd;
 
@@ -1085,6 +1317,12 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
     opts += 3;
   }
 #endif
+#if LWIP_WND_SCALE
+  if (seg->flags & TF_SEG_OPTS_WND_SCALE) {
+    *opts = TCP_BUILD_WND_SCALE_OPTION();
+    opts += 1;
+  }
+#endif
 
   /* Set retransmission timer running if it is not currently enabled 
      This must be set before checking the route. */
@@ -1092,13 +1330,14 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
     pcb->rtime = 0;
   }
 
-  /* If we don't have a local IP address, we get one by
-     calling ip_route(). */
+  netif = ip_route(&(pcb->remote_ip));
+  if (netif == NULL) {
+    return;
+  }
+
+  /* If we don't have a local IP address, we take the one of the
+     outgoing netif. */
   if (ip_addr_isany(&(pcb->local_ip))) {
-    netif = ip_route(&(pcb->remote_ip));
-    if (netif == NULL) {
-      return;
-    }
     ip_addr_copy(pcb->local_ip, netif->ip_addr);
   }
 
@@ -1119,8 +1358,26 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
 
   seg->p->payload = seg->tcphdr;
 
+#if LWIP_TCP_LSO
+  /* segments larger than the MSS are cut into MSS sized ones by the netif */
+  if (seg->len > pcb->mss - LWIP_TCP_OPT_LENGTH(seg->flags)) {
+    seg->p->flags |= PBUF_FLAG_TCP_LSO;
+  } else {
+    seg->p->flags &= ~PBUF_FLAG_TCP_LSO;
+  }
+#endif /* LWIP_TCP_LSO */
+
   seg->tcphdr->chksum = 0;
 #if CHECKSUM_GEN_TCP
+  if (!NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_GEN_TCP)) {
+    /* The hardware completes the checksum, seed it with the pseudo header
+       sum. The length is left out of segments the netif cuts up. */
+    seg->tcphdr->chksum = tcp_pseudo_hdr_chksum(&(pcb->local_ip), &(pcb->remote_ip),
+#if LWIP_TCP_LSO
+           (seg->p->flags & PBUF_FLAG_TCP_LSO) ? 0 :
+#endif /* LWIP_TCP_LSO */
+           seg->p->tot_len);
+  } else
 #if TCP_CHECKSUM_ON_COPY
   {
     u32_t acc;
@@ -1155,9 +1412,11 @@ tcp_output_segment(struct tcp_seg *seg, struct tcp_pcb *pcb)
 #endif /* TCP_CHECKSUM_ON_COPY_SANITY_CHECK */
   }
 #else /* TCP_CHECKSUM_ON_COPY */
-  seg->tcphdr->chksum = inet_chksum_pseudo(seg->p, &(pcb->local_ip),
-         &(pcb->remote_ip),
-         IP_PROTO_TCP, seg->p->tot_len);
+  {
+    seg->tcphdr->chksum = inet_chksum_pseudo(seg->p, &(pcb->local_ip),
+           &(pcb->remote_ip),
+           IP_PROTO_TCP, seg->p->tot_len);
+  }
 #endif /* TCP_CHECKSUM_ON_COPY */
 #endif /* CHECKSUM_GEN_TCP */
   TCP_STATS_INC(tcp.xmit);
@@ -1212,13 +1471,12 @@ tcp_rst(u32_t seqno, u32_t ackno,
   tcphdr->seqno = htonl(seqno);
   tcphdr->ackno = htonl(ackno);
   TCPH_HDRLEN_FLAGS_SET(tcphdr, TCP_HLEN/4, TCP_RST | TCP_ACK);
-  tcphdr->wnd = PP_HTONS(TCP_WND);
+  tcphdr->wnd = PP_HTONS(((TCP_WND >> TCP_RCV_SCALE) & 0xFFFF));
   tcphdr->chksum = 0;
   tcphdr->urgp = 0;
 
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, local_ip, remote_ip,
-              IP_PROTO_TCP, p->tot_len);
+  tcp_output_chksum(p, local_ip, remote_ip);
 #endif
   TCP_STATS_INC(tcp.xmit);
   snmp_inc_tcpoutrsts();
@@ -1340,7 +1598,7 @@ tcp_rexmit_fast(struct tcp_pcb *pcb)
     /* The minimum value for ssthresh should be 2 MSS */
     if (pcb->ssthresh < 2*pcb->mss) {
       LWIP_DEBUGF(TCP_FR_DEBUG, 
-                  ("tcp_receive: The minimum value for ssthresh %"U16_F
+                  ("tcp_receive: The minimum value for ssthresh %"TCPWNDSIZE_F
                    " should be min 2 mss %"U16_F"...\n",
                    pcb->ssthresh, 2*pcb->mss));
       pcb->ssthresh = 2*pcb->mss;
@@ -1382,8 +1640,7 @@ tcp_keepalive(struct tcp_pcb *pcb)
   tcphdr = (struct tcp_hdr *)p->payload;
 
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, &pcb->local_ip, &pcb->remote_ip,
-                                      IP_PROTO_TCP, p->tot_len);
+  tcp_output_chksum(p, &pcb->local_ip, &pcb->remote_ip);
 #endif
   TCP_STATS_INC(tcp.xmit);
 
@@ -1463,8 +1720,7 @@ tcp_zero_window_probe(struct tcp_pcb *pcb)
   }
 
 #if CHECKSUM_GEN_TCP
-  tcphdr->chksum = inet_chksum_pseudo(p, &pcb->local_ip, &pcb->remote_ip,
-                                      IP_PROTO_TCP, p->tot_len);
+  tcp_output_chksum(p, &pcb->local_ip, &pcb->remote_ip);
 #endif
   TCP_STATS_INC(tcp.xmit);
 
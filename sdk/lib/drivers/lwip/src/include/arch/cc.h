@@ -43,8 +43,11 @@ typedef ULONG_PTR mem_ptr_t;
 /* Endianness */
 #define BYTE_ORDER LITTLE_ENDIAN
 
-/* Checksum calculation algorithm choice */
-#define LWIP_CHKSUM_ALGORITHM 3
+/* Checksum calculation, shared with the IP library (network/checksum.c) */
+ULONG ChecksumFold(ULONG Sum);
+ULONG ChecksumCompute(PVOID Data, UINT Count, ULONG Seed);
+ULONG ChecksumCopy(PVOID Destination, CONST VOID *Source, UINT Count, ULONG Seed);
+#define LWIP_CHKSUM(dataptr, len) ((u16_t)ChecksumFold(ChecksumCompute((dataptr), (len), 0)))
 
 /* Diagnostics */
 #define LWIP_PLATFORM_DIAG(x) (DbgPrint x)
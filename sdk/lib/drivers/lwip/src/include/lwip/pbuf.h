@@ -75,6 +75,9 @@ typedef enum {
 #define PBUF_FLAG_LLMCAST   0x10U
 /** indicates this pbuf includes a TCP FIN flag */
 #define PBUF_FLAG_TCP_FIN   0x20U
+/** indicates this pbuf is a TCP segment larger than the MSS that the netif
+    has to cut into MSS sized segments (see LWIP_TCP_LSO) */
+#define PBUF_FLAG_TCP_LSO   0x40U
 
 struct pbuf {
   /** next pbuf in singly linked pbuf chain */
@@ -64,9 +64,26 @@
  * add support for other transport mediums */
 #define TCP_MSS                         1460
 
-#define TCP_WND                         0xFFFF
+/* Windows above 64k are negotiated with the window scale option. These are
+ * the largest sizes a connection may grow to; rostcp starts every connection
+ * at 64k and lets it grow (or sets it from SO_RCVBUF/SO_SNDBUF) from there */
+#define LWIP_WND_SCALE                  1
 
-#define TCP_SND_BUF                     TCP_WND
+#define TCP_RCV_SCALE                   4
+
+#define TCP_WND                         (0xFFFF << TCP_RCV_SCALE)
+
+#define TCP_SND_BUF                     (1024 * 1024)
+
+/* Don't wait for a quarter of a megabyte of window to open up before telling
+ * the peer about it */
+#define TCP_WND_UPDATE_THRESHOLD        (4 * TCP_MSS)
+
+/* Let the NIC compute checksums and cut large segments when the miniport
+ * offers it; tcpip turns this on per interface */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+
+#define LWIP_TCP_LSO                    1
 
 #define TCP_MAXRTX                      8
 
@@ -12,6 +12,12 @@
     #define LWIP_QUEUE_TAG   'uQwl'
 #endif
 
+/* Buffer sizes of connections that haven't been given one by their client.
+ * They double whenever the peer manages to fill them, up to TCP_WND and
+ * TCP_SND_BUF */
+#define ROS_TCP_INITIAL_WND     0xFFFF
+#define ROS_TCP_INITIAL_SND_BUF 0xFFFF
+
 typedef struct tcp_pcb* PTCP_PCB;
 
 typedef struct _QUEUE_ENTRY
@@ -59,6 +65,9 @@ struct lwip_callback_msg
             PCONNECTION_ENDPOINT Connection;
             int Callback;
         } Close;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+        } SetBuffers;
     } Input;
     
     /* Output */
@@ -85,6 +94,9 @@ struct lwip_callback_msg
         struct {
             err_t Error;
         } Close;
+        struct {
+            err_t Error;
+        } SetBuffers;
     } Output;
 };
 
@@ -105,6 +117,7 @@ err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, con
 err_t       LibTCPConnect(PCONNECTION_ENDPOINT Connection, struct ip_addr *const ipaddr, const u16_t port);
 err_t       LibTCPShutdown(PCONNECTION_ENDPOINT Connection, const int shut_rx, const int shut_tx);
 err_t       LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback);
+err_t       LibTCPSetBufferSizes(PCONNECTION_ENDPOINT Connection);
 
 err_t       LibTCPGetPeerName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t *const port);
 err_t       LibTCPGetHostName(PTCP_PCB pcb, struct ip_addr *const ipaddr, u16_t *const port);
@@ -1,6 +1,7 @@
 #include "lwip/sys.h"
 #include "lwip/netif.h"
 #include "lwip/tcpip.h"
+#include "lwip/ip.h"
 
 #include "rosip.h"
 
@@ -8,12 +9,38 @@
 
 typedef struct netif* PNETIF;
 
+/* Copies a TCP segment and checks its checksum in the same pass */
+static
+BOOLEAN
+LibIPCopyTcpSegment(void *const dest,
+                    const void *const data,
+                    const u32_t size)
+{
+    const struct ip_hdr *iphdr = data;
+    u16_t hlen;
+    ULONG Sum;
+
+    hlen = IPH_HL(iphdr) * 4;
+    if (hlen < IP_HLEN || hlen > size)
+        return FALSE;
+
+    /* Pseudo header */
+    Sum = ChecksumCompute((PVOID)&iphdr->src, 2 * sizeof(ip_addr_p_t), 0);
+    Sum += htons(IP_PROTO_TCP) + htons((u16_t)(size - hlen));
+
+    RtlCopyMemory(dest, data, hlen);
+    Sum = ChecksumCopy((u8_t *)dest + hlen, (const u8_t *)data + hlen, size - hlen, Sum);
+
+    return (ChecksumFold(Sum) == 0xFFFF);
+}
+
 void
 LibIPInsertPacket(void *ifarg,
                   const void *const data,
                   const u32_t size)
 {
     struct pbuf *p;
+    PNETIF netif = ifarg;
 
     ASSERT(ifarg);
     ASSERT(data);
@@ -25,9 +52,24 @@ LibIPInsertPacket(void *ifarg,
         ASSERT(p->tot_len == p->len);
         ASSERT(p->len == size);
 
-        RtlCopyMemory(p->payload, data, p->len);
+        if (!NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_CHECK_TCP) &&
+            size >= IP_HLEN &&
+            IPH_PROTO((const struct ip_hdr *)data) == IP_PROTO_TCP)
+        {
+            /* lwIP leaves the checksum of TCP segments to us on this netif */
+            if (!LibIPCopyTcpSegment(p->payload, data, p->len))
+            {
+                DPRINT("Dropping TCP segment with bad checksum\n");
+                pbuf_free(p);
+                return;
+            }
+        }
+        else
+        {
+            RtlCopyMemory(p->payload, data, p->len);
+        }
 
-        ((PNETIF)ifarg)->input(p, (PNETIF)ifarg);
+        netif->input(p, netif);
     }
 }
 
@@ -1,6 +1,7 @@
 #include "lwip/sys.h"
 #include "lwip/netif.h"
 #include "lwip/tcpip.h"
+#include "lwip/tcp_impl.h"
 
 #include "rosip.h"
 
@@ -202,6 +203,28 @@ WaitForEventSafely(PRKEVENT Event)
     }
 }
 
+/* Zero sizes leave the current ones alone */
+static
+void
+LibTCPSetPcbBufferSizes(PTCP_PCB pcb, ULONG ReceiveWindow, ULONG SendBuffer)
+{
+    if (pcb->state == LISTEN)
+    {
+        /* Connections accepted from this PCB start with these sizes */
+        if (ReceiveWindow)
+            ((struct tcp_pcb_listen *)pcb)->rcv_wnd_max = LWIP_MAX(LWIP_MIN(ReceiveWindow, TCP_WND), TCP_MSS);
+        if (SendBuffer)
+            ((struct tcp_pcb_listen *)pcb)->snd_buf_max = LWIP_MAX(LWIP_MIN(SendBuffer, TCP_SND_BUF), 2 * TCP_MSS);
+    }
+    else
+    {
+        if (ReceiveWindow)
+            tcp_setrcvwnd(pcb, LWIP_MIN(ReceiveWindow, TCP_WND));
+        if (SendBuffer)
+            tcp_setsndbuf(pcb, LWIP_MIN(SendBuffer, TCP_SND_BUF));
+    }
+}
+
 static
 err_t
 InternalSendEventHandler(void *arg, PTCP_PCB pcb, const u16_t space)
@@ -233,6 +256,16 @@ InternalRecvEventHandler(void *arg, PTCP_PCB pcb, struct pbuf *p, const err_t er
     {
         LibTCPEnqueuePacket(Connection, p);
 
+        /* The peer used up all the window we offered, so it could have sent more.
+         * Let it, unless our client picked the window size itself. */
+        if (!Connection->ReceiveWindowSize &&
+            (pcb->flags & TF_WND_SCALE) &&
+            tcp_rcvwnd(pcb) < TCP_WND &&
+            TCP_SEQ_GEQ(pcb->rcv_nxt + pcb->mss, pcb->rcv_ann_right_edge))
+        {
+            tcp_setrcvwnd(pcb, 2 * tcp_rcvwnd(pcb));
+        }
+
         tcp_recved(pcb, p->tot_len);
 
         TCPRecvEventHandler(arg);
@@ -331,8 +364,15 @@ LibTCPSocketCallback(void *arg)
 
     if (msg->Output.Socket.NewPcb)
     {
-        tcp_arg(msg->Output.Socket.NewPcb, msg->Input.Socket.Arg);
+        PCONNECTION_ENDPOINT Connection = msg->Input.Socket.Arg;
+
+        tcp_arg(msg->Output.Socket.NewPcb, Connection);
         tcp_err(msg->Output.Socket.NewPcb, InternalErrorEventHandler);
+
+        /* Start small, the buffers grow as the connection needs them */
+        LibTCPSetPcbBufferSizes(msg->Output.Socket.NewPcb,
+                                Connection->ReceiveWindowSize ? Connection->ReceiveWindowSize : ROS_TCP_INITIAL_WND,
+                                Connection->SendBufferSize ? Connection->SendBufferSize : ROS_TCP_INITIAL_SND_BUF);
     }
 
     KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
@@ -497,6 +537,17 @@ LibTCPSendCallback(void *arg)
 
     SendFlags = TCP_WRITE_FLAG_COPY;
     SendLength = msg->Input.Send.DataLength;
+
+    /* The peer takes more than we can buffer, so buffer more.
+     * Unless our client picked the buffer size itself. */
+    if (!msg->Input.Send.Connection->SendBufferSize &&
+        tcp_sndbuf(pcb) < SendLength &&
+        tcp_sndbufsize(pcb) < TCP_SND_BUF &&
+        pcb->snd_wnd >= tcp_sndbufsize(pcb))
+    {
+        tcp_setsndbuf(pcb, 2 * tcp_sndbufsize(pcb));
+    }
+
     if (tcp_sndbuf(pcb) == 0)
     {
         /* No buffer space so return pending */
@@ -709,6 +760,57 @@ LibTCPShutdown(PCONNECTION_ENDPOINT Connection, const int shut_rx, const int shu
     return ERR_MEM;
 }
 
+static
+void
+LibTCPSetBufferSizesCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Connection = msg->Input.SetBuffers.Connection;
+
+    if (!Connection->SocketContext)
+    {
+        msg->Output.SetBuffers.Error = ERR_CLSD;
+        goto done;
+    }
+
+    LibTCPSetPcbBufferSizes(Connection->SocketContext,
+                            Connection->ReceiveWindowSize,
+                            Connection->SendBufferSize);
+
+    msg->Output.SetBuffers.Error = ERR_OK;
+
+done:
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+err_t
+LibTCPSetBufferSizes(PCONNECTION_ENDPOINT Connection)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+
+        msg->Input.SetBuffers.Connection = Connection;
+
+        tcpip_callback_with_block(LibTCPSetBufferSizesCallback, msg, 1);
+
+        if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.SetBuffers.Error;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
 static
 void
 LibTCPCloseCallback(void *arg)
@@ -795,8 +897,22 @@ LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback)
 void
 LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg)
 {
+    PCONNECTION_ENDPOINT Connection = arg;
+    PCONNECTION_ENDPOINT Listener = listen_pcb->callback_arg;
+
     ASSERT(arg);
 
+    /* The PCB inherited the listener's buffer sizes, and so does the
+     * connection. Sizes set on the accepting endpoint take precedence. */
+    if (Listener)
+    {
+        if (!Connection->ReceiveWindowSize)
+            Connection->ReceiveWindowSize = Listener->ReceiveWindowSize;
+        if (!Connection->SendBufferSize)
+            Connection->SendBufferSize = Listener->SendBufferSize;
+    }
+    LibTCPSetPcbBufferSizes(pcb, Connection->ReceiveWindowSize, Connection->SendBufferSize);
+
     tcp_arg(pcb, NULL);
     tcp_recv(pcb, InternalRecvEventHandler);
     tcp_sent(pcb, InternalSendEventHandler);
@@ -20,6 +20,82 @@
 #define COMPRESSION_FORMAT_MASK  0x00FF
 #define COMPRESSION_ENGINE_MASK  0xFF00
 
+#define LZNT1_CHUNK_SIZE         0x1000
+#define LZNT1_MIN_MATCH          3
+#define LZNT1_HASH_BITS          12
+#define LZNT1_HASH_SIZE          (1 << LZNT1_HASH_BITS)
+#define LZNT1_NIL                0xFFFF
+
+/* how many hash chain entries are probed for each position */
+#define LZNT1_STANDARD_CHAIN     8
+#define LZNT1_MAXIMUM_CHAIN      LZNT1_CHUNK_SIZE
+
+/* compressed chunk of LZNT1_CHUNK_SIZE zero bytes: a literal and a single backwards reference */
+static const UCHAR lznt1_zero_chunk[] = { 0x03, 0xB0, 0x02, 0x00, 0xFC, 0x0F };
+
+/* match finder state, kept in the caller supplied compression workspace */
+struct lznt1_workspace
+{
+    USHORT head[LZNT1_HASH_SIZE];
+    USHORT prev[LZNT1_CHUNK_SIZE];
+};
+
+#define XPRESS_MIN_MATCH         3
+#define XPRESS_MAX_MATCH         0xFFFF
+#define XPRESS_HASH_BITS         15
+#define XPRESS_HASH_SIZE         (1 << XPRESS_HASH_BITS)
+#define XPRESS_STANDARD_CHAIN    16
+#define XPRESS_MAXIMUM_CHAIN     128
+
+/* plain LZ77 reaches back 8 KB, the Huffman variant 64 KB */
+#define XPRESS_WINDOW_SIZE       0x2000
+#define XPRESS_HUFF_WINDOW_SIZE  0xFFFF
+#define XPRESS_HUFF_RING_SIZE    0x10000
+
+/* Huffman blocks cover 64 KB of data and start with 512 four bit code lengths */
+#define XPRESS_HUFF_BLOCK_SIZE   0x10000
+#define XPRESS_HUFF_SYMBOLS      512
+#define XPRESS_HUFF_MAX_BITS     15
+#define XPRESS_HUFF_TABLE_BITS   11
+#define XPRESS_HUFF_EOF          256
+
+/* match finder and Huffman code construction state, kept in the compression workspace.
+ * Plain XPRESS only uses the head table and the start of the position ring. */
+struct xpress_workspace
+{
+    ULONG head[XPRESS_HASH_SIZE];
+    ULONG prev[XPRESS_HUFF_RING_SIZE];
+    ULONG items[XPRESS_HUFF_BLOCK_SIZE];
+    ULONG freq[XPRESS_HUFF_SYMBOLS];
+    ULONG weight[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT parent[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT leaves[XPRESS_HUFF_SYMBOLS];
+    USHORT codes[XPRESS_HUFF_SYMBOLS];
+    UCHAR depth[2 * XPRESS_HUFF_SYMBOLS];
+    UCHAR lengths[XPRESS_HUFF_SYMBOLS];
+};
+
+#define XPRESS_WORKSPACE_SIZE    (FIELD_OFFSET(struct xpress_workspace, prev) + XPRESS_WINDOW_SIZE * sizeof(ULONG))
+
+/* canonical Huffman code of one block, as seen by the decoder */
+struct xpress_huff_code
+{
+    ULONG first_code[XPRESS_HUFF_MAX_BITS + 1];
+    USHORT count[XPRESS_HUFF_MAX_BITS + 1];
+    USHORT offset[XPRESS_HUFF_MAX_BITS + 1];
+    USHORT sorted[XPRESS_HUFF_SYMBOLS];
+};
+
+/* bit stream writer of the Huffman variant: 16 bit words of code bits are
+ * reserved ahead of time, extra length bytes go in between */
+struct xpress_huff_writer
+{
+    ULONG bitbuf;
+    ULONG bitcount;
+    UCHAR *next_bits;
+    UCHAR *next_bits2;
+    UCHAR *next_byte;
+};
 
 
 
@@ -216,28 +292,177 @@ out:
 }
 
 
+/* hash of the three bytes starting at p */
+static inline ULONG lznt1_hash(const UCHAR *p)
+{
+    return ((ULONG)(p[0] | (p[1] << 8) | (p[2] << 16)) * 2654435761u) >> (32 - LZNT1_HASH_BITS);
+}
+
+/* number of length bits of a backwards reference at this chunk position,
+ * mirrors the displacement bits computation in lznt1_decompress_chunk */
+static inline ULONG lznt1_length_bits(ULONG pos)
+{
+    ULONG displacement_bits;
+
+    for (displacement_bits = 12; displacement_bits > 4; displacement_bits--)
+        if ((1 << (displacement_bits - 1)) < pos) break;
+    return 16 - displacement_bits;
+}
+
+/* add all positions below limit to the hash chains */
+static inline void lznt1_hash_upto(struct lznt1_workspace *ws, const UCHAR *src, ULONG src_size,
+                                   ULONG *hashed, ULONG limit)
+{
+    ULONG hash;
+
+    while (*hashed < limit && *hashed + LZNT1_MIN_MATCH <= src_size)
+    {
+        hash = lznt1_hash(src + *hashed);
+        ws->prev[*hashed] = ws->head[hash];
+        ws->head[hash] = *hashed;
+        (*hashed)++;
+    }
+}
+
+/* find the longest earlier match for the data at pos, returns 0 if there is none */
+static ULONG lznt1_find_match(const struct lznt1_workspace *ws, const UCHAR *src, ULONG src_size,
+                              ULONG pos, ULONG max_chain, ULONG *displacement)
+{
+    ULONG max_length, best_length = 0, length, cand;
+
+    if (pos + LZNT1_MIN_MATCH > src_size)
+        return 0;
+
+    max_length = min((1 << lznt1_length_bits(pos)) - 1 + LZNT1_MIN_MATCH, src_size - pos);
+
+    /* chains are ordered by position, so the first hits are the closest ones.
+     * Matches may overlap pos, the decompressor copies byte by byte. */
+    cand = ws->head[lznt1_hash(src + pos)];
+    while (cand != LZNT1_NIL && max_chain--)
+    {
+        /* a candidate can only win if it agrees at the current best length */
+        if (src[cand + best_length] == src[pos + best_length])
+        {
+            for (length = 0; length < max_length; length++)
+                if (src[cand + length] != src[pos + length]) break;
+
+            if (length > best_length)
+            {
+                best_length = length;
+                *displacement = pos - cand;
+                if (length == max_length) break;
+            }
+        }
+        cand = ws->prev[cand];
+    }
+
+    return (best_length >= LZNT1_MIN_MATCH) ? best_length : 0;
+}
+
+/* compress a single LZNT1 chunk, returns NULL if it does not fit into dst_size */
+static UCHAR *lznt1_compress_chunk(UCHAR *dst, ULONG dst_size, const UCHAR *src, ULONG src_size,
+                                   struct lznt1_workspace *ws, ULONG max_chain, BOOLEAN lazy)
+{
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size, *flags = NULL;
+    ULONG pos = 0, hashed = 0, flag_bit = 8;
+    ULONG length, displacement, next_displacement;
+
+    memset(ws->head, 0xFF, sizeof(ws->head));
+
+    while (pos < src_size)
+    {
+        /* every 8 entities are preceded by a flags byte */
+        if (flag_bit == 8)
+        {
+            if (dst_cur >= dst_end) return NULL;
+            flags = dst_cur++;
+            *flags = 0;
+            flag_bit = 0;
+        }
+
+        lznt1_hash_upto(ws, src, src_size, &hashed, pos);
+        length = lznt1_find_match(ws, src, src_size, pos, max_chain, &displacement);
+
+        /* maximum engine: emit a literal if the next position starts a longer match */
+        if (length && lazy)
+        {
+            lznt1_hash_upto(ws, src, src_size, &hashed, pos + 1);
+            if (lznt1_find_match(ws, src, src_size, pos + 1, max_chain, &next_displacement) > length)
+                length = 0;
+        }
+
+        if (length)
+        {
+            /* backwards reference */
+            if (dst_cur + sizeof(WORD) > dst_end) return NULL;
+            *(WORD *)dst_cur = ((displacement - 1) << lznt1_length_bits(pos)) | (length - LZNT1_MIN_MATCH);
+            dst_cur += sizeof(WORD);
+            *flags |= 1 << flag_bit;
+            pos += length;
+        }
+        else
+        {
+            /* uncompressed data */
+            if (dst_cur >= dst_end) return NULL;
+            *dst_cur++ = src[pos++];
+        }
+        flag_bit++;
+    }
+
+    return dst_cur;
+}
+
 static NTSTATUS
 RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
-                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace)
+                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace, USHORT engine)
 {
         UCHAR *src_cur = src, *src_end = src + src_size;
         UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
-        ULONG block_size;
+        struct lznt1_workspace *ws = (struct lznt1_workspace *)workspace;
+        ULONG block_size, max_chain;
+        BOOLEAN lazy;
+        UCHAR *ptr;
+
+        if (!workspace) return STATUS_ACCESS_VIOLATION;
+
+        /* the standard engine trades ratio for speed by probing only a few
+         * candidates and taking the first match it finds */
+        max_chain = (engine == COMPRESSION_ENGINE_MAXIMUM) ? LZNT1_MAXIMUM_CHAIN : LZNT1_STANDARD_CHAIN;
+        lazy = (engine == COMPRESSION_ENGINE_MAXIMUM);
 
         while (src_cur < src_end)
         {
             /* determine size of current chunk */
-            block_size = min(0x1000, src_end - src_cur);
-            if (dst_cur + sizeof(WORD) + block_size > dst_end)
+            block_size = min(LZNT1_CHUNK_SIZE, src_end - src_cur);
+            if (dst_cur + sizeof(WORD) > dst_end)
                 return STATUS_BUFFER_TOO_SMALL;
 
-            /* write (uncompressed) chunk header */
-            *(WORD *)dst_cur = 0x3000 | (block_size - 1);
-            dst_cur += sizeof(WORD);
+            /* try a compressed chunk, including its header it has to be smaller
+             * than the data, RtlDescribeChunk tells both kinds apart by size */
+            ptr = (block_size > sizeof(WORD)) ?
+                  lznt1_compress_chunk(dst_cur + sizeof(WORD),
+                                       min(block_size - sizeof(WORD) - 1, dst_end - dst_cur - sizeof(WORD)),
+                                       src_cur, block_size, ws, max_chain, lazy) : NULL;
+            if (ptr)
+            {
+                /* write compressed chunk header */
+                *(WORD *)dst_cur = 0xB000 | (ptr - dst_cur - sizeof(WORD) - 1);
+                dst_cur = ptr;
+            }
+            else
+            {
+                if (dst_cur + sizeof(WORD) + block_size > dst_end)
+                    return STATUS_BUFFER_TOO_SMALL;
+
+                /* write (uncompressed) chunk header */
+                *(WORD *)dst_cur = 0x3000 | (block_size - 1);
+                dst_cur += sizeof(WORD);
+
+                /* write chunk content */
+                memcpy(dst_cur, src_cur, block_size);
+                dst_cur += block_size;
+            }
 
-            /* write chunk content */
-            memcpy(dst_cur, src_cur, block_size);
-            dst_cur += block_size;
             src_cur += block_size;
         }
 
@@ -248,21 +473,740 @@ RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
 }
 
 
+/* hash of the three bytes starting at p */
+static inline ULONG xpress_hash(const UCHAR *p)
+{
+    return ((ULONG)(p[0] | (p[1] << 8) | (p[2] << 16)) * 2654435761u) >> (32 - XPRESS_HASH_BITS);
+}
+
+/* add all positions below limit to the hash chains, positions are stored plus one */
+static inline void xpress_hash_upto(struct xpress_workspace *ws, const UCHAR *src, ULONG src_size,
+                                    ULONG ring_mask, ULONG *hashed, ULONG limit)
+{
+    ULONG hash;
+
+    while (*hashed < limit && *hashed + XPRESS_MIN_MATCH <= src_size)
+    {
+        hash = xpress_hash(src + *hashed);
+        ws->prev[*hashed & ring_mask] = ws->head[hash];
+        ws->head[hash] = *hashed + 1;
+        (*hashed)++;
+    }
+}
+
+/* find the longest match for the data at pos that ends before end, returns 0 if there is none */
+static ULONG xpress_find_match(const struct xpress_workspace *ws, const UCHAR *src, ULONG pos, ULONG end,
+                               ULONG window, ULONG ring_mask, ULONG max_chain, ULONG *offset)
+{
+    ULONG max_length, best_length = 0, length, cand;
+
+    if (pos + XPRESS_MIN_MATCH > end)
+        return 0;
+
+    max_length = min(end - pos, XPRESS_MAX_MATCH);
+
+    /* a ring slot is reused once the position it links from is ring_mask + 1 bytes back,
+     * so the chain is only trusted while the candidate is within both the window and the ring */
+    window = min(window, ring_mask + 1);
+    cand = ws->head[xpress_hash(src + pos)];
+    while (cand-- && max_chain--)
+    {
+        if (cand >= pos || pos - cand > window) break;
+
+        if (src[cand + best_length] == src[pos + best_length])
+        {
+            for (length = 0; length < max_length; length++)
+                if (src[cand + length] != src[pos + length]) break;
+
+            if (length > best_length)
+            {
+                best_length = length;
+                *offset = pos - cand;
+                if (length == max_length) break;
+            }
+        }
+        cand = ws->prev[cand & ring_mask];
+    }
+
+    return (best_length >= XPRESS_MIN_MATCH) ? best_length : 0;
+}
+
+/* greedy or lazy match at pos, shared by both XPRESS variants */
+static ULONG xpress_next_match(struct xpress_workspace *ws, const UCHAR *src, ULONG src_size, ULONG pos,
+                               ULONG end, ULONG window, ULONG ring_mask, ULONG max_chain, BOOLEAN lazy,
+                               ULONG *hashed, ULONG *offset)
+{
+    ULONG length, next_offset;
+
+    xpress_hash_upto(ws, src, src_size, ring_mask, hashed, pos);
+    length = xpress_find_match(ws, src, pos, end, window, ring_mask, max_chain, offset);
+
+    /* maximum engine: emit a literal if the next position starts a longer match */
+    if (length && lazy)
+    {
+        xpress_hash_upto(ws, src, src_size, ring_mask, hashed, pos + 1);
+        if (xpress_find_match(ws, src, pos + 1, end, window, ring_mask, max_chain, &next_offset) > length)
+            length = 0;
+    }
+
+    return length;
+}
+
+/* compress data with plain LZ77 (MS-XCA 2.3) */
+static NTSTATUS xpress_compress(const UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+                                ULONG *final_size, struct xpress_workspace *ws, ULONG max_chain, BOOLEAN lazy)
+{
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size, *flags_ptr, *nibble = NULL;
+    ULONG pos = 0, hashed = 0, flags = 0, flag_count = 0;
+    ULONG length, offset, needed;
+
+    memset(ws->head, 0, sizeof(ws->head));
+
+    /* every 32 entities are preceded by a flags word */
+    if (dst_size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+    flags_ptr = dst_cur;
+    dst_cur += sizeof(ULONG);
+
+    while (pos < src_size)
+    {
+        length = xpress_next_match(ws, src, src_size, pos, src_size, XPRESS_WINDOW_SIZE,
+                                   XPRESS_WINDOW_SIZE - 1, max_chain, lazy, &hashed, &offset);
+        if (length)
+        {
+            /* lengths from 10 on spill into a shared nibble, then a byte, then a word */
+            needed = sizeof(WORD);
+            if (length - XPRESS_MIN_MATCH >= 7)
+            {
+                if (!nibble) needed++;
+                if (length - XPRESS_MIN_MATCH >= 7 + 15)
+                    needed += (length - XPRESS_MIN_MATCH >= 7 + 15 + 255) ? 1 + sizeof(WORD) : 1;
+            }
+            if (dst_end - dst_cur < needed) return STATUS_BUFFER_TOO_SMALL;
+
+            pos += length;
+            length -= XPRESS_MIN_MATCH;
+            if (length < 7)
+            {
+                *(WORD *)dst_cur = ((offset - 1) << 3) | length;
+                dst_cur += sizeof(WORD);
+            }
+            else
+            {
+                *(WORD *)dst_cur = ((offset - 1) << 3) | 7;
+                dst_cur += sizeof(WORD);
+                length -= 7;
+
+                if (!nibble)
+                {
+                    nibble = dst_cur++;
+                    *nibble = min(length, 15);
+                }
+                else
+                {
+                    *nibble |= min(length, 15) << 4;
+                    nibble = NULL;
+                }
+
+                if (length >= 15)
+                {
+                    length -= 15;
+                    if (length < 255)
+                    {
+                        *dst_cur++ = length;
+                    }
+                    else
+                    {
+                        *dst_cur++ = 255;
+                        *(WORD *)dst_cur = length + 15 + 7;
+                        dst_cur += sizeof(WORD);
+                    }
+                }
+            }
+            flags = (flags << 1) | 1;
+        }
+        else
+        {
+            if (dst_cur >= dst_end) return STATUS_BUFFER_TOO_SMALL;
+            *dst_cur++ = src[pos++];
+            flags <<= 1;
+        }
+
+        if (++flag_count == 32)
+        {
+            if (dst_end - dst_cur < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+            *(ULONG *)flags_ptr = flags;
+            flags_ptr = dst_cur;
+            dst_cur += sizeof(ULONG);
+            flags = flag_count = 0;
+        }
+    }
+
+    /* the unused flag bits are set, a match flag without data ends the stream */
+    if (flag_count)
+        flags = (flags << (32 - flag_count)) | ((1 << (32 - flag_count)) - 1);
+    else
+        flags = 0xFFFFFFFF;
+    *(ULONG *)flags_ptr = flags;
+
+    if (final_size)
+        *final_size = dst_cur - dst;
+
+    return STATUS_SUCCESS;
+}
+
+/* decompress data encoded with plain LZ77 (MS-XCA 2.4) */
+static NTSTATUS xpress_decompress(UCHAR *dst, ULONG dst_size, UCHAR *src, ULONG src_size,
+                                  ULONG *final_size)
+{
+    UCHAR *src_cur = src, *src_end = src + src_size, *nibble = NULL;
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
+    ULONG flags = 0, flag_count = 0, length, offset;
+
+    while (dst_cur < dst_end)
+    {
+        if (!flag_count)
+        {
+            if (src_end - src_cur < sizeof(ULONG))
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            flags = *(ULONG *)src_cur;
+            src_cur += sizeof(ULONG);
+            flag_count = 32;
+        }
+        flag_count--;
+
+        if (!(flags & (1 << flag_count)))
+        {
+            /* uncompressed data */
+            if (src_cur >= src_end)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            *dst_cur++ = *src_cur++;
+            continue;
+        }
+
+        /* a match flag at the end of the input terminates the stream */
+        if (src_cur == src_end)
+            break;
+
+        if (src_end - src_cur < sizeof(WORD))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        length = *(WORD *)src_cur & 7;
+        offset = (*(WORD *)src_cur >> 3) + 1;
+        src_cur += sizeof(WORD);
+
+        if (length == 7)
+        {
+            if (!nibble)
+            {
+                if (src_cur >= src_end)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                nibble = src_cur++;
+                length = *nibble & 0xF;
+            }
+            else
+            {
+                length = *nibble >> 4;
+                nibble = NULL;
+            }
+
+            if (length == 15)
+            {
+                if (src_cur >= src_end)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                length = *src_cur++;
+
+                if (length == 255)
+                {
+                    if (src_end - src_cur < sizeof(WORD))
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    length = *(WORD *)src_cur;
+                    src_cur += sizeof(WORD);
+
+                    if (!length)
+                    {
+                        if (src_end - src_cur < sizeof(ULONG))
+                            return STATUS_BAD_COMPRESSION_BUFFER;
+                        length = *(ULONG *)src_cur;
+                        src_cur += sizeof(ULONG);
+                    }
+
+                    if (length < 15 + 7)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    length -= 15 + 7;
+                }
+                length += 15;
+            }
+            length += 7;
+        }
+        length += XPRESS_MIN_MATCH;
+
+        /* ensure reference is valid */
+        if (dst_cur - dst < offset)
+            return STATUS_BAD_COMPRESSION_BUFFER;
+
+        /* partial decompression is no error */
+        length = min(length, dst_end - dst_cur);
+        if (offset >= length)
+        {
+            memcpy(dst_cur, dst_cur - offset, length);
+            dst_cur += length;
+        }
+        else
+        {
+            /* overlapping run */
+            while (length--)
+            {
+                *dst_cur = *(dst_cur - offset);
+                dst_cur++;
+            }
+        }
+    }
+
+    if (final_size)
+        *final_size = dst_cur - dst;
+
+    return STATUS_SUCCESS;
+}
+
+/* limit code lengths to 15 bits by flattening the weights until the tree fits */
+static void xpress_huff_build_lengths(struct xpress_workspace *ws)
+{
+    ULONG count, sym, leaf, node, inner, a, b, i, max_depth;
+
+    for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+        ws->weight[sym] = ws->freq[sym];
+
+    for (;;)
+    {
+        memset(ws->lengths, 0, sizeof(ws->lengths));
+
+        /* leaves sorted by weight, insertion sort keeps equal weights in symbol order */
+        count = 0;
+        for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+        {
+            if (!ws->weight[sym]) continue;
+            for (i = count; i && ws->weight[ws->leaves[i - 1]] > ws->weight[sym]; i--)
+                ws->leaves[i] = ws->leaves[i - 1];
+            ws->leaves[i] = sym;
+            count++;
+        }
+
+        /* a lone symbol still needs a one bit code, pair it with an unused one */
+        if (count < 2)
+        {
+            sym = count ? ws->leaves[0] : 0;
+            ws->lengths[sym] = 1;
+            ws->lengths[sym ? 0 : 1] = 1;
+            return;
+        }
+
+        /* two queue construction: leaves [0, count), inner nodes [count, 2 * count - 1) */
+        leaf = 0;
+        inner = count;
+        for (node = count; node < 2 * count - 1; node++)
+        {
+            if (leaf < count && (inner >= node || ws->weight[ws->leaves[leaf]] <= ws->weight[XPRESS_HUFF_SYMBOLS + inner - count]))
+                a = leaf++;
+            else
+                a = inner++;
+            if (leaf < count && (inner >= node || ws->weight[ws->leaves[leaf]] <= ws->weight[XPRESS_HUFF_SYMBOLS + inner - count]))
+                b = leaf++;
+            else
+                b = inner++;
+
+            ws->weight[XPRESS_HUFF_SYMBOLS + node - count] =
+                ((a < count) ? ws->weight[ws->leaves[a]] : ws->weight[XPRESS_HUFF_SYMBOLS + a - count]) +
+                ((b < count) ? ws->weight[ws->leaves[b]] : ws->weight[XPRESS_HUFF_SYMBOLS + b - count]);
+            ws->parent[a] = ws->parent[b] = node;
+        }
+
+        /* parents always come after their children */
+        max_depth = 0;
+        ws->depth[2 * count - 2] = 0;
+        for (i = 2 * count - 2; i--; )
+        {
+            ws->depth[i] = ws->depth[ws->parent[i]] + 1;
+            if (i < count && ws->depth[i] > max_depth)
+                max_depth = ws->depth[i];
+        }
+
+        if (max_depth <= XPRESS_HUFF_MAX_BITS)
+        {
+            for (i = 0; i < count; i++)
+                ws->lengths[ws->leaves[i]] = ws->depth[i];
+            return;
+        }
+
+        for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+            if (ws->weight[sym]) ws->weight[sym] = (ws->weight[sym] + 1) / 2;
+    }
+}
+
+/* assign canonical codes: shorter codes first, equal lengths in symbol order */
+static void xpress_huff_build_codes(struct xpress_workspace *ws)
+{
+    ULONG next_code[XPRESS_HUFF_MAX_BITS + 1], count[XPRESS_HUFF_MAX_BITS + 1];
+    ULONG sym, len, code = 0;
+
+    memset(count, 0, sizeof(count));
+    for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+        count[ws->lengths[sym]]++;
+
+    count[0] = 0;
+    for (len = 1; len <= XPRESS_HUFF_MAX_BITS; len++)
+    {
+        code = (code + count[len - 1]) << 1;
+        next_code[len] = code;
+    }
+
+    for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+        if (ws->lengths[sym]) ws->codes[sym] = next_code[ws->lengths[sym]]++;
+}
+
+static inline void xpress_huff_put_bits(struct xpress_huff_writer *out, ULONG bits, ULONG count)
+{
+    out->bitbuf = (out->bitbuf << count) | bits;
+    out->bitcount += count;
+    if (out->bitcount > 16)
+    {
+        out->bitcount -= 16;
+        *(WORD *)out->next_bits = (WORD)(out->bitbuf >> out->bitcount);
+        out->next_bits = out->next_bits2;
+        out->next_bits2 = out->next_byte;
+        out->next_byte += sizeof(WORD);
+    }
+}
+
+static inline void xpress_huff_flush(struct xpress_huff_writer *out)
+{
+    *(WORD *)out->next_bits = (WORD)(out->bitbuf << (16 - out->bitcount));
+    *(WORD *)out->next_bits2 = 0;
+}
+
+/* compress data with LZ77 and Huffman coding (MS-XCA 2.1) */
+static NTSTATUS xpress_huff_compress(const UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
+                                     ULONG *final_size, struct xpress_workspace *ws, ULONG max_chain, BOOLEAN lazy)
+{
+    struct xpress_huff_writer out;
+    UCHAR *dst_end = dst + dst_size;
+    ULONG pos = 0, hashed = 0, block_start, block_end, count, item, length, offset, offset_bits, sym, i;
+    BOOLEAN last;
+
+    memset(ws->head, 0, sizeof(ws->head));
+    out.next_byte = dst;
+
+    do
+    {
+        /* collect the matches of one block and count the symbols */
+        block_start = pos;
+        block_end = pos + min(src_size - pos, XPRESS_HUFF_BLOCK_SIZE);
+        memset(ws->freq, 0, sizeof(ws->freq));
+        count = 0;
+
+        while (pos < block_end)
+        {
+            length = xpress_next_match(ws, src, src_size, pos, block_end, XPRESS_HUFF_WINDOW_SIZE,
+                                       XPRESS_HUFF_RING_SIZE - 1, max_chain, lazy, &hashed, &offset);
+
+            /* the shortest match at distance one shares its symbol with the end of stream */
+            if (length && !(length == XPRESS_MIN_MATCH && offset == 1))
+            {
+                for (offset_bits = 0; offset >> (offset_bits + 1); offset_bits++);
+                ws->freq[XPRESS_HUFF_EOF + (offset_bits << 4) + min(length - XPRESS_MIN_MATCH, 15)]++;
+                ws->items[count++] = (offset << 16) | (length - XPRESS_MIN_MATCH);
+                pos += length;
+            }
+            else
+            {
+                ws->freq[src[pos]]++;
+                ws->items[count++] = src[pos++];
+            }
+        }
+
+        /* a full last block is followed by one holding just the end of stream */
+        last = (block_end - block_start < XPRESS_HUFF_BLOCK_SIZE);
+        if (last)
+            ws->freq[XPRESS_HUFF_EOF]++;
+
+        xpress_huff_build_lengths(ws);
+        xpress_huff_build_codes(ws);
+
+        /* code length table and the first two bit stream words */
+        if (dst_end - out.next_byte < XPRESS_HUFF_SYMBOLS / 2 + 2 * sizeof(WORD))
+            return STATUS_BUFFER_TOO_SMALL;
+        for (i = 0; i < XPRESS_HUFF_SYMBOLS / 2; i++)
+            out.next_byte[i] = ws->lengths[2 * i] | (ws->lengths[2 * i + 1] << 4);
+        out.next_bits = out.next_byte + XPRESS_HUFF_SYMBOLS / 2;
+        out.next_bits2 = out.next_bits + sizeof(WORD);
+        out.next_byte = out.next_bits2 + sizeof(WORD);
+        out.bitbuf = out.bitcount = 0;
+
+        for (i = 0; i < count; i++)
+        {
+            /* worst case: two words of bits and three length bytes */
+            if (dst_end - out.next_byte < 2 * sizeof(WORD) + 3)
+                return STATUS_BUFFER_TOO_SMALL;
+
+            item = ws->items[i];
+            if (item < 256)
+            {
+                xpress_huff_put_bits(&out, ws->codes[item], ws->lengths[item]);
+                continue;
+            }
+
+            length = item & 0xFFFF;
+            offset = item >> 16;
+            for (offset_bits = 0; offset >> (offset_bits + 1); offset_bits++);
+            sym = XPRESS_HUFF_EOF + (offset_bits << 4) + min(length, 15);
+            xpress_huff_put_bits(&out, ws->codes[sym], ws->lengths[sym]);
+
+            if (length >= 15)
+            {
+                if (length - 15 < 255)
+                {
+                    *out.next_byte++ = length - 15;
+                }
+                else
+                {
+                    *out.next_byte++ = 255;
+                    *(WORD *)out.next_byte = length;
+                    out.next_byte += sizeof(WORD);
+                }
+            }
+
+            xpress_huff_put_bits(&out, offset - (1 << offset_bits), offset_bits);
+        }
+
+        if (last)
+        {
+            if (dst_end - out.next_byte < sizeof(WORD))
+                return STATUS_BUFFER_TOO_SMALL;
+            xpress_huff_put_bits(&out, ws->codes[XPRESS_HUFF_EOF], ws->lengths[XPRESS_HUFF_EOF]);
+        }
+
+        /* the next block starts right after the words reserved so far */
+        xpress_huff_flush(&out);
+    }
+    while (!last);
+
+    if (final_size)
+        *final_size = out.next_byte - dst;
+
+    return STATUS_SUCCESS;
+}
+
+/* read the code lengths of a block, optionally fill the lookup table for short codes */
+static BOOLEAN xpress_huff_build_decoder(struct xpress_huff_code *code, const UCHAR *lengths, USHORT *table)
+{
+    USHORT next[XPRESS_HUFF_MAX_BITS + 1];
+    ULONG sym, len, first = 0, offset = 0, i, fill;
+
+    memset(code->count, 0, sizeof(code->count));
+    for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+        code->count[(lengths[sym / 2] >> ((sym & 1) * 4)) & 0xF]++;
+
+    code->count[0] = 0;
+    for (len = 1; len <= XPRESS_HUFF_MAX_BITS; len++)
+    {
+        first = (first + code->count[len - 1]) << 1;
+        if (first + code->count[len] > (1UL << len))
+            return FALSE;
+        code->first_code[len] = first;
+        code->offset[len] = next[len] = offset;
+        offset += code->count[len];
+    }
+
+    for (sym = 0; sym < XPRESS_HUFF_SYMBOLS; sym++)
+    {
+        len = (lengths[sym / 2] >> ((sym & 1) * 4)) & 0xF;
+        if (len) code->sorted[next[len]++] = sym;
+    }
+
+    if (table)
+    {
+        memset(table, 0, sizeof(USHORT) << XPRESS_HUFF_TABLE_BITS);
+        for (len = 1; len <= XPRESS_HUFF_TABLE_BITS; len++)
+        {
+            for (i = 0; i < code->count[len]; i++)
+            {
+                fill = (code->first_code[len] + i) << (XPRESS_HUFF_TABLE_BITS - len);
+                for (sym = 0; sym < (1UL << (XPRESS_HUFF_TABLE_BITS - len)); sym++)
+                    table[fill + sym] = (code->sorted[code->offset[len] + i] << 4) | len;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+/* decode the symbol at the top of bits, returns XPRESS_HUFF_SYMBOLS for an invalid code */
+static inline ULONG xpress_huff_decode(const struct xpress_huff_code *code, const USHORT *table,
+                                       ULONG bits, ULONG *length)
+{
+    ULONG peek = bits >> (32 - XPRESS_HUFF_MAX_BITS), entry, len = 1, index;
+
+    if (table)
+    {
+        entry = table[peek >> (XPRESS_HUFF_MAX_BITS - XPRESS_HUFF_TABLE_BITS)];
+        if (entry)
+        {
+            *length = entry & 0xF;
+            return entry >> 4;
+        }
+        len = XPRESS_HUFF_TABLE_BITS + 1;
+    }
+
+    /* codes of each length are consecutive, walk them from the shortest */
+    for (; len <= XPRESS_HUFF_MAX_BITS; len++)
+    {
+        index = (peek >> (XPRESS_HUFF_MAX_BITS - len)) - code->first_code[len];
+        if (index < code->count[len])
+        {
+            *length = len;
+            return code->sorted[code->offset[len] + index];
+        }
+    }
+
+    return XPRESS_HUFF_SYMBOLS;
+}
+
+/* decompress data encoded with LZ77 and Huffman coding (MS-XCA 2.2) */
+static NTSTATUS xpress_huff_decompress(UCHAR *dst, ULONG dst_size, UCHAR *src, ULONG src_size,
+                                       ULONG *final_size, USHORT *table)
+{
+    struct xpress_huff_code code;
+    UCHAR *src_cur = src, *src_end = src + src_size;
+    UCHAR *dst_cur = dst, *dst_end = dst + dst_size, *block_end;
+    ULONG bits, symbol, length, offset, offset_bits;
+    LONG extra;
+
+#define XPRESS_HUFF_CONSUME(count)                                  \
+    do {                                                            \
+        bits <<= (count);                                           \
+        extra -= (count);                                           \
+        if (extra < 0)                                              \
+        {                                                           \
+            if (src_end - src_cur < sizeof(WORD))                   \
+                return STATUS_BAD_COMPRESSION_BUFFER;               \
+            bits |= (ULONG)*(WORD *)src_cur << -extra;              \
+            src_cur += sizeof(WORD);                                \
+            extra += 16;                                            \
+        }                                                           \
+    } while (0)
+
+    while (dst_cur < dst_end)
+    {
+        /* every block starts with its code lengths and two words of bits */
+        if (src_end - src_cur < XPRESS_HUFF_SYMBOLS / 2 + 2 * sizeof(WORD))
+            break;
+        if (!xpress_huff_build_decoder(&code, src_cur, table))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        src_cur += XPRESS_HUFF_SYMBOLS / 2;
+        bits = ((ULONG)*(WORD *)src_cur << 16) | *(WORD *)(src_cur + sizeof(WORD));
+        src_cur += 2 * sizeof(WORD);
+        extra = 16;
+
+        block_end = dst_cur + min(dst_end - dst_cur, XPRESS_HUFF_BLOCK_SIZE);
+        while (dst_cur < block_end)
+        {
+            symbol = xpress_huff_decode(&code, table, bits, &length);
+            if (symbol == XPRESS_HUFF_SYMBOLS)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            XPRESS_HUFF_CONSUME(length);
+
+            if (symbol < 256)
+            {
+                *dst_cur++ = symbol;
+                continue;
+            }
+
+            /* end of stream once all input is used up */
+            if (symbol == XPRESS_HUFF_EOF && src_cur == src_end)
+                goto out;
+
+            symbol -= XPRESS_HUFF_EOF;
+            length = symbol & 0xF;
+            offset_bits = symbol >> 4;
+
+            if (length == 15)
+            {
+                if (src_cur >= src_end)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                length = *src_cur++;
+
+                if (length == 255)
+                {
+                    if (src_end - src_cur < sizeof(WORD))
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    length = *(WORD *)src_cur;
+                    src_cur += sizeof(WORD);
+
+                    if (!length)
+                    {
+                        if (src_end - src_cur < sizeof(ULONG))
+                            return STATUS_BAD_COMPRESSION_BUFFER;
+                        length = *(ULONG *)src_cur;
+                        src_cur += sizeof(ULONG);
+                    }
+
+                    if (length < 15)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    length -= 15;
+                }
+                length += 15;
+            }
+            length += XPRESS_MIN_MATCH;
+
+            offset = (1 << offset_bits);
+            if (offset_bits)
+            {
+                offset |= bits >> (32 - offset_bits);
+                XPRESS_HUFF_CONSUME(offset_bits);
+            }
+
+            /* ensure reference is valid */
+            if (dst_cur - dst < offset)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+
+            /* partial decompression is no error */
+            length = min(length, dst_end - dst_cur);
+            if (offset >= length)
+            {
+                memcpy(dst_cur, dst_cur - offset, length);
+                dst_cur += length;
+            }
+            else
+            {
+                /* overlapping run */
+                while (length--)
+                {
+                    *dst_cur = *(dst_cur - offset);
+                    dst_cur++;
+                }
+            }
+        }
+    }
+
+#undef XPRESS_HUFF_CONSUME
+
+out:
+    if (final_size)
+        *final_size = dst_cur - dst;
+
+    return STATUS_SUCCESS;
+}
+
+
 static NTSTATUS
 RtlpWorkSpaceSizeLZNT1(USHORT Engine,
                        PULONG BufferAndWorkSpaceSize,
                        PULONG FragmentWorkSpaceSize)
 {
-   if (Engine == COMPRESSION_ENGINE_STANDARD)
+   if ((Engine == COMPRESSION_ENGINE_STANDARD) ||
+         (Engine == COMPRESSION_ENGINE_MAXIMUM))
    {
-      *BufferAndWorkSpaceSize = 0x8010;
-      *FragmentWorkSpaceSize = 0x1000;
-      return(STATUS_SUCCESS);
-   }
-   else if (Engine == COMPRESSION_ENGINE_MAXIMUM)
-   {
-      *BufferAndWorkSpaceSize = 0x10;
-      *FragmentWorkSpaceSize = 0x1000;
+      /* Both engines share the hash chains, they only differ in how far they search */
+      *BufferAndWorkSpaceSize = sizeof(struct lznt1_workspace);
+      *FragmentWorkSpaceSize = LZNT1_CHUNK_SIZE;
       return(STATUS_SUCCESS);
    }
 
@@ -270,6 +1214,170 @@ RtlpWorkSpaceSizeLZNT1(USHORT Engine,
 }
 
 
+static NTSTATUS
+RtlpWorkSpaceSizeXpress(USHORT Format,
+                        USHORT Engine,
+                        PULONG BufferAndWorkSpaceSize,
+                        PULONG FragmentWorkSpaceSize)
+{
+    if ((Engine != COMPRESSION_ENGINE_STANDARD) &&
+        (Engine != COMPRESSION_ENGINE_MAXIMUM))
+        return STATUS_NOT_SUPPORTED;
+
+    if (Format == COMPRESSION_FORMAT_XPRESS)
+    {
+        /* Plain LZ77 decodes without any workspace */
+        *BufferAndWorkSpaceSize = XPRESS_WORKSPACE_SIZE;
+        *FragmentWorkSpaceSize = 0;
+    }
+    else
+    {
+        /* The decoder uses the workspace for its short code lookup table */
+        *BufferAndWorkSpaceSize = sizeof(struct xpress_workspace);
+        *FragmentWorkSpaceSize = sizeof(USHORT) << XPRESS_HUFF_TABLE_BITS;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS
+RtlpCompressBufferXpress(USHORT Format,
+                         USHORT Engine,
+                         PUCHAR UncompressedBuffer,
+                         ULONG UncompressedBufferSize,
+                         PUCHAR CompressedBuffer,
+                         ULONG CompressedBufferSize,
+                         PULONG FinalCompressedSize,
+                         PVOID WorkSpace)
+{
+    ULONG MaxChain;
+    BOOLEAN Lazy;
+
+    if (!WorkSpace)
+        return STATUS_ACCESS_VIOLATION;
+
+    /* Same trade off as for LZNT1 */
+    MaxChain = (Engine == COMPRESSION_ENGINE_MAXIMUM) ? XPRESS_MAXIMUM_CHAIN : XPRESS_STANDARD_CHAIN;
+    Lazy = (Engine == COMPRESSION_ENGINE_MAXIMUM);
+
+    if (Format == COMPRESSION_FORMAT_XPRESS)
+        return xpress_compress(UncompressedBuffer, UncompressedBufferSize,
+                               CompressedBuffer, CompressedBufferSize,
+                               FinalCompressedSize, WorkSpace, MaxChain, Lazy);
+
+    return xpress_huff_compress(UncompressedBuffer, UncompressedBufferSize,
+                                CompressedBuffer, CompressedBufferSize,
+                                FinalCompressedSize, WorkSpace, MaxChain, Lazy);
+}
+
+
+static NTSTATUS
+RtlpDescribeChunkLZNT1(PUCHAR *CompressedBuffer,
+                       PUCHAR EndOfCompressedBufferPlus1,
+                       PUCHAR *ChunkBuffer,
+                       PULONG ChunkSize)
+{
+    PUCHAR Chunk = *CompressedBuffer;
+    USHORT ChunkHeader;
+    ULONG DataSize;
+
+    *ChunkBuffer = Chunk;
+    *ChunkSize = 0;
+
+    /* A missing or zero header terminates the stream */
+    if (Chunk + sizeof(USHORT) > EndOfCompressedBufferPlus1)
+        return STATUS_NO_MORE_ENTRIES;
+
+    ChunkHeader = *(PUSHORT)Chunk;
+    if (!ChunkHeader)
+        return STATUS_NO_MORE_ENTRIES;
+
+    DataSize = (ChunkHeader & 0xFFF) + 1;
+    if (Chunk + sizeof(USHORT) + DataSize > EndOfCompressedBufferPlus1)
+        return STATUS_BAD_COMPRESSION_BUFFER;
+
+    if (ChunkHeader & 0x8000)
+    {
+        /* Compressed chunks are described including their header,
+         * a chunk of zeroes has no size at all */
+        if ((sizeof(USHORT) + DataSize != sizeof(lznt1_zero_chunk)) ||
+            (RtlCompareMemory(Chunk, lznt1_zero_chunk, sizeof(lznt1_zero_chunk)) != sizeof(lznt1_zero_chunk)))
+        {
+            *ChunkSize = sizeof(USHORT) + DataSize;
+        }
+    }
+    else
+    {
+        /* Uncompressed chunks are described by their data */
+        *ChunkBuffer = Chunk + sizeof(USHORT);
+        *ChunkSize = DataSize;
+    }
+
+    *CompressedBuffer = Chunk + sizeof(USHORT) + DataSize;
+    return STATUS_SUCCESS;
+}
+
+
+static NTSTATUS
+RtlpReserveChunkLZNT1(PUCHAR *CompressedBuffer,
+                      PUCHAR EndOfCompressedBufferPlus1,
+                      PUCHAR *ChunkBuffer,
+                      ULONG ChunkSize)
+{
+    PUCHAR Chunk = *CompressedBuffer;
+    ULONG Available = EndOfCompressedBufferPlus1 - Chunk;
+
+    if (ChunkSize == 0)
+    {
+        /* Chunk of zeroes, written here in full */
+        if (Available < sizeof(lznt1_zero_chunk))
+            return STATUS_BUFFER_TOO_SMALL;
+
+        RtlCopyMemory(Chunk, lznt1_zero_chunk, sizeof(lznt1_zero_chunk));
+        *ChunkBuffer = Chunk;
+        *CompressedBuffer = Chunk + sizeof(lznt1_zero_chunk);
+    }
+    else if (ChunkSize == LZNT1_CHUNK_SIZE)
+    {
+        /* Uncompressed chunk, the caller fills in the data after the header */
+        if (Available < sizeof(USHORT) + ChunkSize)
+            return STATUS_BUFFER_TOO_SMALL;
+
+        *(PUSHORT)Chunk = 0x3000 | (ChunkSize - 1);
+        *ChunkBuffer = Chunk + sizeof(USHORT);
+        *CompressedBuffer = Chunk + sizeof(USHORT) + ChunkSize;
+    }
+    else
+    {
+        /* Compressed chunk, the caller fills in the header as well */
+        if (ChunkSize <= sizeof(USHORT) || ChunkSize > LZNT1_CHUNK_SIZE)
+            return STATUS_INVALID_PARAMETER;
+        if (Available < ChunkSize)
+            return STATUS_BUFFER_TOO_SMALL;
+
+        *ChunkBuffer = Chunk;
+        *CompressedBuffer = Chunk + ChunkSize;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+static BOOLEAN
+RtlpIsZeroChunk(PUCHAR Buffer,
+                ULONG Length)
+{
+    while (Length--)
+    {
+        if (*Buffer++)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+
 /*
  * @implemented
  */
@@ -284,12 +1392,16 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                   IN PVOID WorkSpace)
 {
    USHORT Format = CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
-   /* USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK; */
+   USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK;
 
    if ((Format == COMPRESSION_FORMAT_NONE) ||
          (Format == COMPRESSION_FORMAT_DEFAULT))
       return(STATUS_INVALID_PARAMETER);
 
+   if ((Engine != COMPRESSION_ENGINE_STANDARD) &&
+         (Engine != COMPRESSION_ENGINE_MAXIMUM))
+      return(STATUS_NOT_SUPPORTED);
+
    if (Format == COMPRESSION_FORMAT_LZNT1)
       return(RtlpCompressBufferLZNT1(UncompressedBuffer,
                                      UncompressedBufferSize,
@@ -297,14 +1409,26 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                                      CompressedBufferSize,
                                      UncompressedChunkSize,
                                      FinalCompressedSize,
-                                     WorkSpace));
+                                     WorkSpace,
+                                     Engine));
+
+   if ((Format == COMPRESSION_FORMAT_XPRESS) ||
+         (Format == COMPRESSION_FORMAT_XPRESS_HUFF))
+      return(RtlpCompressBufferXpress(Format,
+                                      Engine,
+                                      UncompressedBuffer,
+                                      UncompressedBufferSize,
+                                      CompressedBuffer,
+                                      CompressedBufferSize,
+                                      FinalCompressedSize,
+                                      WorkSpace));
 
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS NTAPI
 RtlCompressChunks(IN PUCHAR UncompressedBuffer,
@@ -315,12 +1439,77 @@ RtlCompressChunks(IN PUCHAR UncompressedBuffer,
                   IN ULONG CompressedDataInfoLength,
                   IN PVOID WorkSpace)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    USHORT Format = CompressedDataInfo->CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
+    PUCHAR Source = UncompressedBuffer;
+    PUCHAR Target = CompressedBuffer;
+    PUCHAR TargetEnd = CompressedBuffer + CompressedBufferSize;
+    ULONG ChunkSize, NumberOfChunks, BlockSize, FinalSize, i;
+    NTSTATUS Status;
+
+    if ((Format == COMPRESSION_FORMAT_NONE) ||
+        (Format == COMPRESSION_FORMAT_DEFAULT))
+        return STATUS_INVALID_PARAMETER;
+
+    if (Format != COMPRESSION_FORMAT_LZNT1)
+        return STATUS_UNSUPPORTED_COMPRESSION;
+
+    if ((CompressedDataInfo->ChunkShift < 9) || (CompressedDataInfo->ChunkShift > 16))
+        return STATUS_INVALID_PARAMETER;
+
+    ChunkSize = 1 << CompressedDataInfo->ChunkShift;
+    NumberOfChunks = (UncompressedBufferSize + ChunkSize - 1) >> CompressedDataInfo->ChunkShift;
+    if ((NumberOfChunks > MAXUSHORT) ||
+        (CompressedDataInfoLength < FIELD_OFFSET(COMPRESSED_DATA_INFO, CompressedChunkSizes) +
+                                    NumberOfChunks * sizeof(ULONG)))
+        return STATUS_BUFFER_TOO_SMALL;
+
+    for (i = 0; i < NumberOfChunks; i++)
+    {
+        BlockSize = min(ChunkSize, UncompressedBufferSize - i * ChunkSize);
+
+        if (RtlpIsZeroChunk(Source, BlockSize))
+        {
+            /* Zeroes take no space at all */
+            FinalSize = 0;
+        }
+        else
+        {
+            /* Every chunk is compressed on its own so it can be decompressed
+             * without the ones before it. It has to shrink to be kept. */
+            Status = RtlCompressBuffer(CompressedDataInfo->CompressionFormatAndEngine,
+                                       Source,
+                                       BlockSize,
+                                       Target,
+                                       min(BlockSize - 1, (ULONG)(TargetEnd - Target)),
+                                       ChunkSize,
+                                       &FinalSize,
+                                       WorkSpace);
+            if (Status == STATUS_BUFFER_TOO_SMALL)
+            {
+                /* Store it as is */
+                if ((ULONG)(TargetEnd - Target) < BlockSize)
+                    return STATUS_BUFFER_TOO_SMALL;
+
+                RtlCopyMemory(Target, Source, BlockSize);
+                FinalSize = BlockSize;
+            }
+            else if (!NT_SUCCESS(Status))
+            {
+                return Status;
+            }
+        }
+
+        CompressedDataInfo->CompressedChunkSizes[i] = FinalSize;
+        Source += BlockSize;
+        Target += FinalSize;
+    }
+
+    CompressedDataInfo->NumberOfChunks = (USHORT)NumberOfChunks;
+    return STATUS_SUCCESS;
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS NTAPI
 RtlDecompressChunks(OUT PUCHAR UncompressedBuffer,
@@ -331,8 +1520,71 @@ RtlDecompressChunks(OUT PUCHAR UncompressedBuffer,
                     IN ULONG CompressedTailSize,
                     IN PCOMPRESSED_DATA_INFO CompressedDataInfo)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    USHORT Format = CompressedDataInfo->CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
+    PUCHAR Source = CompressedBuffer;
+    PUCHAR SourceEnd = CompressedBuffer + CompressedBufferSize;
+    PUCHAR Target = UncompressedBuffer;
+    PUCHAR TargetEnd = UncompressedBuffer + UncompressedBufferSize;
+    ULONG ChunkSize, BlockSize, CompressedChunkSize, FinalSize, i;
+    NTSTATUS Status;
+
+    if ((Format == COMPRESSION_FORMAT_NONE) ||
+        (Format == COMPRESSION_FORMAT_DEFAULT))
+        return STATUS_INVALID_PARAMETER;
+
+    if (Format != COMPRESSION_FORMAT_LZNT1)
+        return STATUS_UNSUPPORTED_COMPRESSION;
+
+    if ((CompressedDataInfo->ChunkShift < 9) || (CompressedDataInfo->ChunkShift > 16))
+        return STATUS_INVALID_PARAMETER;
+
+    ChunkSize = 1 << CompressedDataInfo->ChunkShift;
+
+    for (i = 0; (i < CompressedDataInfo->NumberOfChunks) && (Target < TargetEnd); i++)
+    {
+        BlockSize = min(ChunkSize, (ULONG)(TargetEnd - Target));
+        CompressedChunkSize = CompressedDataInfo->CompressedChunkSizes[i];
+
+        /* The last chunks may come from a separate tail buffer */
+        if ((ULONG)(SourceEnd - Source) < CompressedChunkSize)
+        {
+            if (!CompressedTail || (CompressedTailSize < CompressedChunkSize))
+                return STATUS_BAD_COMPRESSION_BUFFER;
+
+            Source = CompressedTail;
+            SourceEnd = CompressedTail + CompressedTailSize;
+            CompressedTail = NULL;
+        }
+
+        if (CompressedChunkSize == 0)
+        {
+            RtlZeroMemory(Target, BlockSize);
+        }
+        else if (CompressedChunkSize == BlockSize)
+        {
+            RtlCopyMemory(Target, Source, BlockSize);
+        }
+        else
+        {
+            Status = RtlDecompressBuffer(Format,
+                                         Target,
+                                         BlockSize,
+                                         Source,
+                                         CompressedChunkSize,
+                                         &FinalSize);
+            if (!NT_SUCCESS(Status))
+                return Status;
+
+            /* A short chunk ends in zeroes */
+            if (FinalSize < BlockSize)
+                RtlZeroMemory(Target + FinalSize, BlockSize - FinalSize);
+        }
+
+        Source += CompressedChunkSize;
+        Target += BlockSize;
+    }
+
+    return STATUS_SUCCESS;
 }
 
 /*
@@ -378,12 +1630,42 @@ RtlDecompressBuffer(IN USHORT CompressionFormat,
                     IN ULONG CompressedBufferSize,
                     OUT PULONG FinalUncompressedSize)
 {
-    return RtlDecompressFragment(CompressionFormat, UncompressedBuffer, UncompressedBufferSize,
-                                 CompressedBuffer, CompressedBufferSize, 0, FinalUncompressedSize, NULL);
+    return RtlDecompressBufferEx(CompressionFormat, UncompressedBuffer, UncompressedBufferSize,
+                                 CompressedBuffer, CompressedBufferSize, FinalUncompressedSize, NULL);
 }
 
 /*
- * @unimplemented
+ * @implemented
+ */
+NTSTATUS NTAPI
+RtlDecompressBufferEx(IN USHORT CompressionFormat,
+                      OUT PUCHAR UncompressedBuffer,
+                      IN ULONG UncompressedBufferSize,
+                      IN PUCHAR CompressedBuffer,
+                      IN ULONG CompressedBufferSize,
+                      OUT PULONG FinalUncompressedSize,
+                      IN PVOID WorkSpace OPTIONAL)
+{
+    switch (CompressionFormat & COMPRESSION_FORMAT_MASK)
+    {
+        case COMPRESSION_FORMAT_XPRESS:
+            return xpress_decompress(UncompressedBuffer, UncompressedBufferSize, CompressedBuffer,
+                                     CompressedBufferSize, FinalUncompressedSize);
+
+        case COMPRESSION_FORMAT_XPRESS_HUFF:
+            /* Without a workspace every code is decoded the slow way */
+            return xpress_huff_decompress(UncompressedBuffer, UncompressedBufferSize, CompressedBuffer,
+                                          CompressedBufferSize, FinalUncompressedSize, WorkSpace);
+
+        default:
+            return RtlDecompressFragment(CompressionFormat, UncompressedBuffer, UncompressedBufferSize,
+                                         CompressedBuffer, CompressedBufferSize, 0,
+                                         FinalUncompressedSize, WorkSpace);
+    }
+}
+
+/*
+ * @implemented
  */
 NTSTATUS NTAPI
 RtlDescribeChunk(IN USHORT CompressionFormat,
@@ -392,8 +1674,19 @@ RtlDescribeChunk(IN USHORT CompressionFormat,
                  OUT PUCHAR *ChunkBuffer,
                  OUT PULONG ChunkSize)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    USHORT Format = CompressionFormat & COMPRESSION_FORMAT_MASK;
+
+    if ((Format == COMPRESSION_FORMAT_NONE) ||
+        (Format == COMPRESSION_FORMAT_DEFAULT))
+        return STATUS_INVALID_PARAMETER;
+
+    if (Format == COMPRESSION_FORMAT_LZNT1)
+        return RtlpDescribeChunkLZNT1(CompressedBuffer,
+                                      EndOfCompressedBufferPlus1,
+                                      ChunkBuffer,
+                                      ChunkSize);
+
+    return STATUS_UNSUPPORTED_COMPRESSION;
 }
 
 
@@ -417,13 +1710,20 @@ RtlGetCompressionWorkSpaceSize(IN USHORT CompressionFormatAndEngine,
                                     CompressBufferAndWorkSpaceSize,
                                     CompressFragmentWorkSpaceSize));
 
+   if ((Format == COMPRESSION_FORMAT_XPRESS) ||
+         (Format == COMPRESSION_FORMAT_XPRESS_HUFF))
+      return(RtlpWorkSpaceSizeXpress(Format,
+                                     Engine,
+                                     CompressBufferAndWorkSpaceSize,
+                                     CompressFragmentWorkSpaceSize));
+
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
 
 
 
 /*
- * @unimplemented
+ * @implemented
  */
 NTSTATUS NTAPI
 RtlReserveChunk(IN USHORT CompressionFormat,
@@ -432,8 +1732,19 @@ RtlReserveChunk(IN USHORT CompressionFormat,
                 OUT PUCHAR *ChunkBuffer,
                 IN ULONG ChunkSize)
 {
-    UNIMPLEMENTED;
-    return STATUS_NOT_IMPLEMENTED;
+    USHORT Format = CompressionFormat & COMPRESSION_FORMAT_MASK;
+
+    if ((Format == COMPRESSION_FORMAT_NONE) ||
+        (Format == COMPRESSION_FORMAT_DEFAULT))
+        return STATUS_INVALID_PARAMETER;
+
+    if (Format == COMPRESSION_FORMAT_LZNT1)
+        return RtlpReserveChunkLZNT1(CompressedBuffer,
+                                     EndOfCompressedBufferPlus1,
+                                     ChunkBuffer,
+                                     ChunkSize);
+
+    return STATUS_UNSUPPORTED_COMPRESSION;
 }
 
 /* EOF */
@@ -191,6 +191,10 @@ RtlpInitializeHeap(OUT PHEAP Heap,
     for (Index = 0; Index < HEAP_FREELISTS; ++Index)
         InitializeListHead(&Heap->FreeLists[Index]);
 
+    /* The size index of the non-dedicated list is created on demand */
+    Heap->NonDedicatedListLength = 0;
+    Heap->BlocksIndex = NULL;
+
     /* Initialise the Heap Virtual Allocated Blocks list */
     InitializeListHead(&Heap->VirtualAllocdBlocks);
 
@@ -246,14 +250,200 @@ RtlpClearFreeListsBit(PHEAP Heap,
     Heap->u.FreeListsInUseBytes[Index] ^= Bit;
 }
 
+C_ASSERT((1 << HEAP_FREE_INDEX_BASE_SHIFT) == HEAP_FREELISTS);
+
+FORCEINLINE
+ULONG
+RtlpGetFreeIndexSlot(SIZE_T Size)
+{
+    ULONG Octave;
+
+    /* Everything in the non-dedicated list is at least this big */
+    if (Size < HEAP_FREELISTS)
+        return 0;
+
+    ASSERT(Size <= MAXUSHORT);
+    BitScanReverse(&Octave, (ULONG)Size);
+
+    return ((Octave - HEAP_FREE_INDEX_BASE_SHIFT) << HEAP_FREE_INDEX_SLOT_SHIFT) |
+           ((ULONG)(Size >> (Octave - HEAP_FREE_INDEX_SLOT_SHIFT)) & ((1 << HEAP_FREE_INDEX_SLOT_SHIFT) - 1));
+}
+
+VOID NTAPI
+RtlpCreateFreeIndex(PHEAP Heap)
+{
+    PHEAP_FREE_INDEX FreeIndex = NULL;
+    PLIST_ENTRY FreeListHead, Current;
+    PHEAP_FREE_ENTRY FreeEntry;
+    SIZE_T Size = sizeof(HEAP_FREE_INDEX);
+    ULONG Slot;
+    NTSTATUS Status;
+
+    /* Kernel mode heaps may be shared between processes, so they can't
+       keep it in the current one's address space */
+    if (RtlpGetMode() == KernelMode)
+        return;
+
+    Status = ZwAllocateVirtualMemory(NtCurrentProcess(),
+                                     (PVOID *)&FreeIndex,
+                                     0,
+                                     &Size,
+                                     MEM_RESERVE | MEM_COMMIT,
+                                     PAGE_READWRITE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("HEAP: Failed to allocate the free index for heap %p, Status 0x%08X\n", Heap, Status);
+        return;
+    }
+
+    /* The list is sorted, so the first block seen in every slot is its hint */
+    FreeListHead = &Heap->FreeLists[0];
+    for (Current = FreeListHead->Flink; Current != FreeListHead; Current = Current->Flink)
+    {
+        FreeEntry = CONTAINING_RECORD(Current, HEAP_FREE_ENTRY, FreeList);
+        Slot = RtlpGetFreeIndexSlot(FreeEntry->Size);
+
+        if (!FreeIndex->Hints[Slot])
+        {
+            FreeIndex->Hints[Slot] = Current;
+            FreeIndex->SlotsInUse[Slot >> 5] |= 1 << (Slot & 31);
+        }
+    }
+
+    Heap->BlocksIndex = FreeIndex;
+}
+
+VOID NTAPI
+RtlpDestroyFreeIndex(PHEAP Heap)
+{
+    PVOID BaseAddress = Heap->BlocksIndex;
+    SIZE_T Size = 0;
+
+    if (!BaseAddress) return;
+
+    Heap->BlocksIndex = NULL;
+    ZwFreeVirtualMemory(NtCurrentProcess(),
+                        &BaseAddress,
+                        &Size,
+                        MEM_RELEASE);
+}
+
+/* Returns the first entry of the non-dedicated list which is at least Size
+   big, or the list head if there is none */
+PLIST_ENTRY NTAPI
+RtlpFindNonDedicatedPosition(PHEAP Heap,
+                             SIZE_T Size)
+{
+    PHEAP_FREE_INDEX FreeIndex = Heap->BlocksIndex;
+    PLIST_ENTRY FreeListHead, Current;
+    ULONG Slot, Word, Bits;
+
+    FreeListHead = &Heap->FreeLists[0];
+    if (Size > MAXUSHORT)
+        return FreeListHead;
+
+    if (FreeIndex)
+    {
+        /* Jump to the first used slot which may fit */
+        Slot = RtlpGetFreeIndexSlot(Size);
+        Word = Slot >> 5;
+        Bits = FreeIndex->SlotsInUse[Word] & ~((1 << (Slot & 31)) - 1);
+
+        while (!Bits)
+        {
+            if (++Word == HEAP_FREE_INDEX_SLOTS / 32)
+                return FreeListHead;
+
+            Bits = FreeIndex->SlotsInUse[Word];
+        }
+
+        Current = FreeIndex->Hints[(Word << 5) + RtlpFindLeastSetBit(Bits)];
+    }
+    else
+    {
+        Current = FreeListHead->Flink;
+    }
+
+    /* With an index, only blocks of the requested slot can be too small */
+    while (Current != FreeListHead &&
+           CONTAINING_RECORD(Current, HEAP_FREE_ENTRY, FreeList)->Size < Size)
+    {
+        Current = Current->Flink;
+    }
+
+    return Current;
+}
+
+/* Called after a block was linked into the non-dedicated list */
+VOID NTAPI
+RtlpInsertFreeIndex(PHEAP Heap,
+                    PHEAP_FREE_ENTRY FreeEntry)
+{
+    PHEAP_FREE_INDEX FreeIndex = Heap->BlocksIndex;
+    PLIST_ENTRY Hint;
+    ULONG Slot;
+
+    Heap->NonDedicatedListLength++;
+
+    if (!FreeIndex)
+    {
+        /* Short lists are walked just fine. Don't retry a failed allocation
+           on every insertion */
+        if (Heap->NonDedicatedListLength % HEAP_FREE_INDEX_THRESHOLD == 0)
+            RtlpCreateFreeIndex(Heap);
+
+        return;
+    }
+
+    /* It went in before every block of the same size or bigger */
+    Slot = RtlpGetFreeIndexSlot(FreeEntry->Size);
+    Hint = FreeIndex->Hints[Slot];
+
+    if (!Hint ||
+        CONTAINING_RECORD(Hint, HEAP_FREE_ENTRY, FreeList)->Size >= FreeEntry->Size)
+    {
+        FreeIndex->Hints[Slot] = &FreeEntry->FreeList;
+        FreeIndex->SlotsInUse[Slot >> 5] |= 1 << (Slot & 31);
+    }
+}
+
+/* Called before a block is unlinked from the non-dedicated list */
+VOID NTAPI
+RtlpRemoveFreeIndex(PHEAP Heap,
+                    PHEAP_FREE_ENTRY FreeEntry)
+{
+    PHEAP_FREE_INDEX FreeIndex = Heap->BlocksIndex;
+    PLIST_ENTRY Next;
+    ULONG Slot;
+
+    Heap->NonDedicatedListLength--;
+
+    if (!FreeIndex) return;
+
+    Slot = RtlpGetFreeIndexSlot(FreeEntry->Size);
+    if (FreeIndex->Hints[Slot] != &FreeEntry->FreeList) return;
+
+    /* Hand the hint over to the next block if it's in the same slot */
+    Next = FreeEntry->FreeList.Flink;
+    if (Next != &Heap->FreeLists[0] &&
+        RtlpGetFreeIndexSlot(CONTAINING_RECORD(Next, HEAP_FREE_ENTRY, FreeList)->Size) == Slot)
+    {
+        FreeIndex->Hints[Slot] = Next;
+    }
+    else
+    {
+        FreeIndex->Hints[Slot] = NULL;
+        FreeIndex->SlotsInUse[Slot >> 5] &= ~(1 << (Slot & 31));
+    }
+}
+
 VOID NTAPI
 RtlpInsertFreeBlockHelper(PHEAP Heap,
                           PHEAP_FREE_ENTRY FreeEntry,
                           SIZE_T BlockSize,
                           BOOLEAN NoFill)
 {
-    PLIST_ENTRY FreeListHead, Current;
-    PHEAP_FREE_ENTRY CurrentEntry;
+    PLIST_ENTRY FreeListHead;
 
     ASSERT(FreeEntry->Size == BlockSize);
 
@@ -292,26 +482,15 @@ RtlpInsertFreeBlockHelper(PHEAP Heap,
     }
     else
     {
-        /* Non-dedicated one */
-        FreeListHead = &Heap->FreeLists[0];
-        Current = FreeListHead->Flink;
-
-        /* Find a position where to insert it to (the list must be sorted) */
-        while (FreeListHead != Current)
-        {
-            CurrentEntry = CONTAINING_RECORD(Current, HEAP_FREE_ENTRY, FreeList);
-
-            if (BlockSize <= CurrentEntry->Size)
-                break;
-
-            Current = Current->Flink;
-        }
-
-        FreeListHead = Current;
+        /* Non-dedicated one. Find a position where to insert it to (the list must be sorted) */
+        FreeListHead = RtlpFindNonDedicatedPosition(Heap, BlockSize);
     }
 
     /* Actually insert it into the list */
     InsertTailList(FreeListHead, &FreeEntry->FreeList);
+
+    if (BlockSize >= HEAP_FREELISTS)
+        RtlpInsertFreeIndex(Heap, FreeEntry);
 }
 
 VOID NTAPI
@@ -386,6 +565,10 @@ RtlpRemoveFreeBlock(PHEAP Heap,
 {
     SIZE_T Result, RealSize;
 
+    /* Keep the size index of the non-dedicated list in sync */
+    if (!Dedicated && FreeEntry->Size >= HEAP_FREELISTS)
+        RtlpRemoveFreeIndex(Heap, FreeEntry);
+
     /* Remove the free block and update the freelists bitmap */
     if (RemoveEntryList(&FreeEntry->FreeList) &&
         (Dedicated || (!Dedicated && FreeEntry->Size < HEAP_FREELISTS)))
@@ -1584,6 +1767,12 @@ RtlDestroyHeap(HANDLE HeapPtr) /* [in] Handle of heap */
         RtlpRemoveHeapFromProcessList(Heap);
     }
 
+    /* Release the front end heap, if there is any */
+    RtlpDestroyLowFragHeap(Heap);
+
+    /* Release the size index of the non-dedicated list */
+    RtlpDestroyFreeIndex(Heap);
+
     /* Delete the heap lock */
     if (!(Heap->Flags & HEAP_NO_SERIALIZE))
     {
@@ -1784,55 +1973,48 @@ RtlpAllocateNonDedicated(PHEAP Heap,
         {
             /* Our request is smaller than the largest entry in the zero list */
 
-            /* Go through the list to find insertion place */
-            Next = FreeListHead->Flink;
-            while (FreeListHead != Next)
+            /* Find the minimally fitting entry */
+            Next = RtlpFindNonDedicatedPosition(Heap, Index);
+            if (FreeListHead != Next)
             {
                 FreeBlock = CONTAINING_RECORD(Next, HEAP_FREE_ENTRY, FreeList);
 
-                if (FreeBlock->Size >= Index)
-                {
-                    /* Found minimally fitting entry. Proceed to either using it as it is
-                    or splitting it to two entries */
-                    RemoveEntryList(&FreeBlock->FreeList);
-
-                    /* Split it */
-                    InUseEntry = RtlpSplitEntry(Heap, Flags, FreeBlock, AllocationSize, Index, Size);
+                /* Proceed to either using it as it is or splitting it to two entries */
+                RtlpRemoveFreeBlock(Heap, FreeBlock, FALSE, TRUE);
 
-                    /* Release the lock */
-                    if (HeapLocked) RtlLeaveHeapLock(Heap->LockVariable);
+                /* Split it */
+                InUseEntry = RtlpSplitEntry(Heap, Flags, FreeBlock, AllocationSize, Index, Size);
 
-                    /* Zero memory if that was requested */
-                    if (Flags & HEAP_ZERO_MEMORY)
-                        RtlZeroMemory(InUseEntry + 1, Size);
-                    else if (Heap->Flags & HEAP_FREE_CHECKING_ENABLED)
-                    {
-                        /* Fill this block with a special pattern */
-                        RtlFillMemoryUlong(InUseEntry + 1, Size & ~0x3, ARENA_INUSE_FILLER);
-                    }
+                /* Release the lock */
+                if (HeapLocked) RtlLeaveHeapLock(Heap->LockVariable);
 
-                    /* Fill tail of the block with a special pattern too if requested */
-                    if (Heap->Flags & HEAP_TAIL_CHECKING_ENABLED)
-                    {
-                        RtlFillMemory((PCHAR)(InUseEntry + 1) + Size, sizeof(HEAP_ENTRY), HEAP_TAIL_FILL);
-                        InUseEntry->Flags |= HEAP_ENTRY_FILL_PATTERN;
-                    }
+                /* Zero memory if that was requested */
+                if (Flags & HEAP_ZERO_MEMORY)
+                    RtlZeroMemory(InUseEntry + 1, Size);
+                else if (Heap->Flags & HEAP_FREE_CHECKING_ENABLED)
+                {
+                    /* Fill this block with a special pattern */
+                    RtlFillMemoryUlong(InUseEntry + 1, Size & ~0x3, ARENA_INUSE_FILLER);
+                }
 
-                    /* Prepare extra if it's present */
-                    if (InUseEntry->Flags & HEAP_ENTRY_EXTRA_PRESENT)
-                    {
-                        Extra = RtlpGetExtraStuffPointer(InUseEntry);
-                        RtlZeroMemory(Extra, sizeof(HEAP_ENTRY_EXTRA));
+                /* Fill tail of the block with a special pattern too if requested */
+                if (Heap->Flags & HEAP_TAIL_CHECKING_ENABLED)
+                {
+                    RtlFillMemory((PCHAR)(InUseEntry + 1) + Size, sizeof(HEAP_ENTRY), HEAP_TAIL_FILL);
+                    InUseEntry->Flags |= HEAP_ENTRY_FILL_PATTERN;
+                }
 
-                        // TODO: Tagging
-                    }
+                /* Prepare extra if it's present */
+                if (InUseEntry->Flags & HEAP_ENTRY_EXTRA_PRESENT)
+                {
+                    Extra = RtlpGetExtraStuffPointer(InUseEntry);
+                    RtlZeroMemory(Extra, sizeof(HEAP_ENTRY_EXTRA));
 
-                    /* Return pointer to the */
-                    return InUseEntry + 1;
+                    // TODO: Tagging
                 }
 
-                /* Advance to the next entry */
-                Next = Next->Flink;
+                /* Return pointer to the */
+                return InUseEntry + 1;
             }
         }
     }
@@ -1843,7 +2025,7 @@ RtlpAllocateNonDedicated(PHEAP Heap,
     /* Use the new biggest entry we've got */
     if (FreeBlock)
     {
-        RemoveEntryList(&FreeBlock->FreeList);
+        RtlpRemoveFreeBlock(Heap, FreeBlock, FALSE, TRUE);
 
         /* Split it */
         InUseEntry = RtlpSplitEntry(Heap, Flags, FreeBlock, AllocationSize, Index, Size);
@@ -1928,6 +2110,7 @@ RtlAllocateHeap(IN PVOID HeapPtr,
     BOOLEAN HeapLocked = FALSE;
     PHEAP_VIRTUAL_ALLOC_ENTRY VirtualBlock = NULL;
     PHEAP_ENTRY_EXTRA Extra;
+    PVOID FrontEndBlock;
     NTSTATUS Status;
 
     /* Force flags */
@@ -1977,6 +2160,15 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 
     Index = AllocationSize >> HEAP_ENTRY_SHIFT;
 
+    /* Small blocks without extra stuff come from the front end heap if it's active */
+    if (Index < HEAP_LFH_BUCKETS &&
+        Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP &&
+        !(EntryFlags & HEAP_ENTRY_EXTRA_PRESENT))
+    {
+        FrontEndBlock = RtlpLowFragHeapAlloc(Heap, Flags, Size, AllocationSize);
+        if (FrontEndBlock) return FrontEndBlock;
+    }
+
     /* Acquire the lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2147,60 +2339,26 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 }
 
 
-/***********************************************************************
- *           HeapFree   (KERNEL32.338)
- * RETURNS
- * TRUE: Success
- * FALSE: Failure
- *
- * @implemented
- */
-BOOLEAN NTAPI RtlFreeHeap(
-   HANDLE HeapPtr, /* [in] Handle of heap */
-   ULONG Flags,   /* [in] Heap freeing flags */
-   PVOID Ptr     /* [in] Address of memory to free */
-)
+/* Returns a busy block to the free lists, or to the system if it was
+   allocated directly. The heap lock must be held by the caller */
+BOOLEAN NTAPI
+RtlpFreeHeapEntry(PHEAP Heap,
+                  PHEAP_ENTRY HeapEntry)
 {
-    PHEAP Heap;
-    PHEAP_ENTRY HeapEntry;
     USHORT TagIndex = 0;
     SIZE_T BlockSize;
     PHEAP_VIRTUAL_ALLOC_ENTRY VirtualEntry;
-    BOOLEAN Locked = FALSE;
     NTSTATUS Status;
 
-    /* Freeing NULL pointer is a legal operation */
-    if (!Ptr) return TRUE;
-
-    /* Get pointer to the heap and force flags */
-    Heap = (PHEAP)HeapPtr;
-    Flags |= Heap->ForceFlags;
-
-    /* Call special heap */
-    if (RtlpHeapIsSpecial(Flags))
-        return RtlDebugFreeHeap(Heap, Flags, Ptr);
-
-    /* Lock if necessary */
-    if (!(Flags & HEAP_NO_SERIALIZE))
-    {
-        RtlEnterHeapLock(Heap->LockVariable, TRUE);
-        Locked = TRUE;
-    }
-
-    /* Get pointer to the heap entry */
-    HeapEntry = (PHEAP_ENTRY)Ptr - 1;
-
     /* Check this entry, fail if it's invalid */
     if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
-        (((ULONG_PTR)Ptr & 0x7) != 0) ||
+        (((ULONG_PTR)(HeapEntry + 1) & 0x7) != 0) ||
         (HeapEntry->SegmentOffset >= HEAP_SEGMENTS))
     {
         /* This is an invalid block */
-        DPRINT1("HEAP: Trying to free an invalid address %p!\n", Ptr);
+        DPRINT1("HEAP: Trying to free an invalid address %p!\n", HeapEntry + 1);
         RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
 
-        /* Release the heap lock */
-        if (Locked) RtlLeaveHeapLock(Heap->LockVariable);
         return FALSE;
     }
 
@@ -2223,7 +2381,7 @@ BOOLEAN NTAPI RtlFreeHeap(
         if (!NT_SUCCESS(Status))
         {
             DPRINT1("HEAP: Failed releasing memory with Status 0x%08X. Heap %p, ptr %p, base address %p\n",
-                Status, Heap, Ptr, VirtualEntry);
+                Status, Heap, HeapEntry + 1, VirtualEntry);
             RtlSetLastWin32ErrorAndNtStatusFromNtStatus(Status);
         }
     }
@@ -2284,10 +2442,60 @@ BOOLEAN NTAPI RtlFreeHeap(
         }
     }
 
+    return TRUE;
+}
+
+/***********************************************************************
+ *           HeapFree   (KERNEL32.338)
+ * RETURNS
+ * TRUE: Success
+ * FALSE: Failure
+ *
+ * @implemented
+ */
+BOOLEAN NTAPI RtlFreeHeap(
+   HANDLE HeapPtr, /* [in] Handle of heap */
+   ULONG Flags,   /* [in] Heap freeing flags */
+   PVOID Ptr     /* [in] Address of memory to free */
+)
+{
+    PHEAP Heap;
+    PHEAP_ENTRY HeapEntry;
+    BOOLEAN Locked = FALSE;
+    BOOLEAN Result;
+
+    /* Freeing NULL pointer is a legal operation */
+    if (!Ptr) return TRUE;
+
+    /* Get pointer to the heap and force flags */
+    Heap = (PHEAP)HeapPtr;
+    Flags |= Heap->ForceFlags;
+
+    /* Call special heap */
+    if (RtlpHeapIsSpecial(Flags))
+        return RtlDebugFreeHeap(Heap, Flags, Ptr);
+
+    /* Get pointer to the heap entry */
+    HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+
+    /* Front end heap blocks are freed without taking the heap lock */
+    if (RtlpIsLowFragHeapEntry(Heap, HeapEntry))
+        return RtlpLowFragHeapFree(Heap, Flags, HeapEntry);
+
+    /* Lock if necessary */
+    if (!(Flags & HEAP_NO_SERIALIZE))
+    {
+        RtlEnterHeapLock(Heap->LockVariable, TRUE);
+        Locked = TRUE;
+    }
+
+    /* Give the block back to the backend */
+    Result = RtlpFreeHeapEntry(Heap, HeapEntry);
+
     /* Release the heap lock */
     if (Locked) RtlLeaveHeapLock(Heap->LockVariable);
 
-    return TRUE;
+    return Result;
 }
 
 BOOLEAN NTAPI
@@ -2590,6 +2798,10 @@ RtlReAllocateHeap(HANDLE HeapPtr,
         return NULL;
     }
 
+    /* Front end heap blocks are resized by the front end */
+    if (RtlpIsLowFragHeapEntry(Heap, (PHEAP_ENTRY)Ptr - 1))
+        return RtlpLowFragHeapReAlloc(Heap, Flags, Ptr, Size);
+
     /* Calculate allocation size and index */
     if (Size)
         AllocationSize = Size;
@@ -3154,6 +3366,10 @@ RtlpValidateHeapEntry(
     if ((ULONG_PTR)HeapEntry & (HEAP_ENTRY_SIZE - 1)) goto invalid_entry;
     if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY)) goto invalid_entry;
 
+    /* Front end heap blocks are checked against their subsegment */
+    if (RtlpIsLowFragHeapEntry(Heap, HeapEntry))
+        return RtlpValidateLowFragHeapEntry(Heap, HeapEntry);
+
     BigAllocation = HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC;
     Segment = Heap->Segments[HeapEntry->SegmentOffset];
 
@@ -3384,6 +3600,60 @@ RtlpValidateHeapSegment(
     return TRUE;
 }
 
+BOOLEAN NTAPI
+RtlpValidateFreeIndex(PHEAP Heap)
+{
+    PHEAP_FREE_INDEX FreeIndex = Heap->BlocksIndex;
+    PLIST_ENTRY ListHead, NextEntry;
+    PHEAP_FREE_ENTRY FreeEntry;
+    ULONG Slot, PreviousSlot = MAXULONG, Count = 0;
+    BOOLEAN InUse;
+
+    ListHead = &Heap->FreeLists[0];
+    for (NextEntry = ListHead->Flink; NextEntry != ListHead; NextEntry = NextEntry->Flink)
+    {
+        FreeEntry = CONTAINING_RECORD(NextEntry, HEAP_FREE_ENTRY, FreeList);
+        Count++;
+
+        if (!FreeIndex) continue;
+
+        /* The first entry of every slot is its hint */
+        Slot = RtlpGetFreeIndexSlot(FreeEntry->Size);
+        if (Slot != PreviousSlot &&
+            (FreeIndex->Hints[Slot] != NextEntry ||
+             !(FreeIndex->SlotsInUse[Slot >> 5] & (1 << (Slot & 31)))))
+        {
+            DPRINT1("HEAP: Free index slot %lx has hint %p instead of %p\n", Slot, FreeIndex->Hints[Slot], NextEntry);
+            return FALSE;
+        }
+
+        PreviousSlot = Slot;
+    }
+
+    if (Count != Heap->NonDedicatedListLength)
+    {
+        DPRINT1("HEAP: Non dedicated list has %lu entries, %lu expected\n", Count, Heap->NonDedicatedListLength);
+        return FALSE;
+    }
+
+    if (!FreeIndex) return TRUE;
+
+    /* And there are no stale hints */
+    for (Slot = 0; Slot < HEAP_FREE_INDEX_SLOTS; Slot++)
+    {
+        InUse = (FreeIndex->SlotsInUse[Slot >> 5] & (1 << (Slot & 31))) != 0;
+
+        if (InUse != (FreeIndex->Hints[Slot] != NULL) ||
+            (InUse && RtlpGetFreeIndexSlot(CONTAINING_RECORD(FreeIndex->Hints[Slot], HEAP_FREE_ENTRY, FreeList)->Size) != Slot))
+        {
+            DPRINT1("HEAP: Free index slot %lx is inconsistent\n", Slot);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 BOOLEAN NTAPI
 RtlpValidateHeap(PHEAP Heap,
                  BOOLEAN ForceValidation)
@@ -3479,6 +3749,10 @@ RtlpValidateHeap(PHEAP Heap,
         ListHead++;
     }
 
+    /* Check the size index of the non-dedicated list */
+    if (!RtlpValidateFreeIndex(Heap))
+        return FALSE;
+
     /* Check big allocations */
     ListHead = &Heap->VirtualAllocdBlocks;
     NextEntry = ListHead->Flink;
@@ -3918,13 +4192,18 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
         }
 
         /* Check for a special magic value for enabling LFH */
-        if (*(PULONG)HeapInformation != 2)
+        if (*(PULONG)HeapInformation != HEAP_FRONT_LOWFRAGHEAP)
         {
             return STATUS_UNSUCCESSFUL;
         }
 
-        DPRINT1("RtlSetHeapInformation() needs to enable LFH\n");
-        return STATUS_SUCCESS;
+        if (!HeapHandle)
+        {
+            return STATUS_INVALID_PARAMETER;
+        }
+
+        /* Put the low fragmentation heap in front of this heap */
+        return RtlpActivateLowFragHeap((PHEAP)HeapHandle);
     }
 
     return STATUS_SUCCESS;
@@ -3963,7 +4242,108 @@ RtlQueryHeapInformation(HANDLE HeapHandle,
     return STATUS_UNSUCCESSFUL;
 }
 
-NTSTATUS
+/* Takes the smallest free block of at least Index units off the free lists.
+   The heap lock must be held by the caller */
+PHEAP_FREE_ENTRY NTAPI
+RtlpFindFreeBlock(PHEAP Heap,
+                  SIZE_T Index)
+{
+    PULONG FreeListsInUse;
+    ULONG FreeListsInUseUlong;
+    PLIST_ENTRY FreeListHead, Next;
+    PHEAP_FREE_ENTRY FreeBlock;
+    SIZE_T InUseIndex, i;
+
+    if (Index < HEAP_FREELISTS)
+    {
+        /* Same bitmap walk as RtlAllocateHeap */
+        InUseIndex = Index >> 5;
+        FreeListsInUse = &Heap->u.FreeListsInUseUlong[InUseIndex];
+        FreeListsInUseUlong = *FreeListsInUse++ & ~((1 << ((ULONG)Index & 0x1f)) - 1);
+
+        for (i = InUseIndex; i < 4; i++)
+        {
+            if (FreeListsInUseUlong)
+            {
+                FreeListHead = &Heap->FreeLists[i * 32] + RtlpFindLeastSetBit(FreeListsInUseUlong);
+                FreeBlock = CONTAINING_RECORD(FreeListHead->Blink, HEAP_FREE_ENTRY, FreeList);
+                RtlpRemoveFreeBlock(Heap, FreeBlock, TRUE, FALSE);
+                return FreeBlock;
+            }
+
+            if (i < 3) FreeListsInUseUlong = *FreeListsInUse++;
+        }
+    }
+
+    /* The non-dedicated list is sorted, the first fitting block is the smallest */
+    Next = RtlpFindNonDedicatedPosition(Heap, Index);
+    if (Next == &Heap->FreeLists[0])
+        return NULL;
+
+    FreeBlock = CONTAINING_RECORD(Next, HEAP_FREE_ENTRY, FreeList);
+    RtlpRemoveFreeBlock(Heap, FreeBlock, FALSE, FALSE);
+    return FreeBlock;
+}
+
+/* Cuts Count busy blocks of Index units each off the start of a free block
+   taken off the free lists. The last one goes through RtlpSplitEntry, which
+   gives back the rest */
+VOID NTAPI
+RtlpCarveFreeBlock(PHEAP Heap,
+                   ULONG Flags,
+                   PHEAP_FREE_ENTRY FreeBlock,
+                   SIZE_T AllocationSize,
+                   SIZE_T Index,
+                   SIZE_T Size,
+                   ULONG Count,
+                   PHEAP_ENTRY *Entries)
+{
+    UCHAR FreeFlags, EntryFlags = HEAP_ENTRY_BUSY;
+    PHEAP_ENTRY InUseEntry, NextEntry;
+    SIZE_T BlockSize;
+    ULONG i;
+
+    ASSERT(Count > 0 && FreeBlock->Size >= Index * Count);
+
+    EntryFlags |= (Flags & HEAP_SETTABLE_USER_FLAGS) >> 4;
+
+    FreeFlags = FreeBlock->Flags;
+    BlockSize = FreeBlock->Size;
+    InUseEntry = (PHEAP_ENTRY)FreeBlock;
+
+    for (i = 0; i < Count - 1; i++)
+    {
+        /* Previous size and segment offset are already right */
+        InUseEntry->Flags = EntryFlags;
+        InUseEntry->SmallTagIndex = 0;
+        InUseEntry->Size = (USHORT)Index;
+        InUseEntry->UnusedBytes = (UCHAR)(AllocationSize - Size);
+        Entries[i] = InUseEntry;
+
+        NextEntry = InUseEntry + Index;
+        NextEntry->PreviousSize = (USHORT)Index;
+        NextEntry->SegmentOffset = InUseEntry->SegmentOffset;
+        InUseEntry = NextEntry;
+    }
+
+    Heap->TotalFreeSize -= Index * (Count - 1);
+
+    /* What's left is a free block again, as far as RtlpSplitEntry cares */
+    FreeBlock = (PHEAP_FREE_ENTRY)InUseEntry;
+    FreeBlock->Flags = FreeFlags;
+    FreeBlock->Size = (USHORT)(BlockSize - Index * (Count - 1));
+    Entries[Count - 1] = RtlpSplitEntry(Heap, Flags, FreeBlock, AllocationSize, Index, Size);
+
+    /* When nothing was split off, the following entry still has the size of the whole block */
+    InUseEntry = Entries[Count - 1];
+    if (!(InUseEntry->Flags & HEAP_ENTRY_LAST_ENTRY))
+        (InUseEntry + InUseEntry->Size)->PreviousSize = InUseEntry->Size;
+}
+
+/*
+ * @implemented
+ */
+ULONG
 NTAPI
 RtlMultipleAllocateHeap(IN PVOID HeapHandle,
                         IN ULONG Flags,
@@ -3971,19 +4351,187 @@ RtlMultipleAllocateHeap(IN PVOID HeapHandle,
                         IN ULONG Count,
                         OUT PVOID *Array)
 {
-    UNIMPLEMENTED;
-    return 0;
+    PHEAP Heap = (PHEAP)HeapHandle;
+    PHEAP_FREE_ENTRY FreeBlock;
+    PHEAP_ENTRY *Entries;
+    SIZE_T AllocationSize, Index, Wanted;
+    ULONG Allocated = 0, Carved, First, i;
+    EXCEPTION_RECORD ExceptionRecord;
+    BOOLEAN HeapLocked = FALSE;
+
+    if (!Count) return 0;
+
+    /* Force flags */
+    Flags |= Heap->ForceFlags;
+
+    /* Calculate allocation size and index, like RtlAllocateHeap does */
+    AllocationSize = ((Size ? Size : 1) + Heap->AlignRound) & Heap->AlignMask;
+    Index = AllocationSize >> HEAP_ENTRY_SHIFT;
+
+    /* Debug heaps, blocks with extra stuff and big blocks can't be carved
+       from a common free block, so they go one by one */
+    if (RtlpHeapIsSpecial(Flags) ||
+        (Flags & HEAP_EXTRA_FLAGS_MASK) ||
+        Heap->PseudoTagEntries ||
+        Size >= 0x80000000 ||
+        Index > Heap->VirtualMemoryThreshold)
+    {
+        for (; Allocated < Count; Allocated++)
+        {
+            Array[Allocated] = RtlAllocateHeap(Heap, Flags, Size);
+            if (!Array[Allocated]) break;
+        }
+
+        return Allocated;
+    }
+
+    /* The front end heap doesn't need the heap lock for small blocks */
+    if (Index < HEAP_LFH_BUCKETS &&
+        Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP)
+    {
+        for (; Allocated < Count; Allocated++)
+        {
+            Array[Allocated] = RtlpLowFragHeapAlloc(Heap, Flags, Size, AllocationSize);
+            if (!Array[Allocated]) break;
+        }
+
+        if (Allocated == Count) return Allocated;
+    }
+
+    /* Entries are collected in the caller's array and turned into user
+       pointers once the lock is gone */
+    Entries = (PHEAP_ENTRY *)Array;
+
+    if (!(Flags & HEAP_NO_SERIALIZE))
+    {
+        RtlEnterHeapLock(Heap->LockVariable, TRUE);
+        HeapLocked = TRUE;
+    }
+
+    First = Allocated;
+    while (Allocated < Count)
+    {
+        /* Try to fit everything that's left into one free block */
+        Wanted = min(Count - Allocated, HEAP_MAX_BLOCK_SIZE / Index) * Index;
+
+        FreeBlock = RtlpFindFreeBlock(Heap, Wanted);
+        if (!FreeBlock && RtlpExtendHeap(Heap, Wanted << HEAP_ENTRY_SHIFT))
+            FreeBlock = RtlpFindFreeBlock(Heap, Wanted);
+
+        /* Settle for less if memory is tight or fragmented */
+        if (!FreeBlock)
+            FreeBlock = RtlpFindFreeBlock(Heap, Index);
+        if (!FreeBlock)
+            break;
+
+        Carved = (ULONG)min(Count - Allocated, FreeBlock->Size / Index);
+        RtlpCarveFreeBlock(Heap, Flags, FreeBlock, AllocationSize, Index, Size,
+                           Carved, &Entries[Allocated]);
+        Allocated += Carved;
+    }
+
+    if (HeapLocked) RtlLeaveHeapLock(Heap->LockVariable);
+
+    for (i = First; i < Allocated; i++)
+    {
+        /* Zero memory if that was requested */
+        if (Flags & HEAP_ZERO_MEMORY)
+            RtlZeroMemory(Entries[i] + 1, Size);
+        else if (Heap->Flags & HEAP_FREE_CHECKING_ENABLED)
+        {
+            /* Fill this block with a special pattern */
+            RtlFillMemoryUlong(Entries[i] + 1, Size & ~0x3, ARENA_INUSE_FILLER);
+        }
+
+        /* Fill tail of the block with a special pattern too if requested */
+        if (Heap->Flags & HEAP_TAIL_CHECKING_ENABLED)
+        {
+            RtlFillMemory((PCHAR)(Entries[i] + 1) + Size, sizeof(HEAP_ENTRY), HEAP_TAIL_FILL);
+            Entries[i]->Flags |= HEAP_ENTRY_FILL_PATTERN;
+        }
+
+        /* User data starts right after the entry's header */
+        Array[i] = Entries[i] + 1;
+    }
+
+    if (Allocated < Count)
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_NO_MEMORY);
+
+        /* Generate an exception */
+        if (Flags & HEAP_GENERATE_EXCEPTIONS)
+        {
+            ExceptionRecord.ExceptionCode = STATUS_NO_MEMORY;
+            ExceptionRecord.ExceptionRecord = NULL;
+            ExceptionRecord.NumberParameters = 1;
+            ExceptionRecord.ExceptionFlags = 0;
+            ExceptionRecord.ExceptionInformation[0] = AllocationSize;
+
+            RtlRaiseException(&ExceptionRecord);
+        }
+
+        DPRINT1("HEAP: Allocated only %lu of %lu blocks!\n", Allocated, Count);
+    }
+
+    return Allocated;
 }
 
-NTSTATUS
+/*
+ * @implemented
+ */
+ULONG
 NTAPI
 RtlMultipleFreeHeap(IN PVOID HeapHandle,
                     IN ULONG Flags,
                     IN ULONG Count,
-                    OUT PVOID *Array)
+                    IN PVOID *Array)
 {
-    UNIMPLEMENTED;
-    return 0;
+    PHEAP Heap = (PHEAP)HeapHandle;
+    PHEAP_ENTRY HeapEntry;
+    BOOLEAN HeapLocked = FALSE;
+    ULONG Freed;
+
+    /* Force flags */
+    Flags |= Heap->ForceFlags;
+
+    /* Debug heaps validate every block on their own */
+    if (RtlpHeapIsSpecial(Flags))
+    {
+        for (Freed = 0; Freed < Count; Freed++)
+        {
+            if (!RtlFreeHeap(Heap, Flags, Array[Freed])) break;
+        }
+
+        return Freed;
+    }
+
+    for (Freed = 0; Freed < Count; Freed++)
+    {
+        /* Freeing NULL pointer is a legal operation */
+        if (!Array[Freed]) continue;
+
+        HeapEntry = (PHEAP_ENTRY)Array[Freed] - 1;
+
+        /* Front end heap blocks are freed without taking the heap lock */
+        if (RtlpIsLowFragHeapEntry(Heap, HeapEntry))
+        {
+            if (!RtlpLowFragHeapFree(Heap, Flags, HeapEntry)) break;
+            continue;
+        }
+
+        /* Take the lock once, at the first backend block */
+        if (!HeapLocked && !(Flags & HEAP_NO_SERIALIZE))
+        {
+            RtlEnterHeapLock(Heap->LockVariable, TRUE);
+            HeapLocked = TRUE;
+        }
+
+        if (!RtlpFreeHeapEntry(Heap, HeapEntry)) break;
+    }
+
+    if (HeapLocked) RtlLeaveHeapLock(Heap->LockVariable);
+
+    return Freed;
 }
 
 /* EOF */
@@ -55,6 +55,25 @@
 /* Segment flags */
 #define HEAP_USER_ALLOCATED    0x1
 
+/* Front end heap types */
+#define HEAP_FRONT_NONE        0
+#define HEAP_FRONT_LOWFRAGHEAP 2
+
+/* Low fragmentation heap definitions */
+#define HEAP_LFH_BUCKETS            HEAP_FREELISTS
+#define HEAP_LFH_MAX_SLOTS          32
+#define HEAP_LFH_SEGMENT_OFFSET     0xFF
+#define HEAP_LFH_SUBSEGMENT_SIZE    (4 * PAGE_SIZE)
+#define HEAP_LFH_MIN_BLOCK_COUNT    16
+#define HEAP_SUBSEGMENT_SIGNATURE   0x5342534C /* 'LSBS' */
+
+/* Size index of the non-dedicated free list. Sizes from HEAP_FREELISTS up to
+   MAXUSHORT are split into octaves of 32 slots each */
+#define HEAP_FREE_INDEX_BASE_SHIFT  7
+#define HEAP_FREE_INDEX_SLOT_SHIFT  5
+#define HEAP_FREE_INDEX_SLOTS       ((16 - HEAP_FREE_INDEX_BASE_SHIFT) << HEAP_FREE_INDEX_SLOT_SHIFT)
+#define HEAP_FREE_INDEX_THRESHOLD   64
+
 /* A handy inline to distinguis normal heap, special "debug heap" and special "page heap" */
 FORCEINLINE BOOLEAN
 RtlpHeapIsSpecial(ULONG Flags)
@@ -203,6 +222,14 @@ typedef struct _HEAP_LIST_LOOKUP
     PLIST_ENTRY *ListHints;
 } HEAP_LIST_LOOKUP, *PHEAP_LIST_LOOKUP;
 
+/* Points at the first, smallest, free block of every slot in the sorted
+   non-dedicated list, so a search only walks blocks sharing the slot */
+typedef struct _HEAP_FREE_INDEX
+{
+    ULONG SlotsInUse[HEAP_FREE_INDEX_SLOTS / (sizeof(ULONG) * 8)];
+    PLIST_ENTRY Hints[HEAP_FREE_INDEX_SLOTS];
+} HEAP_FREE_INDEX, *PHEAP_FREE_INDEX;
+
 typedef struct _HEAP
 {
     HEAP_ENTRY Entry;
@@ -250,7 +277,7 @@ typedef struct _HEAP
     struct _HEAP_SEGMENT *Segments[HEAP_SEGMENTS]; //FIXME: non-Vista
     USHORT AllocatorBackTraceIndex;
     ULONG NonDedicatedListLength;
-    PVOID BlocksIndex; // HEAP_LIST_LOOKUP
+    PVOID BlocksIndex; // FIXME: HEAP_LIST_LOOKUP on Vista, HEAP_FREE_INDEX here
     PVOID UCRIndex;
     PHEAP_PSEUDO_TAG_ENTRY PseudoTagEntries;
     LIST_ENTRY FreeLists[HEAP_FREELISTS]; //FIXME: non-Vista
@@ -327,6 +354,49 @@ typedef struct _HEAP_VIRTUAL_ALLOC_ENTRY
     HEAP_ENTRY BusyBlock;
 } HEAP_VIRTUAL_ALLOC_ENTRY, *PHEAP_VIRTUAL_ALLOC_ENTRY;
 
+/* Low fragmentation heap structures */
+typedef struct _HEAP_SUBSEGMENT
+{
+    SLIST_HEADER FreeBlocks;
+    LIST_ENTRY BucketEntry;
+    struct _HEAP_LFH_SLOT *Owner;
+    ULONG Signature;
+    USHORT BucketIndex;
+    USHORT BlockUnits;
+    ULONG BlockCount;
+    volatile LONG FreeCount;
+} HEAP_SUBSEGMENT, *PHEAP_SUBSEGMENT;
+
+#define HEAP_SUBSEGMENT_HEADER_UNITS \
+    (ROUND_UP(sizeof(HEAP_SUBSEGMENT), sizeof(HEAP_ENTRY)) >> HEAP_ENTRY_SHIFT)
+
+typedef struct _HEAP_LFH_SLOT
+{
+    PHEAP_LOCK Lock;
+    HEAP_LOCK LockStorage;
+    PHEAP_SUBSEGMENT ActiveSubSegment[HEAP_LFH_BUCKETS];
+} HEAP_LFH_SLOT, *PHEAP_LFH_SLOT;
+
+typedef struct _HEAP_LFH
+{
+    PHEAP Heap;
+    SIZE_T Size;
+    ULONG SlotCount;
+    ULONG SlotMask;
+    LIST_ENTRY Buckets[HEAP_LFH_BUCKETS];
+    ULONG SubSegmentsCreated;
+    ULONG SubSegmentsDestroyed;
+    HEAP_LFH_SLOT Slots[ANYSIZE_ARRAY];
+} HEAP_LFH, *PHEAP_LFH;
+
+/* Tells whether a busy entry was handed out by the low fragmentation heap */
+FORCEINLINE BOOLEAN
+RtlpIsLowFragHeapEntry(PHEAP Heap, PHEAP_ENTRY HeapEntry)
+{
+    return (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP) &&
+           (HeapEntry->SegmentOffset == HEAP_LFH_SEGMENT_OFFSET);
+}
+
 /* Global variables */
 extern RTL_CRITICAL_SECTION RtlpProcessHeapsListLock;
 extern BOOLEAN RtlpPageHeapEnabled;
@@ -352,6 +422,34 @@ RtlpValidateHeapEntry(PHEAP Heap, PHEAP_ENTRY HeapEntry);
 BOOLEAN NTAPI
 RtlpValidateHeapHeaders(PHEAP Heap, BOOLEAN Recalculate);
 
+/* heaplfh.c */
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap);
+
+VOID NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap);
+
+PVOID NTAPI
+RtlpLowFragHeapAlloc(PHEAP Heap,
+                     ULONG Flags,
+                     SIZE_T Size,
+                     SIZE_T AllocationSize);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    ULONG Flags,
+                    PHEAP_ENTRY HeapEntry);
+
+PVOID NTAPI
+RtlpLowFragHeapReAlloc(PHEAP Heap,
+                       ULONG Flags,
+                       PVOID Ptr,
+                       SIZE_T Size);
+
+BOOLEAN NTAPI
+RtlpValidateLowFragHeapEntry(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry);
+
 /* heapdbg.c */
 HANDLE NTAPI
 RtlDebugCreateHeap(ULONG Flags,
@@ -0,0 +1,488 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS system libraries
+ * FILE:            lib/rtl/heaplfh.c
+ * PURPOSE:         RTL Low Fragmentation Heap (front end allocator)
+ * PROGRAMMERS:     ReactOS Team
+ */
+
+/* Useful references:
+   http://illmatics.com/Understanding_the_LFH.pdf
+   http://msdn.microsoft.com/en-us/library/aa366750(VS.85).aspx
+*/
+
+/* The low fragmentation heap sits in front of the usual heap backend.
+   Requests which fit into a dedicated free list size are served from
+   subsegments: backend blocks carved into equally sized LFH blocks of a
+   single size class (bucket). Every bucket has one active subsegment per
+   affinity slot, so threads running in different slots never share a lock
+   on the allocation path. Frees don't take any lock at all, they just push
+   the block back onto its subsegment free list. The backend heap lock is
+   only taken when a slot needs a new active subsegment, and it is always
+   acquired before a slot lock. */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+#include <heap.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* FUNCTIONS *****************************************************************/
+
+FORCEINLINE
+PHEAP_LFH_SLOT
+RtlpGetLowFragHeapSlot(PHEAP_LFH Lfh)
+{
+    /* Thread IDs are multiples of 4, so drop the low bits to spread threads
+       across all the affinity slots */
+    return &Lfh->Slots[(HandleToUlong(NtCurrentTeb()->ClientId.UniqueThread) >> 2) & Lfh->SlotMask];
+}
+
+FORCEINLINE
+PHEAP_SUBSEGMENT
+RtlpGetSubSegmentFromEntry(PHEAP_ENTRY HeapEntry)
+{
+    /* PreviousSize holds the block index inside its subsegment */
+    return (PHEAP_SUBSEGMENT)(HeapEntry -
+                              (HeapEntry->PreviousSize * HeapEntry->Size) -
+                              HEAP_SUBSEGMENT_HEADER_UNITS);
+}
+
+PHEAP_SUBSEGMENT NTAPI
+RtlpCreateSubSegment(PHEAP_LFH Lfh,
+                     SIZE_T Index)
+{
+    PHEAP_SUBSEGMENT SubSegment;
+    PHEAP_ENTRY FirstBlock, Block;
+    SIZE_T BlockSize, TotalSize;
+    ULONG BlockCount, i;
+
+    /* Calculate how many blocks of this size class fit into a subsegment */
+    BlockSize = Index << HEAP_ENTRY_SHIFT;
+    BlockCount = (ULONG)(HEAP_LFH_SUBSEGMENT_SIZE / BlockSize);
+    if (BlockCount < HEAP_LFH_MIN_BLOCK_COUNT)
+        BlockCount = HEAP_LFH_MIN_BLOCK_COUNT;
+
+    TotalSize = (HEAP_SUBSEGMENT_HEADER_UNITS << HEAP_ENTRY_SHIFT) + BlockCount * BlockSize;
+
+    /* The request is way beyond the front end sizes, so it goes to the backend.
+       The caller already owns the heap lock. */
+    ASSERT((TotalSize >> HEAP_ENTRY_SHIFT) >= HEAP_LFH_BUCKETS);
+    SubSegment = RtlAllocateHeap(Lfh->Heap, HEAP_NO_SERIALIZE, TotalSize);
+    if (!SubSegment) return NULL;
+
+    /* Initialize the subsegment header */
+    RtlInitializeSListHead(&SubSegment->FreeBlocks);
+    SubSegment->Owner = NULL;
+    SubSegment->Signature = HEAP_SUBSEGMENT_SIGNATURE;
+    SubSegment->BucketIndex = (USHORT)Index;
+    SubSegment->BlockUnits = (USHORT)Index;
+    SubSegment->BlockCount = BlockCount;
+    SubSegment->FreeCount = BlockCount;
+
+    /* Carve it into blocks. Push them backwards, so that the lowest address
+       is handed out first */
+    FirstBlock = (PHEAP_ENTRY)SubSegment + HEAP_SUBSEGMENT_HEADER_UNITS;
+    for (i = BlockCount; i > 0; i--)
+    {
+        Block = FirstBlock + (i - 1) * Index;
+
+        Block->Size = (USHORT)Index;
+        Block->Flags = 0;
+        Block->SmallTagIndex = 0;
+        Block->PreviousSize = (USHORT)(i - 1);
+        Block->SegmentOffset = HEAP_LFH_SEGMENT_OFFSET;
+        Block->UnusedBytes = 0;
+
+        RtlInterlockedPushEntrySList(&SubSegment->FreeBlocks, (PSLIST_ENTRY)(Block + 1));
+    }
+
+    /* Register it in its bucket */
+    InsertHeadList(&Lfh->Buckets[Index], &SubSegment->BucketEntry);
+    Lfh->SubSegmentsCreated++;
+
+    DPRINT("LFH %p: new subsegment %p, %lu blocks of %Iu bytes\n", Lfh, SubSegment, BlockCount, BlockSize);
+
+    return SubSegment;
+}
+
+VOID NTAPI
+RtlpDestroySubSegment(PHEAP_LFH Lfh,
+                      PHEAP_SUBSEGMENT SubSegment)
+{
+    /* Only unowned subsegments without any busy block can go away */
+    ASSERT(SubSegment->Owner == NULL);
+    ASSERT(SubSegment->FreeCount == (LONG)SubSegment->BlockCount);
+
+    RemoveEntryList(&SubSegment->BucketEntry);
+    SubSegment->Signature = 0;
+    Lfh->SubSegmentsDestroyed++;
+
+    /* Give it back to the backend. The caller already owns the heap lock. */
+    RtlFreeHeap(Lfh->Heap, HEAP_NO_SERIALIZE, SubSegment);
+}
+
+PHEAP_SUBSEGMENT NTAPI
+RtlpLowFragHeapRefillSlot(PHEAP_LFH Lfh,
+                          PHEAP_LFH_SLOT Slot,
+                          SIZE_T Index)
+{
+    PHEAP_SUBSEGMENT SubSegment, OldSubSegment, Candidate, EmptySubSegment = NULL;
+    PLIST_ENTRY BucketHead, Current;
+    LONG FreeCount;
+
+    /* The caller owns both the heap lock, which protects the bucket lists,
+       and the slot lock */
+    BucketHead = &Lfh->Buckets[Index];
+
+    /* Give up the exhausted subsegment. It's most likely full, so move it to the tail */
+    OldSubSegment = Slot->ActiveSubSegment[Index];
+    if (OldSubSegment)
+    {
+        OldSubSegment->Owner = NULL;
+        Slot->ActiveSubSegment[Index] = NULL;
+
+        RemoveEntryList(&OldSubSegment->BucketEntry);
+        InsertTailList(BucketHead, &OldSubSegment->BucketEntry);
+    }
+
+    /* Look for an unowned subsegment with free blocks, preferring partially used ones */
+    SubSegment = NULL;
+    Current = BucketHead->Flink;
+    while (Current != BucketHead)
+    {
+        Candidate = CONTAINING_RECORD(Current, HEAP_SUBSEGMENT, BucketEntry);
+        Current = Current->Flink;
+
+        if (Candidate->Owner) continue;
+
+        FreeCount = Candidate->FreeCount;
+
+        if (FreeCount == (LONG)Candidate->BlockCount)
+        {
+            /* Keep one completely free subsegment around, release the others */
+            if (!EmptySubSegment)
+                EmptySubSegment = Candidate;
+            else
+                RtlpDestroySubSegment(Lfh, Candidate);
+        }
+        else if (FreeCount != 0)
+        {
+            /* Found a partially used one */
+            SubSegment = Candidate;
+            break;
+        }
+    }
+
+    /* Fall back to the free one, or create a brand new subsegment */
+    if (!SubSegment) SubSegment = EmptySubSegment;
+    if (!SubSegment) SubSegment = RtlpCreateSubSegment(Lfh, Index);
+
+    /* Make it active for this slot */
+    if (SubSegment)
+    {
+        SubSegment->Owner = Slot;
+        Slot->ActiveSubSegment[Index] = SubSegment;
+    }
+
+    return SubSegment;
+}
+
+PVOID NTAPI
+RtlpLowFragHeapAlloc(PHEAP Heap,
+                     ULONG Flags,
+                     SIZE_T Size,
+                     SIZE_T AllocationSize)
+{
+    PHEAP_LFH Lfh = (PHEAP_LFH)Heap->FrontEndHeap;
+    PHEAP_LFH_SLOT Slot;
+    PHEAP_SUBSEGMENT SubSegment;
+    PSLIST_ENTRY FreeBlock = NULL;
+    PHEAP_ENTRY InUseEntry;
+    SIZE_T Index;
+
+    Index = AllocationSize >> HEAP_ENTRY_SHIFT;
+    ASSERT(Index < HEAP_LFH_BUCKETS);
+
+    /* Get this thread's affinity slot and lock it */
+    Slot = RtlpGetLowFragHeapSlot(Lfh);
+    RtlEnterHeapLock(Slot->Lock, TRUE);
+
+    /* Try the active subsegment first. Only the slot owner pops from it,
+       while frees may push concurrently */
+    SubSegment = Slot->ActiveSubSegment[Index];
+    if (SubSegment)
+        FreeBlock = RtlInterlockedPopEntrySList(&SubSegment->FreeBlocks);
+
+    if (!FreeBlock)
+    {
+        /* It's exhausted. The heap lock always comes before a slot lock,
+           so drop the slot and reacquire both in the right order */
+        RtlLeaveHeapLock(Slot->Lock);
+        RtlEnterHeapLock(Heap->LockVariable, TRUE);
+        RtlEnterHeapLock(Slot->Lock, TRUE);
+
+        /* Somebody else sharing this slot may have refilled it meanwhile */
+        SubSegment = Slot->ActiveSubSegment[Index];
+        if (SubSegment)
+            FreeBlock = RtlInterlockedPopEntrySList(&SubSegment->FreeBlocks);
+
+        if (!FreeBlock)
+        {
+            SubSegment = RtlpLowFragHeapRefillSlot(Lfh, Slot, Index);
+            if (SubSegment)
+                FreeBlock = RtlInterlockedPopEntrySList(&SubSegment->FreeBlocks);
+        }
+
+        RtlLeaveHeapLock(Heap->LockVariable);
+    }
+
+    if (!FreeBlock)
+    {
+        /* Let the backend deal with it */
+        RtlLeaveHeapLock(Slot->Lock);
+        return NULL;
+    }
+
+    InterlockedDecrement(&SubSegment->FreeCount);
+    RtlLeaveHeapLock(Slot->Lock);
+
+    /* Size, block index and segment offset were set when the subsegment was carved */
+    InUseEntry = (PHEAP_ENTRY)FreeBlock - 1;
+    ASSERT(InUseEntry->Size == Index);
+    ASSERT(InUseEntry->SegmentOffset == HEAP_LFH_SEGMENT_OFFSET);
+
+    InUseEntry->Flags = HEAP_ENTRY_BUSY | ((Flags & HEAP_SETTABLE_USER_FLAGS) >> 4);
+    InUseEntry->SmallTagIndex = 0;
+    InUseEntry->UnusedBytes = (UCHAR)(AllocationSize - Size);
+
+    /* Zero memory if that was requested */
+    if (Flags & HEAP_ZERO_MEMORY)
+        RtlZeroMemory(InUseEntry + 1, Size);
+
+    return InUseEntry + 1;
+}
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    ULONG Flags,
+                    PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_SUBSEGMENT SubSegment;
+
+    /* Make sure the block really belongs to the front end */
+    if (!RtlpValidateLowFragHeapEntry(Heap, HeapEntry))
+    {
+        DPRINT1("HEAP: Trying to free an invalid address %p!\n", HeapEntry + 1);
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return FALSE;
+    }
+
+    SubSegment = RtlpGetSubSegmentFromEntry(HeapEntry);
+
+    /* Mark it as free and put it back. The subsegment must not be touched
+       after its free count was updated, since it may be released right away */
+    HeapEntry->Flags = 0;
+    RtlInterlockedPushEntrySList(&SubSegment->FreeBlocks, (PSLIST_ENTRY)(HeapEntry + 1));
+    InterlockedIncrement(&SubSegment->FreeCount);
+
+    return TRUE;
+}
+
+PVOID NTAPI
+RtlpLowFragHeapReAlloc(PHEAP Heap,
+                       ULONG Flags,
+                       PVOID Ptr,
+                       SIZE_T Size)
+{
+    PHEAP_ENTRY InUseEntry = (PHEAP_ENTRY)Ptr - 1;
+    SIZE_T AllocationSize, OldSize;
+    EXCEPTION_RECORD ExceptionRecord;
+    PVOID NewBaseAddress;
+
+    if (!RtlpValidateLowFragHeapEntry(Heap, InUseEntry))
+    {
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus(STATUS_INVALID_PARAMETER);
+        return Ptr;
+    }
+
+    /* Calculate allocation size of the new block */
+    AllocationSize = (Size ? Size : 1);
+    AllocationSize = (AllocationSize + Heap->AlignRound) & Heap->AlignMask;
+
+    OldSize = (InUseEntry->Size << HEAP_ENTRY_SHIFT) - InUseEntry->UnusedBytes;
+
+    /* Same size class without extra stuff, so it can be done in place */
+    if ((AllocationSize >> HEAP_ENTRY_SHIFT) == InUseEntry->Size &&
+        !(Flags & HEAP_EXTRA_FLAGS_MASK))
+    {
+        InUseEntry->UnusedBytes = (UCHAR)(AllocationSize - Size);
+
+        if (Size > OldSize && (Flags & HEAP_ZERO_MEMORY))
+            RtlZeroMemory((PCHAR)Ptr + OldSize, Size - OldSize);
+
+        return Ptr;
+    }
+
+    if (Flags & HEAP_REALLOC_IN_PLACE_ONLY)
+    {
+        DPRINT1("Realloc in place failed, but it was the only option\n");
+
+        if (Flags & HEAP_GENERATE_EXCEPTIONS)
+        {
+            ExceptionRecord.ExceptionCode = STATUS_NO_MEMORY;
+            ExceptionRecord.ExceptionRecord = NULL;
+            ExceptionRecord.NumberParameters = 1;
+            ExceptionRecord.ExceptionFlags = 0;
+            ExceptionRecord.ExceptionInformation[0] = AllocationSize;
+
+            RtlRaiseException(&ExceptionRecord);
+        }
+
+        return NULL;
+    }
+
+    /* Move it into a block of a different size class */
+    NewBaseAddress = RtlAllocateHeap(Heap, Flags & ~HEAP_ZERO_MEMORY, Size);
+    if (!NewBaseAddress) return NULL;
+
+    RtlMoveMemory(NewBaseAddress, Ptr, min(Size, OldSize));
+
+    if (Size > OldSize && (Flags & HEAP_ZERO_MEMORY))
+        RtlZeroMemory((PCHAR)NewBaseAddress + OldSize, Size - OldSize);
+
+    RtlpLowFragHeapFree(Heap, Flags, InUseEntry);
+
+    return NewBaseAddress;
+}
+
+BOOLEAN NTAPI
+RtlpValidateLowFragHeapEntry(PHEAP Heap,
+                             PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_SUBSEGMENT SubSegment;
+
+    if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY)) goto invalid_entry;
+    if (!HeapEntry->Size || HeapEntry->Size >= HEAP_LFH_BUCKETS) goto invalid_entry;
+
+    SubSegment = RtlpGetSubSegmentFromEntry(HeapEntry);
+
+    if (SubSegment->Signature != HEAP_SUBSEGMENT_SIGNATURE ||
+        SubSegment->BlockUnits != HeapEntry->Size ||
+        HeapEntry->PreviousSize >= SubSegment->BlockCount)
+    {
+        goto invalid_entry;
+    }
+
+    return TRUE;
+
+invalid_entry:
+    DPRINT1("HEAP: Invalid LFH entry %p in heap %p\n", HeapEntry, Heap);
+    return FALSE;
+}
+
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH Lfh = NULL;
+    ULONG SlotCount, Index;
+    SIZE_T Size;
+    NTSTATUS Status;
+
+    /* The front end only exists for serialized, non debug user mode heaps */
+    if (RtlpGetMode() != UserMode ||
+        (Heap->ForceFlags & HEAP_FLAG_PAGE_ALLOCS) ||
+        Heap->Signature != HEAP_SIGNATURE ||
+        RtlpHeapIsSpecial(Heap->Flags) ||
+        (Heap->Flags & (HEAP_NO_SERIALIZE |
+                        HEAP_CREATE_ALIGN_16 |
+                        HEAP_TAIL_CHECKING_ENABLED |
+                        HEAP_FREE_CHECKING_ENABLED)))
+    {
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    /* One affinity slot per processor, rounded up to a power of two */
+    SlotCount = 1;
+    while (SlotCount < RtlGetCurrentPeb()->NumberOfProcessors &&
+           SlotCount < HEAP_LFH_MAX_SLOTS)
+    {
+        SlotCount <<= 1;
+    }
+
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    /* Nothing to do if it's already there */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_LOWFRAGHEAP)
+    {
+        RtlLeaveHeapLock(Heap->LockVariable);
+        return STATUS_SUCCESS;
+    }
+
+    Size = FIELD_OFFSET(HEAP_LFH, Slots[SlotCount]);
+    Status = ZwAllocateVirtualMemory(NtCurrentProcess(),
+                                     (PVOID *)&Lfh,
+                                     0,
+                                     &Size,
+                                     MEM_RESERVE | MEM_COMMIT,
+                                     PAGE_READWRITE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("HEAP: Failed to allocate the LFH for heap %p, Status 0x%08X\n", Heap, Status);
+        RtlLeaveHeapLock(Heap->LockVariable);
+        return Status;
+    }
+
+    /* Fresh memory is zeroed, so only the non-zero parts need initialization */
+    Lfh->Heap = Heap;
+    Lfh->Size = Size;
+    Lfh->SlotCount = SlotCount;
+    Lfh->SlotMask = SlotCount - 1;
+
+    for (Index = 0; Index < HEAP_LFH_BUCKETS; Index++)
+        InitializeListHead(&Lfh->Buckets[Index]);
+
+    for (Index = 0; Index < SlotCount; Index++)
+    {
+        Lfh->Slots[Index].Lock = &Lfh->Slots[Index].LockStorage;
+        RtlInitializeHeapLock(&Lfh->Slots[Index].Lock);
+    }
+
+    /* Publish it. The type is checked without the heap lock, so it goes last */
+    InterlockedExchangePointer(&Heap->FrontEndHeap, Lfh);
+    Heap->FrontEndHeapType = HEAP_FRONT_LOWFRAGHEAP;
+
+    RtlLeaveHeapLock(Heap->LockVariable);
+
+    DPRINT("Enabled LFH %p with %lu slots for heap %p\n", Lfh, SlotCount, Heap);
+
+    return STATUS_SUCCESS;
+}
+
+VOID NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH Lfh = (PHEAP_LFH)Heap->FrontEndHeap;
+    PVOID BaseAddress;
+    SIZE_T Size = 0;
+    ULONG Index;
+
+    if (Heap->FrontEndHeapType != HEAP_FRONT_LOWFRAGHEAP) return;
+
+    /* Subsegments live in the heap segments and vanish together with them */
+    for (Index = 0; Index < Lfh->SlotCount; Index++)
+        RtlDeleteHeapLock(Lfh->Slots[Index].Lock);
+
+    Heap->FrontEndHeapType = HEAP_FRONT_NONE;
+    Heap->FrontEndHeap = NULL;
+
+    BaseAddress = Lfh;
+    ZwFreeVirtualMemory(NtCurrentProcess(),
+                        &BaseAddress,
+                        &Size,
+                        MEM_RELEASE);
+}
+
+/* EOF */
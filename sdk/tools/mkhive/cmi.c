@@ -85,6 +85,35 @@ CmpFileWrite(
     return (fwrite(Buffer, 1, BufferLength, File) == BufferLength);
 }
 
+static BOOLEAN
+NTAPI
+CmpFileWriteGather(
+    IN PHHIVE RegistryHive,
+    IN ULONG FileType,
+    IN PHV_WRITE_SEGMENT Segments,
+    IN ULONG SegmentCount)
+{
+    PCMHIVE CmHive = (PCMHIVE)RegistryHive;
+    FILE *File = CmHive->FileHandles[HFILE_TYPE_PRIMARY];
+    ULONG i;
+
+    for (i = 0; i < SegmentCount; i++)
+    {
+        /* Only seek when this segment does not follow the previous one */
+        if (i == 0 ||
+            Segments[i].FileOffset != Segments[i - 1].FileOffset + Segments[i - 1].Length)
+        {
+            if (fseek(File, Segments[i].FileOffset, SEEK_SET) != 0)
+                return FALSE;
+        }
+
+        if (fwrite(Segments[i].Buffer, 1, Segments[i].Length, File) != Segments[i].Length)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
 static BOOLEAN
 NTAPI
 CmpFileSetSize(
@@ -132,6 +161,8 @@ CmiInitializeHive(
                           CmpFileWrite,
                           CmpFileRead,
                           CmpFileFlush,
+                          CmpFileWriteGather,
+                          NULL,
                           1,
                           NULL);
     if (!NT_SUCCESS(Status))